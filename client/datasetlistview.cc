@@ -14,6 +14,9 @@ DataSetListView::DataSetListView(Station &station, QWidget *parent)
   localTable->setModel(&_datadir);
   QTableView *remoteTable = new QTableView();
   remoteTable->setModel(_remoteList);
+  // Download remote datasets on double click
+  connect(remoteTable, SIGNAL(doubleClicked(QModelIndex)),
+          _remoteList, SLOT(download(QModelIndex)));
 
   QTabWidget *tabs = new QTabWidget();
   tabs->addTab(localTable, tr("Local Datasets"));
@@ -12,18 +12,27 @@
 #include <ovlnet/logger.hh>
 #include "lib/audio.hh"
 #include "lib/station.hh"
-#include <fftw3.h>
+#include "lib/dsp/welch.hh"
+#include "lib/dsp/fftplan.hh"
+#include "lib/dsp/kernels.hh"
 #include <cmath>
 
 
 #define N_FFT       8192
 #define N_PSD       (N_FFT/2+1)
-#define N_PSD_SUM   5
+#define N_PSD_AVG   10
 #define N_PLOT      (std::min(1100, N_PSD))
 #define PLOT_OFFSET (N_PSD - N_PLOT)
 #define N_PLOT_HIST 512
 #define DB_MAX      10.
 #define DB_MIN      -40.
+/* Offset of the averaged PSD to the levels of the former sum of 5 unwindowed frames. */
+#define DB_OFFSET   (10*std::log10(5.*N_FFT))
+/* Block size and capacity of the queue of the monitor stage. */
+#define N_BLOCK     4096
+#define N_QUEUE     (1<<16)
+/* Sample rate assumed if the input device is not ready. */
+#define DEFAULT_RATE 46e3
 
 
 /* ****************************************************************************************** *
@@ -89,43 +98,74 @@ LinearColorMap::map(const double &value) {
 }
 
 
+/* ****************************************************************************************** *
+ *  Implementation of MonitorStage
+ * ****************************************************************************************** */
+MonitorStage::MonitorStage(FFTPlanCache &plans, double rate, QObject *parent)
+  : PipelineStage("monitor", N_BLOCK, N_QUEUE, DROP, parent), _rate(rate), _psd(0),
+    _db(N_PLOT, 0)
+{
+  // Mean over Hann windowed frames with 50% overlap, samples scaled to [-1,1)
+  _psd = new WelchPSD(plans, _rate, _rate/N_FFT, 0.5,
+                      WindowFunction::HANN, WelchPSD::LINEAR, N_PSD_AVG, 1./(1<<15));
+}
+
+MonitorStage::~MonitorStage() {
+  // Stop the worker before the estimator gets destroyed
+  stop();
+  wait();
+  delete _psd;
+}
+
+double
+MonitorStage::rate() const {
+  return _rate;
+}
+
+void
+MonitorStage::process(const int16_t *samples, size_t n) {
+  while (n) {
+    size_t m = _psd->process(samples, n);
+    samples += m; n -= m;
+    // If a new estimate is available -> pass levels to the plot
+    if (_psd->completed()) {
+      dsp_log_power(_psd->psd().constData()+PLOT_OFFSET, DB_OFFSET, _db.data(), N_PLOT);
+      emit spectrum(_db);
+    }
+  }
+}
+
+
 /* ****************************************************************************************** *
  *  Implementation of MonitorView
  * ****************************************************************************************** */
 MonitorView::MonitorView(const QAudioDeviceInfo &device, Application &app, QWidget *parent)
-  : QWidget(parent), _application(app), _input(0), _fftInBuffer(0), _nFFTBuffer(0),
-    _fftwOutBuffer(0), _psd(0), _psdSumCount(0),
+  : QWidget(parent), _application(app), _input(0), _stage(0),
     _colormap(QVector<QColor> {Qt::black, Qt::red, Qt::yellow, Qt::white}, DB_MIN, DB_MAX),
     _plot(N_PLOT, N_PLOT_HIST)
 {
   _input = new Audio(device, this);
-
-  _fftInBuffer = new double[N_FFT]; _nFFTBuffer = N_FFT;
-  _fftwOutBuffer = new double[N_FFT];
-  _fft = fftw_plan_r2r_1d(N_FFT, _fftInBuffer, _fftwOutBuffer, FFTW_R2HC, FFTW_ESTIMATE);
-  _psd = new double[N_PSD];
-
   _plot.fill(Qt::black);
 
+  qRegisterMetaType< QVector<float> >("QVector<float>");
   connect(_input, SIGNAL(stream(const int16_t*,size_t)),
           this, SLOT(processStream(const int16_t*,size_t)));
 
+  _createStage();
   _input->start();
 }
 
 MonitorView::~MonitorView() {
-  fftw_destroy_plan(_fft);
-  if (_fftInBuffer)
-    delete[] _fftInBuffer;
-  if (_fftwOutBuffer)
-    delete[] _fftwOutBuffer;
-  if (_psd)
-    delete[] _psd;
+  delete _stage;
 }
 
 bool
 MonitorView::setDevice(const QAudioDeviceInfo &device) {
   if (_input->setDevice(device)) {
+    // The new device may run at another rate
+    if (_input->sampleRate() != _stage->rate()) {
+      _createStage();
+    }
     return _input->start();
   }
   return false;
@@ -133,50 +173,16 @@ MonitorView::setDevice(const QAudioDeviceInfo &device) {
 
 void
 MonitorView::processStream(const int16_t *data, size_t len) {
-  while (len) {
-    // Determine number of samples to store in buffer
-    size_t n = std::min(len, _nFFTBuffer);
-    // store in buffer
-    size_t offset = N_FFT-_nFFTBuffer;
-    for (size_t i=0; i<n; i++) {
-      _fftInBuffer[offset+i] = double(data[i])/(1<<15);
-    }
-    // Update counts
-    _nFFTBuffer -= n; len -= n;
-    // If buffer is full -> update plot
-    if (0 == _nFFTBuffer) {
-      // Perform FFT
-      fftw_execute(_fft);
-      updatePSD();
-      _nFFTBuffer = N_FFT;
-    }
-  }
-}
-
-void
-MonitorView::updatePSD() {
-  _psd[0] += _fftwOutBuffer[0]*_fftwOutBuffer[0];
-  for (size_t i=1; i<N_PSD; i++) {
-    _psd[i] +=
-          _fftwOutBuffer[i]*_fftwOutBuffer[i]
-          + _fftwOutBuffer[N_FFT-i]*_fftwOutBuffer[N_FFT-i];
-  }
-  _psdSumCount++;
-  if (N_PSD_SUM == _psdSumCount) {
-    updatePlot();
-    // Reset PSD sum
-    for (size_t i=0; i<N_PSD; i++) { _psd[i] = 0; }
-    _psdSumCount = 0;
-  }
+  // Estimate the spectrum on the pipeline stage
+  _stage->push(data, len);
 }
 
 void
-MonitorView::updatePlot() {
+MonitorView::updatePlot(const QVector<float> &levels) {
   QPainter painter(&_plot);
   painter.drawPixmap(0, 0, _plot, 0, 1, N_PLOT, N_PLOT_HIST);
   for (int i=1; i<N_PLOT; i++) {
-    double db = 10*std::log10(_psd[PLOT_OFFSET+i-1])
-        /*- 10*std::log10(N_FFT) - 10*std::log10(N_PSD_SUM)*/;
+    double db = levels[i-1];
     db = std::max(DB_MIN, std::min(db, DB_MAX));
     painter.setPen(_colormap(db));
     painter.drawLine(i-1, N_PLOT_HIST-1, i, N_PLOT_HIST-1);
@@ -192,9 +198,19 @@ MonitorView::paintEvent(QPaintEvent *evt) {
   drawKnownStations(painter);
 }
 
+void
+MonitorView::_createStage() {
+  delete _stage;
+  double rate = _input->ready() ? _input->sampleRate() : DEFAULT_RATE;
+  _stage = new MonitorStage(_application.station().fftPlans(), rate);
+  _application.station().pipeline().add(_stage);
+  connect(_stage, SIGNAL(spectrum(QVector<float>)), this, SLOT(updatePlot(QVector<float>)));
+  _stage->start();
+}
+
 void
 MonitorView::drawKnownStations(QPainter &painter) {
-  double Fs=48e3, dF=Fs/N_FFT, F0=dF*PLOT_OFFSET;
+  double Fs=_stage->rate(), dF=Fs/N_FFT, F0=dF*PLOT_OFFSET;
   QMap<QString, double> stations;
   stations.insert("ALPHA",  14.880952e3);
   stations.insert("JXN",  16.4e3);
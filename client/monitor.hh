@@ -3,7 +3,11 @@
 
 #include <QWidget>
 #include <QAudioDeviceInfo>
-#include <fftw3.h>
+#include <QVector>
+#include "lib/pipeline.hh"
+
+class WelchPSD;
+class FFTPlanCache;
 
 class Application;
 class Audio;
@@ -67,6 +71,36 @@ protected:
 };
 
 
+/** Pipeline stage of the monitor, estimates the spectrum of the input stream. */
+class MonitorStage: public PipelineStage
+{
+  Q_OBJECT
+
+public:
+  /** Constructs the stage for an input stream sampled at @c rate Hz. */
+  MonitorStage(FFTPlanCache &plans, double rate, QObject *parent=0);
+  virtual ~MonitorStage();
+
+  /** Returns the sample rate of the input stream in Hz. */
+  double rate() const;
+
+signals:
+  /** Gets emitted with the levels of the plotted bins in dB on each new estimate. */
+  void spectrum(const QVector<float> &db);
+
+protected:
+  void process(const int16_t *samples, size_t n);
+
+protected:
+  /** Sample rate of the input stream. */
+  double _rate;
+  /** PSD estimate of the input stream. */
+  WelchPSD *_psd;
+  /** Levels of the plotted bins in dB. */
+  QVector<float> _db;
+};
+
+
 class MonitorView : public QWidget
 {
   Q_OBJECT
@@ -79,25 +113,20 @@ public:
 
 protected slots:
   void processStream(const int16_t *data, size_t len);
+  void updatePlot(const QVector<float> &levels);
 
 protected:
-  void updatePSD();
-  void updatePlot();
   void paintEvent(QPaintEvent *evt);
   void drawKnownStations(QPainter &painter);
+  /** (Re-)creates the pipeline stage for the sample rate of the input device. */
+  void _createStage();
 
 protected:
   Application &_application;
   Audio *_input;
 
-  double *_fftInBuffer;
-  size_t _nFFTBuffer;
-  double *_fftwOutBuffer;
-
-  fftw_plan _fft;
-
-  double *_psd;
-  size_t _psdSumCount;
+  /** Estimates the spectrum on a pipeline worker. */
+  MonitorStage *_stage;
 
   LinearColorMap _colormap;
   QPixmap _plot;
@@ -2,6 +2,8 @@
 #include "application.hh"
 #include "lib/station.hh"
 #include "lib/stationlist.hh"
+#include "lib/queryscheduler.hh"
+#include "lib/crawlqueue.hh"
 #include "locationeditdialog.hh"
 #include "osmwidget.hh"
 
@@ -59,6 +61,8 @@ StationListView::StationListView(Application &app, QWidget *parent)
 
   _numNodesLabel = new QLabel("0/0");
   _numSocksLabel = new QLabel("0");
+  _queriesLabel = new QLabel("0/0");
+  _crawlLabel = new QLabel(tr("0 (0.0/min)"));
   _inRateLabel = new QLabel(tr("--- b (--- b/s)"));
   _outRateLabel = new QLabel(tr("--- b (--- b/s)"));
 
@@ -70,9 +74,11 @@ StationListView::StationListView(Application &app, QWidget *parent)
   form_left->addRow(tr("Location"), _locationLabel);
   form_left->addRow(tr("Nodes/Stations"), _numNodesLabel);
   form_left->addRow(tr("Connections"), _numSocksLabel);
+  form_left->addRow(tr("Queries running/queued"), _queriesLabel);
 
   QFormLayout *form_right = new QFormLayout();
   form_right->addRow(tr("State"), _stateLabel);
+  form_right->addRow(tr("Candidates (discovery rate)"), _crawlLabel);
   form_right->addRow(tr("Received"), _inRateLabel);
   form_right->addRow(tr("Send"), _outRateLabel);
 
@@ -107,6 +113,15 @@ StationListView::_onUpdateStats() {
         .arg(QString::number(_application.station().numNodes()))
         .arg(QString::number(_application.station().stations().numStations())));
   _numSocksLabel->setText(QString::number(_application.station().numSockets()));
+  _queriesLabel->setText(
+        QString("%1/%2")
+        .arg(QString::number(_application.station().queries().numRunning()))
+        .arg(QString::number(_application.station().queries().numQueued())));
+  const CrawlQueue &crawler = _application.station().stations().crawler();
+  _crawlLabel->setText(
+        tr("%1 (%2/min)")
+        .arg(QString::number(crawler.numPending()))
+        .arg(QString::number(crawler.discoveryRate(QDateTime::currentMSecsSinceEpoch()), 'f', 1)));
   _inRateLabel->setText(
         tr("%1 (%2/s)")
         .arg(formatVolume(_application.station().bytesReceived()))
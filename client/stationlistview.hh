@@ -29,6 +29,8 @@ protected:
   QLabel *_stateLabel;
   QLabel *_numNodesLabel;
   QLabel *_numSocksLabel;
+  QLabel *_queriesLabel;
+  QLabel *_crawlLabel;
   QLabel *_inRateLabel;
   QLabel *_outRateLabel;
   OSMWidget *_map;
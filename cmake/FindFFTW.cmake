@@ -1,8 +1,8 @@
 # - Find FFTW
-# Find the native FFTW includes and library
+# Find the native FFTW includes and the single precision library
 #
 #  FFTW_INCLUDES    - where to find fftw3.h
-#  FFTW_LIBRARIES   - List of libraries when using FFTW.
+#  FFTW_LIBRARIES   - List of libraries when using FFTW (fftw3f).
 #  FFTW_FOUND       - True if FFTW found.
 
 if (FFTW_INCLUDES)
@@ -12,7 +12,7 @@ endif (FFTW_INCLUDES)
 
 find_path (FFTW_INCLUDES fftw3.h)
 
-find_library (FFTW_LIBRARIES NAMES fftw3)
+find_library (FFTW_LIBRARIES NAMES fftw3f)
 
 # handle the QUIETLY and REQUIRED arguments and set FFTW_FOUND to TRUE if
 # all listed variables are TRUE
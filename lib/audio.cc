@@ -63,6 +63,7 @@ Audio::setDevice(const QAudioDeviceInfo &device) {
   if (ready()) {
     this->stop();
     delete _input;
+    _input = 0;
   }
 
   QAudioFormat format;
@@ -93,6 +94,11 @@ Audio::ready() const {
   return 0 != _input;
 }
 
+double
+Audio::sampleRate() const {
+  return ready() ? _input->format().sampleRate() : 0;
+}
+
 bool Audio::start(double mSec) {
   // Check if input device is ready
   if (! ready()) {
@@ -108,7 +114,7 @@ bool Audio::start(double mSec) {
 
   // Compute samples to record
   if (mSec>0) {
-    _nSamples = 96e3*mSec/1000;
+    _nSamples = _input->format().sampleRate()*mSec/1000;
   } else {
     _nSamples = -1;
   }
@@ -16,10 +16,12 @@ public:
   bool setDevice(const QAudioDeviceInfo &device);
 
   bool ready() const;
+  /** Returns the sample rate of the input device in Hz, 0 if not ready. */
+  double sampleRate() const;
 
 public slots:
-  bool start(double mSec=-1);
-  void stop();
+  virtual bool start(double mSec=-1);
+  virtual void stop();
 
 signals:
   void stream(const int16_t *data, size_t len);
@@ -0,0 +1,211 @@
+#include "binarycodec.hh"
+#include <ovlnet/logger.hh>
+#include <netinet/in.h>
+#include <cstring>
+#include <algorithm>
+
+
+/* ********************************************************************************************* *
+ * Implementation of BinaryCodec
+ * ********************************************************************************************* */
+bool
+BinaryCodec::isBinary(const QByteArray &data) {
+  return data.startsWith(VLF_BINARY_MAGIC);
+}
+
+bool
+BinaryCodec::parseHeader(const char *data, size_t len, Type &type, uint32_t &count) {
+  if (len < VLF_BINARY_HEADER_SIZE) { return false; }
+  if (0 != memcmp(data, VLF_BINARY_MAGIC, 4)) { return false; }
+  if (Version != uint8_t(data[4])) { return false; }
+  type = Type(uint8_t(data[5]));
+  uint32_t n; memcpy(&n, data+6, 4);
+  count = ntohl(n);
+  return true;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of BinaryWriter
+ * ********************************************************************************************* */
+BinaryWriter::BinaryWriter(BinaryCodec::Type type)
+  : _data(), _count(0), _recordStart(-1)
+{
+  _data.append(VLF_BINARY_MAGIC, 4);
+  _data.append(char(BinaryCodec::Version));
+  _data.append(char(type));
+  // Placeholder for the record count
+  writeUInt32(0);
+}
+
+void
+BinaryWriter::beginRecord() {
+  _recordStart = _data.size();
+  // Placeholder for the record length
+  writeUInt16(0);
+}
+
+bool
+BinaryWriter::endRecord() {
+  if (_recordStart < 0) { return false; }
+  size_t length = _data.size()-_recordStart-2;
+  if (length > 0xffff) {
+    // The length does not fit into the prefix, drop the record
+    logWarning() << "Drop binary record of " << length << "b: Record too long.";
+    _data.truncate(_recordStart);
+    _recordStart = -1;
+    return false;
+  }
+  uint16_t len = htons(length);
+  memcpy(_data.data()+_recordStart, &len, 2);
+  _recordStart = -1;
+  // Update record count
+  uint32_t count = htonl(++_count);
+  memcpy(_data.data()+6, &count, 4);
+  return true;
+}
+
+void
+BinaryWriter::writeUInt8(uint8_t value) {
+  _data.append(char(value));
+}
+
+void
+BinaryWriter::writeUInt16(uint16_t value) {
+  value = htons(value);
+  _data.append((const char *) &value, 2);
+}
+
+void
+BinaryWriter::writeUInt32(uint32_t value) {
+  value = htonl(value);
+  _data.append((const char *) &value, 4);
+}
+
+void
+BinaryWriter::writeInt64(int64_t value) {
+  uint64_t v = uint64_t(value);
+  writeUInt32(uint32_t(v >> 32));
+  writeUInt32(uint32_t(v & 0xffffffff));
+}
+
+void
+BinaryWriter::writeFloat(float value) {
+  uint32_t v; memcpy(&v, &value, 4);
+  writeUInt32(v);
+}
+
+void
+BinaryWriter::writeDouble(double value) {
+  int64_t v; memcpy(&v, &value, 8);
+  writeInt64(v);
+}
+
+void
+BinaryWriter::writeIdentifier(const Identifier &id) {
+  _data.append(id.constData(), OVL_HASH_SIZE);
+}
+
+void
+BinaryWriter::writeDateTime(const QDateTime &datetime) {
+  writeInt64(datetime.toMSecsSinceEpoch());
+}
+
+void
+BinaryWriter::writeString(const QString &str) {
+  QByteArray utf8 = str.toUtf8();
+  // Longer strings get the record dropped by endRecord
+  writeUInt16(std::min(utf8.size(), 0xffff));
+  _data.append(utf8);
+}
+
+const QByteArray &
+BinaryWriter::data() const {
+  return _data;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of BinaryReader
+ * ********************************************************************************************* */
+BinaryReader::BinaryReader(const char *data, size_t len)
+  : _data(data), _len(len), _pos(0)
+{
+  // pass...
+}
+
+size_t
+BinaryReader::bytesLeft() const {
+  return _len - _pos;
+}
+
+bool
+BinaryReader::readUInt8(uint8_t &value) {
+  if (bytesLeft() < 1) { return false; }
+  value = uint8_t(_data[_pos++]);
+  return true;
+}
+
+bool
+BinaryReader::readUInt16(uint16_t &value) {
+  if (bytesLeft() < 2) { return false; }
+  memcpy(&value, _data+_pos, 2); _pos += 2;
+  value = ntohs(value);
+  return true;
+}
+
+bool
+BinaryReader::readUInt32(uint32_t &value) {
+  if (bytesLeft() < 4) { return false; }
+  memcpy(&value, _data+_pos, 4); _pos += 4;
+  value = ntohl(value);
+  return true;
+}
+
+bool
+BinaryReader::readInt64(int64_t &value) {
+  uint32_t hi, lo;
+  if (! (readUInt32(hi) && readUInt32(lo))) { return false; }
+  value = int64_t((uint64_t(hi) << 32) | lo);
+  return true;
+}
+
+bool
+BinaryReader::readFloat(float &value) {
+  uint32_t v;
+  if (! readUInt32(v)) { return false; }
+  memcpy(&value, &v, 4);
+  return true;
+}
+
+bool
+BinaryReader::readDouble(double &value) {
+  int64_t v;
+  if (! readInt64(v)) { return false; }
+  memcpy(&value, &v, 8);
+  return true;
+}
+
+bool
+BinaryReader::readIdentifier(Identifier &id) {
+  if (bytesLeft() < OVL_HASH_SIZE) { return false; }
+  id = Identifier(_data+_pos); _pos += OVL_HASH_SIZE;
+  return true;
+}
+
+bool
+BinaryReader::readDateTime(QDateTime &datetime) {
+  int64_t msecs;
+  if (! readInt64(msecs)) { return false; }
+  datetime = QDateTime::fromMSecsSinceEpoch(msecs);
+  return true;
+}
+
+bool
+BinaryReader::readString(QString &str) {
+  uint16_t len;
+  if (! readUInt16(len)) { return false; }
+  if (bytesLeft() < len) { return false; }
+  str = QString::fromUtf8(_data+_pos, len); _pos += len;
+  return true;
+}
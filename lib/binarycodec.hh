@@ -0,0 +1,108 @@
+#ifndef BINARYCODEC_HH
+#define BINARYCODEC_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QDateTime>
+#include <ovlnet/buckets.hh>
+#include <ovlnet/dht_config.hh>
+
+/** Magic bytes prefixing binary encoded responses. */
+#define VLF_BINARY_MAGIC "VLFB"
+/** Size of the header of binary encoded responses (magic, version, type and record count). */
+#define VLF_BINARY_HEADER_SIZE 10
+
+
+/** Compact binary encoding of the station metadata endpoints.
+ * A binary response consists of the magic "VLFB", a version byte, a type byte and the number of
+ * records as a 32bit integer. Each record is prefixed by its length as a 16bit integer, such that
+ * decoders can skip fields added in later versions. All integers and floats are stored in network
+ * byte order, identifiers are stored as raw bytes and date-times as ms since epoch (UTC). */
+class BinaryCodec
+{
+public:
+  /** Record types. */
+  typedef enum {
+    STATUS = 1,    ///< Station info (/status).
+    LIST = 2,      ///< Station identifiers (/list).
+    SCHEDULE = 3,  ///< Scheduled events (/schedule).
+    DATASETS = 4,  ///< Dataset list (/data).
+    DIGEST = 5,    ///< Station list digest (/list/digest).
+    SID_SERIES = 6, ///< SID series list (/sid).
+    SID = 7        ///< SID series rows (/sid?series=...).
+  } Type;
+
+  /** Current version of the encoding. */
+  static const uint8_t Version = 1;
+
+  /** Returns @c true if the given data starts with the magic bytes. */
+  static bool isBinary(const QByteArray &data);
+  /** Parses the header. Returns @c false if the header is invalid. */
+  static bool parseHeader(const char *data, size_t len, Type &type, uint32_t &count);
+};
+
+
+/** Assembles a binary encoded response. */
+class BinaryWriter
+{
+public:
+  /** Starts a new response of the given type. */
+  explicit BinaryWriter(BinaryCodec::Type type);
+
+  /** Starts a new record. */
+  void beginRecord();
+  /** Completes the current record. Records longer than 64kB cannot be encoded, they get dropped
+   * and @c false is returned. */
+  bool endRecord();
+
+  void writeUInt8(uint8_t value);
+  void writeUInt16(uint16_t value);
+  void writeUInt32(uint32_t value);
+  void writeInt64(int64_t value);
+  void writeFloat(float value);
+  void writeDouble(double value);
+  /** Writes the raw bytes of the identifier. */
+  void writeIdentifier(const Identifier &id);
+  /** Writes the date-time as ms since epoch. */
+  void writeDateTime(const QDateTime &datetime);
+  /** Writes a length-prefixed UTF-8 string. Strings longer than 64kB make the record too long. */
+  void writeString(const QString &str);
+
+  /** Returns the encoded response. */
+  const QByteArray &data() const;
+
+protected:
+  QByteArray _data;
+  uint32_t _count;
+  int _recordStart;
+};
+
+
+/** Decodes a single record in place.
+ * All read methods return @c false if the record is too short. */
+class BinaryReader
+{
+public:
+  /** Reads from the given buffer without copying it. */
+  BinaryReader(const char *data, size_t len);
+
+  /** Returns the number of bytes left. */
+  size_t bytesLeft() const;
+
+  bool readUInt8(uint8_t &value);
+  bool readUInt16(uint16_t &value);
+  bool readUInt32(uint32_t &value);
+  bool readInt64(int64_t &value);
+  bool readFloat(float &value);
+  bool readDouble(double &value);
+  bool readIdentifier(Identifier &id);
+  bool readDateTime(QDateTime &datetime);
+  bool readString(QString &str);
+
+protected:
+  const char *_data;
+  size_t _len;
+  size_t _pos;
+};
+
+#endif // BINARYCODEC_HH
@@ -0,0 +1,33 @@
+#include "blobresponse.hh"
+
+
+/* ********************************************************************************************* *
+ * Implementation of HttpBlobResponse
+ * ********************************************************************************************* */
+HttpBlobResponse::HttpBlobResponse(const QByteArray &data, const QString &contentType,
+                                   HttpRequest *request)
+  : HttpResponse(request->version(), HTTP_OK, request->socket()), _data(data), _offset(0),
+    _output(request->socket())
+{
+  setHeader("Content-Type", contentType.toUtf8());
+  setHeader("Content-Length", QByteArray::number(_data.size()));
+  connect(this, SIGNAL(headersSend()), this, SLOT(_onHeadersSend()));
+}
+
+void
+HttpBlobResponse::_onHeadersSend() {
+  connect(_output, SIGNAL(bytesWritten(qint64)), this, SLOT(_onBytesWritten(qint64)));
+  _onBytesWritten(0);
+}
+
+void
+HttpBlobResponse::_onBytesWritten(qint64 bytes) {
+  if (_offset < _data.size()) {
+    qint64 n = _output->write(_data.constData()+_offset, _data.size()-_offset);
+    if (n > 0) { _offset += n; }
+  }
+  if (_offset >= _data.size()) {
+    disconnect(_output, SIGNAL(bytesWritten(qint64)), this, SLOT(_onBytesWritten(qint64)));
+    emit completed();
+  }
+}
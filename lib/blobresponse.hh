@@ -0,0 +1,30 @@
+#ifndef BLOBRESPONSE_HH
+#define BLOBRESPONSE_HH
+
+#include <ovlnet/httpservice.hh>
+
+
+/** Sends a binary blob held in memory as the response body. */
+class HttpBlobResponse: public HttpResponse
+{
+  Q_OBJECT
+
+public:
+  /** Constructs a response to the given request, serving the @c data with the specified
+   * content type. */
+  HttpBlobResponse(const QByteArray &data, const QString &contentType, HttpRequest *request);
+
+protected slots:
+  void _onHeadersSend();
+  void _onBytesWritten(qint64 bytes);
+
+protected:
+  /** The response body. */
+  QByteArray _data;
+  /** Number of bytes already written. */
+  int _offset;
+  /** The connection to write the body to. */
+  QIODevice *_output;
+};
+
+#endif // BLOBRESPONSE_HH
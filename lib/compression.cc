@@ -0,0 +1,121 @@
+#include "compression.hh"
+#include <QFile>
+#include <QSaveFile>
+#include <cstring>
+#include <ovlnet/logger.hh>
+
+
+QByteArray
+deflateData(const QByteArray &data, int level) {
+  uLongf len = compressBound(data.size());
+  QByteArray res(len, 0);
+  if (Z_OK != compress2((Bytef *) res.data(), &len, (const Bytef *) data.constData(),
+                        data.size(), level)) {
+    return QByteArray();
+  }
+  res.resize(len);
+  return res;
+}
+
+bool
+deflateFile(const QString &source, const QString &dest, int level) {
+  QFile in(source);
+  if (! in.open(QIODevice::ReadOnly)) {
+    logError() << "Cannot open " << source << " for compression.";
+    return false;
+  }
+  QSaveFile out(dest);
+  if (! out.open(QIODevice::WriteOnly)) {
+    logError() << "Cannot open " << dest << " for writing.";
+    return false;
+  }
+
+  z_stream stream;
+  memset(&stream, 0, sizeof(z_stream));
+  if (Z_OK != deflateInit(&stream, level)) { return false; }
+
+  char inbuf[1<<16], outbuf[1<<16];
+  int flush = Z_NO_FLUSH, ret = Z_OK;
+  while (Z_STREAM_END != ret) {
+    qint64 n = in.read(inbuf, sizeof(inbuf));
+    if (n < 0) { break; }
+    flush = in.atEnd() ? Z_FINISH : Z_NO_FLUSH;
+    stream.next_in = (Bytef *) inbuf; stream.avail_in = n;
+    do {
+      stream.next_out = (Bytef *) outbuf; stream.avail_out = sizeof(outbuf);
+      ret = ::deflate(&stream, flush);
+      if (Z_STREAM_ERROR == ret) { break; }
+      out.write(outbuf, sizeof(outbuf)-stream.avail_out);
+    } while (0 == stream.avail_out);
+    if ((Z_STREAM_ERROR == ret) || ((Z_FINISH == flush) && (Z_STREAM_END != ret))) { break; }
+  }
+  deflateEnd(&stream);
+
+  if (Z_STREAM_END != ret) {
+    logError() << "Failed to compress " << source << ".";
+    out.cancelWriting();
+    return false;
+  }
+  return out.commit();
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Inflater
+ * ********************************************************************************************* */
+Inflater::Inflater(size_t maxOut)
+  : _maxOut(maxOut), _ok(true), _complete(false)
+{
+  memset(&_stream, 0, sizeof(z_stream));
+  _ok = (Z_OK == inflateInit(&_stream));
+}
+
+Inflater::~Inflater() {
+  inflateEnd(&_stream);
+}
+
+bool
+Inflater::inflate(const QByteArray &data, QByteArray &out) {
+  return inflate(data.constData(), data.size(), out);
+}
+
+bool
+Inflater::inflate(const char *data, size_t len, QByteArray &out) {
+  if (! _ok) { return false; }
+  if (_complete) {
+    // Trailing data after the end of the stream
+    _ok = (0 == len);
+    return _ok;
+  }
+
+  char buffer[1<<16];
+  _stream.next_in = (Bytef *) data; _stream.avail_in = len;
+  do {
+    _stream.next_out = (Bytef *) buffer; _stream.avail_out = sizeof(buffer);
+    int ret = ::inflate(&_stream, Z_NO_FLUSH);
+    if ((Z_OK != ret) && (Z_STREAM_END != ret) && (Z_BUF_ERROR != ret)) {
+      _ok = false; return false;
+    }
+    out.append(buffer, sizeof(buffer)-_stream.avail_out);
+    if (_maxOut && (_stream.total_out > _maxOut)) {
+      _ok = false; return false;
+    }
+    _complete = (Z_STREAM_END == ret);
+  } while ((! _complete) && (0 == _stream.avail_out));
+
+  if (_complete && _stream.avail_in) {
+    // Trailing data after the end of the stream
+    _ok = false;
+  }
+  return _ok;
+}
+
+bool
+Inflater::isComplete() const {
+  return _complete;
+}
+
+size_t
+Inflater::totalOut() const {
+  return _stream.total_out;
+}
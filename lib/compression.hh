@@ -0,0 +1,47 @@
+#ifndef COMPRESSION_HH
+#define COMPRESSION_HH
+
+#include <QByteArray>
+#include <QString>
+#include <zlib.h>
+
+
+/** Compresses the given data into a zlib stream. The default level favours speed. */
+QByteArray deflateData(const QByteArray &data, int level=1);
+
+/** Compresses the file @c source into the file @c dest. The destination is written to a temporary
+ * file first and renamed once complete. Returns @c false on error. */
+bool deflateFile(const QString &source, const QString &dest, int level=6);
+
+
+/** Incremental decompression of a zlib stream. The compressed stream can be passed in arbitrary
+ * chunks. */
+class Inflater
+{
+public:
+  /** Constructor.
+   * @param maxOut Specifies the max. size of the decompressed stream in bytes, 0 means
+   *        unlimited. Decompression stops with an error as soon as the limit is exceeded, such
+   *        that a small malicious stream cannot expand into memory. */
+  Inflater(size_t maxOut=0);
+  /** Destructor. */
+  virtual ~Inflater();
+
+  /** Decompresses the next chunk and appends the result to @c out. Returns @c false on error. */
+  bool inflate(const char *data, size_t len, QByteArray &out);
+  /** Decompresses the next chunk and appends the result to @c out. Returns @c false on error. */
+  bool inflate(const QByteArray &data, QByteArray &out);
+
+  /** Returns @c true if the end of the stream was reached. */
+  bool isComplete() const;
+  /** Returns the number of decompressed bytes. */
+  size_t totalOut() const;
+
+protected:
+  z_stream _stream;
+  size_t _maxOut;
+  bool _ok;
+  bool _complete;
+};
+
+#endif // COMPRESSION_HH
@@ -0,0 +1,138 @@
+#include "crawlqueue.hh"
+#include <algorithm>
+
+/** Window in ms to average the discovery rate over. */
+#define DISCOVERY_RATE_WINDOW 600000
+
+
+/* ********************************************************************************************* *
+ * Implementation of CrawlQueue
+ * ********************************************************************************************* */
+CrawlQueue::CrawlQueue(qint64 minInterval, qint64 maxInterval, qint64 backoff, size_t maxAttempts)
+  : _minInterval(minInterval), _maxInterval(maxInterval), _backoff(backoff),
+    _maxAttempts(maxAttempts), _interval(minInterval), _entries(), _fresh(), _retries(),
+    _discovered(0), _dropped(0), _discoveries()
+{
+  // pass...
+}
+
+bool
+CrawlQueue::add(const Identifier &id, qint64 now) {
+  if (_entries.contains(id)) { return false; }
+  Entry entry = { 0, false };
+  _entries.insert(id, entry);
+  _fresh.append(id);
+  return true;
+}
+
+bool
+CrawlQueue::contains(const Identifier &id) const {
+  return _entries.contains(id);
+}
+
+bool
+CrawlQueue::next(Identifier &id, qint64 now) {
+  // Prefer candidates never tried
+  while (_fresh.size()) {
+    id = _fresh.takeFirst();
+    if (_entries.contains(id) && (! _entries[id].inFlight)) {
+      _entries[id].inFlight = true;
+      return true;
+    }
+  }
+  // then retry failed ones
+  while (_retries.size() && (_retries.begin().key() <= now)) {
+    id = _retries.begin().value();
+    _retries.erase(_retries.begin());
+    if (_entries.contains(id) && (! _entries[id].inFlight)) {
+      _entries[id].inFlight = true;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool
+CrawlQueue::succeeded(const Identifier &id, qint64 now) {
+  if (! _entries.contains(id)) { return false; }
+  _entries.remove(id);
+  _discovered++;
+  _discoveries.append(now);
+  _expireDiscoveries(now);
+  return true;
+}
+
+void
+CrawlQueue::failed(const Identifier &id, qint64 now) {
+  if (! _entries.contains(id)) { return; }
+  Entry &entry = _entries[id];
+  entry.inFlight = false;
+  entry.attempts++;
+  if (entry.attempts >= _maxAttempts) {
+    _entries.remove(id);
+    _dropped++;
+    return;
+  }
+  // Exponential backoff
+  _retries.insert(now + (_backoff << (entry.attempts-1)), id);
+}
+
+size_t
+CrawlQueue::numPending() const {
+  return _entries.size();
+}
+
+size_t
+CrawlQueue::numReady(qint64 now) const {
+  size_t n = _fresh.size();
+  QMultiMap<qint64, Identifier>::const_iterator item = _retries.begin();
+  for (; (item != _retries.end()) && (item.key() <= now); item++) {
+    n++;
+  }
+  return n;
+}
+
+qint64
+CrawlQueue::nextDue(qint64 now) const {
+  if (_fresh.size()) { return 0; }
+  if (_retries.size()) { return std::max(qint64(0), _retries.begin().key()-now); }
+  return -1;
+}
+
+size_t
+CrawlQueue::numDiscovered() const {
+  return _discovered;
+}
+
+size_t
+CrawlQueue::numDropped() const {
+  return _dropped;
+}
+
+double
+CrawlQueue::discoveryRate(qint64 now) const {
+  _expireDiscoveries(now);
+  return double(_discoveries.size())*60000/DISCOVERY_RATE_WINDOW;
+}
+
+qint64
+CrawlQueue::interval(qint64 now) {
+  if (numReady(now)) {
+    // Work to do -> crawl fast
+    _interval = _minInterval;
+    return _interval;
+  }
+  // Converged -> slow down but wake up for the next retry
+  _interval = std::min(2*_interval, _maxInterval);
+  if (_retries.size()) {
+    return std::max(_minInterval, std::min(_interval, _retries.begin().key()-now));
+  }
+  return _interval;
+}
+
+void
+CrawlQueue::_expireDiscoveries(qint64 now) const {
+  while (_discoveries.size() && (_discoveries.first() < (now-DISCOVERY_RATE_WINDOW))) {
+    _discoveries.removeFirst();
+  }
+}
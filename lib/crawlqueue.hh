@@ -0,0 +1,92 @@
+#ifndef CRAWLQUEUE_HH
+#define CRAWLQUEUE_HH
+
+#include <QHash>
+#include <QList>
+#include <QMap>
+#include <ovlnet/buckets.hh>
+
+
+/** Crawl policy for the discovery of stations.
+ * Keeps track of all candidates which have not been contacted successfully yet. Candidates
+ * never tried are preferred over retries of failed ones, failed candidates are retried with an
+ * exponential backoff and dropped after a number of attempts. The queue also determines the
+ * interval between crawl rounds, which is short while there is work to do and grows while the
+ * crawler converged.
+ *
+ * The class does not access the network or any clock. The current time in ms is passed to all
+ * methods, such that the policy can be run in virtual time. */
+class CrawlQueue
+{
+public:
+  /** Constructor.
+   * @param minInterval Specifies the crawl interval in ms while candidates are pending.
+   * @param maxInterval Specifies the max. crawl interval in ms once the crawler converged.
+   * @param backoff Specifies the initial delay in ms before a failed candidate is retried.
+   * @param maxAttempts Specifies the number of attempts before a candidate is dropped. */
+  CrawlQueue(qint64 minInterval=1000, qint64 maxInterval=600000, qint64 backoff=60000,
+             size_t maxAttempts=5);
+
+  /** Adds a candidate. Returns @c false if the candidate is already pending. */
+  bool add(const Identifier &id, qint64 now);
+  /** Returns @c true if the candidate is pending. */
+  bool contains(const Identifier &id) const;
+  /** Takes the next candidate to contact. Returns @c false if no candidate is due. */
+  bool next(Identifier &id, qint64 now);
+
+  /** Marks the candidate as contacted successfully. Returns @c true if the candidate was
+   * pending (i.e. it was discovered by the crawler). */
+  bool succeeded(const Identifier &id, qint64 now);
+  /** Marks the candidate as failed. The candidate is retried later or dropped. */
+  void failed(const Identifier &id, qint64 now);
+
+  /** Returns the number of pending candidates. */
+  size_t numPending() const;
+  /** Returns the number of candidates due now. */
+  size_t numReady(qint64 now) const;
+  /** Returns the delay in ms until the next candidate is due, 0 if one is due now and -1 if no
+   * candidate is waiting to be contacted. */
+  qint64 nextDue(qint64 now) const;
+  /** Returns the number of stations discovered so far. */
+  size_t numDiscovered() const;
+  /** Returns the number of candidates dropped so far. */
+  size_t numDropped() const;
+  /** Returns the discovery rate in stations per minute, averaged over the last 10 minutes. */
+  double discoveryRate(qint64 now) const;
+
+  /** Returns the delay in ms until the next crawl round. Gets called once per round. The interval
+   * is reset to the min. interval while candidates are due and doubles otherwise. */
+  qint64 interval(qint64 now);
+
+protected:
+  /** Drops discovery timestamps older than the averaging window. */
+  void _expireDiscoveries(qint64 now) const;
+
+protected:
+  /** State of a pending candidate. */
+  typedef struct {
+    /** Number of failed attempts. */
+    size_t attempts;
+    /** If @c true, the candidate is currently being contacted. */
+    bool inFlight;
+  } Entry;
+
+  qint64 _minInterval;
+  qint64 _maxInterval;
+  qint64 _backoff;
+  size_t _maxAttempts;
+  /** The current crawl interval. */
+  qint64 _interval;
+  /** All pending candidates. */
+  QHash<Identifier, Entry> _entries;
+  /** Candidates never tried, in order of appearance. */
+  QList<Identifier> _fresh;
+  /** Failed candidates by the time they are due again. */
+  QMultiMap<qint64, Identifier> _retries;
+  size_t _discovered;
+  size_t _dropped;
+  /** Times of recent discoveries. */
+  mutable QList<qint64> _discoveries;
+};
+
+#endif // CRAWLQUEUE_HH
@@ -1,7 +1,12 @@
 #include "datasetfile.hh"
 #include <netinet/in.h>
 #include "query.hh"
+#include "queryscheduler.hh"
+#include "querygroup.hh"
 #include "station.hh"
+#include "binarycodec.hh"
+#include "compression.hh"
+#include <cstring>
 
 
 /* ********************************************************************************************* *
@@ -59,18 +64,29 @@ Timeseries::toJson() const {
   return obj;
 }
 
+void
+Timeseries::toBinary(BinaryWriter &writer) const {
+  writer.writeUInt8(_identifier.isValid() ? 1 : 0);
+  if (_identifier.isValid()) {
+    writer.writeIdentifier(_identifier);
+  }
+  writer.writeFloat(_location.longitude());
+  writer.writeFloat(_location.latitude());
+  writer.writeFloat(_location.height());
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of DataSetFile
  * ********************************************************************************************* */
 DataSetFile::DataSetFile()
-  : _filename(), _timestamp(), _numSamples(0), _sampleRate(0), _datasets()
+  : _filename(), _timestamp(), _numSamples(0), _sampleRate(0), _datasets(), _baseband()
 {
   // pass...
 }
 
 DataSetFile::DataSetFile(const QString &filename)
-  : _filename(filename), _timestamp(), _numSamples(0), _sampleRate(0), _datasets()
+  : _filename(filename), _timestamp(), _numSamples(0), _sampleRate(0), _datasets(), _baseband()
 {
   QFile file(_filename);
   // Try to open file.
@@ -108,13 +124,14 @@ DataSetFile::DataSetFile(const QString &filename)
       return;
     }
     _datasets.append(Timeseries(offset, &header));
-    offset += _numSamples;
+    offset += sizeof(Timeseries::Header) + 2*_numSamples;
   }
+  _readBasebandTable(file, offset);
 }
 
 DataSetFile::DataSetFile(const DataSetFile &other)
   : _filename(other._filename), _timestamp(other._timestamp), _numSamples(other._numSamples),
-    _sampleRate(other._sampleRate), _datasets(other._datasets)
+    _sampleRate(other._sampleRate), _datasets(other._datasets), _baseband(other._baseband)
 {
   // pass...
 }
@@ -126,6 +143,7 @@ DataSetFile::operator =(const DataSetFile &other) {
   _numSamples = other._numSamples;
   _sampleRate = other._sampleRate;
   _datasets = other._datasets;
+  _baseband = other._baseband;
   return *this;
 }
 
@@ -136,6 +154,38 @@ DataSetFile::_reset() {
   _numSamples = 0;
   _sampleRate = 0;
   _datasets.clear();
+  _baseband.clear();
+}
+
+void
+DataSetFile::_readBasebandTable(QFile &file, size_t offset) {
+  if ((! file.seek(offset)) || ("BCN1" != file.read(4))) { return; }
+  QByteArray data = file.readAll();
+  const char *ptr = data.constData(), *end = ptr+data.size();
+  if ((end-ptr) < 2) { return; }
+  // The fields are not aligned
+  uint16_t count; memcpy(&count, ptr, 2); count = ntohs(count); ptr += 2;
+  // Each beacon has two timeseries
+  if ((2*size_t(count)) != size_t(_datasets.size())) {
+    logWarning() << "Ignore beacon table of " << _filename << ": Number of timeseries mismatch.";
+    return;
+  }
+  QVector<Baseband> baseband;
+  for (size_t i=0; i<count; i++) {
+    if ((end-ptr) < 9) { return; }
+    uint32_t frequency, scale;
+    memcpy(&frequency, ptr, 4); frequency = ntohl(frequency);
+    memcpy(&scale, ptr+4, 4); scale = ntohl(scale);
+    uint8_t len = ptr[8]; ptr += 9;
+    if ((end-ptr) < len) { return; }
+    Baseband beacon;
+    beacon.name = QString::fromUtf8(ptr, len); ptr += len;
+    float value;
+    memcpy(&value, &frequency, 4); beacon.frequency = value;
+    memcpy(&value, &scale, 4); beacon.scale = value;
+    baseband.append(beacon);
+  }
+  _baseband = baseband;
 }
 
 bool
@@ -198,6 +248,35 @@ DataSetFile::readTimeseries(size_t i, int16_t *data) const {
   return true;
 }
 
+size_t
+DataSetFile::numBaseband() const {
+  return _baseband.size();
+}
+
+const DataSetFile::Baseband &
+DataSetFile::baseband(size_t i) const {
+  return _baseband[i];
+}
+
+QByteArray
+DataSetFile::basebandTable(const QVector<Baseband> &beacons) {
+  QByteArray table("BCN1");
+  uint16_t count = htons(beacons.size());
+  table.append((const char *) &count, 2);
+  foreach (Baseband beacon, beacons) {
+    float frequency = beacon.frequency;
+    uint32_t value;
+    memcpy(&value, &frequency, 4); value = htonl(value);
+    table.append((const char *) &value, 4);
+    memcpy(&value, &beacon.scale, 4); value = htonl(value);
+    table.append((const char *) &value, 4);
+    QByteArray name = beacon.name.toUtf8().left(255);
+    table.append(char(name.size()));
+    table.append(name);
+  }
+  return table;
+}
+
 QJsonObject
 DataSetFile::toJson() const {
   QJsonObject res;
@@ -210,20 +289,80 @@ DataSetFile::toJson() const {
     datasets.append(_datasets[i].toJson());
   }
   res.insert("timeseries", datasets);
+  // Beacons of narrowband recordings
+  if (! _baseband.isEmpty()) {
+    QJsonArray baseband;
+    foreach (Baseband beacon, _baseband) {
+      QJsonObject obj;
+      obj.insert("name", beacon.name);
+      obj.insert("frequency", beacon.frequency);
+      baseband.append(obj);
+    }
+    res.insert("baseband", baseband);
+  }
 
   return res;
 }
 
+void
+DataSetFile::toBinary(const Identifier &id, BinaryWriter &writer) const {
+  writer.beginRecord();
+  writer.writeIdentifier(id);
+  writer.writeDateTime(_timestamp);
+  writer.writeUInt32(_numSamples);
+  writer.writeUInt32(_sampleRate);
+  writer.writeUInt16(_datasets.size());
+  for (int i=0; i<_datasets.size(); i++) {
+    _datasets[i].toBinary(writer);
+  }
+  writer.endRecord();
+}
+
+
+/** Creates the compressed copy of a dataset on the thread pool of the @c DataSetDir. */
+class DataSetCompressor: public QRunnable
+{
+public:
+  DataSetCompressor(DataSetDir &dir, const QString &id, const QString &source,
+                    const QString &dest)
+    : QRunnable(), _dir(dir), _id(id), _source(source), _dest(dest)
+  {
+    // pass...
+  }
+
+  void run() {
+    if (! deflateFile(_source, _dest)) {
+      logError() << "Cannot compress dataset " << _id << ".";
+    }
+    // The dataset dir waits for all compressions before it gets destroyed
+    QMetaObject::invokeMethod(&_dir, "_onCompressed", Qt::QueuedConnection, Q_ARG(QString, _id));
+  }
+
+protected:
+  DataSetDir &_dir;
+  QString _id;
+  QString _source;
+  QString _dest;
+};
+
 
 /* ********************************************************************************************* *
  * Implementation of DataSetDir
  * ********************************************************************************************* */
 DataSetDir::DataSetDir(const QString &directory)
-  : _dir(directory), _datasetOrder(), _datasets(), _parents()
+  : _dir(directory), _datasetOrder(), _datasets(), _parents(), _compressing(), _compressor()
 {
+  // Compress one dataset at a time
+  _compressor.setMaxThreadCount(1);
   reload();
 }
 
+DataSetDir::~DataSetDir() {
+  // Compressions report back to this instance
+  _compressor.clear();
+  _compressor.waitForDone();
+}
+
 QString DataSetDir::path() const {
   return _dir.absolutePath();
 }
@@ -249,9 +388,38 @@ DataSetDir::dataset(const Identifier &id) const {
   return _datasets[id];
 }
 
+QString
+DataSetDir::compressedFilename(const Identifier &id) {
+  if (! _datasets.contains(id)) { return QString(); }
+  QString filename = _dir.absoluteFilePath(".deflate/"+id.toBase32());
+  // The copy is renamed into place once complete
+  if (QFile::exists(filename)) { return filename; }
+  _compress(id);
+  return QString();
+}
+
+void
+DataSetDir::_compress(const Identifier &id) {
+  if (_compressing.contains(id)) { return; }
+  QString filename = _dir.absoluteFilePath(".deflate/"+id.toBase32());
+  if (QFile::exists(filename)) { return; }
+  if ((! _dir.exists(".deflate")) && (! _dir.mkpath(".deflate"))) {
+    logError() << "Cannot create directory " << _dir.absoluteFilePath(".deflate") << ".";
+    return;
+  }
+  _compressing.insert(id);
+  _compressor.start(new DataSetCompressor(*this, id.toBase32(), _datasets[id].filename(),
+                                          filename));
+}
+
+void
+DataSetDir::_onCompressed(const QString &id) {
+  _compressing.remove(Identifier::fromBase32(id));
+}
+
 bool
 DataSetDir::addDataset(const Identifier &id) {
-  DataSetFile file(id.toBase32());
+  DataSetFile file(_dir.absoluteFilePath(id.toBase32()));
   if (! file.isValid()) { return false; }
   if (_datasets.contains(id)) { return true; }
   beginInsertRows(QModelIndex(), _datasetOrder.size(), _datasetOrder.size());
@@ -288,6 +456,15 @@ DataSetDir::reload() {
     addDataset(filename);
   }
   endResetModel();
+  // Drop compressed copies of removed datasets (and partial copies), unless some are being written
+  QDir deflated(_dir.absoluteFilePath(".deflate"));
+  if (deflated.exists() && _compressing.isEmpty()) {
+    foreach (QString filename, deflated.entryList(QDir::Files|QDir::Hidden)) {
+      if (! _datasets.contains(Identifier::fromBase32(filename))) {
+        deflated.remove(filename);
+      }
+    }
+  }
 }
 
 QJsonObject
@@ -300,6 +477,16 @@ DataSetDir::toJson() const {
   return res;
 }
 
+QByteArray
+DataSetDir::toBinary() const {
+  BinaryWriter writer(BinaryCodec::DATASETS);
+  QHash<Identifier, DataSetFile>::const_iterator dataset = _datasets.begin();
+  for (; dataset != _datasets.end(); dataset++) {
+    dataset->toBinary(dataset.key(), writer);
+  }
+  return writer.data();
+}
+
 int
 DataSetDir::rowCount(const QModelIndex &parent) const {
   return _datasets.size();
@@ -374,6 +561,19 @@ RemoteTimeseries::RemoteTimeseries(const QJsonObject &obj)
   _location = Location(obj.value("location").toObject());
 }
 
+RemoteTimeseries::RemoteTimeseries(BinaryReader &record)
+  : _identifier(), _location()
+{
+  uint8_t hasId; float lon, lat, height;
+  if (! record.readUInt8(hasId)) { return; }
+  if (hasId && (! record.readIdentifier(_identifier))) { return; }
+  if (! (record.readFloat(lon) && record.readFloat(lat) && record.readFloat(height))) {
+    logError() << "Invalid timeseries: Record too short.";
+    return;
+  }
+  _location = Location(lon, lat, height);
+}
+
 RemoteTimeseries::RemoteTimeseries(const RemoteTimeseries &other)
   : _identifier(other._identifier), _location(other._location)
 {
@@ -432,6 +632,30 @@ RemoteDataSet::RemoteDataSet(const Identifier &remote, const QJsonObject &obj)
   }
 }
 
+RemoteDataSet::RemoteDataSet(const Identifier &remote, BinaryReader &record)
+  : _timestamp(), _samples(0), _sampleRate(0), _parents(), _timeseries(), _remotes()
+{
+  _remotes.insert(remote);
+  QDateTime timestamp; uint32_t samples, rate; uint16_t numTimeseries;
+  if (! (record.readDateTime(timestamp) && record.readUInt32(samples)
+         && record.readUInt32(rate) && record.readUInt16(numTimeseries))) {
+    logError() << "Invalid dataset: Record too short.";
+    return;
+  }
+  _samples = samples;
+  _sampleRate = rate;
+  for (uint16_t i=0; i<numTimeseries; i++) {
+    RemoteTimeseries ts(record);
+    if (ts.location().isNull()) {
+      logError() << "Invalid dataset: Invalid timeseries.";
+      return;
+    }
+    _timeseries.append(ts);
+  }
+  // Mark dataset as valid
+  _timestamp = timestamp.toLocalTime();
+}
+
 RemoteDataSet::RemoteDataSet(const RemoteDataSet &other)
   : _timestamp(other._timestamp), _samples(other._samples), _sampleRate(other._sampleRate),
     _parents(other._parents), _timeseries(other._timeseries), _remotes(other._remotes)
@@ -501,6 +725,8 @@ RemoteDataSetList::RemoteDataSetList(Station &station, QObject *parent)
   // Get notified if a station got updated
   connect(&_station.stations(), SIGNAL(stationUpdated(StationItem)),
           this, SLOT(_onUpdateRemoteDataSets(StationItem)));
+  // Get the lists of all stations known already
+  refresh();
 }
 
 size_t
@@ -522,18 +748,57 @@ void
 RemoteDataSetList::add(const Identifier &remote, const QJsonObject &list) {
   QJsonObject::const_iterator entry = list.begin();
   for (; entry != list.end(); entry++) {
-    if (_datasets.contains(Identifier::fromBase32(entry.key()))) {
-      _datasets[Identifier::fromBase32(entry.key())].addRemote(remote);
-      int idx = _datasetOrder.indexOf(Identifier::fromBase32(entry.key()));
-      emit dataChanged(index(idx, 0),index(idx, 4));
-    } else {
-      beginInsertRows(QModelIndex(), _datasetOrder.size(), _datasetOrder.size());
-      _datasets.insert(Identifier::fromBase32(entry.key()),
-                       RemoteDataSet(remote, entry.value().toObject()));
-      _datasetOrder.append(Identifier::fromBase32(entry.key()));
-      endInsertRows();
-    }
+    add(remote, Identifier::fromBase32(entry.key()),
+        RemoteDataSet(remote, entry.value().toObject()));
+  }
+}
+
+void
+RemoteDataSetList::add(const Identifier &remote, const Identifier &id, const RemoteDataSet &dataset) {
+  if (_datasets.contains(id)) {
+    _datasets[id].addRemote(remote);
+    int idx = _datasetOrder.indexOf(id);
+    emit dataChanged(index(idx, 0),index(idx, 4));
+  } else {
+    beginInsertRows(QModelIndex(), _datasetOrder.size(), _datasetOrder.size());
+    _datasets.insert(id, dataset);
+    _datasetOrder.append(id);
+    endInsertRows();
+  }
+}
+
+void
+RemoteDataSetList::refresh() {
+  QList<Identifier> remotes;
+  for (size_t i=0; i<_station.stations().numStations(); i++) {
+    remotes.append(_station.stations().station(i).id());
   }
+  DataSetListGroup *group = new DataSetListGroup(_station, remotes);
+  connect(group, SIGNAL(dataSetReceived(Identifier,Identifier,RemoteDataSet)),
+          this, SLOT(add(Identifier,Identifier,RemoteDataSet)));
+  group->start();
+}
+
+void
+RemoteDataSetList::download(const Identifier &id) {
+  if (_station.datasets().contains(id)) {
+    logInfo() << "Dataset " << id.toBase32() << " is already present.";
+    return;
+  }
+  if (! _datasets.contains(id)) {
+    logError() << "Cannot download unknown dataset " << id.toBase32() << ".";
+    return;
+  }
+  logInfo() << "Download dataset " << id.toBase32() << " from "
+            << _datasets[id].numRemotes() << " stations.";
+  DataSetDownload *download = new DataSetDownload(_station, id, _datasets[id].remotes().toList());
+  download->start();
+}
+
+void
+RemoteDataSetList::download(const QModelIndex &index) {
+  if ((! index.isValid()) || (index.row() >= _datasetOrder.size())) { return; }
+  download(_datasetOrder[index.row()]);
 }
 
 int
@@ -590,7 +855,8 @@ RemoteDataSetList::headerData(int section, Qt::Orientation orientation, int role
 void
 RemoteDataSetList::_onUpdateRemoteDataSets(const StationItem &station) {
   // logDebug() << "Station " << station.id() << " updated -> Get dataset list.";
-  DataSetListQuery *query = new DataSetListQuery(_station, station.node());
-  connect(query, SIGNAL(dataSetListReceived(Identifier,QJsonObject)),
-          this, SLOT(add(Identifier,QJsonObject)));
+  DataSetListQuery *query = _station.queries().submit(
+        new DataSetListQuery(_station, station.node()), QueryScheduler::BACKGROUND);
+  connect(query, SIGNAL(dataSetReceived(Identifier,Identifier,RemoteDataSet)),
+          this, SLOT(add(Identifier,Identifier,RemoteDataSet)));
 }
@@ -7,12 +7,15 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include <QAbstractTableModel>
+#include <QThreadPool>
 #include <ovlnet/buckets.hh>
 #include "location.hh"
 #include "stationlist.hh"
 
 #include <ovlnet/dht_config.hh>
 
+class BinaryReader;
+class BinaryWriter;
 
 class Timeseries
 {
@@ -36,6 +39,8 @@ public:
   const Location &location() const;
 
   QJsonObject toJson() const;
+  /** Serializes the timeseries header into the current binary record. */
+  void toBinary(BinaryWriter &writer) const;
 
 protected:
   size_t     _offset;
@@ -44,6 +49,13 @@ protected:
 };
 
 
+/** A dataset file holding one or more timeseries of equal length and sample rate.
+ * The file header is followed by the timeseries, each prefixed by its header. Narrowband
+ * recordings hold the in-phase and quadrature components of the complex baseband of each beacon
+ * as consecutive timeseries, followed by a table of the beacons: the magic "BCN1", the number of
+ * beacons as a 16bit integer and for each beacon its center frequency in Hz and the scale of the
+ * samples as floats and its name as a length-prefixed UTF-8 string. Readers unaware of the table
+ * ignore it. All values are stored in network byte order. */
 class DataSetFile
 {
 public:
@@ -59,6 +71,16 @@ public:
     uint32_t rate;
   } Header;
 
+  /** The complex baseband of a beacon in a narrowband recording. */
+  typedef struct {
+    /** Name of the beacon. */
+    QString name;
+    /** Center frequency in Hz. */
+    double frequency;
+    /** Scale of the samples relative to the input. */
+    float scale;
+  } Baseband;
+
 public:
   DataSetFile();
   DataSetFile(const QString &filename);
@@ -76,10 +98,21 @@ public:
   const Timeseries &timeseries(size_t i) const;
   bool readTimeseries(size_t i, int16_t *data) const;
 
+  /** Returns the number of beacons of a narrowband recording, 0 otherwise. The timeseries 2i and
+   * 2i+1 hold the in-phase and quadrature components of the i-th beacon. */
+  size_t numBaseband() const;
+  const Baseband &baseband(size_t i) const;
+  /** Assembles the beacon table of a narrowband recording. */
+  static QByteArray basebandTable(const QVector<Baseband> &beacons);
+
   QJsonObject toJson() const;
+  /** Serializes the dataset header as a binary record with the given identifier. */
+  void toBinary(const Identifier &id, BinaryWriter &writer) const;
 
 protected:
   void _reset();
+  /** Reads the beacon table at the given offset, if present. */
+  void _readBasebandTable(QFile &file, size_t offset);
 
 protected:
   QString _filename;
@@ -87,13 +120,16 @@ protected:
   size_t _numSamples;
   size_t _sampleRate;
   QVector<Timeseries> _datasets;
+  QVector<Baseband> _baseband;
 };
 
 
 /** Implements the dataset database.
  * This database is stored as a directory containing all datasets as separate files.
  * The name of these files corresponds to the ID of the dataset. Upon construction, the DB
- * reads the meta data from all datasets in the directory. */
+ * reads the meta data from all datasets in the directory. Compressed copies of the datasets are
+ * created by a background thread in the @c .deflate subdirectory, once a dataset is first
+ * requested compressed. Hence, only datasets actually transferred take extra disk space. */
 class DataSetDir: public QAbstractTableModel
 {
   Q_OBJECT
@@ -101,6 +137,8 @@ class DataSetDir: public QAbstractTableModel
 public:
   /** Constructs the dataset database located at the specified @c directory. */
   explicit DataSetDir(const QString &directory);
+  /** Destructor, waits for running compressions. */
+  virtual ~DataSetDir();
 
   /** Returns the path to the data directory. */
   QString path() const;
@@ -114,6 +152,9 @@ public:
 
   /** Return the @c DataSetFile for the specified dataset. */
   DataSetFile dataset(const Identifier &id) const;
+  /** Returns the filename of the compressed copy of the specified dataset. Returns an empty
+   * string if the copy is not available (yet). Missing copies get created in the background. */
+  QString compressedFilename(const Identifier &id);
   /** Adds a dataset to the database. The dataset must be present in the directory. */
   bool addDataset(const QString &name);
   /** Adds a dataset to the database. The dataset must be present in the directory. */
@@ -124,6 +165,8 @@ public:
 
   /** Returns the database as a Json array. */
   QJsonObject toJson() const;
+  /** Returns the database as a binary encoded dataset list. */
+  QByteArray toBinary() const;
 
   /* *** Implementation of QAbstactTableModel */
   int rowCount(const QModelIndex &parent) const;
@@ -131,6 +174,15 @@ public:
   QVariant data(const QModelIndex &index, int role) const;
   QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
+protected:
+  /** Creates the compressed copy of the specified dataset in the background, unless it exists
+   * or is being created. */
+  void _compress(const Identifier &id);
+
+protected slots:
+  /** Gets called once the compression of a dataset finished. */
+  void _onCompressed(const QString &id);
+
 protected:
   /** The database directory. */
   QDir _dir;
@@ -140,6 +192,10 @@ protected:
   QHash<Identifier, DataSetFile> _datasets;
   /** Reverse lookup table to match parents to derived datasets. */
   QHash<Identifier, Identifier> _parents;
+  /** Datasets being compressed. */
+  QSet<Identifier> _compressing;
+  /** Single background thread compressing the datasets. */
+  QThreadPool _compressor;
 };
 
 
@@ -148,6 +204,7 @@ class RemoteTimeseries
 public:
   RemoteTimeseries();
   RemoteTimeseries(const QJsonObject &obj);
+  RemoteTimeseries(BinaryReader &record);
   RemoteTimeseries(const RemoteTimeseries &other);
 
   RemoteTimeseries &operator =(const RemoteTimeseries &other);
@@ -166,6 +223,7 @@ class RemoteDataSet
 public:
   RemoteDataSet();
   RemoteDataSet(const Identifier &remote, const QJsonObject &obj);
+  RemoteDataSet(const Identifier &remote, BinaryReader &record);
   RemoteDataSet(const RemoteDataSet &other);
 
   RemoteDataSet &operator =(const RemoteDataSet &other);
@@ -213,7 +271,16 @@ public:
   QVariant headerData(int section, Qt::Orientation orientation, int role) const;
 
 public slots:
+  /** Adds all datasets of the given list held by the specified remote station. */
   void add(const Identifier &remote, const QJsonObject &list);
+  /** Adds a single dataset held by the specified remote station. */
+  void add(const Identifier &remote, const Identifier &id, const RemoteDataSet &dataset);
+  /** Requests the dataset lists of all known stations at once. */
+  void refresh();
+  /** Downloads the specified dataset from one of the stations holding it. */
+  void download(const Identifier &id);
+  /** Downloads the dataset of the given row. */
+  void download(const QModelIndex &index);
 
 protected slots:
   void _onUpdateRemoteDataSets(const StationItem &station);
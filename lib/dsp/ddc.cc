@@ -0,0 +1,193 @@
+#include "ddc.hh"
+#include "window.hh"
+#include "kernels.hh"
+#include <algorithm>
+#include <cmath>
+
+/** Order of the CIC filters. */
+#define DDC_CIC_ORDER 3
+/** Decimation of the FIR stage. */
+#define DDC_FIR_DECIMATION 4
+/** Bits of the NCO table index. */
+#define DDC_NCO_BITS 12
+
+
+/** Computes the sine table of the NCOs in Q15. A 4096 entry table keeps the spurs of the mixer
+ * below -70dB. */
+static QVector<int16_t>
+ddc_make_sine_table() {
+  QVector<int16_t> table(1 << DDC_NCO_BITS);
+  for (int i=0; i<(1 << DDC_NCO_BITS); i++) {
+    table[i] = std::round(32767*std::sin(2*M_PI*i/(1 << DDC_NCO_BITS)));
+  }
+  return table;
+}
+
+/** Returns the shared sine table. */
+static const int16_t *
+ddc_sine_table() {
+  static const QVector<int16_t> table = ddc_make_sine_table();
+  return table.constData();
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of DDCBank
+ * ********************************************************************************************* */
+DDCBank::DDCBank(double rate, double outputRate)
+  : _rate(rate), _cicDecimation(1), _count(0), _cicCount(0), _completed(false),
+    _phase(), _step(), _integrators(), _combs(), _taps(), _delay(), _delayPos(0), _re(), _im()
+{
+  double integer = integerRate(_rate, outputRate);
+  if (integer > 0) { outputRate = integer; }
+  _cicDecimation = std::max(1., std::round(_rate/(DDC_FIR_DECIMATION*outputRate)));
+  // Low-pass at 40% of the output rate, stopband from 60%, where the aliases of the decimation
+  // start, with 60dB attenuation (relative to the CIC output rate)
+  double cutoff = 0.5/DDC_FIR_DECIMATION, width = 0.2/DDC_FIR_DECIMATION;
+  size_t length = std::ceil(52/(2.285*2*M_PI*width));
+  WindowFunction window(WindowFunction::KAISER, length, 5.65);
+  _taps.resize(length);
+  double gain = 0;
+  for (size_t k=0; k<length; k++) {
+    double t = k - (length-1)/2.;
+    _taps[k] = window.data()[k] * ((0 == t) ? 2*cutoff : std::sin(2*M_PI*cutoff*t)/(M_PI*t));
+    gain += _taps[k];
+  }
+  // Unity gain, including the gain of the CIC and the Q15 NCO. The factor 2 yields the amplitude
+  // of the real input
+  gain *= std::pow(double(_cicDecimation), DDC_CIC_ORDER)*32767/2;
+  for (size_t k=0; k<length; k++) {
+    _taps[k] /= gain;
+  }
+  ddc_sine_table();
+}
+
+double
+DDCBank::integerRate(double rate, double outputRate) {
+  // The datasets store the rate as an integer, hence the total decimation must divide the rate
+  double best = 0;
+  for (size_t d=1; (d*DDC_FIR_DECIMATION) <= rate; d++) {
+    double out = rate/(d*DDC_FIR_DECIMATION);
+    if (out != std::floor(out)) { continue; }
+    if ((0 == best) || (std::abs(out-outputRate) < std::abs(best-outputRate))) {
+      best = out;
+    }
+  }
+  return best;
+}
+
+size_t
+DDCBank::add(double frequency) {
+  _phase.append(0);
+  // Mixing with exp(-j 2 pi f t) shifts the frequency to 0
+  _step.append(uint32_t(int64_t(std::round(-frequency/_rate*4294967296.))));
+  _integrators.resize(_integrators.size() + 2*DDC_CIC_ORDER);
+  _combs.resize(_combs.size() + 2*DDC_CIC_ORDER);
+  std::fill(_integrators.end()-2*DDC_CIC_ORDER, _integrators.end(), 0);
+  std::fill(_combs.end()-2*DDC_CIC_ORDER, _combs.end(), 0);
+  // Rebuild the delay lines
+  _delay.fill(0, 4*_taps.size()*_phase.size());
+  _delayPos = 0;
+  _re.append(0); _im.append(0);
+  return _phase.size()-1;
+}
+
+size_t
+DDCBank::numChannels() const {
+  return _phase.size();
+}
+
+size_t
+DDCBank::decimation() const {
+  return _cicDecimation*DDC_FIR_DECIMATION;
+}
+
+double
+DDCBank::outputRate() const {
+  return _rate/decimation();
+}
+
+size_t
+DDCBank::process(const int16_t *samples, size_t n) {
+  _completed = false;
+  const int16_t *table = ddc_sine_table();
+  const size_t nChannels = _phase.size(), shift = 32-DDC_NCO_BITS;
+  uint32_t *phase = _phase.data();
+  const uint32_t *step = _step.constData();
+  uint64_t *integrators = _integrators.data();
+
+  size_t i=0;
+  while (i<n) {
+    // Integrate up to the next CIC output
+    size_t m = std::min(n-i, _cicDecimation-_count);
+    for (size_t j=0; j<nChannels; j++) {
+      uint64_t *in = integrators + 2*DDC_CIC_ORDER*j;
+      uint32_t p = phase[j];
+      for (size_t k=0; k<m; k++) {
+        int32_t x = samples[i+k];
+        // exp(j p) = cos(p) + j sin(p), cos(p) = sin(p + pi/2)
+        int32_t c = table[(p + (1u << 30)) >> shift], s = table[p >> shift];
+        in[0] += uint64_t(int64_t(x*c)); in[1] += uint64_t(int64_t(x*s));
+        for (size_t l=1; l<DDC_CIC_ORDER; l++) {
+          in[2*l] += in[2*l-2]; in[2*l+1] += in[2*l-1];
+        }
+        p += step[j];
+      }
+      phase[j] = p;
+    }
+    i += m; _count += m;
+    if (_cicDecimation == _count) {
+      _count = 0;
+      _comb();
+      if (_completed) { break; }
+    }
+  }
+  return i;
+}
+
+bool
+DDCBank::completed() const {
+  return _completed;
+}
+
+float
+DDCBank::re(size_t i) const {
+  return _re[i];
+}
+
+float
+DDCBank::im(size_t i) const {
+  return _im[i];
+}
+
+void
+DDCBank::_comb() {
+  const size_t nChannels = _phase.size(), length = _taps.size();
+  // Decimated outputs of the combs into the delay lines
+  for (size_t j=0; j<nChannels; j++) {
+    const uint64_t *in = _integrators.constData() + 2*DDC_CIC_ORDER*j;
+    uint64_t *comb = _combs.data() + 2*DDC_CIC_ORDER*j;
+    uint64_t re = in[2*DDC_CIC_ORDER-2], im = in[2*DDC_CIC_ORDER-1];
+    for (size_t l=0; l<DDC_CIC_ORDER; l++) {
+      uint64_t dre = re - comb[2*l], dim = im - comb[2*l+1];
+      comb[2*l] = re; comb[2*l+1] = im;
+      re = dre; im = dim;
+    }
+    float *delay = _delay.data() + 4*length*j;
+    delay[_delayPos] = delay[_delayPos+length] = float(int64_t(re));
+    delay[2*length+_delayPos] = delay[3*length+_delayPos] = float(int64_t(im));
+  }
+  _delayPos = (_delayPos+1) % length;
+
+  if (DDC_FIR_DECIMATION != ++_cicCount) { return; }
+  _cicCount = 0;
+  // The delay lines start at the oldest sample, the low-pass is symmetric up to the periodic
+  // window, hence the taps are not reversed
+  for (size_t j=0; j<nChannels; j++) {
+    const float *delay = _delay.constData() + 4*length*j;
+    float out[2];
+    dsp_complex_dot(_taps.constData(), delay+_delayPos, delay+2*length+_delayPos, out, length);
+    _re[j] = out[0]; _im[j] = out[1];
+  }
+  _completed = true;
+}
@@ -0,0 +1,75 @@
+#ifndef DSP_DDC_HH
+#define DSP_DDC_HH
+
+#include <QVector>
+#include <cstdint>
+
+
+/** A bank of digital down-converters, each shifting a narrow band around a center frequency to
+ * complex baseband at a low common output rate.
+ * Each channel mixes the input with a table based NCO and decimates it in two stages: a 3rd order
+ * CIC filter decimates by all but the last factor of 4 in exact integer arithmetic, a Kaiser
+ * windowed FIR low-pass then decimates by 4 and removes the aliases of the CIC. The passband
+ * spans +/- 40% of the output rate, with a droop of less than 0.5dB at its edges due to the
+ * CIC. */
+class DDCBank
+{
+public:
+  /** Constructs an empty bank for the input sample rate @c rate in Hz. The output rate is the
+   * integer rate closest to @c outputRate which divides the input rate by a multiple of 4, see
+   * @c integerRate. If there is none, the output rate is the closest rate but not an
+   * integer. */
+  DDCBank(double rate, double outputRate);
+
+  /** Returns the integer output rate closest to @c outputRate for the input rate @c rate, 0 if
+   * no decimation yields an integer rate. */
+  static double integerRate(double rate, double outputRate);
+
+  /** Adds a channel at the given center frequency in Hz. Returns the index of the channel. */
+  size_t add(double frequency);
+  /** Returns the number of channels. */
+  size_t numChannels() const;
+  /** Returns the total decimation factor. */
+  size_t decimation() const;
+  /** Returns the output sample rate in Hz. */
+  double outputRate() const;
+
+  /** Processes at most the samples needed to complete the next output sample and returns the
+   * number of samples processed. Once an output sample is completed, @c completed returns
+   * @c true until the next call. */
+  size_t process(const int16_t *samples, size_t n);
+  /** Returns @c true if the last call to @c process completed an output sample. */
+  bool completed() const;
+  /** Returns the in-phase component of the last output sample of the specified channel in input
+   * units. */
+  float re(size_t i) const;
+  /** Returns the quadrature component of the last output sample of the specified channel in input
+   * units. */
+  float im(size_t i) const;
+
+protected:
+  /** Evaluates the combs of all channels and feeds the FIR filters. */
+  void _comb();
+
+protected:
+  double _rate;
+  /** Decimation of the CIC stage. */
+  size_t _cicDecimation;
+  /** Samples processed in the current CIC output and CIC outputs in the current output. */
+  size_t _count, _cicCount;
+  bool _completed;
+  /** NCO phases and increments. */
+  QVector<uint32_t> _phase, _step;
+  /** Integrator and comb states of the CIC filters (I and Q of each channel interleaved). The
+   * unsigned arithmetic wraps around, which cancels in the combs. */
+  QVector<uint64_t> _integrators, _combs;
+  /** FIR taps and the delay lines of all channels (I and Q), each stored twice such that the
+   * last samples are contiguous. */
+  QVector<float> _taps;
+  QVector<float> _delay;
+  size_t _delayPos;
+  /** Last output samples. */
+  QVector<float> _re, _im;
+};
+
+#endif // DSP_DDC_HH
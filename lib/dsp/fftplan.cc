@@ -0,0 +1,242 @@
+#include "fftplan.hh"
+#include <ovlnet/logger.hh>
+#include <QFile>
+
+
+/* ********************************************************************************************* *
+ * Implementation of FFTPlan
+ * ********************************************************************************************* */
+FFTPlan::FFTPlan(FFTPlanCache &cache, size_t size)
+  : _cache(&cache), _size(size), _input(0), _output(0), _plan(0), _pending(0), _flags(0),
+    _serial(0)
+{
+  _input = (float *) fftwf_malloc(sizeof(float)*_size);
+  _output = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex)*numBins());
+  for (size_t i=0; i<_size; i++) {
+    _input[i] = 0;
+  }
+}
+
+FFTPlan::~FFTPlan() {
+  if (_cache) {
+    _cache->_release(this);
+  } else {
+    fftwf_plan pending = _pending.exchange(0);
+    if (pending) { fftwf_destroy_plan(pending); }
+    if (_plan) { fftwf_destroy_plan(_plan); }
+  }
+  fftwf_free(_input);
+  fftwf_free(_output);
+}
+
+size_t
+FFTPlan::size() const {
+  return _size;
+}
+
+size_t
+FFTPlan::numBins() const {
+  return _size/2+1;
+}
+
+float *
+FFTPlan::input() {
+  return _input;
+}
+
+fftwf_complex *
+FFTPlan::output() {
+  return _output;
+}
+
+const fftwf_complex *
+FFTPlan::output() const {
+  return _output;
+}
+
+void
+FFTPlan::execute() {
+  fftwf_plan tuned = _pending.exchange(0);
+  if ((0 == _plan) && (0 == tuned)) {
+    // Created while the planner was busy, wait for the first plan
+    FFTPlanCache *cache = _cache;
+    QMutexLocker locker(&cache->_lock);
+    while (0 == (tuned = _pending.exchange(0))) {
+      cache->_planned.wait(&cache->_lock);
+    }
+  }
+  if (tuned && _plan) {
+    // Old plan gets destroyed by the planner thread
+    QMutexLocker locker(&_cache->_lock);
+    _cache->_retired.append(_plan);
+    _cache->_wakeup.wakeAll();
+  }
+  if (tuned) {
+    _plan = tuned;
+  }
+  // New-array execute, buffers are aligned as the ones used for planning
+  fftwf_execute_dft_r2c(_plan, _input, _output);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of FFTPlanCache
+ * ********************************************************************************************* */
+FFTPlanCache::FFTPlanCache(const QString &filename, QObject *parent)
+  : QThread(parent), _filename(filename), _plannerLock(), _lock(), _wakeup(), _planned(),
+    _nextSerial(1), _stop(false), _plans(), _queue(), _retired()
+{
+  QMutexLocker locker(&_plannerLock);
+  if (QFile::exists(_filename)) {
+    if (fftwf_import_wisdom_from_filename(_filename.toLocal8Bit().constData())) {
+      logDebug() << "Loaded FFTW wisdom from " << _filename << ".";
+    } else {
+      logWarning() << "Cannot load FFTW wisdom from " << _filename << ".";
+    }
+  }
+  start(QThread::LowPriority);
+}
+
+FFTPlanCache::~FFTPlanCache() {
+  {
+    QMutexLocker locker(&_lock);
+    _stop = true;
+    _wakeup.wakeAll();
+  }
+  wait();
+  QMutexLocker locker(&_plannerLock);
+  foreach (fftwf_plan plan, _retired) {
+    fftwf_destroy_plan(plan);
+  }
+  // Detach remaining plans, they keep their current FFTW plan
+  QMutexLocker plans(&_lock);
+  foreach (FFTPlan *plan, _plans) {
+    if (0 == plan->_flags) {
+      // Never planned, hand over a plan, the plan takes it on its next execute
+      plan->_pending = fftwf_plan_dft_r2c_1d(plan->_size, plan->_input, plan->_output,
+                                             FFTW_ESTIMATE);
+    } else {
+      fftwf_plan pending = plan->_pending.exchange(0);
+      if (pending) { fftwf_destroy_plan(pending); }
+    }
+    plan->_cache = 0;
+  }
+  _planned.wakeAll();
+  plans.unlock();
+  _saveWisdom();
+}
+
+FFTPlan *
+FFTPlanCache::create(size_t size) {
+  FFTPlan *plan = new FFTPlan(*this, size);
+  // Never wait for a tuning run of the background thread
+  if (_plannerLock.tryLock()) {
+    plan->_plan = _initialPlan(size, plan->_input, plan->_output, plan->_flags);
+    _plannerLock.unlock();
+  }
+  QMutexLocker locker(&_lock);
+  plan->_serial = _nextSerial++;
+  _plans.insert(plan);
+  if (0 == plan->_flags) {
+    // Plan it first
+    _queue.prepend(plan);
+    _wakeup.wakeAll();
+  } else if (FFTW_PATIENT != plan->_flags) {
+    _queue.append(plan);
+    _wakeup.wakeAll();
+  }
+  return plan;
+}
+
+void
+FFTPlanCache::run() {
+  QMutexLocker locker(&_lock);
+  while (! _stop) {
+    if (_retired.isEmpty() && _queue.isEmpty()) {
+      _wakeup.wait(&_lock);
+      continue;
+    }
+    QList<fftwf_plan> retired = _retired; _retired.clear();
+    FFTPlan *plan = 0;
+    size_t size = 0; unsigned flags = 0; quint64 serial = 0;
+    if (! _queue.isEmpty()) {
+      plan = _queue.takeFirst();
+      size = plan->_size; serial = plan->_serial;
+      if (plan->_flags) {
+        flags = (FFTW_ESTIMATE == plan->_flags) ? FFTW_MEASURE : FFTW_PATIENT;
+      }
+    }
+    locker.unlock();
+
+    fftwf_plan tuned = 0;
+    {
+      QMutexLocker planner(&_plannerLock);
+      foreach (fftwf_plan old, retired) {
+        fftwf_destroy_plan(old);
+      }
+      if (plan) {
+        // Measuring overwrites the arrays, hence plan on scratch buffers
+        float *in = (float *) fftwf_malloc(sizeof(float)*size);
+        fftwf_complex *out = (fftwf_complex *) fftwf_malloc(sizeof(fftwf_complex)*(size/2+1));
+        if (flags) {
+          tuned = fftwf_plan_dft_r2c_1d(size, in, out, flags);
+          _saveWisdom();
+        } else {
+          tuned = _initialPlan(size, in, out, flags);
+        }
+        fftwf_free(in); fftwf_free(out);
+      }
+    }
+
+    locker.relock();
+    if (! tuned) { continue; }
+    // The plan may have been released meanwhile and another one allocated at the same address
+    if ((! _plans.contains(plan)) || (serial != plan->_serial)) {
+      _retired.append(tuned);
+      continue;
+    }
+    if (0 == plan->_flags) {
+      // First plan, wake the plan if it waits for it
+      _planned.wakeAll();
+    } else {
+      logDebug() << "FFT plan of size " << size << " upgraded to "
+                 << ((FFTW_MEASURE == flags) ? "FFTW_MEASURE" : "FFTW_PATIENT") << ".";
+    }
+    fftwf_plan old = plan->_pending.exchange(tuned);
+    if (old) { _retired.append(old); }
+    plan->_flags = flags;
+    if (FFTW_PATIENT != flags) {
+      _queue.append(plan);
+    }
+  }
+}
+
+void
+FFTPlanCache::_release(FFTPlan *plan) {
+  QMutexLocker locker(&_lock);
+  _plans.remove(plan);
+  _queue.removeAll(plan);
+  if (plan->_plan) { _retired.append(plan->_plan); }
+  fftwf_plan pending = plan->_pending.exchange(0);
+  if (pending) { _retired.append(pending); }
+  _wakeup.wakeAll();
+}
+
+fftwf_plan
+FFTPlanCache::_initialPlan(size_t size, float *in, fftwf_complex *out, unsigned &flags) {
+  // Use a tuned plan right away if known from wisdom
+  fftwf_plan plan = fftwf_plan_dft_r2c_1d(size, in, out, FFTW_PATIENT | FFTW_WISDOM_ONLY);
+  if (plan) {
+    flags = FFTW_PATIENT;
+    return plan;
+  }
+  flags = FFTW_ESTIMATE;
+  return fftwf_plan_dft_r2c_1d(size, in, out, FFTW_ESTIMATE);
+}
+
+void
+FFTPlanCache::_saveWisdom() {
+  if (! fftwf_export_wisdom_to_filename(_filename.toLocal8Bit().constData())) {
+    logWarning() << "Cannot save FFTW wisdom to " << _filename << ".";
+  }
+}
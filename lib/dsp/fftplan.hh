@@ -0,0 +1,121 @@
+#ifndef DSP_FFTPLAN_HH
+#define DSP_FFTPLAN_HH
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QString>
+#include <QSet>
+#include <QList>
+#include <atomic>
+#include <fftw3.h>
+
+class FFTPlanCache;
+
+
+/** A single precision real-to-complex FFT of a fixed size with its own (aligned) input and output
+ * buffers.
+ * Plans are obtained from the @c FFTPlanCache. A plan starts with the best plan available from
+ * wisdom without measuring, and gets swapped against tuned plans once they are computed in the
+ * background. The swap happens in @c execute, hence plans are only used by the thread that
+ * executes them. A plan created while the background thread is tuning gets its first plan from
+ * that thread, its first @c execute waits for it. */
+class FFTPlan
+{
+protected:
+  /** Hidden constructor, use @c FFTPlanCache::create. */
+  FFTPlan(FFTPlanCache &cache, size_t size);
+
+public:
+  /** Destructor. */
+  ~FFTPlan();
+
+  /** Returns the size of the transform. */
+  size_t size() const;
+  /** Returns the number of output bins, i.e. size/2+1. */
+  size_t numBins() const;
+  /** Returns the input buffer of @c size samples. */
+  float *input();
+  /** Returns the output buffer of @c numBins complex values. */
+  fftwf_complex *output();
+  const fftwf_complex *output() const;
+
+  /** Performs the transform of the input buffer into the output buffer. */
+  void execute();
+
+protected:
+  /** The cache, reset if the cache gets destroyed before the plan. */
+  FFTPlanCache *_cache;
+  size_t _size;
+  float *_input;
+  fftwf_complex *_output;
+  /** Plan in use. */
+  fftwf_plan _plan;
+  /** Tuned plan computed in the background, swapped in by @c execute. */
+  std::atomic<fftwf_plan> _pending;
+  /** Planner flags of the current plan, 0 if not planned yet. */
+  unsigned _flags;
+  /** Serial number, distinguishes plans allocated at the same address. */
+  quint64 _serial;
+
+  friend class FFTPlanCache;
+};
+
+
+/** Station-wide cache of FFTW plans and wisdom.
+ * The wisdom is loaded from and saved to a file in the config directory of the station. New plans
+ * are created with @c FFTW_ESTIMATE (unless tuned plans are known from wisdom) such that startup
+ * stays fast. A background thread then computes @c FFTW_MEASURE and @c FFTW_PATIENT plans, which
+ * are handed over to the plans atomically. As the FFTW planner is not thread-safe, all planner
+ * calls are serialized by this class. @c create never waits for a tuning run, the plan rather
+ * gets planned by the background thread next. */
+class FFTPlanCache: public QThread
+{
+  Q_OBJECT
+
+public:
+  /** Constructs a cache, using the wisdom file @c filename. */
+  explicit FFTPlanCache(const QString &filename, QObject *parent=0);
+  /** Destructor, stops the background planner and saves the wisdom. Plans still alive remain
+   * usable. */
+  virtual ~FFTPlanCache();
+
+  /** Creates a new plan of the given size. The ownership is transferred to the caller. */
+  FFTPlan *create(size_t size);
+
+protected:
+  /** Background planner. */
+  void run();
+  /** Unregisters the plan and hands its FFTW plans over to the background thread for
+   * destruction. */
+  void _release(FFTPlan *plan);
+  /** Returns the initial plan of the given size, a tuned one if known from wisdom, and sets the
+   * planner flags accordingly. The planner lock must be held. */
+  fftwf_plan _initialPlan(size_t size, float *in, fftwf_complex *out, unsigned &flags);
+  /** Saves the wisdom, the planner lock must be held. */
+  void _saveWisdom();
+
+protected:
+  /** Wisdom file. */
+  QString _filename;
+  /** Serializes all calls to the FFTW planner. */
+  QMutex _plannerLock;
+  /** Protects the members below. */
+  QMutex _lock;
+  QWaitCondition _wakeup;
+  /** Signals plans waiting for their first plan. */
+  QWaitCondition _planned;
+  /** Serial number of the next plan. */
+  quint64 _nextSerial;
+  bool _stop;
+  /** All plans alive. */
+  QSet<FFTPlan *> _plans;
+  /** Plans to upgrade. */
+  QList<FFTPlan *> _queue;
+  /** FFTW plans to destroy. */
+  QList<fftwf_plan> _retired;
+
+  friend class FFTPlan;
+};
+
+#endif // DSP_FFTPLAN_HH
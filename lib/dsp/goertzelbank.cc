@@ -0,0 +1,78 @@
+#include "goertzelbank.hh"
+#include <algorithm>
+#include <cmath>
+
+
+/* ********************************************************************************************* *
+ * Implementation of GoertzelBank
+ * ********************************************************************************************* */
+GoertzelBank::GoertzelBank(double rate, size_t length)
+  : _rate(rate), _length(std::max(size_t(1), length)), _count(0), _completed(false),
+    _coeff(), _s1(), _s2(), _magnitude()
+{
+  // pass...
+}
+
+size_t
+GoertzelBank::add(double frequency) {
+  _coeff.append(2*std::cos(2*M_PI*frequency/_rate));
+  _s1.append(0); _s2.append(0);
+  _magnitude.append(0);
+  return _coeff.size()-1;
+}
+
+size_t
+GoertzelBank::numFilters() const {
+  return _coeff.size();
+}
+
+size_t
+GoertzelBank::length() const {
+  return _length;
+}
+
+double
+GoertzelBank::resolution() const {
+  return _rate/_length;
+}
+
+size_t
+GoertzelBank::process(const int16_t *samples, size_t n) {
+  _completed = false;
+  n = std::min(n, _length-_count);
+
+  const size_t nFilters = _coeff.size();
+  const float * __restrict coeff = _coeff.constData();
+  float * __restrict s1 = _s1.data();
+  float * __restrict s2 = _s2.data();
+  // Filters are independent, hence the inner loop vectorizes
+  for (size_t i=0; i<n; i++) {
+    float x = samples[i];
+    for (size_t j=0; j<nFilters; j++) {
+      float s0 = x + coeff[j]*s1[j] - s2[j];
+      s2[j] = s1[j]; s1[j] = s0;
+    }
+  }
+  _count += n;
+
+  if (_length == _count) {
+    for (size_t j=0; j<nFilters; j++) {
+      double power = double(s1[j])*s1[j] + double(s2[j])*s2[j] - double(coeff[j])*s1[j]*s2[j];
+      _magnitude[j] = std::sqrt(std::max(0., power)/_length);
+      s1[j] = s2[j] = 0;
+    }
+    _count = 0;
+    _completed = true;
+  }
+  return n;
+}
+
+bool
+GoertzelBank::completed() const {
+  return _completed;
+}
+
+double
+GoertzelBank::magnitude(size_t i) const {
+  return _magnitude[i];
+}
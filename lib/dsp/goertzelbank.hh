@@ -0,0 +1,54 @@
+#ifndef DSP_GOERTZELBANK_HH
+#define DSP_GOERTZELBANK_HH
+
+#include <QVector>
+#include <cstdint>
+
+
+/** A bank of Goertzel filters, each estimating the magnitude of a single DFT bin at an arbitrary
+ * frequency over blocks of a fixed length.
+ * The cost per sample is proportional to the number of filters, the frequency resolution is
+ * given by the block length and is not tied to a power of two. The filter states are stored in
+ * contiguous single precision arrays and all filters are updated per sample in one loop, which
+ * the compiler vectorizes (SSE, NEON). */
+class GoertzelBank
+{
+public:
+  /** Constructs an empty bank for the sample rate @c rate in Hz and the block length @c length in
+   * samples. */
+  GoertzelBank(double rate, size_t length);
+
+  /** Adds a filter at the given frequency in Hz. Returns the index of the filter. */
+  size_t add(double frequency);
+  /** Returns the number of filters. */
+  size_t numFilters() const;
+  /** Returns the block length in samples. */
+  size_t length() const;
+  /** Returns the frequency resolution in Hz. */
+  double resolution() const;
+
+  /** Processes at most the samples needed to complete the current block and returns the number of
+   * samples processed. Once a block is completed, the magnitudes are updated and @c completed
+   * returns @c true until the next call. */
+  size_t process(const int16_t *samples, size_t n);
+  /** Returns @c true if the last call to @c process completed a block. */
+  bool completed() const;
+  /** Returns the magnitude of the specified filter over the last completed block, normalized like
+   * the magnitude of a DFT bin divided by the square root of the block length. */
+  double magnitude(size_t i) const;
+
+protected:
+  double _rate;
+  size_t _length;
+  /** Number of samples processed in the current block. */
+  size_t _count;
+  bool _completed;
+  /** Filter coefficients 2cos(2pi f/rate). */
+  QVector<float> _coeff;
+  /** Filter states. */
+  QVector<float> _s1, _s2;
+  /** Magnitudes of the last completed block. */
+  QVector<double> _magnitude;
+};
+
+#endif // DSP_GOERTZELBANK_HH
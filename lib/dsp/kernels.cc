@@ -0,0 +1,122 @@
+#include "kernels.hh"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+
+/** Approximates log2(x) from the exponent and a polynomial of the mantissa. Values <= 0, denormals
+ * and NaNs are clamped to the smallest normal float. */
+static inline float
+fast_log2(float x) {
+  int32_t bits; std::memcpy(&bits, &x, 4);
+  // Clamping in the integer domain keeps the loops free of branches, negative values have
+  // negative bit patterns
+  bits = std::max(bits, int32_t(0x00800000));
+  // Exponent and mantissa in [1,2)
+  float e = float(((bits >> 23) & 0xff) - 127);
+  bits = (bits & 0x007fffff) | 0x3f800000;
+  float m; std::memcpy(&m, &bits, 4);
+  // Polynomial approximation of log2(m)/(m-1) on [1,2), interpolating at the Chebyshev nodes
+  float p = -0.033822046f;
+  p = p*m + 0.31358133f;
+  p = p*m - 1.2177429f;
+  p = p*m + 2.5786199f;
+  p = p*m - 3.3095852f;
+  p = p*m + 3.1116303f;
+  return e + p*(m-1);
+}
+
+void
+dsp_window(const int16_t *__restrict in, const float *__restrict window, float scale,
+           float *__restrict out, size_t n)
+{
+  if (0 == window) {
+    for (size_t i=0; i<n; i++) {
+      out[i] = scale*in[i];
+    }
+    return;
+  }
+  for (size_t i=0; i<n; i++) {
+    out[i] = scale*window[i]*in[i];
+  }
+}
+
+void
+dsp_power(const fftwf_complex *__restrict in, float scale, float *__restrict out, size_t n) {
+  for (size_t i=0; i<n; i++) {
+    out[i] = scale*(in[i][0]*in[i][0] + in[i][1]*in[i][1]);
+  }
+}
+
+void
+dsp_accumulate_power(const fftwf_complex *__restrict in, float scale, float *__restrict acc,
+                     size_t n)
+{
+  for (size_t i=0; i<n; i++) {
+    acc[i] += scale*(in[i][0]*in[i][0] + in[i][1]*in[i][1]);
+  }
+}
+
+void
+dsp_average_power(const fftwf_complex *__restrict in, float scale, float alpha,
+                  float *__restrict avg, size_t n)
+{
+  for (size_t i=0; i<n; i++) {
+    avg[i] += alpha*(scale*(in[i][0]*in[i][0] + in[i][1]*in[i][1]) - avg[i]);
+  }
+}
+
+void
+dsp_max_power(const fftwf_complex *__restrict in, float scale, float *__restrict max, size_t n) {
+  for (size_t i=0; i<n; i++) {
+    max[i] = std::max(max[i], scale*(in[i][0]*in[i][0] + in[i][1]*in[i][1]));
+  }
+}
+
+void
+dsp_complex_dot(const float *__restrict in, const float *__restrict re,
+                const float *__restrict im, float *__restrict out, size_t n)
+{
+  // Independent partial sums, as float reductions are not reordered without -ffast-math
+  float accRe[8] = {0,0,0,0,0,0,0,0}, accIm[8] = {0,0,0,0,0,0,0,0};
+  size_t i=0;
+  for (; (i+8)<=n; i+=8) {
+    for (size_t j=0; j<8; j++) {
+      accRe[j] += in[i+j]*re[i+j];
+      accIm[j] += in[i+j]*im[i+j];
+    }
+  }
+  for (size_t j=0; i<n; i++, j++) {
+    accRe[j] += in[i]*re[i];
+    accIm[j] += in[i]*im[i];
+  }
+  out[0] = out[1] = 0;
+  for (size_t j=0; j<8; j++) {
+    out[0] += accRe[j]; out[1] += accIm[j];
+  }
+}
+
+void
+dsp_scale(const float *in, float scale, float *out, size_t n) {
+  // May be used in-place, hence no restrict
+  for (size_t i=0; i<n; i++) {
+    out[i] = scale*in[i];
+  }
+}
+
+void
+dsp_magnitude(const fftwf_complex *__restrict in, float scale, float *__restrict out, size_t n) {
+  for (size_t i=0; i<n; i++) {
+    // sqrtf maps to a single instruction with -fno-math-errno, which -O3 vectorizes
+    out[i] = std::sqrt(scale*(in[i][0]*in[i][0] + in[i][1]*in[i][1]));
+  }
+}
+
+void
+dsp_log_power(const float *__restrict in, float offset, float *__restrict out, size_t n) {
+  // 10*log10(x) = 10*log10(2)*log2(x)
+  const float k = 3.0102999566f;
+  for (size_t i=0; i<n; i++) {
+    out[i] = k*fast_log2(in[i]) + offset;
+  }
+}
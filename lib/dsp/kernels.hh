@@ -0,0 +1,35 @@
+#ifndef DSP_KERNELS_HH
+#define DSP_KERNELS_HH
+
+#include <cstddef>
+#include <cstdint>
+#include <fftw3.h>
+
+/** @file kernels.hh Elementary vector operations of the DSP core.
+ * The kernels are plain loops over restrict-qualified arrays without branches or calls to the
+ * math library, such that the compiler vectorizes them for the target (SSE/AVX, NEON). */
+
+/** Converts integer samples to float, scales and applies a window: out = scale*window*in. If
+ * @c window is null, no window is applied. */
+void dsp_window(const int16_t *in, const float *window, float scale, float *out, size_t n);
+/** Power of complex values: out = scale*|in|^2. */
+void dsp_power(const fftwf_complex *in, float scale, float *out, size_t n);
+/** Accumulates the power of complex values: acc += scale*|in|^2. */
+void dsp_accumulate_power(const fftwf_complex *in, float scale, float *acc, size_t n);
+/** Exponentially averages the power of complex values: avg += alpha*(scale*|in|^2 - avg). */
+void dsp_average_power(const fftwf_complex *in, float scale, float alpha, float *avg, size_t n);
+/** Keeps the maximum power of complex values: max = max(max, scale*|in|^2). */
+void dsp_max_power(const fftwf_complex *in, float scale, float *max, size_t n);
+/** Dot product of a real vector with complex coefficients given as separate real and imaginary
+ * parts: out[0] = sum in*re, out[1] = sum in*im. */
+void dsp_complex_dot(const float *in, const float *re, const float *im, float *out, size_t n);
+/** Scales a vector: out = scale*in. */
+void dsp_scale(const float *in, float scale, float *out, size_t n);
+/** Magnitude of complex values: out = sqrt(scale)*|in|. */
+void dsp_magnitude(const fftwf_complex *in, float scale, float *out, size_t n);
+/** Converts power values into decibel: out = 10*log10(in) + offset. Uses a polynomial
+ * approximation of the logarithm, the error is below 3e-5 dB (5e-5 dB including the rounding of
+ * levels far from 0 dB). Values <= 0 map to a large negative level. */
+void dsp_log_power(const float *in, float offset, float *out, size_t n);
+
+#endif // DSP_KERNELS_HH
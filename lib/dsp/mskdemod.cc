@@ -0,0 +1,204 @@
+#include "mskdemod.hh"
+#include "window.hh"
+#include "kernels.hh"
+#include <algorithm>
+#include <cmath>
+
+/** Number of symbols per block of the phase tracking. */
+#define MSK_BLOCK_SYMBOLS 8
+/** Gain of the frequency tracking. */
+#define MSK_FLL_GAIN 0.25
+/** Min. magnitude of the weaker line relative to the stronger one. A block of (almost) equal bits
+ * carries only one line and gets extended. */
+#define MSK_MIN_LINE 0.25
+/** Max. number of blocks a block gets extended to. */
+#define MSK_MAX_EXTEND 4
+
+
+/* ********************************************************************************************* *
+ * Implementation of MSKDemodulator
+ * ********************************************************************************************* */
+MSKDemodulator::MSKDemodulator(double rate, double interval)
+  : _rate(rate), _length(std::max(1., std::round(rate*interval))), _count(0), _completed(false),
+    _buffer(), _offset(0), _channels()
+{
+  // pass...
+}
+
+size_t
+MSKDemodulator::add(double frequency, double baud) {
+  Channel channel;
+  // Decimate to about 4 samples per symbol
+  channel.decimation = std::max(1., std::floor(_rate/(4*baud)));
+  double outputRate = _rate/channel.decimation;
+  // Low-pass passing the main lobe of the MSK spectrum (+/- 0.75 baud), with a transition of
+  // half the baud rate and 60dB stop-band attenuation
+  double cutoff = 1.25*baud/_rate;
+  size_t length = std::ceil(7.3*_rate/baud);
+  WindowFunction window(WindowFunction::KAISER, length, 5.65);
+  channel.re.resize(length); channel.im.resize(length);
+  double omega = 2*M_PI*frequency/_rate, gain = 0;
+  QVector<double> h(length);
+  for (size_t k=0; k<length; k++) {
+    double t = k - (length-1)/2.;
+    h[k] = window.data()[k] * ((0 == t) ? 2*cutoff : std::sin(2*M_PI*cutoff*t)/(M_PI*t));
+    gain += h[k];
+  }
+  // Shift to the carrier, the factor 2 yields the amplitude of the real input
+  for (size_t k=0; k<length; k++) {
+    channel.re[k] =  2*h[k]/gain*std::cos(omega*k);
+    channel.im[k] = -2*h[k]/gain*std::sin(omega*k);
+  }
+  // Start with the next input sample
+  channel.next = _offset + _buffer.size();
+  channel.carrier = std::fmod(omega*channel.next, 2*M_PI);
+  channel.carrierStep = std::fmod(omega*channel.decimation, 2*M_PI);
+  channel.block = std::max(1., std::round(MSK_BLOCK_SYMBOLS*outputRate/baud));
+  channel.nco = 0;
+  channel.tone = 0;
+  channel.toneStep = M_PI*baud/outputRate;
+  channel.plusRe = channel.plusIm = channel.minusRe = channel.minusIm = 0;
+  channel.count = 0;
+  channel.lines = 0; channel.outputs = 0;
+  channel.amplitude = channel.phase = channel.offset = channel.residual = 0;
+  channel.lastPhase = NAN;
+  _channels.append(channel);
+  return _channels.size()-1;
+}
+
+size_t
+MSKDemodulator::numChannels() const {
+  return _channels.size();
+}
+
+double
+MSKDemodulator::interval() const {
+  return _length/_rate;
+}
+
+size_t
+MSKDemodulator::process(const int16_t *samples, size_t n) {
+  _completed = false;
+  n = std::min(n, _length-_count);
+
+  // Append samples to the buffer
+  size_t size = _buffer.size();
+  _buffer.resize(size+n);
+  dsp_window(samples, 0, 1, _buffer.data()+size, n);
+  qint64 end = _offset + _buffer.size();
+
+  // Evaluate the filters of all channels at their decimated instants
+  qint64 first = end;
+  for (int i=0; i<_channels.size(); i++) {
+    Channel &channel = _channels[i];
+    const qint64 length = channel.re.size();
+    for (; (channel.next+length) <= end; channel.next += channel.decimation) {
+      float z[2];
+      dsp_complex_dot(_buffer.constData()+(channel.next-_offset), channel.re.constData(),
+                      channel.im.constData(), z, length);
+      // Down-conversion phase at the first sample of the filter
+      float c = std::cos(channel.carrier), s = std::sin(channel.carrier);
+      _integrate(channel, z[0]*c + z[1]*s, z[1]*c - z[0]*s);
+      double step = channel.carrierStep + 2*M_PI*channel.offset*channel.decimation/_rate;
+      channel.carrier = std::fmod(channel.carrier + step, 2*M_PI);
+      channel.nco += 2*M_PI*channel.offset*channel.decimation/_rate;
+    }
+    first = std::min(first, channel.next);
+  }
+  // Drop samples not needed anymore
+  if (first > _offset) {
+    _buffer.remove(0, first-_offset);
+    _offset = first;
+  }
+
+  _count += n;
+  if (_length == _count) {
+    for (int i=0; i<_channels.size(); i++) {
+      _update(_channels[i]);
+    }
+    _count = 0;
+    _completed = true;
+  }
+  return n;
+}
+
+bool
+MSKDemodulator::completed() const {
+  return _completed;
+}
+
+double
+MSKDemodulator::amplitude(size_t i) const {
+  return _channels[i].amplitude;
+}
+
+double
+MSKDemodulator::phase(size_t i) const {
+  return _channels[i].phase;
+}
+
+double
+MSKDemodulator::frequencyOffset(size_t i) const {
+  return _channels[i].offset;
+}
+
+void
+MSKDemodulator::reset() {
+  for (int i=0; i<_channels.size(); i++) {
+    Channel &channel = _channels[i];
+    channel.nco = channel.offset = channel.residual = channel.phase = 0;
+    channel.lastPhase = NAN;
+  }
+}
+
+void
+MSKDemodulator::_integrate(Channel &channel, float re, float im) {
+  // Squaring removes the modulation, leaving lines at +/- half the baud rate
+  double sRe = double(re)*re - double(im)*im, sIm = 2*double(re)*im;
+  double c = std::cos(channel.tone), s = std::sin(channel.tone);
+  channel.plusRe  += sRe*c + sIm*s; channel.plusIm  += sIm*c - sRe*s;
+  channel.minusRe += sRe*c - sIm*s; channel.minusIm += sIm*c + sRe*s;
+  channel.tone = std::fmod(channel.tone + channel.toneStep, 2*M_PI);
+  if (++channel.count >= channel.block) {
+    _track(channel);
+  }
+}
+
+void
+MSKDemodulator::_track(Channel &channel) {
+  // The phase of a missing line is random, extend the block until both lines are present
+  double plus = std::hypot(channel.plusRe, channel.plusIm);
+  double minus = std::hypot(channel.minusRe, channel.minusIm);
+  if ((std::min(plus, minus) < MSK_MIN_LINE*std::max(plus, minus))
+      && (channel.count < MSK_MAX_EXTEND*channel.block)) {
+    return;
+  }
+  // Each line carries about half of the squared amplitude
+  channel.lines += plus + minus;
+  channel.outputs += channel.count;
+  // The timing offset cancels in the sum of the line phases, leaving four times the carrier phase
+  double phase = std::atan2(channel.plusIm*channel.minusRe + channel.plusRe*channel.minusIm,
+                            channel.plusRe*channel.minusRe - channel.plusIm*channel.minusIm);
+  if (std::isnan(channel.lastPhase)) {
+    channel.residual = phase/4;
+  } else {
+    // Unwrap the phase relative to the tracked carrier and follow its drift
+    double delta = std::remainder(phase - channel.lastPhase, 2*M_PI)/4;
+    double duration = double(channel.count*channel.decimation)/_rate;
+    channel.residual += delta;
+    channel.offset += MSK_FLL_GAIN*delta/(2*M_PI*duration);
+  }
+  channel.lastPhase = phase;
+  channel.plusRe = channel.plusIm = channel.minusRe = channel.minusIm = 0;
+  channel.count = 0;
+}
+
+void
+MSKDemodulator::_update(Channel &channel) {
+  // Keep the last estimates if no block was completed
+  if (0 == channel.outputs) { return; }
+  channel.amplitude = std::sqrt(channel.lines/channel.outputs);
+  // Carrier phase relative to the nominal frequency
+  channel.phase = channel.nco + channel.residual;
+  channel.lines = 0; channel.outputs = 0;
+}
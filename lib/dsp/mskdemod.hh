@@ -0,0 +1,109 @@
+#ifndef DSP_MSKDEMOD_HH
+#define DSP_MSKDEMOD_HH
+
+#include <QVector>
+#include <cstdint>
+
+
+/** Coherent amplitude and phase tracking of MSK transmitters (e.g., DHO, NAA, GQD).
+ * Each channel down-converts its carrier to baseband and decimates it to about 4 samples per
+ * symbol in a single step: a Kaiser windowed low-pass, shifted to the carrier frequency, is only
+ * evaluated at the decimated instants on the shared input buffer. Hence the cost per input sample
+ * and channel is a few multiply-adds, independent of the carrier frequency.
+ *
+ * The carrier is recovered by squaring the baseband signal, which removes the modulation and
+ * leaves two lines at +/- half the baud rate. Both lines are integrated over blocks of 8 symbols,
+ * the sum of their phases yields four times the carrier phase and their magnitudes the carrier
+ * amplitude. A block of (almost) equal bits carries only one of the lines and gets extended. The
+ * carrier phase is unwrapped between blocks and a frequency locked loop follows the drift of the
+ * carrier (e.g., due to the sound card clock), which keeps the changes between blocks small.
+ * Offsets up to about 1/80 of the baud rate are acquired reliably (1/64 is the limit of the
+ * unwrapping, see test/mskdemodtest.cc). The carrier phase is known up to a
+ * constant multiple of pi/2 only, but its changes (e.g., due to ionospheric disturbances) are
+ * tracked continuously. */
+class MSKDemodulator
+{
+public:
+  /** Constructs a demodulator without channels for the sample rate @c rate in Hz, updating the
+   * estimates every @c interval seconds. */
+  MSKDemodulator(double rate, double interval=0.1);
+
+  /** Adds a channel for a transmitter at the carrier @c frequency in Hz with the given @c baud
+   * rate. Returns the index of the channel. */
+  size_t add(double frequency, double baud);
+  /** Returns the number of channels. */
+  size_t numChannels() const;
+  /** Returns the update interval in s. */
+  double interval() const;
+
+  /** Processes at most the samples needed to complete the current interval and returns the
+   * number of samples processed. Once an interval is completed, the estimates are updated and
+   * @c completed returns @c true until the next call. */
+  size_t process(const int16_t *samples, size_t n);
+  /** Returns @c true if the last call to @c process completed an interval. */
+  bool completed() const;
+
+  /** Returns the carrier amplitude of the channel in input units. */
+  double amplitude(size_t i) const;
+  /** Returns the unwrapped carrier phase of the channel in rad. */
+  double phase(size_t i) const;
+  /** Returns the frequency offset of the carrier in Hz, from the phase change over the last
+   * interval. */
+  double frequencyOffset(size_t i) const;
+
+  /** Resets the phase tracking of all channels. */
+  void reset();
+
+protected:
+  /** State of a channel. */
+  typedef struct {
+    /** Decimation factor. */
+    size_t decimation;
+    /** Real and imaginary parts of the shifted low-pass. */
+    QVector<float> re, im;
+    /** Absolute index of the first input sample of the next output. */
+    qint64 next;
+    /** Number of outputs per block of the phase tracking. */
+    size_t block;
+    /** Phase of the down-conversion at the next output and its nominal increment per output. */
+    double carrier, carrierStep;
+    /** Phase of the tracked carrier relative to the nominal one. */
+    double nco;
+    /** Phase of the lines of the squared signal and its increment per output. */
+    double tone, toneStep;
+    /** Lines at +/- half the baud rate integrated over the current block and the number of
+     * outputs integrated. */
+    double plusRe, plusIm, minusRe, minusIm;
+    size_t count;
+    /** Sum of the line magnitudes and number of outputs of the blocks of the current interval. */
+    double lines;
+    size_t outputs;
+    /** Estimates of the last interval, the offset also tunes the down-conversion. */
+    double amplitude, phase, offset;
+    /** Unwrapped phase relative to the tracked carrier. */
+    double residual;
+    /** Four times the carrier phase of the last interval, NaN if unknown. */
+    double lastPhase;
+  } Channel;
+
+  /** Adds an output sample to the integrated lines of the channel. */
+  void _integrate(Channel &channel, float re, float im);
+  /** Updates the phase tracking of the channel at the end of a block. */
+  void _track(Channel &channel);
+  /** Updates the estimates of the channel at the end of an interval. */
+  void _update(Channel &channel);
+
+protected:
+  double _rate;
+  /** Interval length in samples. */
+  size_t _length;
+  /** Number of samples processed in the current interval. */
+  size_t _count;
+  bool _completed;
+  /** Input samples, starting at the absolute index @c _offset. */
+  QVector<float> _buffer;
+  qint64 _offset;
+  QVector<Channel> _channels;
+};
+
+#endif // DSP_MSKDEMOD_HH
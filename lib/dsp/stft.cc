@@ -0,0 +1,79 @@
+#include "stft.hh"
+#include "kernels.hh"
+#include <algorithm>
+#include <cstring>
+
+
+/* ********************************************************************************************* *
+ * Implementation of STFT
+ * ********************************************************************************************* */
+STFT::STFT(FFTPlanCache &plans, size_t size, size_t hop, WindowFunction::Type window,
+           float scale)
+  : _hop(std::max(size_t(1), std::min(hop, size))), _window(window, size), _scale(scale),
+    _plan(plans.create(size)), _frame(size), _fill(0), _completed(false)
+{
+  // pass...
+}
+
+STFT::~STFT() {
+  delete _plan;
+}
+
+size_t
+STFT::size() const {
+  return _frame.size();
+}
+
+size_t
+STFT::hop() const {
+  return _hop;
+}
+
+const WindowFunction &
+STFT::window() const {
+  return _window;
+}
+
+size_t
+STFT::process(const int16_t *samples, size_t n) {
+  _completed = false;
+  size_t size = _frame.size();
+  n = std::min(n, size-_fill);
+  std::memcpy(_frame.data()+_fill, samples, n*sizeof(int16_t));
+  _fill += n;
+
+  if (size == _fill) {
+    dsp_window(_frame.constData(), _window.data(), _scale, _plan->input(), size);
+    _plan->execute();
+    // Keep the overlap for the next frame
+    std::memmove(_frame.data(), _frame.constData()+_hop, (size-_hop)*sizeof(int16_t));
+    _fill = size-_hop;
+    _completed = true;
+  }
+  return n;
+}
+
+bool
+STFT::completed() const {
+  return _completed;
+}
+
+size_t
+STFT::numBins() const {
+  return _plan->numBins();
+}
+
+const fftwf_complex *
+STFT::spectrum() const {
+  return _plan->output();
+}
+
+void
+STFT::power(float *out, float scale) const {
+  dsp_power(_plan->output(), scale/_window.sumSquares(), out, numBins());
+}
+
+void
+STFT::accumulatePower(float *acc, float scale) const {
+  dsp_accumulate_power(_plan->output(), scale/_window.sumSquares(), acc, numBins());
+}
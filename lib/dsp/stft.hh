@@ -0,0 +1,62 @@
+#ifndef DSP_STFT_HH
+#define DSP_STFT_HH
+
+#include "fftplan.hh"
+#include "window.hh"
+#include <QVector>
+#include <cstdint>
+
+
+/** Short-time Fourier transform of a sample stream.
+ * Samples are collected into overlapping frames of @c size samples, advanced by @c hop samples.
+ * Each completed frame is windowed and transformed, the spectrum remains accessible until the
+ * next frame completes. */
+class STFT
+{
+public:
+  /** Constructor.
+   * @param plans Specifies the plan cache to obtain the FFT plan from.
+   * @param size Specifies the frame size.
+   * @param hop Specifies the number of samples between the starts of subsequent frames. Frames
+   *        overlap if @c hop is smaller than @c size.
+   * @param window Specifies the window applied to each frame.
+   * @param scale Specifies the scaling of the integer samples. */
+  STFT(FFTPlanCache &plans, size_t size, size_t hop,
+       WindowFunction::Type window=WindowFunction::HANN, float scale=1);
+  /** Destructor. */
+  ~STFT();
+
+  size_t size() const;
+  size_t hop() const;
+  const WindowFunction &window() const;
+
+  /** Processes at most the samples needed to complete the next frame and returns the number of
+   * samples processed. If a frame was completed, it gets transformed and @c completed returns
+   * @c true until the next call. */
+  size_t process(const int16_t *samples, size_t n);
+  /** Returns @c true if the last call to @c process completed a frame. */
+  bool completed() const;
+
+  /** Returns the number of bins of the spectrum, i.e. size/2+1. */
+  size_t numBins() const;
+  /** Returns the spectrum of the last completed frame. */
+  const fftwf_complex *spectrum() const;
+  /** Computes the power spectrum of the last completed frame, normalized by the window power
+   * such that white noise has the same level for any window, times @c scale. */
+  void power(float *out, float scale=1) const;
+  /** Adds the normalized power spectrum of the last completed frame times @c scale. */
+  void accumulatePower(float *acc, float scale=1) const;
+
+protected:
+  size_t _hop;
+  WindowFunction _window;
+  float _scale;
+  FFTPlan *_plan;
+  /** Samples of the current frame. */
+  QVector<int16_t> _frame;
+  /** Number of samples in the current frame. */
+  size_t _fill;
+  bool _completed;
+};
+
+#endif // DSP_STFT_HH
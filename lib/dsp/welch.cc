@@ -0,0 +1,112 @@
+#include "welch.hh"
+#include "kernels.hh"
+#include <algorithm>
+#include <cmath>
+
+
+/* ********************************************************************************************* *
+ * Implementation of WelchPSD
+ * ********************************************************************************************* */
+WelchPSD::WelchPSD(FFTPlanCache &plans, double rate, double resolution, double overlap,
+                   WindowFunction::Type window, Averaging averaging, double frames, float scale)
+  : _rate(rate), _averaging(averaging), _frames(std::max(1., frames)),
+    _stft(plans, _frameSize(rate, resolution), _frameHop(_frameSize(rate, resolution), overlap),
+          window, scale),
+    _acc(), _psd(), _count(0), _completed(false)
+{
+  _acc.fill(0, _stft.numBins());
+  _psd.fill(0, _stft.numBins());
+}
+
+size_t
+WelchPSD::size() const {
+  return _stft.size();
+}
+
+size_t
+WelchPSD::hop() const {
+  return _stft.hop();
+}
+
+double
+WelchPSD::resolution() const {
+  return _rate/_stft.size();
+}
+
+size_t
+WelchPSD::numBins() const {
+  return _stft.numBins();
+}
+
+size_t
+WelchPSD::bin(double frequency) const {
+  return std::min(numBins()-1, size_t(std::max(0., std::round(frequency/resolution()))));
+}
+
+double
+WelchPSD::frequency(size_t bin) const {
+  return bin*resolution();
+}
+
+size_t
+WelchPSD::process(const int16_t *samples, size_t n) {
+  _completed = false;
+  n = _stft.process(samples, n);
+  if (! _stft.completed()) { return n; }
+
+  // Normalization of the frame power by the window
+  float scale = 1./_stft.window().sumSquares();
+  switch (_averaging) {
+    case LINEAR:
+      dsp_accumulate_power(_stft.spectrum(), scale, _acc.data(), _acc.size());
+      if (++_count >= _frames) {
+        dsp_scale(_acc.constData(), 1./_count, _psd.data(), _psd.size());
+        _acc.fill(0); _count = 0;
+        _completed = true;
+      }
+      break;
+    case EXPONENTIAL:
+      // The first frames get a larger weight, such that the estimate is unbiased from the start
+      _count++;
+      dsp_average_power(_stft.spectrum(), scale, 1./std::min(double(_count), _frames),
+                        _psd.data(), _psd.size());
+      _completed = true;
+      break;
+    case MAX_HOLD:
+      dsp_max_power(_stft.spectrum(), scale, _psd.data(), _psd.size());
+      _count++;
+      _completed = true;
+      break;
+  }
+  return n;
+}
+
+size_t
+WelchPSD::_frameSize(double rate, double resolution) {
+  // Even frame size
+  return std::max(2., 2*std::round(rate/resolution/2));
+}
+
+size_t
+WelchPSD::_frameHop(size_t size, double overlap) {
+  overlap = std::min(0.9, std::max(0., overlap));
+  return std::max(1., std::round(size*(1-overlap)));
+}
+
+bool
+WelchPSD::completed() const {
+  return _completed;
+}
+
+const QVector<float> &
+WelchPSD::psd() const {
+  return _psd;
+}
+
+void
+WelchPSD::reset() {
+  _acc.fill(0);
+  _psd.fill(0);
+  _count = 0;
+  _completed = false;
+}
@@ -0,0 +1,83 @@
+#ifndef DSP_WELCH_HH
+#define DSP_WELCH_HH
+
+#include "stft.hh"
+
+
+/** Welch estimate of the power spectrum of a sample stream.
+ * The spectrum is averaged over overlapping windowed frames. The estimate is the power per bin,
+ * normalized by the window power such that white noise of variance s^2 yields s^2 in each bin
+ * independent of window and frame size (times the configured scale). */
+class WelchPSD
+{
+public:
+  /** Possible averaging modes. */
+  typedef enum {
+    /** Mean over a fixed number of frames, a new estimate is available after each block of
+     * frames. */
+    LINEAR,
+    /** Exponential moving average with a time constant given in frames, updated per frame. */
+    EXPONENTIAL,
+    /** Maximum of all frames since the last reset, updated per frame. */
+    MAX_HOLD
+  } Averaging;
+
+public:
+  /** Constructor.
+   * @param plans Specifies the plan cache.
+   * @param rate Specifies the sample rate in Hz.
+   * @param resolution Specifies the bin width in Hz, which determines the frame size.
+   * @param overlap Specifies the overlap of subsequent frames, usually 0.5 to 0.75.
+   * @param window Specifies the window.
+   * @param averaging Specifies the averaging mode.
+   * @param frames Specifies the number of frames averaged (@c LINEAR) or the time constant in
+   *        frames (@c EXPONENTIAL).
+   * @param scale Specifies the scaling of the integer samples. */
+  WelchPSD(FFTPlanCache &plans, double rate, double resolution, double overlap=0.5,
+           WindowFunction::Type window=WindowFunction::HANN, Averaging averaging=LINEAR,
+           double frames=8, float scale=1);
+
+  /** Returns the frame size. */
+  size_t size() const;
+  /** Returns the number of samples between subsequent frames. */
+  size_t hop() const;
+  /** Returns the bin width in Hz. */
+  double resolution() const;
+  /** Returns the number of bins. */
+  size_t numBins() const;
+  /** Returns the index of the bin containing the given frequency. */
+  size_t bin(double frequency) const;
+  /** Returns the center frequency of the bin. */
+  double frequency(size_t bin) const;
+
+  /** Processes at most the samples needed to complete the next frame and returns the number of
+   * samples processed. @c completed returns @c true if a new estimate is available. */
+  size_t process(const int16_t *samples, size_t n);
+  /** Returns @c true if the last call to @c process updated the estimate. */
+  bool completed() const;
+  /** Returns the current estimate. */
+  const QVector<float> &psd() const;
+  /** Discards the estimate and all frames averaged so far. */
+  void reset();
+
+protected:
+  /** Returns the frame size for the given resolution. */
+  static size_t _frameSize(double rate, double resolution);
+  /** Returns the hop for the given frame size and overlap. */
+  static size_t _frameHop(size_t size, double overlap);
+
+protected:
+  double _rate;
+  Averaging _averaging;
+  double _frames;
+  STFT _stft;
+  /** Sum (LINEAR), average or maximum of the frames. */
+  QVector<float> _acc;
+  /** The estimate. */
+  QVector<float> _psd;
+  /** Number of frames averaged. */
+  size_t _count;
+  bool _completed;
+};
+
+#endif // DSP_WELCH_HH
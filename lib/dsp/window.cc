@@ -0,0 +1,108 @@
+#include "window.hh"
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <fftw3.h>
+#include <cmath>
+#include <algorithm>
+
+
+/** Modified Bessel function of the first kind and order 0. */
+static double
+bessel_i0(double x) {
+  double sum = 1, term = 1, q = x*x/4;
+  for (int k=1; k<64; k++) {
+    term *= q/(double(k)*k);
+    sum += term;
+    if (term < 1e-12*sum) { break; }
+  }
+  return sum;
+}
+
+/** Frees a table. */
+static void
+free_table(WindowFunction::Table *table) {
+  fftwf_free(table->data);
+  delete table;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of WindowFunction
+ * ********************************************************************************************* */
+WindowFunction::WindowFunction(Type type, size_t size, double beta)
+  : _type(type), _size(size), _data()
+{
+  if (_size) {
+    _data = _table(_type, _size, beta);
+  }
+}
+
+WindowFunction::Type
+WindowFunction::type() const {
+  return _type;
+}
+
+size_t
+WindowFunction::size() const {
+  return _size;
+}
+
+const float *
+WindowFunction::data() const {
+  return _data ? _data->data : 0;
+}
+
+double
+WindowFunction::sum() const {
+  return _data ? _data->sum : 0;
+}
+
+double
+WindowFunction::sumSquares() const {
+  return _data ? _data->sumSquares : 0;
+}
+
+QSharedPointer<WindowFunction::Table>
+WindowFunction::_table(Type type, size_t size, double beta) {
+  static QMutex lock;
+  static QHash<QPair<QPair<int, quint64>, double>, QWeakPointer<Table> > cache;
+
+  QMutexLocker locker(&lock);
+  QPair<QPair<int, quint64>, double> key(QPair<int, quint64>(type, size),
+                                         (KAISER == type) ? beta : 0);
+  QSharedPointer<Table> table = cache.value(key).toStrongRef();
+  if (table) { return table; }
+
+  table = QSharedPointer<Table>(new Table(), free_table);
+  table->data = (float *) fftwf_malloc(sizeof(float)*size);
+  table->sum = table->sumSquares = 0;
+  for (size_t i=0; i<size; i++) {
+    double phi = 2*M_PI*i/size, w = 1;
+    switch (type) {
+      case RECTANGULAR:
+        w = 1;
+        break;
+      case HANN:
+        w = 0.5 - 0.5*std::cos(phi);
+        break;
+      case BLACKMAN_HARRIS:
+        w = 0.35875 - 0.48829*std::cos(phi) + 0.14128*std::cos(2*phi) - 0.01168*std::cos(3*phi);
+        break;
+      case KAISER: {
+        double x = 2.*i/size - 1;
+        w = bessel_i0(beta*std::sqrt(std::max(0., 1-x*x)))/bessel_i0(beta);
+      } break;
+    }
+    table->data[i] = w;
+    table->sum += w;
+    table->sumSquares += w*w;
+  }
+  // Drop tables no longer in use
+  QMutableHashIterator<QPair<QPair<int, quint64>, double>, QWeakPointer<Table> > item(cache);
+  while (item.hasNext()) {
+    if (item.next().value().isNull()) { item.remove(); }
+  }
+  cache.insert(key, table.toWeakRef());
+  return table;
+}
@@ -0,0 +1,55 @@
+#ifndef DSP_WINDOW_HH
+#define DSP_WINDOW_HH
+
+#include <QSharedPointer>
+
+
+/** A window function of a fixed size.
+ * WindowFunction tables are computed once and shared between all windows of the same type, size and
+ * parameter. The tables are periodic (DFT-even) as appropriate for spectral analysis. */
+class WindowFunction
+{
+public:
+  /** Possible window types. */
+  typedef enum {
+    RECTANGULAR,
+    HANN,
+    BLACKMAN_HARRIS,
+    KAISER
+  } Type;
+
+  /** A window table. */
+  typedef struct {
+    /** Aligned coefficients. */
+    float *data;
+    /** Sum of the coefficients. */
+    double sum;
+    /** Sum of the squared coefficients. */
+    double sumSquares;
+  } Table;
+
+public:
+  /** Constructs a window of the given type and size. The parameter @c beta is only used by the
+   * Kaiser window. */
+  WindowFunction(Type type=HANN, size_t size=0, double beta=8.6);
+
+  Type type() const;
+  size_t size() const;
+  /** Returns the coefficients. */
+  const float *data() const;
+  /** Returns the sum of the coefficients, i.e. the coherent gain times the size. */
+  double sum() const;
+  /** Returns the sum of the squared coefficients, which normalizes power spectra of noise. */
+  double sumSquares() const;
+
+protected:
+  /** Returns the shared table for the window. */
+  static QSharedPointer<Table> _table(Type type, size_t size, double beta);
+
+protected:
+  Type _type;
+  size_t _size;
+  QSharedPointer<Table> _data;
+};
+
+#endif // DSP_WINDOW_HH
@@ -0,0 +1,243 @@
+#include "jsonstream.hh"
+#include <QJsonDocument>
+#include <QJsonArray>
+
+
+inline bool
+isJsonWhitespace(char c) {
+  return (' ' == c) || ('\t' == c) || ('\n' == c) || ('\r' == c);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of JsonStreamHandler
+ * ********************************************************************************************* */
+JsonStreamHandler::JsonStreamHandler()
+{
+  // pass...
+}
+
+JsonStreamHandler::~JsonStreamHandler() {
+  // pass...
+}
+
+bool
+JsonStreamHandler::arrayItem(const QJsonValue &value) {
+  return true;
+}
+
+bool
+JsonStreamHandler::objectMember(const QString &key, const QJsonValue &value) {
+  return true;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of JsonStreamParser
+ * ********************************************************************************************* */
+JsonStreamParser::JsonStreamParser(JsonStreamHandler &handler, size_t maxElementSize)
+  : _handler(handler), _maxElementSize(maxElementSize), _state(START), _isObject(false),
+    _numElements(0), _separated(false), _nesting(0), _inString(false), _escape(false), _token(),
+    _key(), _errorString()
+{
+  // pass...
+}
+
+bool
+JsonStreamParser::isComplete() const {
+  return DONE == _state;
+}
+
+bool
+JsonStreamParser::hasError() const {
+  return ERROR == _state;
+}
+
+const QString &
+JsonStreamParser::errorString() const {
+  return _errorString;
+}
+
+void
+JsonStreamParser::reset() {
+  _state = START;
+  _isObject = false;
+  _numElements = 0;
+  _separated = false;
+  _nesting = 0;
+  _inString = _escape = false;
+  _token.clear();
+  _key.clear();
+  _errorString.clear();
+}
+
+bool
+JsonStreamParser::feed(const QByteArray &data) {
+  return feed(data.constData(), data.size());
+}
+
+bool
+JsonStreamParser::feed(const char *data, size_t len) {
+  for (size_t i=0; i<len; i++) {
+    char c = data[i];
+    switch (_state) {
+    case START:
+      if (isJsonWhitespace(c)) { break; }
+      if ('[' == c) {
+        _isObject = false; _state = NEXT;
+      } else if ('{' == c) {
+        _isObject = true; _state = NEXT;
+      } else {
+        return _error("Document is neither an array nor an object.");
+      }
+      break;
+
+    case NEXT:
+      if (isJsonWhitespace(c)) { break; }
+      if (',' == c) {
+        // Exactly one separator between two elements
+        if ((0 == _numElements) || _separated) {
+          return _error("Unexpected ','.");
+        }
+        _separated = true;
+      } else if ((_isObject ? '}' : ']') == c) {
+        if (_separated) {
+          return _error("Trailing ',' before end of document.");
+        }
+        _state = DONE;
+      } else if (_numElements && (! _separated)) {
+        return _error("Expected ',' between elements.");
+      } else if (! _isObject) {
+        _startValue(c);
+      } else if ('"' == c) {
+        _token = "\""; _inString = true; _escape = false;
+        _state = KEY;
+      } else {
+        return _error("Expected member name.");
+      }
+      break;
+
+    case KEY:
+      _token.append(c);
+      if (_escape) {
+        _escape = false;
+      } else if ('\\' == c) {
+        _escape = true;
+      } else if ('"' == c) {
+        QJsonDocument doc = QJsonDocument::fromJson("["+_token+"]");
+        if ((! doc.isArray()) || (! doc.array().at(0).isString())) {
+          return _error("Invalid member name.");
+        }
+        _key = doc.array().at(0).toString();
+        _token.clear(); _inString = false;
+        _state = COLON;
+      }
+      break;
+
+    case COLON:
+      if (isJsonWhitespace(c)) { break; }
+      if (':' != c) {
+        return _error("Expected ':' after member name.");
+      }
+      _state = VALUE_START;
+      break;
+
+    case VALUE_START:
+      if (isJsonWhitespace(c)) { break; }
+      _startValue(c);
+      break;
+
+    case VALUE:
+      if (_inString) {
+        _token.append(c);
+        if (_escape) {
+          _escape = false;
+        } else if ('\\' == c) {
+          _escape = true;
+        } else if ('"' == c) {
+          _inString = false;
+          // String value complete
+          if ((0 == _nesting) && (! _emitValue())) { return false; }
+        }
+      } else if (('[' == c) || ('{' == c)) {
+        _token.append(c); _nesting++;
+      } else if ((']' == c) || ('}' == c)) {
+        if (0 == _nesting) {
+          // Scalar value terminated by the end of the top-level container
+          if (! _emitValue()) { return false; }
+          if ((_isObject ? '}' : ']') != c) {
+            return _error("Mismatched bracket.");
+          }
+          _state = DONE;
+        } else {
+          _token.append(c); _nesting--;
+          // Array or object value complete
+          if ((0 == _nesting) && (! _emitValue())) { return false; }
+        }
+      } else if ('"' == c) {
+        _token.append(c); _inString = true;
+      } else if ((0 == _nesting) && ((',' == c) || isJsonWhitespace(c))) {
+        // Scalar value complete, the terminating ',' separates it from the next element
+        if (! _emitValue()) { return false; }
+        _separated = (',' == c);
+      } else {
+        _token.append(c);
+      }
+      break;
+
+    case DONE:
+      if (isJsonWhitespace(c)) { break; }
+      return _error("Trailing data after document.");
+
+    case ERROR:
+      return false;
+    }
+
+    if (size_t(_token.size()) > _maxElementSize) {
+      return _error("Element too large.");
+    }
+  }
+
+  return true;
+}
+
+void
+JsonStreamParser::_startValue(char c) {
+  _token.clear();
+  _token.append(c);
+  _nesting = 0; _inString = false; _escape = false;
+  if ('"' == c) {
+    _inString = true;
+  } else if (('[' == c) || ('{' == c)) {
+    _nesting = 1;
+  }
+  _state = VALUE;
+}
+
+bool
+JsonStreamParser::_emitValue() {
+  QJsonParseError err;
+  QJsonDocument doc = QJsonDocument::fromJson("["+_token+"]", &err);
+  if ((QJsonParseError::NoError != err.error) || (1 != doc.array().size())) {
+    return _error(QString("Invalid element: %1").arg(err.errorString()));
+  }
+  _token.clear();
+  _state = NEXT;
+  _numElements++;
+  _separated = false;
+
+  bool ok = _isObject ? _handler.objectMember(_key, doc.array().at(0))
+                      : _handler.arrayItem(doc.array().at(0));
+  if (! ok) {
+    return _error("Aborted by handler.");
+  }
+  return true;
+}
+
+bool
+JsonStreamParser::_error(const QString &message) {
+  _errorString = message;
+  _state = ERROR;
+  _token.clear();
+  return false;
+}
@@ -0,0 +1,99 @@
+#ifndef JSONSTREAM_HH
+#define JSONSTREAM_HH
+
+#include <QByteArray>
+#include <QString>
+#include <QJsonValue>
+
+
+/** Interface of consumers of a @c JsonStreamParser. */
+class JsonStreamHandler
+{
+protected:
+  /** Hidden constructor. */
+  JsonStreamHandler();
+
+public:
+  /** Destructor. */
+  virtual ~JsonStreamHandler();
+
+  /** Gets called for every complete element of a top-level array. Returning @c false aborts
+   * the parser. */
+  virtual bool arrayItem(const QJsonValue &value);
+  /** Gets called for every complete member of a top-level object. Returning @c false aborts
+   * the parser. */
+  virtual bool objectMember(const QString &key, const QJsonValue &value);
+};
+
+
+/** Incremental parser for JSON documents consisting of a single array or object.
+ * The document can be passed in arbitrary chunks. Every element of the top-level array or
+ * member of the top-level object is passed to the handler as soon as it is complete. Only the
+ * currently incomplete element is kept in memory. */
+class JsonStreamParser
+{
+public:
+  /** Constructs a parser passing elements to the given handler.
+   * @param maxElementSize Specifies the max. size of a single element in bytes. */
+  JsonStreamParser(JsonStreamHandler &handler, size_t maxElementSize=(1<<20));
+
+  /** Parses the next chunk of the document. Returns @c false on error. */
+  bool feed(const char *data, size_t len);
+  /** Parses the next chunk of the document. Returns @c false on error. */
+  bool feed(const QByteArray &data);
+
+  /** Returns @c true if the top-level array or object was closed. */
+  bool isComplete() const;
+  /** Returns @c true if the document was malformed or the handler aborted. */
+  bool hasError() const;
+  /** Returns the error message. */
+  const QString &errorString() const;
+
+  /** Resets the parser. */
+  void reset();
+
+protected:
+  /** Starts a new value with the given character. */
+  void _startValue(char c);
+  /** Parses the complete token and passes it to the handler. */
+  bool _emitValue();
+  /** Puts the parser into the error state. */
+  bool _error(const QString &message);
+
+protected:
+  /** Possible parser states. */
+  typedef enum {
+    START,       ///< Before the top-level container.
+    NEXT,        ///< Expecting the next element, a separator or the end of the container.
+    KEY,         ///< Within a member name.
+    COLON,       ///< Expecting a colon after a member name.
+    VALUE_START, ///< Expecting a member value.
+    VALUE,       ///< Within a value.
+    DONE,        ///< Top-level container closed.
+    ERROR        ///< Malformed document or aborted.
+  } State;
+
+protected:
+  JsonStreamHandler &_handler;
+  size_t _maxElementSize;
+  State _state;
+  /** If @c true, the top-level container is an object, otherwise an array. */
+  bool _isObject;
+  /** Number of elements of the top-level container parsed so far. */
+  size_t _numElements;
+  /** If @c true, a ',' was read after the last element. */
+  bool _separated;
+  /** Nesting level within the current value. */
+  size_t _nesting;
+  /** Within a string literal. */
+  bool _inString;
+  /** Last character was an escape within a string literal. */
+  bool _escape;
+  /** The current (incomplete) token. */
+  QByteArray _token;
+  /** The current member name. */
+  QString _key;
+  QString _errorString;
+};
+
+#endif // JSONSTREAM_HH
@@ -85,9 +85,9 @@ Location::lineDist(const Location &other) const {
   double dx = _radius*std::cos(_latitude)*std::cos(_longitude);
   double dy = _radius*std::sin(_latitude);
   double dz = _radius*std::cos(_latitude)*std::sin(_longitude);
-  dx -= other._radius*std::cos(_latitude)*std::cos(other._longitude);
+  dx -= other._radius*std::cos(other._latitude)*std::cos(other._longitude);
   dy -= other._radius*std::sin(other._latitude);
-  dz -= other._radius*std::cos(_latitude)*std::sin(other._longitude);
+  dz -= other._radius*std::cos(other._latitude)*std::sin(other._longitude);
   return std::sqrt(dx*dx + dy*dy + dz*dz);
 }
 
@@ -101,6 +101,23 @@ Location::arcDist(const Location &other) const {
           sin_dlat*sin_dlat + std::cos(_latitude)*std::cos(other._latitude)*sin_dlon*sin_dlon));
 }
 
+double
+Location::bearing(const Location &other) const {
+  double dlon = other._longitude-_longitude;
+  double y = std::sin(dlon)*std::cos(other._latitude);
+  double x = std::cos(_latitude)*std::sin(other._latitude)
+      - std::sin(_latitude)*std::cos(other._latitude)*std::cos(dlon);
+  double deg = std::atan2(y, x)*180/M_PI;
+  return (deg < 0) ? (deg+360) : deg;
+}
+
+void
+Location::unitVector(double *v) const {
+  v[0] = std::cos(_latitude)*std::cos(_longitude);
+  v[1] = std::sin(_latitude);
+  v[2] = std::cos(_latitude)*std::sin(_longitude);
+}
+
 
 QString
 Location::toString() const {
@@ -30,6 +30,10 @@ public:
   double lineDist(const Location &other) const;
   /** Great circle distance between two points. */
   double arcDist(const Location &other) const;
+  /** Initial bearing of the great circle towards the other point in degrees east of north. */
+  double bearing(const Location &other) const;
+  /** Stores the location as a unit vector (earth-centered, earth-fixed) into @c v. */
+  void unitVector(double *v) const;
 
   QString toString() const;
   QJsonObject toJson() const;
@@ -0,0 +1,135 @@
+#include "networkpolicy.hh"
+#include <algorithm>
+
+
+/* ********************************************************************************************* *
+ * Implementation of NetworkPolicy
+ * ********************************************************************************************* */
+const qint64 NetworkPolicy::MinRefresh;
+const qint64 NetworkPolicy::MaxRefresh;
+const qint64 NetworkPolicy::MinRound;
+
+NetworkPolicy::NetworkPolicy(size_t maxProbes)
+  : _crawler(), _maxProbes(maxProbes), _probes(0), _refreshQueue(), _due()
+{
+  // pass...
+}
+
+CrawlQueue &
+NetworkPolicy::crawler() {
+  return _crawler;
+}
+
+const CrawlQueue &
+NetworkPolicy::crawler() const {
+  return _crawler;
+}
+
+size_t
+NetworkPolicy::maxProbes() const {
+  return _maxProbes;
+}
+
+void
+NetworkPolicy::setMaxProbes(size_t n) {
+  _maxProbes = std::max(size_t(1), n);
+}
+
+size_t
+NetworkPolicy::numProbes() const {
+  return _probes;
+}
+
+void
+NetworkPolicy::scheduleRefresh(const Identifier &id, qint64 due) {
+  // Previous entries of the station get outdated and are skipped
+  _due[id] = due;
+  _refreshQueue.insert(due, id);
+}
+
+void
+NetworkPolicy::removeRefresh(const Identifier &id) {
+  _due.remove(id);
+}
+
+size_t
+NetworkPolicy::numRefreshes() const {
+  return _due.size();
+}
+
+bool
+NetworkPolicy::nextProbe(Identifier &id, bool &refresh, qint64 now) {
+  if (_probes >= _maxProbes) { return false; }
+  // Contact pending candidates first
+  if (_crawler.next(id, now)) {
+    refresh = false; _probes++;
+    return true;
+  }
+  // then refresh known stations that are due
+  qint64 due = _nextRefresh();
+  if ((due < 0) || (due > now)) { return false; }
+  id = _refreshQueue.begin().value();
+  _refreshQueue.erase(_refreshQueue.begin());
+  _due.remove(id);
+  refresh = true; _probes++;
+  return true;
+}
+
+bool
+NetworkPolicy::probeDone(qint64 now) {
+  if (_probes) { _probes--; }
+  qint64 due = _nextRefresh();
+  return _crawler.numReady(now) || ((due >= 0) && (due <= now));
+}
+
+qint64
+NetworkPolicy::nextRound(qint64 now) const {
+  // Wake up for the next candidate or the next refresh, whatever comes first
+  qint64 delay = _crawler.nextDue(now);
+  qint64 due = _nextRefresh();
+  if (due >= 0) {
+    // Refreshes are overdue while all probes are running
+    qint64 refresh = std::max(qint64(0), due-now);
+    delay = (delay < 0) ? refresh : std::min(delay, refresh);
+  }
+  if (delay < 0) { return -1; }
+  return std::max(MinRound, delay);
+}
+
+bool
+NetworkPolicy::reconcile() const {
+  return 0 == _crawler.numPending();
+}
+
+qint64
+NetworkPolicy::reconcileInterval(qint64 now) {
+  return _crawler.interval(now);
+}
+
+qint64
+NetworkPolicy::refreshAfterSuccess(qint64 interval, size_t successes, size_t failures) {
+  // Refresh stable stations less often
+  if (successes && (0 == failures)) {
+    return std::min(2*interval, MaxRefresh);
+  }
+  return MinRefresh;
+}
+
+qint64
+NetworkPolicy::refreshAfterFailure(size_t failures) {
+  return std::min(MinRefresh << std::min(failures, size_t(10)), MaxRefresh);
+}
+
+qint64
+NetworkPolicy::_nextRefresh() const {
+  // Skip outdated entries
+  while (_refreshQueue.size()) {
+    QMultiMap<qint64, Identifier>::iterator item = _refreshQueue.begin();
+    QHash<Identifier, qint64>::const_iterator due = _due.find(item.value());
+    if ((_due.end() != due) && (due.value() == item.key())) {
+      return item.key();
+    }
+    _refreshQueue.erase(item);
+  }
+  return -1;
+}
@@ -0,0 +1,92 @@
+#ifndef NETWORKPOLICY_HH
+#define NETWORKPOLICY_HH
+
+#include <QHash>
+#include <QMap>
+#include <ovlnet/buckets.hh>
+#include "crawlqueue.hh"
+
+
+/** Round and refresh policy of the station list.
+ * Decides which stations get probed in a round: pending candidates of the crawler first, then the
+ * known stations due for a refresh, limited by the max. number of parallel probes. It determines
+ * when the next round is due and paces the reconciliation of station lists independently of the
+ * refreshes. The refresh interval of a known station grows while it is stable and backs off
+ * exponentially while it is not reachable.
+ *
+ * Like @c CrawlQueue, the class does not access the network or any clock. The current time in ms
+ * is passed to all methods, such that @c StationList and the offline simulator share the same
+ * policy. */
+class NetworkPolicy
+{
+public:
+  /** Min. refresh interval of a known station in ms. */
+  static const qint64 MinRefresh = 5*60*1000;
+  /** Max. refresh interval of a known station in ms. */
+  static const qint64 MaxRefresh = 6*3600*1000;
+  /** Min. delay between rounds in ms, unless a probe completed. */
+  static const qint64 MinRound = 1000;
+
+public:
+  /** Constructor.
+   * @param maxProbes Specifies the max. number of parallel probes. */
+  explicit NetworkPolicy(size_t maxProbes=8);
+
+  /** Returns the crawler. */
+  CrawlQueue &crawler();
+  /** Returns the crawler. */
+  const CrawlQueue &crawler() const;
+
+  /** Returns the max. number of parallel probes. */
+  size_t maxProbes() const;
+  /** Sets the max. number of parallel probes. */
+  void setMaxProbes(size_t n);
+  /** Returns the number of running probes. */
+  size_t numProbes() const;
+
+  /** Schedules the refresh of a known station at the specified time, replaces any previous
+   * refresh of that station. */
+  void scheduleRefresh(const Identifier &id, qint64 due);
+  /** Drops the scheduled refresh of a station. */
+  void removeRefresh(const Identifier &id);
+  /** Returns the number of scheduled refreshes. */
+  size_t numRefreshes() const;
+
+  /** Takes the next probe of the current round and counts it as running. Returns @c false if no
+   * candidate or refresh is due or all probes are running. @c refresh is set to @c true if a
+   * known station is due for a refresh. */
+  bool nextProbe(Identifier &id, bool &refresh, qint64 now);
+  /** Marks a running probe as completed. Returns @c true if the next round is due now. */
+  bool probeDone(qint64 now);
+  /** Returns the delay in ms until the next round, -1 if neither candidates nor refreshes are
+   * waiting. */
+  qint64 nextRound(qint64 now) const;
+
+  /** Returns @c true if the station lists should be reconciled now, i.e. all candidates have been
+   * contacted. */
+  bool reconcile() const;
+  /** Returns the delay in ms until the next reconciliation. Gets called once per reconciliation,
+   * see @c CrawlQueue::interval. */
+  qint64 reconcileInterval(qint64 now);
+
+  /** Returns the refresh interval after a successful contact, given the previous interval and
+   * the contacts so far. */
+  static qint64 refreshAfterSuccess(qint64 interval, size_t successes, size_t failures);
+  /** Returns the refresh interval after the specified number of consecutive failures. */
+  static qint64 refreshAfterFailure(size_t failures);
+
+protected:
+  /** Returns the time of the earliest scheduled refresh, -1 if none. Drops outdated entries. */
+  qint64 _nextRefresh() const;
+
+protected:
+  CrawlQueue _crawler;
+  size_t _maxProbes;
+  size_t _probes;
+  /** Known stations by the time of their next refresh, may contain outdated entries. */
+  mutable QMultiMap<qint64, Identifier> _refreshQueue;
+  /** Time of the scheduled refresh of each known station. */
+  QHash<Identifier, qint64> _due;
+};
+
+#endif // NETWORKPOLICY_HH
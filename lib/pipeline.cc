@@ -0,0 +1,254 @@
+#include "pipeline.hh"
+#include <ovlnet/logger.hh>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QVector>
+#ifdef Q_OS_LINUX
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+/** Max. time in ms the producer waits for a stage with the BLOCK policy. The producer is usually
+ * the capture on the GUI thread, which must not hang if a stage is stuck. */
+#define PIPELINE_MAX_STALL 100
+
+
+/** Atomically raises the value to at least @c value. */
+template <class T>
+static inline void
+atomic_max(std::atomic<T> &atomic, T value) {
+  T current = atomic.load(std::memory_order_relaxed);
+  while ((current < value) && (! atomic.compare_exchange_weak(current, value))) {
+    // pass...
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of PipelineStage
+ * ********************************************************************************************* */
+PipelineStage::PipelineStage(const QString &name, size_t blockSize, size_t capacity,
+                             Overflow overflow, QObject *parent)
+  : QThread(parent), _name(name), _blockSize(std::max(size_t(1), blockSize)),
+    _overflow(overflow), _core(-1), _queue(std::max(capacity, 2*_blockSize)), _wakeup(0),
+    _space(0), _waiting(false), _flushed(0), _flushing(false), _stop(false), _blocks(0),
+    _samples(0), _dropped(0), _stalls(0), _stallTime(0), _busy(0), _maxBusy(0), _maxQueued(0),
+    _since(QDateTime::currentMSecsSinceEpoch())
+{
+  // pass...
+}
+
+PipelineStage::~PipelineStage() {
+  stop();
+  wait();
+}
+
+const QString &
+PipelineStage::name() const {
+  return _name;
+}
+
+int
+PipelineStage::core() const {
+  return _core;
+}
+
+void
+PipelineStage::setCore(int core) {
+  _core = core;
+}
+
+PipelineStage::Statistics
+PipelineStage::statistics() const {
+  Statistics stats;
+  stats.blocks = _blocks; stats.samples = _samples; stats.dropped = _dropped;
+  stats.stalls = _stalls; stats.stallTime = _stallTime;
+  stats.busy = _busy; stats.maxBusy = _maxBusy; stats.maxQueued = _maxQueued;
+  return stats;
+}
+
+QJsonObject
+PipelineStage::statisticsToJson() const {
+  Statistics stats = statistics();
+  qint64 wall = std::max(qint64(1), QDateTime::currentMSecsSinceEpoch()-_since);
+  QJsonObject obj;
+  obj.insert("name", _name);
+  obj.insert("core", _core);
+  obj.insert("blocks", double(stats.blocks));
+  obj.insert("samples", double(stats.samples));
+  obj.insert("dropped", double(stats.dropped));
+  obj.insert("stalls", double(stats.stalls));
+  obj.insert("stallTime", 1e-6*stats.stallTime);
+  obj.insert("meanBlockTime", stats.blocks ? 1e-3*stats.busy/stats.blocks : 0.);
+  obj.insert("maxBlockTime", 1e-3*stats.maxBusy);
+  obj.insert("load", 1e-6*stats.busy/wall);
+  obj.insert("maxQueued", double(stats.maxQueued));
+  return obj;
+}
+
+void
+PipelineStage::resetStatistics() {
+  _blocks = 0; _samples = 0; _dropped = 0; _stalls = 0; _stallTime = 0; _busy = 0; _maxBusy = 0;
+  _maxQueued = 0;
+  _since = QDateTime::currentMSecsSinceEpoch();
+}
+
+void
+PipelineStage::start(Priority priority) {
+  if (isRunning()) { return; }
+  _stop = false;
+  QThread::start(priority);
+}
+
+size_t
+PipelineStage::push(const int16_t *samples, size_t n) {
+  size_t pushed = _queue.push(samples, n);
+  // Wait a bounded time for the worker if nothing should be lost
+  if ((BLOCK == _overflow) && (pushed < n) && isRunning()) {
+    QElapsedTimer timer; timer.start();
+    _waiting = true;
+    _wakeup.release();
+    while (pushed < n) {
+      // The worker may have taken samples before the producer waits
+      pushed += _queue.push(samples+pushed, n-pushed);
+      qint64 remaining = PIPELINE_MAX_STALL - timer.elapsed();
+      if ((pushed == n) || (remaining <= 0) || (! _space.tryAcquire(1, remaining))) { break; }
+    }
+    _waiting = false;
+    _space.tryAcquire(_space.available());
+    _stalls++; _stallTime += timer.nsecsElapsed();
+  }
+  if (pushed < n) {
+    _dropped += n-pushed;
+  }
+  atomic_max(_maxQueued, _queue.size());
+  // Wake the worker once a block is complete
+  if ((_queue.size() >= _blockSize) && (0 == _wakeup.available())) {
+    _wakeup.release();
+  }
+  return pushed;
+}
+
+void
+PipelineStage::flush() {
+  if (! isRunning()) { return; }
+  _flushing = true;
+  _wakeup.release();
+  _flushed.acquire();
+}
+
+void
+PipelineStage::stop() {
+  _stop = true;
+  _wakeup.release();
+}
+
+void
+PipelineStage::run() {
+#ifdef Q_OS_LINUX
+  if (_core >= 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus); CPU_SET(_core, &cpus);
+    if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpus)) {
+      logWarning() << "Cannot pin pipeline stage " << _name << " to core " << _core << ".";
+    }
+  }
+#endif
+
+  QVector<int16_t> block(_blockSize);
+  QElapsedTimer timer;
+  while (! _stop) {
+    size_t available = _queue.size();
+    bool flushing = _flushing;
+    if (available < _blockSize) {
+      if (flushing && (0 == available)) {
+        // Queue drained
+        _flushing = false;
+        _flushed.release();
+        continue;
+      } else if (! flushing) {
+        _wakeup.tryAcquire(1, 100);
+        continue;
+      }
+    }
+    // Process a complete block, or the remaining samples if flushing
+    size_t n = _queue.pop(block.data(), _blockSize);
+    if (_waiting) { _space.release(); }
+    timer.start();
+    process(block.constData(), n);
+    quint64 busy = timer.nsecsElapsed();
+    _blocks++; _samples += n; _busy += busy;
+    atomic_max(_maxBusy, busy);
+  }
+
+  // Release a waiting producer
+  if (_flushing) {
+    _flushing = false;
+    _flushed.release();
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of Pipeline
+ * ********************************************************************************************* */
+Pipeline::Pipeline(int reportInterval, QObject *parent)
+  : QObject(parent), _stages(), _nextCore(1), _reportTimer()
+{
+  if (reportInterval > 0) {
+    _reportTimer.setInterval(reportInterval);
+    _reportTimer.setSingleShot(false);
+    connect(&_reportTimer, SIGNAL(timeout()), this, SLOT(report()));
+    _reportTimer.start();
+  }
+}
+
+void
+Pipeline::add(PipelineStage *stage) {
+  // Drop destroyed stages
+  _stages.removeAll(QPointer<PipelineStage>());
+  _stages.append(stage);
+  int cores = QThread::idealThreadCount();
+  if (cores > 1) {
+    stage->setCore(_nextCore);
+    _nextCore = (_nextCore % (cores-1)) + 1;
+  }
+  logDebug() << "Added pipeline stage " << stage->name() << " on core " << stage->core() << ".";
+}
+
+size_t
+Pipeline::numStages() const {
+  size_t n = 0;
+  foreach (QPointer<PipelineStage> stage, _stages) {
+    if (stage) { n++; }
+  }
+  return n;
+}
+
+QJsonArray
+Pipeline::statistics() const {
+  QJsonArray stats;
+  foreach (QPointer<PipelineStage> stage, _stages) {
+    if (stage) { stats.append(stage->statisticsToJson()); }
+  }
+  return stats;
+}
+
+void
+Pipeline::report() {
+  foreach (QPointer<PipelineStage> stage, _stages) {
+    if (! stage) { continue; }
+    QJsonObject stats = stage->statisticsToJson();
+    logInfo() << "Pipeline stage " << stage->name() << ": "
+              << stats.value("blocks").toDouble() << " blocks, "
+              << stats.value("meanBlockTime").toDouble() << "us mean, "
+              << stats.value("maxBlockTime").toDouble() << "us max, "
+              << 100*stats.value("load").toDouble() << "% load, "
+              << stats.value("dropped").toDouble() << " samples dropped, "
+              << stats.value("stalls").toDouble() << " stalls ("
+              << stats.value("stallTime").toDouble() << "ms), "
+              << stats.value("maxQueued").toDouble() << " max. queued.";
+    stage->resetStatistics();
+  }
+}
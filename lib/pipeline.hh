@@ -0,0 +1,144 @@
+#ifndef PIPELINE_HH
+#define PIPELINE_HH
+
+#include <QThread>
+#include <QSemaphore>
+#include <QPointer>
+#include <QTimer>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <atomic>
+#include "spscqueue.hh"
+
+
+/** A processing stage of the sample stream running on its own worker thread.
+ * The capture thread pushes the samples into a bounded lock-free queue, the worker takes them
+ * in blocks of a fixed size and passes them to @c process. Results are passed on with queued
+ * signals, or by pushing them into the next stage. If the worker falls behind, the queue fills
+ * up and the overflow policy applies: samples get dropped (and counted) or the capture thread
+ * waits a bounded time for the worker. */
+class PipelineStage: public QThread
+{
+  Q_OBJECT
+
+public:
+  /** Possible behaviours if the queue is full. */
+  typedef enum {
+    DROP,    ///< Drop the samples, keeps the capture thread in real time.
+    BLOCK    ///< Wait a bounded time until the stage took the samples, drop the remaining ones.
+  } Overflow;
+
+  /** Timing statistics of a stage. */
+  typedef struct {
+    /** Number of blocks and samples processed. */
+    quint64 blocks, samples;
+    /** Number of samples dropped. */
+    quint64 dropped;
+    /** Number of times and total time in ns the producer waited for the worker. */
+    quint64 stalls, stallTime;
+    /** Total and max. time spent processing a block in ns. */
+    quint64 busy, maxBusy;
+    /** Max. number of samples in the queue. */
+    size_t maxQueued;
+  } Statistics;
+
+protected:
+  /** Hidden constructor.
+   * @param name Specifies the name of the stage (for reports).
+   * @param blockSize Specifies the number of samples passed to @c process.
+   * @param capacity Specifies the number of samples the queue holds.
+   * @param overflow Specifies the overflow policy. */
+  PipelineStage(const QString &name, size_t blockSize, size_t capacity=1<<16,
+                Overflow overflow=DROP, QObject *parent=0);
+
+public:
+  /** Destructor, stops the worker. */
+  virtual ~PipelineStage();
+
+  const QString &name() const;
+  /** Returns the core the worker is pinned to, -1 if not pinned. */
+  int core() const;
+  /** Pins the worker to the given core, -1 releases it. Takes effect on the next start. */
+  void setCore(int core);
+
+  /** Returns the statistics since the last reset. */
+  Statistics statistics() const;
+  /** Returns the statistics as JSON, including the load (busy time per wall time) since the last
+   * reset. */
+  QJsonObject statisticsToJson() const;
+  /** Resets the statistics. */
+  void resetStatistics();
+
+  /** Starts the worker, dropping a stop requested while it was not running. */
+  void start(Priority priority=InheritPriority);
+  /** Appends samples to the queue, called by the producer. Returns the number of samples
+   * queued. */
+  size_t push(const int16_t *samples, size_t n);
+  /** Waits until the worker processed all queued samples, including a final partial block.
+   * Called by the producer. */
+  void flush();
+  /** Stops the worker after the current block. */
+  void stop();
+
+protected:
+  /** Processes a block of samples on the worker thread. The last block before a flush may be
+   * shorter. Needs to be implemented by all stages. */
+  virtual void process(const int16_t *samples, size_t n) = 0;
+  /** The worker loop. */
+  void run();
+
+protected:
+  QString _name;
+  size_t _blockSize;
+  Overflow _overflow;
+  int _core;
+  SPSCQueue<int16_t> _queue;
+  /** Signals the worker that samples are available. */
+  QSemaphore _wakeup;
+  /** Signals a waiting producer that the worker took samples. */
+  QSemaphore _space;
+  std::atomic<bool> _waiting;
+  /** Signals the producer that the queue is drained. */
+  QSemaphore _flushed;
+  std::atomic<bool> _flushing;
+  std::atomic<bool> _stop;
+  /** Statistics, written by the worker except for the dropped samples and stalls. */
+  std::atomic<quint64> _blocks, _samples, _dropped, _stalls, _stallTime, _busy, _maxBusy;
+  std::atomic<size_t> _maxQueued;
+  /** Time of the last reset in ms since epoch. */
+  std::atomic<qint64> _since;
+};
+
+
+/** Registry of all pipeline stages of a station.
+ * Distributes the workers over the cores, leaving the first core to the capture and the GUI,
+ * and reports the statistics of all stages periodically. */
+class Pipeline: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor, reports the statistics every @c reportInterval ms, 0 disables the reports. */
+  explicit Pipeline(int reportInterval=10*60*1000, QObject *parent=0);
+
+  /** Registers the stage and pins it to the next core, if there are more than one. Must be
+   * called before the stage is started. The stage remains owned by the caller. */
+  void add(PipelineStage *stage);
+  /** Returns the number of registered stages. */
+  size_t numStages() const;
+
+  /** Returns the statistics of all stages. */
+  QJsonArray statistics() const;
+
+public slots:
+  /** Logs and resets the statistics of all stages. */
+  void report();
+
+protected:
+  QList< QPointer<PipelineStage> > _stages;
+  /** The next core to assign. */
+  int _nextCore;
+  QTimer _reportTimer;
+};
+
+#endif // PIPELINE_HH
@@ -1,16 +1,19 @@
 #include "query.hh"
 #include "station.hh"
 #include "stationlist.hh"
+#include "resolvecache.hh"
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QTemporaryFile>
+#include <QTimer>
+#include <QUrlQuery>
 
 
 /* ********************************************************************************************* *
  * Implementation of StationResolveQuery
  * ********************************************************************************************* */
 StationResolveQuery::StationResolveQuery(Node &node, const Identifier &id)
-  : QObject(), SearchQuery(id)
+  : QObject(), SearchQuery(id), _stationId(id)
 {
   node.findNode(this);
 }
@@ -23,7 +26,7 @@ StationResolveQuery::succeeded() {
 
 void
 StationResolveQuery::failed() {
-  emit notFound();
+  emit notFound(_stationId);
   this->deleteLater();
 }
 
@@ -31,34 +34,112 @@ StationResolveQuery::failed() {
 /* ********************************************************************************************* *
  * Implementation of JsonQuery
  * ********************************************************************************************* */
-JsonQuery::JsonQuery(const QString &path, Node &node, const Identifier &remote)
-  : QObject(0), _query(path), _node(node), _remoteId(remote)
+JsonQuery::JsonQuery(const QString &path, Station &station, const Identifier &remote)
+  : QObject(0), _query(path), _station(station), _remoteId(remote), _remoteNode(),
+    _connection(0), _response(0), _responseLength(0),
+    _maxResponseLength(1<<24), _inflater(0), _buffer(), _streaming(false), _parser(*this),
+    _binaryType(0), _format(FORMAT_UNKNOWN), _binaryHeader(false), _recordsLeft(0), _timeout(),
+    _done(false)
 {
-  StationResolveQuery *query = new StationResolveQuery(_node, remote);
-  connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onNodeFound(NodeItem)));
-  connect(query, SIGNAL(notFound()), this, SLOT(_onError()));
+  // Default deadline of 60s
+  _timeout.setInterval(60000);
+  _timeout.setSingleShot(true);
+  connect(&_timeout, SIGNAL(timeout()), this, SLOT(_onError()));
 }
 
-JsonQuery::JsonQuery(const QString &path, Node &node, const NodeItem &remote)
-  : QObject(0), _query(path), _node(node), _remoteId(remote.id())
+JsonQuery::JsonQuery(const QString &path, Station &station, const NodeItem &remote)
+  : QObject(0), _query(path), _station(station), _remoteId(remote.id()), _remoteNode(remote),
+    _connection(0), _response(0), _responseLength(0),
+    _maxResponseLength(1<<24), _inflater(0), _buffer(), _streaming(false), _parser(*this),
+    _binaryType(0), _format(FORMAT_UNKNOWN), _binaryHeader(false), _recordsLeft(0), _timeout(),
+    _done(false)
 {
-  _onNodeFound(remote);
+  // Default deadline of 60s
+  _timeout.setInterval(60000);
+  _timeout.setSingleShot(true);
+  connect(&_timeout, SIGNAL(timeout()), this, SLOT(_onError()));
+}
+
+JsonQuery::~JsonQuery() {
+  if (_inflater) { delete _inflater; }
+}
+
+const QString &
+JsonQuery::path() const {
+  return _query;
+}
+
+const Identifier &
+JsonQuery::remote() const {
+  return _remoteId;
+}
+
+void
+JsonQuery::setTimeout(size_t ms) {
+  _timeout.setInterval(ms);
+}
+
+void
+JsonQuery::setMaxResponseLength(size_t bytes) {
+  _maxResponseLength = bytes;
+}
+
+void
+JsonQuery::setStreaming(bool enable) {
+  _streaming = enable;
+}
+
+void
+JsonQuery::setBinary(BinaryCodec::Type type) {
+  _binaryType = type;
+}
+
+void
+JsonQuery::start() {
+  _timeout.start();
+  if (! _remoteNode.id().isEmpty()) {
+    _onNodeFound(_remoteNode);
+    return;
+  }
+
+  NodeItem node;
+  if (_station.resolver().lookup(_remoteId, node)) {
+    _onNodeFound(node);
+  } else if (_station.resolver().isUnreachable(_remoteId)) {
+    // Fail later, the caller may not be connected to failed() yet
+    QTimer::singleShot(0, this, SLOT(_onError()));
+  } else {
+    StationResolveQuery *query = _station.resolver().resolve(_remoteId);
+    connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onNodeFound(NodeItem)));
+    connect(query, SIGNAL(notFound(Identifier)), this, SLOT(_onError()));
+  }
+}
+
+void
+JsonQuery::cancel() {
+  if (_done) { return; }
+  _done = true;
+  _timeout.stop();
+  if (_response) { disconnect(_response, 0, this, 0); }
+  if (_connection) { disconnect(_connection, 0, this, 0); }
+  deleteLater();
 }
 
 void
 JsonQuery::_onNodeFound(const NodeItem &node) {
+  if (_done) { return; }
   /*logDebug() << "Try to connect station '" << node.id().toBase32()
              << "' for '" << _query << "'."; */
-  _connection = new HttpClientConnection(_node, node, "vlf::station", this);
+  _connection = new HttpClientConnection(_station, node, "vlf::station", this);
   connect(_connection, SIGNAL(established()), this, SLOT(_onConnectionEstablished()));
-  connect(_connection, SIGNAL(error()), this, SLOT(_onError()));
+  connect(_connection, SIGNAL(error()), this, SLOT(_onConnectionFailed()));
 }
 
 void
 JsonQuery::_onConnectionEstablished() {
   /*logDebug() << "Try to query '" << _query
              << "' from station '" << _connection->peerId() << "'."; */
-  _response = _connection->get(_query);
+  _response = _connection->get(_requestPath());
   if (_response) {
     connect(_response, SIGNAL(finished()), this, SLOT(_onResponseReceived()));
     connect(_response, SIGNAL(error()), this, SLOT(_onError()));
@@ -67,8 +148,16 @@ JsonQuery::_onConnectionEstablished() {
   }
 }
 
+void
+JsonQuery::_onConnectionFailed() {
+  // Remember unreachable station
+  _station.resolver().markUnreachable(_remoteId);
+  _onError();
+}
+
 void
 JsonQuery::_onResponseReceived() {
+  if (_done) { return; }
   if (HTTP_OK != _response->responseCode()) {
     logError() << "Cannot query '" << _query << "': Station returned " << _response->responseCode();
     _onError(); return;
@@ -79,11 +168,29 @@ JsonQuery::_onResponseReceived() {
   }
 
   _responseLength = _response->responseHeader("Content-Length").toUInt();
+  if (_responseLength > _maxResponseLength) {
+    logError() << "Station response to '" << _query << "' too large: " << _responseLength << "b.";
+    _onError(); return;
+  }
+  if (_response->hasResponseHeader("Content-Encoding")) {
+    if ("deflate" != _response->responseHeader("Content-Encoding")) {
+      logError() << "Station response to '" << _query << "' has unsupported encoding.";
+      _onError(); return;
+    }
+    // The limit applies to the decompressed response
+    _inflater = new Inflater(_maxResponseLength);
+  }
+
   connect(_response, SIGNAL(readyRead()), this, SLOT(_onReadyRead()));
+  // Process data that arrived along with the headers
+  _onReadyRead();
 }
 
 void
 JsonQuery::_onError() {
+  if (_done) { return; }
+  _done = true;
+  _timeout.stop();
   logError() << "Failed to access " << _query << " at " << _remoteId.toBase32() << ".";
   emit failed();
   deleteLater();
@@ -91,25 +198,161 @@ JsonQuery::_onError() {
 
 void
 JsonQuery::_onReadyRead() {
-  if (_responseLength) {
-    QByteArray tmp = _response->read(_responseLength);
-    _buffer.append(tmp); _responseLength -= tmp.size();
+  if (_done) { return; }
+  // Drain everything available
+  while (_responseLength) {
+    QByteArray tmp = _response->read(std::min(_responseLength, size_t(1<<16)));
+    if (tmp.isEmpty()) { break; }
+    _responseLength -= tmp.size();
+    if (_inflater) {
+      QByteArray out;
+      if (! _inflater->inflate(tmp, out)) {
+        if (_inflater->totalOut() > _maxResponseLength) {
+          logError() << "Station response to '" << _query << "' exceeds "
+                     << _maxResponseLength << "b.";
+        } else {
+          logInfo() << "Station returned invalid compressed response.";
+        }
+        _onError(); return;
+      }
+      tmp = out;
+    }
+    if (! _feed(tmp)) {
+      _onError(); return;
+    }
   }
 
   if (0 == _responseLength) {
     // Response complete
-    QJsonParseError error;
-    QJsonDocument doc = QJsonDocument::fromJson(_buffer, &error);
-    if (QJsonParseError::NoError != error.error) {
-      logInfo() << "Station returned invalid JSON document as result.";
+    if (_inflater && (! _inflater->isComplete())) {
+      logInfo() << "Station returned incomplete compressed response.";
       _onError(); return;
     }
-    this->finished(doc);
+    _complete();
+  }
+}
+
+void
+JsonQuery::_complete() {
+  if (FORMAT_UNKNOWN == _format) {
+    // Too short to be binary
+    _format = FORMAT_JSON;
+    QByteArray tmp = _buffer; _buffer.clear();
+    if (! _feed(tmp)) {
+      _onError(); return;
+    }
+  }
+  if (FORMAT_BINARY == _format) {
+    if ((! _binaryHeader) || _recordsLeft || (! _buffer.isEmpty())) {
+      logInfo() << "Station returned incomplete binary response as result.";
+      _onError(); return;
+    }
+    this->finished(QJsonDocument());
+    return;
+  }
+  if (_streaming) {
+    if (! _parser.isComplete()) {
+      logInfo() << "Station returned incomplete JSON document as result.";
+      _onError(); return;
+    }
+    this->finished(QJsonDocument());
+    return;
+  }
+  QJsonParseError error;
+  QJsonDocument doc = QJsonDocument::fromJson(_buffer, &error);
+  _buffer.clear();
+  if (QJsonParseError::NoError != error.error) {
+    logInfo() << "Station returned invalid JSON document as result.";
+    _onError(); return;
+  }
+  this->finished(doc);
+}
+
+QString
+JsonQuery::_requestPath() const {
+  QUrlQuery query;
+  if (_binaryType) {
+    query.addQueryItem("format", "binary");
+  }
+  query.addQueryItem("encoding", "deflate");
+  return _query + (_query.contains('?') ? "&" : "?") + query.toString();
+}
+
+bool
+JsonQuery::_feed(const QByteArray &data) {
+  if (FORMAT_UNKNOWN == _format) {
+    if (! _binaryType) {
+      _format = FORMAT_JSON;
+    } else {
+      // Sniff format from the magic bytes
+      _buffer.append(data);
+      if (_buffer.size() < 4) { return true; }
+      _format = BinaryCodec::isBinary(_buffer) ? FORMAT_BINARY : FORMAT_JSON;
+      QByteArray tmp = _buffer; _buffer.clear();
+      return _feed(tmp);
+    }
+  }
+
+  if (FORMAT_BINARY == _format) {
+    return _feedBinary(data);
+  }
+  if (! _streaming) {
+    _buffer.append(data);
+  } else if (! _parser.feed(data)) {
+    logInfo() << "Station returned invalid JSON document as result: "
+              << _parser.errorString();
+    return false;
   }
+  return true;
+}
+
+bool
+JsonQuery::_feedBinary(const QByteArray &data) {
+  _buffer.append(data);
+  const char *ptr = _buffer.constData();
+  size_t len = _buffer.size(), pos = 0;
+
+  if (! _binaryHeader) {
+    if (len < VLF_BINARY_HEADER_SIZE) { return true; }
+    BinaryCodec::Type type;
+    if ((! BinaryCodec::parseHeader(ptr, len, type, _recordsLeft)) || (_binaryType != type)) {
+      logInfo() << "Station returned invalid binary response as result.";
+      return false;
+    }
+    _binaryHeader = true;
+    pos = VLF_BINARY_HEADER_SIZE;
+  }
+
+  // Decode all complete records in place
+  uint16_t recordLength;
+  while (BinaryReader(ptr+pos, len-pos).readUInt16(recordLength)
+         && ((len-pos-2) >= recordLength)) {
+    if (0 == _recordsLeft) {
+      logInfo() << "Station returned trailing data after binary response.";
+      return false;
+    }
+    BinaryReader record(ptr+pos+2, recordLength);
+    if (! binaryRecord(record)) {
+      return false;
+    }
+    _recordsLeft--;
+    pos += 2+recordLength;
+  }
+  _buffer.remove(0, pos);
+  return true;
+}
+
+bool
+JsonQuery::binaryRecord(BinaryReader &record) {
+  logError() << "Unexpected binary response for " << _query << ".";
+  return false;
 }
 
 void
 JsonQuery::finished(const QJsonDocument &doc) {
+  _done = true;
+  _timeout.stop();
+  emit received(_remoteId, doc);
   this->deleteLater();
 }
 
@@ -117,32 +360,42 @@ JsonQuery::finished(const QJsonDocument &doc) {
 /* ********************************************************************************************* *
  * Implementation of StationInfoQuery
  * ********************************************************************************************* */
-StationInfoQuery::StationInfoQuery(Node &node, const Identifier &remote)
-  : JsonQuery("/status", node, remote)
+StationInfoQuery::StationInfoQuery(Station &station, const Identifier &remote)
+  : JsonQuery("/status", station, remote), _item()
 {
-  // pass...
+  setMaxResponseLength(1<<16);
+  setBinary(BinaryCodec::STATUS);
 }
 
-StationInfoQuery::StationInfoQuery(Node &node, const NodeItem &remote)
-  : JsonQuery("/status", node, remote)
+StationInfoQuery::StationInfoQuery(Station &station, const NodeItem &remote)
+  : JsonQuery("/status", station, remote), _item()
 {
-  // pass...
+  setMaxResponseLength(1<<16);
+  setBinary(BinaryCodec::STATUS);
+}
+
+bool
+StationInfoQuery::binaryRecord(BinaryReader &record) {
+  _item = StationItem(NodeItem(_connection->peerId(), _connection->peer()), record);
+  return true;
 }
 
 void
 StationInfoQuery::finished(const QJsonDocument &doc) {
-  if (! doc.isObject()) {
-    logError() << "Station returned invalid JSON description: Not an object.";
-    _onError(); return;
+  if (FORMAT_JSON == _format) {
+    if (! doc.isObject()) {
+      logError() << "Station returned invalid JSON description: Not an object.";
+      _onError(); return;
+    }
+    _item = StationItem(NodeItem(_connection->peerId(), _connection->peer()), doc.object());
   }
 
-  StationItem item(NodeItem(_connection->peerId(), _connection->peer()), doc.object());
-  if (item.isNull()) {
+  if (_item.isNull()) {
     logError() << "Station returned invalid status.";
     _onError(); return;
   }
 
-  emit stationInfoReceived(item);
+  emit stationInfoReceived(_item);
   JsonQuery::finished(doc);
 }
 
@@ -150,66 +403,133 @@ StationInfoQuery::finished(const QJsonDocument &doc) {
 /* ********************************************************************************************* *
  * Implementation of StationListQuery
  * ********************************************************************************************* */
-StationListQuery::StationListQuery(Node &node, const Identifier &remote)
-  : JsonQuery("/list", node, remote)
+StationListQuery::StationListQuery(Station &station, const Identifier &remote,
+                                   const QList<int> &buckets)
+  : JsonQuery(_path(buckets), station, remote), _ids()
 {
-  // pass...
+  setStreaming(true);
+  setBinary(BinaryCodec::LIST);
 }
 
-StationListQuery::StationListQuery(Node &node, const NodeItem &remote)
-  : JsonQuery("/list", node, remote)
+StationListQuery::StationListQuery(Station &station, const NodeItem &remote,
+                                   const QList<int> &buckets)
+  : JsonQuery(_path(buckets), station, remote), _ids()
 {
-  // pass...
+  setStreaming(true);
+  setBinary(BinaryCodec::LIST);
 }
 
-void
-StationListQuery::finished(const QJsonDocument &doc) {
-  if (! doc.isArray()) {
-    logError() << "Station returned invalid JSON description: Not an array.";
-    _onError(); return;
+QString
+StationListQuery::_path(const QList<int> &buckets) {
+  if (buckets.isEmpty()) { return "/list"; }
+  QStringList items;
+  foreach (int bucket, buckets) {
+    items.append(QString::number(bucket));
   }
+  return "/list?buckets=" + items.join(",");
+}
 
-  QList<Identifier> ids;
-  QJsonArray array = doc.array();
-  for (int i=0; i<array.size(); i++) {
-    ids.push_back(Identifier::fromBase32(array.at(i).toString()));
+bool
+StationListQuery::arrayItem(const QJsonValue &value) {
+  if (! value.isString()) {
+    logError() << "Station returned invalid station list: Item is not a string.";
+    return false;
   }
+  _ids.push_back(Identifier::fromBase32(value.toString()));
+  return true;
+}
 
-  emit stationListReceived(ids);
+bool
+StationListQuery::binaryRecord(BinaryReader &record) {
+  Identifier id;
+  if (! record.readIdentifier(id)) {
+    logError() << "Station returned invalid station list: Record too short.";
+    return false;
+  }
+  _ids.push_back(id);
+  return true;
+}
+
+void
+StationListQuery::finished(const QJsonDocument &doc) {
+  emit stationListReceived(_ids);
   JsonQuery::finished(doc);
 }
 
 
 /* ********************************************************************************************* *
- * Implementation of StationScheduleQuery
+ * Implementation of StationDigestQuery
  * ********************************************************************************************* */
-StationScheduleQuery::StationScheduleQuery(Node &node, const Identifier &remote)
-  : JsonQuery("/schedule", node, remote)
+StationDigestQuery::StationDigestQuery(Station &station, const Identifier &remote)
+  : JsonQuery("/list/digest", station, remote), _digest(), _numBuckets(0)
 {
-  // pass...
+  setBinary(BinaryCodec::DIGEST);
 }
 
-StationScheduleQuery::StationScheduleQuery(Node &node, const NodeItem &remote)
-  : JsonQuery("/schedule", node, remote)
+StationDigestQuery::StationDigestQuery(Station &station, const NodeItem &remote)
+  : JsonQuery("/list/digest", station, remote), _digest(), _numBuckets(0)
 {
-  // pass...
+  setBinary(BinaryCodec::DIGEST);
+}
+
+bool
+StationDigestQuery::binaryRecord(BinaryReader &record) {
+  if (! _digest.readBucket(record)) {
+    logError() << "Station returned invalid station list digest.";
+    return false;
+  }
+  _numBuckets++;
+  return true;
 }
 
 void
-StationScheduleQuery::finished(const QJsonDocument &doc) {
-  if (! doc.isArray()) {
-    logError() << "Station returned invalid JSON description: Not an array.";
+StationDigestQuery::finished(const QJsonDocument &doc) {
+  if ((FORMAT_BINARY != _format) || (StationDigest::NumBuckets != _numBuckets)) {
+    logError() << "Station returned incomplete station list digest.";
     _onError(); return;
   }
+  emit digestReceived(_remoteId, _digest);
+  JsonQuery::finished(doc);
+}
 
-  QList<ScheduledEvent> events;
-  QJsonArray array = doc.array();
-  for (int i=0; i<array.size(); i++) {
-    if (array.at(i).isObject()) {
-      events.push_back(ScheduledEvent(array.at(i).toObject()));
-    }
+
+/* ********************************************************************************************* *
+ * Implementation of StationScheduleQuery
+ * ********************************************************************************************* */
+StationScheduleQuery::StationScheduleQuery(Station &station, const Identifier &remote)
+  : JsonQuery("/schedule", station, remote), _events()
+{
+  setStreaming(true);
+  setBinary(BinaryCodec::SCHEDULE);
+}
+
+StationScheduleQuery::StationScheduleQuery(Station &station, const NodeItem &remote)
+  : JsonQuery("/schedule", station, remote), _events()
+{
+  setStreaming(true);
+  setBinary(BinaryCodec::SCHEDULE);
+}
+
+bool
+StationScheduleQuery::arrayItem(const QJsonValue &value) {
+  if (value.isObject()) {
+    _events.push_back(ScheduledEvent(value.toObject()));
   }
-  emit stationScheduleReceived(_connection->peerId(), events);
+  return true;
+}
+
+bool
+StationScheduleQuery::binaryRecord(BinaryReader &record) {
+  ScheduledEvent event(record);
+  if (event.isValid()) {
+    _events.push_back(event);
+  }
+  return true;
+}
+
+void
+StationScheduleQuery::finished(const QJsonDocument &doc) {
+  emit stationScheduleReceived(_connection->peerId(), _events);
   JsonQuery::finished(doc);
 }
 
@@ -217,26 +537,45 @@ StationScheduleQuery::finished(const QJsonDocument &doc) {
 /* ********************************************************************************************* *
  * Implementation of StationDataSetListQuery
  * ********************************************************************************************* */
-DataSetListQuery::DataSetListQuery(Node &node, const Identifier &remote)
-  : JsonQuery("/data", node, remote)
+DataSetListQuery::DataSetListQuery(Station &station, const Identifier &remote)
+  : JsonQuery("/data", station, remote)
 {
-  // pass...
+  setStreaming(true);
+  setBinary(BinaryCodec::DATASETS);
 }
 
-DataSetListQuery::DataSetListQuery(Node &node, const NodeItem &remote)
-  : JsonQuery("/data", node, remote)
+DataSetListQuery::DataSetListQuery(Station &station, const NodeItem &remote)
+  : JsonQuery("/data", station, remote)
 {
-  // pass...
+  setStreaming(true);
+  setBinary(BinaryCodec::DATASETS);
 }
 
-void
-DataSetListQuery::finished(const QJsonDocument &doc) {
-  if (! doc.isObject()) {
-    logError() << "Station returned invalid dataset list: Not an object.";
-    _onError(); return;
+bool
+DataSetListQuery::objectMember(const QString &key, const QJsonValue &value) {
+  if (! value.isObject()) {
+    logError() << "Station returned invalid dataset list: Item is not an object.";
+    return false;
   }
-  emit dataSetListReceived(_connection->peerId(), doc.object());
-  JsonQuery::finished(doc);
+  emit dataSetReceived(_connection->peerId(), Identifier::fromBase32(key),
+                       RemoteDataSet(_connection->peerId(), value.toObject()));
+  return true;
+}
+
+bool
+DataSetListQuery::binaryRecord(BinaryReader &record) {
+  Identifier id;
+  if (! record.readIdentifier(id)) {
+    logError() << "Station returned invalid dataset list: Record too short.";
+    return false;
+  }
+  RemoteDataSet dataset(_connection->peerId(), record);
+  if (! dataset.datetime().isValid()) {
+    logError() << "Station returned invalid dataset list: Invalid dataset.";
+    return false;
+  }
+  emit dataSetReceived(_connection->peerId(), id, dataset);
+  return true;
 }
 
 
@@ -245,99 +584,65 @@ DataSetListQuery::finished(const QJsonDocument &doc) {
  * ********************************************************************************************* */
 DownloadDataSetQuery::DownloadDataSetQuery(const Identifier &dataSetId, const Identifier &remote,
                                            Station &station)
-  : QObject(0), _station(station), _dataSetID(dataSetId)
+  : JsonQuery("/data/"+dataSetId.toBase32(), station, remote), _dataSetID(dataSetId), _file()
 {
-  StationResolveQuery *query = new StationResolveQuery(_station, remote);
-  connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onNodeFound(NodeItem)));
-  connect(query, SIGNAL(notFound()), this, SLOT(_onError()));
+  // Datasets are large, allow 30min and 2GB
+  setTimeout(30*60*1000);
+  setMaxResponseLength(size_t(1)<<31);
+  OVLHashInit(&_mdctx);
 }
 
 DownloadDataSetQuery::DownloadDataSetQuery(const Identifier &dataSetId, const NodeItem &remote,
                                            Station &station)
-  : QObject(0), _station(station), _dataSetID(dataSetId)
+  : JsonQuery("/data/"+dataSetId.toBase32(), station, remote), _dataSetID(dataSetId), _file()
 {
-  _onNodeFound(remote);
+  setTimeout(30*60*1000);
+  setMaxResponseLength(size_t(1)<<31);
+  OVLHashInit(&_mdctx);
 }
 
-void
-DownloadDataSetQuery::_onNodeFound(const NodeItem &node) {
-  logDebug() << "Try to connect station '" << node.id()
-             << "' for dataset '" << _dataSetID << "'.";
-  _connection = new HttpClientConnection(_station, node, "vlf::station", this);
-  connect(_connection, SIGNAL(established()), this, SLOT(_onConnectionEstablished()));
-  connect(_connection, SIGNAL(error()), this, SLOT(_onError()));
+const Identifier &
+DownloadDataSetQuery::dataset() const {
+  return _dataSetID;
 }
 
-void
-DownloadDataSetQuery::_onConnectionEstablished() {
-  logDebug() << "Try to download dataset '" << _dataSetID
-             << "' from station '" << _connection->peerId() << "'.";
-
-  _response = _connection->get("/data/"+_dataSetID.toBase32());
-  if (_response) {
-    connect(_response, SIGNAL(finished()), this, SLOT(_onResponseReceived()));
-    connect(_response, SIGNAL(error()), this, SLOT(_onError()));
-  } else {
-    _onError();
+bool
+DownloadDataSetQuery::_feed(const QByteArray &data) {
+  if ((! _file.isOpen()) && (! _file.open())) {
+    logError() << "Cannot create temporary file for dataset '" << _dataSetID << "'.";
+    return false;
   }
+  if (data.size() != _file.write(data)) {
+    logError() << "Cannot write to temporary file " << _file.fileName() << ".";
+    return false;
+  }
+  // The hash is taken over the original dataset
+  OVLHashUpdate((const uint8_t *)data.constData(), data.size(), &_mdctx);
+  return true;
 }
 
 void
-DownloadDataSetQuery::_onResponseReceived() {
-  if (HTTP_OK != _response->responseCode()) {
-    logError() << "Cannot query dataset '" << _dataSetID
-               << "': Station returned " << _response->responseCode();
-    _onError();
-    return;
-  }
-  if (! _response->hasResponseHeader("Content-Length")) {
-    logError() << "Station response has no length!";
+DownloadDataSetQuery::_complete() {
+  if (! _file.isOpen()) {
+    logError() << "Station returned empty dataset '" << _dataSetID << "'.";
     _onError(); return;
   }
-
-  _responseLength = _response->responseHeader("Content-Length").toUInt();
-  _buffer.open();
-  OVLHashInit(&_mdctx);
-  connect(_response, SIGNAL(readyRead()), this, SLOT(_onReadyRead()));
-}
-
-void
-DownloadDataSetQuery::_onError() {
-  logError() << "Failed to access dataset '" << _dataSetID << "'.";
-  emit failed();
-  deleteLater();
-}
-
-void
-DownloadDataSetQuery::_onReadyRead() {
-  if (_responseLength) {
-    QByteArray tmp = _response->read(_responseLength);
-    if (tmp.size() != _buffer.write(tmp)) {
-      logError() << "Cannot write to temporary file " << _buffer.fileName() << ".";
-    }
-    OVLHashUpdate((const uint8_t *)tmp.constData(), tmp.size(), &_mdctx);
-    _responseLength -= tmp.size();
+  _file.flush();
+  _file.close();
+  char hash[OVL_HASH_SIZE];
+  OVLHashFinal(&_mdctx, (uint8_t *)hash);
+  // Check hash
+  if (Identifier(hash) != _dataSetID) {
+    logError() << "Dataset ID '" << _dataSetID
+               << "' does not match hash of downloaded dataset '" << Identifier(hash) << "'.";
+    _onError(); return;
   }
-
-  if (0 == _responseLength) {
-    _buffer.flush();
-    _buffer.close();
-    char hash[OVL_HASH_SIZE];
-    OVLHashFinal(&_mdctx, (uint8_t *)hash);
-    // Check hash
-    if (Identifier(hash) != _dataSetID) {
-      logError() << "Dataset ID '" << _dataSetID
-                 << "' does not match hash of downloaded dataset '" << Identifier(hash) << "'.";
-      _onError(); return;
-    }
-    if (! _buffer.copy(_station.datasets().path()+"/"+_dataSetID.toBase32())) {
-      logError() << "Failed to copy downloaded dataset file to '"
-                 << _station.datasets().path()+"/"+_dataSetID.toBase32() <<"'.";
-      _onError(); return;
-    }
-    _station.datasets().addDataset(_dataSetID);
-    emit succeeded();
+  if (! _file.copy(_station.datasets().path()+"/"+_dataSetID.toBase32())) {
+    logError() << "Failed to copy downloaded dataset file to '"
+               << _station.datasets().path()+"/"+_dataSetID.toBase32() <<"'.";
+    _onError(); return;
   }
+  _station.datasets().addDataset(_dataSetID);
+  emit succeeded();
+  finished(QJsonDocument());
 }
-
-
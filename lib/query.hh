@@ -3,9 +3,13 @@
 
 #include <ovlnet/httpclient.hh>
 #include "schedule.hh"
+#include "jsonstream.hh"
+#include "binarycodec.hh"
+#include "datasetfile.hh"
+#include "compression.hh"
+#include "stationdigest.hh"
 #include <QTemporaryFile>
-
-class StationItem;
+#include <QTimer>
 
 
 /** Self-destructing search query to resolve a node identifier of a station. */
@@ -21,40 +25,124 @@ public:
 
 signals:
   void found(const NodeItem &node);
-  void notFound();
+  void notFound(const Identifier &id);
+
+protected:
+  /** The identifier of the station to resolve. */
+  Identifier _stationId;
 };
 
 
-/** Self-destructing query for the station info. */
-class JsonQuery: public QObject
+/** Self-destructing query for a JSON document from a remote station.
+ * The query does not access the network until @c start gets called. Usually, queries are not
+ * started directly but passed to the @c QueryScheduler of the station.
+ *
+ * By default, the complete response is parsed once received and passed to @c finished. In
+ * streaming mode, the response is parsed while it arrives and every element of the top-level
+ * array or object is passed to @c arrayItem or @c objectMember respectively. Then, @c finished
+ * gets called with an empty document once the response is complete.
+ *
+ * Queries may request the compact binary encoding of the response. Then, every record is passed to
+ * @c binaryRecord as soon as it arrived and @c finished gets called with an empty document. As
+ * older stations ignore the request, the format is determined from the response itself.
+ *
+ * Compressed responses are requested as well and decompressed transparently. The max. response
+ * size applies to the decompressed response. */
+class JsonQuery: public QObject, public JsonStreamHandler
 {
   Q_OBJECT
 
 public:
-  JsonQuery(const QString &path, Node &node, const Identifier &remote);
-  JsonQuery(const QString &path, Node &node, const NodeItem &remote);
+  JsonQuery(const QString &path, Station &station, const Identifier &remote);
+  JsonQuery(const QString &path, Station &station, const NodeItem &remote);
+  /** Destructor. */
+  virtual ~JsonQuery();
+
+  /** Returns the queried path. */
+  const QString &path() const;
+  /** Returns the identifier of the queried station. */
+  const Identifier &remote() const;
+
+  /** Sets the deadline of the query in ms, measured from @c start. The query fails if no
+   * complete response was received within that time. */
+  void setTimeout(size_t ms);
+  /** Sets the max. size of the response in bytes. Larger responses are rejected. */
+  void setMaxResponseLength(size_t bytes);
+
+public slots:
+  /** Resolves the station (if needed) and sends the request. */
+  virtual void start();
+  /** Aborts the query. No further signals get emitted and the query deletes itself. */
+  void cancel();
 
 signals:
+  /** Gets emitted on success with the received document, independent of the query type.
+   * The document is empty in streaming mode. */
+  void received(const Identifier &remote, const QJsonDocument &doc);
   void failed();
 
 protected:
+  /** Enables or disables the streaming mode. */
+  void setStreaming(bool enable);
+  /** Requests the response in the binary encoding of the given type. */
+  void setBinary(BinaryCodec::Type type);
+  /** Gets called for every record of a binary encoded response. Returning @c false aborts
+   * the query. */
+  virtual bool binaryRecord(BinaryReader &record);
   virtual void finished(const QJsonDocument &doc);
 
+  /** Returns the path including the query parameters for the requested format and encoding. */
+  QString _requestPath() const;
+  /** Passes a chunk of the (decompressed) response to the parser according to the response
+   * format. */
+  virtual bool _feed(const QByteArray &data);
+  /** Gets called once the response is complete, parses the buffered response and calls
+   * @c finished. */
+  virtual void _complete();
+  /** Decodes all complete records of a binary encoded response. */
+  bool _feedBinary(const QByteArray &data);
+
 protected slots:
   void _onNodeFound(const NodeItem &node);
   void _onConnectionEstablished();
+  void _onConnectionFailed();
   void _onResponseReceived();
   void _onError();
   void _onReadyRead();
 
 protected:
   QString _query;
-  Node &_node;
+  Station &_station;
   Identifier _remoteId;
+  /** The node of the remote station if known in advance. */
+  NodeItem _remoteNode;
   HttpClientConnection *_connection;
   HttpClientResponse *_response;
   size_t _responseLength;
+  /** Max. response size in bytes. */
+  size_t _maxResponseLength;
+  /** Decompresses the response if it is compressed, 0 otherwise. */
+  Inflater *_inflater;
   QByteArray _buffer;
+  /** If @c true, the response gets parsed while it arrives. */
+  bool _streaming;
+  /** The incremental parser used in streaming mode. */
+  JsonStreamParser _parser;
+  /** The requested binary encoding, 0 if JSON is requested. */
+  int _binaryType;
+  /** Format of the response, determined once the first bytes arrived. */
+  typedef enum {
+    FORMAT_UNKNOWN, FORMAT_JSON, FORMAT_BINARY
+  } Format;
+  Format _format;
+  /** If @c true, the header of a binary response was received. */
+  bool _binaryHeader;
+  /** Number of binary records still expected. */
+  uint32_t _recordsLeft;
+  /** Deadline timer. */
+  QTimer _timeout;
+  /** If @c true, the query has completed, failed or was cancelled. */
+  bool _done;
 };
 
 
@@ -64,31 +152,70 @@ class StationInfoQuery: public JsonQuery
   Q_OBJECT
 
 public:
-  StationInfoQuery(Node &node, const Identifier &remote);
-  StationInfoQuery(Node &node, const NodeItem &remote);
+  StationInfoQuery(Station &station, const Identifier &remote);
+  StationInfoQuery(Station &station, const NodeItem &remote);
 
 signals:
   void stationInfoReceived(const StationItem &station);
 
 protected:
+  bool binaryRecord(BinaryReader &record);
   void finished(const QJsonDocument &doc);
+
+protected:
+  StationItem _item;
 };
 
 
-/** Self-destructing query for the list of stations from another station. */
+/** Self-destructing query for the list of stations from another station. If @c buckets are
+ * given, only the stations of these digest buckets are requested. */
 class StationListQuery: public JsonQuery
 {
   Q_OBJECT
 
 public:
-  StationListQuery(Node &node, const Identifier &remote);
-  StationListQuery(Node &node, const NodeItem &remote);
+  StationListQuery(Station &station, const Identifier &remote,
+                   const QList<int> &buckets=QList<int>());
+  StationListQuery(Station &station, const NodeItem &remote,
+                   const QList<int> &buckets=QList<int>());
+
+protected:
+  /** Assembles the path for the specified buckets. */
+  static QString _path(const QList<int> &buckets);
 
 signals:
   void stationListReceived(const QList<Identifier> &ids);
 
 protected:
+  bool arrayItem(const QJsonValue &value);
+  bool binaryRecord(BinaryReader &record);
+  void finished(const QJsonDocument &doc);
+
+protected:
+  QList<Identifier> _ids;
+};
+
+
+/** Self-destructing query for the digest of the station list of another station. */
+class StationDigestQuery: public JsonQuery
+{
+  Q_OBJECT
+
+public:
+  StationDigestQuery(Station &station, const Identifier &remote);
+  StationDigestQuery(Station &station, const NodeItem &remote);
+
+signals:
+  void digestReceived(const Identifier &remote, const StationDigest &digest);
+
+protected:
+  bool binaryRecord(BinaryReader &record);
   void finished(const QJsonDocument &doc);
+
+protected:
+  StationDigest _digest;
+  /** Number of buckets received. */
+  int _numBuckets;
 };
 
 
@@ -98,34 +225,46 @@ class StationScheduleQuery: public JsonQuery
   Q_OBJECT
 
 public:
-  StationScheduleQuery(Node &node, const Identifier &remote);
-  StationScheduleQuery(Node &node, const NodeItem &remote);
+  StationScheduleQuery(Station &station, const Identifier &remote);
+  StationScheduleQuery(Station &station, const NodeItem &remote);
 
 signals:
   void stationScheduleReceived(const Identifier &remote, const QList<ScheduledEvent> &events);
 
 protected:
+  bool arrayItem(const QJsonValue &value);
+  bool binaryRecord(BinaryReader &record);
   void finished(const QJsonDocument &doc);
+
+protected:
+  QList<ScheduledEvent> _events;
 };
 
-/** Self-destructing query for the dataset list. */
+/** Self-destructing query for the dataset list. Every dataset gets reported as soon as it
+ * arrived. */
 class DataSetListQuery: public JsonQuery
 {
   Q_OBJECT
 
 public:
-  DataSetListQuery(Node &node, const Identifier &remote);
-  DataSetListQuery(Node &node, const NodeItem &remote);
+  DataSetListQuery(Station &station, const Identifier &remote);
+  DataSetListQuery(Station &station, const NodeItem &remote);
 
 signals:
-  void dataSetListReceived(const Identifier &remote, const QJsonObject &lst);
+  void dataSetReceived(const Identifier &remote, const Identifier &id, const RemoteDataSet &dataset);
 
 protected:
-  void finished(const QJsonDocument &doc);
+  bool objectMember(const QString &key, const QJsonValue &value);
+  bool binaryRecord(BinaryReader &record);
 };
 
 
-class DownloadDataSetQuery: public QObject
+/** Self-destructing download of a dataset from a remote station.
+ * Like all queries, the download does not access the network until @c start gets called and is
+ * usually passed to the @c QueryScheduler of the station. The dataset is written to a temporary
+ * file while it arrives. Once complete, its hash is verified and the dataset gets added to the
+ * datasets of the station. */
+class DownloadDataSetQuery: public JsonQuery
 {
   Q_OBJECT
 
@@ -133,24 +272,19 @@ public:
   DownloadDataSetQuery(const Identifier &datasetid, const Identifier &remote, Station &station);
   DownloadDataSetQuery(const Identifier &datasetid, const NodeItem &remote, Station &station);
 
+  /** Returns the identifier of the dataset. */
+  const Identifier &dataset() const;
+
 signals:
   void succeeded();
-  void failed();
 
-protected slots:
-  void _onNodeFound(const NodeItem &node);
-  void _onConnectionEstablished();
-  void _onResponseReceived();
-  void _onError();
-  void _onReadyRead();
+protected:
+  bool _feed(const QByteArray &data);
+  void _complete();
 
 protected:
-  Station &_station;
   Identifier _dataSetID;
-  HttpClientConnection *_connection;
-  HttpClientResponse *_response;
-  size_t _responseLength;
-  QTemporaryFile _buffer;
+  QTemporaryFile _file;
   EVP_MD_CTX _mdctx;
 };
 
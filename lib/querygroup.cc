@@ -0,0 +1,261 @@
+#include "querygroup.hh"
+#include "query.hh"
+#include "station.hh"
+
+
+/* ********************************************************************************************* *
+ * Implementation of JsonQueryGroup
+ * ********************************************************************************************* */
+JsonQueryGroup::JsonQueryGroup(Station &station, const QString &path,
+                               const QList<Identifier> &remotes, size_t timeout,
+                               QueryScheduler::Priority priority)
+  : QObject(0), _station(station), _path(path), _remotes(remotes), _priority(priority),
+    _quorum(0), _queries(), _results(), _failed(0), _deadline(), _done(false)
+{
+  _deadline.setInterval(timeout);
+  _deadline.setSingleShot(true);
+  connect(&_deadline, SIGNAL(timeout()), this, SLOT(_onDeadline()));
+}
+
+void
+JsonQueryGroup::setQuorum(size_t n) {
+  _quorum = n;
+}
+
+const QHash<Identifier, QJsonDocument> &
+JsonQueryGroup::results() const {
+  return _results;
+}
+
+size_t
+JsonQueryGroup::numPending() const {
+  return _queries.size();
+}
+
+size_t
+JsonQueryGroup::numFailed() const {
+  return _failed;
+}
+
+void
+JsonQueryGroup::start() {
+  if (_remotes.isEmpty()) {
+    // Nothing to do, finish later as nobody is connected yet
+    QTimer::singleShot(0, this, SLOT(_onDeadline()));
+    return;
+  }
+
+  QList<Identifier>::const_iterator remote = _remotes.begin();
+  for (; remote != _remotes.end(); remote++) {
+    JsonQuery *query = _station.queries().submit(_createQuery(*remote), _priority);
+    connect(query, SIGNAL(received(Identifier,QJsonDocument)),
+            this, SLOT(_onReceived(Identifier,QJsonDocument)));
+    connect(query, SIGNAL(failed()), this, SLOT(_onFailed()));
+    _connectQuery(query);
+    _queries.append(query);
+  }
+  _deadline.start();
+}
+
+void
+JsonQueryGroup::cancel() {
+  if (_done) { return; }
+  _release();
+}
+
+void
+JsonQueryGroup::_onReceived(const Identifier &remote, const QJsonDocument &doc) {
+  if (_done) { return; }
+  _queries.removeOne(qobject_cast<JsonQuery *>(sender()));
+  _results.insert(remote, doc);
+  emit received(remote, doc);
+
+  if ((_quorum && (size_t(_results.size()) >= _quorum)) || _queries.isEmpty()) {
+    _finish();
+  }
+}
+
+void
+JsonQueryGroup::_onFailed() {
+  if (_done) { return; }
+  _queries.removeOne(qobject_cast<JsonQuery *>(sender()));
+  _failed++;
+  if (_queries.isEmpty()) {
+    _finish();
+  }
+}
+
+void
+JsonQueryGroup::_onDeadline() {
+  if (_done) { return; }
+  logInfo() << "Query group for '" << _path << "' finished with " << _results.size()
+            << " of " << _remotes.size() << " answers.";
+  _finish();
+}
+
+JsonQuery *
+JsonQueryGroup::_createQuery(const Identifier &remote) {
+  return new JsonQuery(_path, _station, remote);
+}
+
+void
+JsonQueryGroup::_connectQuery(JsonQuery *query) {
+  // pass...
+}
+
+void
+JsonQueryGroup::_finish() {
+  emit finished(_results);
+  _release();
+}
+
+void
+JsonQueryGroup::_release() {
+  _done = true;
+  _deadline.stop();
+  foreach (JsonQuery *query, _queries) {
+    disconnect(query, 0, this, 0);
+    _station.queries().cancel(query);
+  }
+  _queries.clear();
+  deleteLater();
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of DataSetListGroup
+ * ********************************************************************************************* */
+DataSetListGroup::DataSetListGroup(Station &station, const QList<Identifier> &remotes,
+                                   size_t timeout)
+  : JsonQueryGroup(station, "/data", remotes, timeout, QueryScheduler::BACKGROUND)
+{
+  // pass...
+}
+
+JsonQuery *
+DataSetListGroup::_createQuery(const Identifier &remote) {
+  return new DataSetListQuery(_station, remote);
+}
+
+void
+DataSetListGroup::_connectQuery(JsonQuery *query) {
+  connect(query, SIGNAL(dataSetReceived(Identifier,Identifier,RemoteDataSet)),
+          this, SIGNAL(dataSetReceived(Identifier,Identifier,RemoteDataSet)));
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of HedgedJsonQuery
+ * ********************************************************************************************* */
+HedgedJsonQuery::HedgedJsonQuery(Station &station, const QString &path,
+                                 const QList<Identifier> &replicas, size_t hedgeDelay,
+                                 size_t timeout, QueryScheduler::Priority priority)
+  : QObject(0), _station(station), _path(path), _replicas(replicas), _priority(priority),
+    _next(0), _queries(), _hedgeTimer(), _deadline(), _done(false)
+{
+  _hedgeTimer.setInterval(hedgeDelay);
+  _hedgeTimer.setSingleShot(true);
+  connect(&_hedgeTimer, SIGNAL(timeout()), this, SLOT(_onHedge()));
+
+  _deadline.setInterval(timeout);
+  _deadline.setSingleShot(true);
+  connect(&_deadline, SIGNAL(timeout()), this, SLOT(_onDeadline()));
+}
+
+void
+HedgedJsonQuery::start() {
+  _deadline.start();
+  if (_replicas.isEmpty()) {
+    // Fail later as nobody is connected yet
+    _deadline.setInterval(0);
+    _deadline.start();
+    return;
+  }
+  _onHedge();
+}
+
+void
+HedgedJsonQuery::cancel() {
+  if (_done) { return; }
+  _release();
+}
+
+void
+HedgedJsonQuery::_onHedge() {
+  if (_done || (_next >= _replicas.size())) { return; }
+  JsonQuery *query = _station.queries().submit(_createQuery(_replicas[_next++]), _priority);
+  connect(query, SIGNAL(received(Identifier,QJsonDocument)),
+          this, SLOT(_onReceived(Identifier,QJsonDocument)));
+  connect(query, SIGNAL(failed()), this, SLOT(_onFailed()));
+  _queries.append(query);
+  // Arm timer for the next replica
+  if (_next < _replicas.size()) {
+    _hedgeTimer.start();
+  }
+}
+
+void
+HedgedJsonQuery::_onReceived(const Identifier &remote, const QJsonDocument &doc) {
+  if (_done) { return; }
+  _queries.removeOne(qobject_cast<JsonQuery *>(sender()));
+  emit received(remote, doc);
+  _release();
+}
+
+void
+HedgedJsonQuery::_onFailed() {
+  if (_done) { return; }
+  _queries.removeOne(qobject_cast<JsonQuery *>(sender()));
+  if (_next < _replicas.size()) {
+    // Do not wait for the hedge delay, ask next replica immediately
+    _hedgeTimer.stop();
+    _onHedge();
+  } else if (_queries.isEmpty()) {
+    emit failed();
+    _release();
+  }
+}
+
+void
+HedgedJsonQuery::_onDeadline() {
+  if (_done) { return; }
+  logInfo() << "Hedged query for '" << _path << "' timed out.";
+  emit failed();
+  _release();
+}
+
+JsonQuery *
+HedgedJsonQuery::_createQuery(const Identifier &replica) {
+  return new JsonQuery(_path, _station, replica);
+}
+
+void
+HedgedJsonQuery::_release() {
+  _done = true;
+  _hedgeTimer.stop();
+  _deadline.stop();
+  foreach (JsonQuery *query, _queries) {
+    disconnect(query, 0, this, 0);
+    _station.queries().cancel(query);
+  }
+  _queries.clear();
+  deleteLater();
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of DataSetDownload
+ * ********************************************************************************************* */
+DataSetDownload::DataSetDownload(Station &station, const Identifier &dataset,
+                                 const QList<Identifier> &remotes, size_t hedgeDelay,
+                                 size_t timeout)
+  : HedgedJsonQuery(station, "/data/"+dataset.toBase32(), remotes, hedgeDelay, timeout),
+    _dataset(dataset)
+{
+  // pass...
+}
+
+JsonQuery *
+DataSetDownload::_createQuery(const Identifier &replica) {
+  return new DownloadDataSetQuery(_dataset, replica, _station);
+}
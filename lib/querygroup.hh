@@ -0,0 +1,188 @@
+#ifndef QUERYGROUP_HH
+#define QUERYGROUP_HH
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QTimer>
+#include <QJsonDocument>
+#include <ovlnet/buckets.hh>
+#include "queryscheduler.hh"
+#include "datasetfile.hh"
+
+class Station;
+class JsonQuery;
+
+
+/** Self-destructing fan-out of a JSON query to several stations.
+ * The group sends the same query to all given stations in parallel and collects the answers.
+ * Every answer is reported immediately via @c received. Once all stations answered or failed,
+ * the quorum is reached or the deadline passed, @c finished gets emitted with the (possibly
+ * partial) results and all outstanding queries get cancelled. */
+class JsonQueryGroup: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param path Specifies the path to query.
+   * @param remotes Specifies the stations to query.
+   * @param timeout Specifies the deadline of the whole group in ms.
+   * @param priority Specifies the priority of the queries. */
+  JsonQueryGroup(Station &station, const QString &path, const QList<Identifier> &remotes,
+                 size_t timeout=30000,
+                 QueryScheduler::Priority priority=QueryScheduler::INTERACTIVE);
+
+  /** If set to a value >0, the group finishes as soon as that many answers were received. */
+  void setQuorum(size_t n);
+
+  /** Returns the answers received so far. */
+  const QHash<Identifier, QJsonDocument> &results() const;
+  /** Returns the number of stations that did not answer yet. */
+  size_t numPending() const;
+  /** Returns the number of stations that failed to answer. */
+  size_t numFailed() const;
+
+public slots:
+  /** Submits all queries. */
+  void start();
+  /** Cancels all outstanding queries. No further signals get emitted. */
+  void cancel();
+
+signals:
+  /** Gets emitted for every answer. */
+  void received(const Identifier &remote, const QJsonDocument &doc);
+  /** Gets emitted once the group is complete. */
+  void finished(const QHash<Identifier, QJsonDocument> &results);
+
+protected slots:
+  void _onReceived(const Identifier &remote, const QJsonDocument &doc);
+  void _onFailed();
+  void _onDeadline();
+
+protected:
+  /** Creates the query for the given station. By default a plain @c JsonQuery of the path. */
+  virtual JsonQuery *_createQuery(const Identifier &remote);
+  /** Gets called for every submitted query, allows to connect to the signals of specialized
+   * queries. */
+  virtual void _connectQuery(JsonQuery *query);
+  /** Cancels all outstanding queries and deletes the group. */
+  void _release();
+  /** Emits @c finished and deletes the group. */
+  void _finish();
+
+protected:
+  Station &_station;
+  QString _path;
+  QList<Identifier> _remotes;
+  QueryScheduler::Priority _priority;
+  size_t _quorum;
+  /** Outstanding queries. */
+  QList<JsonQuery *> _queries;
+  QHash<Identifier, QJsonDocument> _results;
+  size_t _failed;
+  QTimer _deadline;
+  bool _done;
+};
+
+
+/** Self-destructing fan-out of the dataset list query to several stations. Every dataset gets
+ * reported as soon as it arrived. */
+class DataSetListGroup: public JsonQueryGroup
+{
+  Q_OBJECT
+
+public:
+  DataSetListGroup(Station &station, const QList<Identifier> &remotes, size_t timeout=60000);
+
+signals:
+  void dataSetReceived(const Identifier &remote, const Identifier &id,
+                       const RemoteDataSet &dataset);
+
+protected:
+  JsonQuery *_createQuery(const Identifier &remote);
+  void _connectQuery(JsonQuery *query);
+};
+
+
+/** Self-destructing hedged JSON query.
+ * The query is sent to the first replica. If no answer was received within the hedge delay or
+ * the replica failed, the query is additionally sent to the next replica and so on. The first
+ * answer wins, all other queries get cancelled. */
+class HedgedJsonQuery: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param path Specifies the path to query.
+   * @param replicas Specifies the stations to query in order of preference.
+   * @param hedgeDelay Specifies the delay in ms after which the next replica gets queried.
+   * @param timeout Specifies the overall deadline in ms.
+   * @param priority Specifies the priority of the queries. */
+  HedgedJsonQuery(Station &station, const QString &path, const QList<Identifier> &replicas,
+                  size_t hedgeDelay=2000, size_t timeout=30000,
+                  QueryScheduler::Priority priority=QueryScheduler::INTERACTIVE);
+
+public slots:
+  /** Sends the query to the first replica. */
+  void start();
+  /** Cancels all outstanding queries. No further signals get emitted. */
+  void cancel();
+
+signals:
+  /** Gets emitted with the first answer received. */
+  void received(const Identifier &remote, const QJsonDocument &doc);
+  /** Gets emitted if all replicas failed or the deadline passed. */
+  void failed();
+
+protected slots:
+  /** Sends the query to the next replica. */
+  void _onHedge();
+  void _onReceived(const Identifier &remote, const QJsonDocument &doc);
+  void _onFailed();
+  void _onDeadline();
+
+protected:
+  /** Creates the query for the given replica. By default a plain @c JsonQuery of the path. */
+  virtual JsonQuery *_createQuery(const Identifier &replica);
+  /** Cancels all outstanding queries and deletes the query. */
+  void _release();
+
+protected:
+  Station &_station;
+  QString _path;
+  QList<Identifier> _replicas;
+  QueryScheduler::Priority _priority;
+  /** Index of the next replica to query. */
+  int _next;
+  QList<JsonQuery *> _queries;
+  QTimer _hedgeTimer;
+  QTimer _deadline;
+  bool _done;
+};
+
+
+/** Self-destructing download of a dataset from one of the stations holding it.
+ * The download is hedged over the given stations: Another station gets asked only if the
+ * previous one failed or did not complete the download within the hedge delay. On success,
+ * @c received gets emitted with an empty document. */
+class DataSetDownload: public HedgedJsonQuery
+{
+  Q_OBJECT
+
+public:
+  /** Constructor.
+   * @param dataset Specifies the dataset to download.
+   * @param remotes Specifies the stations holding the dataset in order of preference. */
+  DataSetDownload(Station &station, const Identifier &dataset, const QList<Identifier> &remotes,
+                  size_t hedgeDelay=5*60*1000, size_t timeout=60*60*1000);
+
+protected:
+  JsonQuery *_createQuery(const Identifier &replica);
+
+protected:
+  Identifier _dataset;
+};
+
+#endif // QUERYGROUP_HH
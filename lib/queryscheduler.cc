@@ -0,0 +1,118 @@
+#include "queryscheduler.hh"
+#include "query.hh"
+#include <QTimer>
+
+
+/* ********************************************************************************************* *
+ * Implementation of QueryScheduler
+ * ********************************************************************************************* */
+QueryScheduler::QueryScheduler(size_t maxQueries, size_t maxPerPeer, QObject *parent)
+  : QObject(parent), _maxQueries(maxQueries), _maxPerPeer(maxPerPeer), _pending(), _info(),
+    _subscribers(), _running(), _runningPerPeer(), _schedulePending(false)
+{
+  // pass...
+}
+
+size_t
+QueryScheduler::numQueued() const {
+  return _queues[INTERACTIVE].size() + _queues[BACKGROUND].size();
+}
+
+size_t
+QueryScheduler::numRunning() const {
+  return _running.size();
+}
+
+QString
+QueryScheduler::_key(const JsonQuery *query) {
+  return query->remote().toBase32() + query->path();
+}
+
+JsonQuery *
+QueryScheduler::_submit(JsonQuery *query, Priority priority) {
+  QString key = _key(query);
+  if (_pending.contains(key)) {
+    JsonQuery *pending = _pending[key];
+    // Only coalesce queries of the same type
+    if (pending->metaObject() == query->metaObject()) {
+      // Promote a queued background query if requested interactively
+      if ((INTERACTIVE == priority) && _queues[BACKGROUND].removeOne(pending)) {
+        _queues[INTERACTIVE].append(pending);
+      }
+      _subscribers[pending] += 1;
+      delete query;
+      return pending;
+    }
+  }
+
+  _pending.insert(key, query);
+  _info.insert(query, QPair<QString, Identifier>(key, query->remote()));
+  _subscribers.insert(query, 1);
+  _queues[priority].append(query);
+  connect(query, SIGNAL(destroyed(QObject*)), this, SLOT(_onQueryDestroyed(QObject*)));
+
+  // Start queries later, the caller needs to connect to the query first
+  if (! _schedulePending) {
+    _schedulePending = true;
+    QTimer::singleShot(0, this, SLOT(_schedule()));
+  }
+  emit queueChanged(numQueued(), numRunning());
+  return query;
+}
+
+void
+QueryScheduler::cancel(JsonQuery *query) {
+  if (! _subscribers.contains(query)) { return; }
+  if (0 == (_subscribers[query] -= 1)) {
+    // Nobody is waiting for the query anymore
+    query->cancel();
+  }
+}
+
+void
+QueryScheduler::_schedule() {
+  _schedulePending = false;
+  size_t started = 0;
+  for (int prio=INTERACTIVE; prio<=BACKGROUND; prio++) {
+    QList<JsonQuery *>::iterator query = _queues[prio].begin();
+    while ((size_t(_running.size()) < _maxQueries) && (query != _queues[prio].end())) {
+      // Skip queries to stations with too many running queries
+      if (_runningPerPeer.value((*query)->remote(), 0) >= _maxPerPeer) {
+        query++; continue;
+      }
+      JsonQuery *next = *query;
+      query = _queues[prio].erase(query);
+      _running.insert(next);
+      _runningPerPeer[next->remote()] += 1;
+      next->start();
+      started++;
+    }
+  }
+  if (started) {
+    emit queueChanged(numQueued(), numRunning());
+  }
+}
+
+void
+QueryScheduler::_onQueryDestroyed(QObject *query) {
+  if (! _info.contains(query)) { return; }
+  QPair<QString, Identifier> info = _info.take(query);
+  _subscribers.remove(query);
+  // Do not remove a newer query with the same key
+  if (query == _pending.value(info.first, 0)) {
+    _pending.remove(info.first);
+  }
+
+  if (_running.remove(query)) {
+    if (0 == (_runningPerPeer[info.second] -= 1)) {
+      _runningPerPeer.remove(info.second);
+    }
+  } else {
+    // Query got deleted while waiting
+    _queues[INTERACTIVE].removeOne(static_cast<JsonQuery *>(query));
+    _queues[BACKGROUND].removeOne(static_cast<JsonQuery *>(query));
+  }
+
+  _schedule();
+  emit queueChanged(numQueued(), numRunning());
+}
@@ -0,0 +1,89 @@
+#ifndef QUERYSCHEDULER_HH
+#define QUERYSCHEDULER_HH
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QSet>
+#include <ovlnet/buckets.hh>
+
+class JsonQuery;
+
+
+/** Station-wide scheduler for all outbound queries to other stations.
+ * Identical requests (same path at the same station) that are queued or running are
+ * coalesced into a single query. The number of concurrently running queries is limited globally
+ * and per remote station. Interactive queries are always started before background ones. */
+class QueryScheduler: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Possible query priorities. */
+  typedef enum {
+    INTERACTIVE = 0, ///< Queries triggered by the user.
+    BACKGROUND  = 1  ///< Queries to crawl and update the network.
+  } Priority;
+
+public:
+  /** Constructor.
+   * @param maxQueries Specifies the max. number of concurrently running queries.
+   * @param maxPerPeer Specifies the max. number of concurrently running queries per station. */
+  explicit QueryScheduler(size_t maxQueries=16, size_t maxPerPeer=2, QObject *parent=0);
+
+  /** Submits a query. If an identical query is already queued or running, the given one gets
+   * deleted and the pending one is returned instead. Hence, connect to the signals of the returned
+   * query only. The scheduler starts the query once there is a free slot. */
+  template <class T>
+  T *submit(T *query, Priority priority=INTERACTIVE) {
+    return static_cast<T *>(_submit(query, priority));
+  }
+
+  /** Withdraws one submission of the given query. As queries may be shared between several
+   * submitters, the query gets cancelled only if nobody else is waiting for it. The caller
+   * should disconnect from the query first. */
+  void cancel(JsonQuery *query);
+
+  /** Returns the number of queries waiting to be started. */
+  size_t numQueued() const;
+  /** Returns the number of running queries. */
+  size_t numRunning() const;
+
+signals:
+  /** Gets emitted whenever the number of queued or running queries changes. */
+  void queueChanged(size_t queued, size_t running);
+
+protected:
+  /** Implements @c submit. */
+  JsonQuery *_submit(JsonQuery *query, Priority priority);
+  /** Returns the key used to coalesce identical queries. */
+  static QString _key(const JsonQuery *query);
+
+protected slots:
+  /** Starts queued queries as long as there are free slots. */
+  void _schedule();
+  /** Releases the slot or queue entry of a deleted query. */
+  void _onQueryDestroyed(QObject *query);
+
+protected:
+  /** Max. number of running queries. */
+  size_t _maxQueries;
+  /** Max. number of running queries per station. */
+  size_t _maxPerPeer;
+  /** Queued queries by priority. */
+  QList<JsonQuery *> _queues[2];
+  /** All pending (queued or running) queries by key. */
+  QHash<QString, JsonQuery *> _pending;
+  /** Keys and stations of all pending queries. Needed once the query got destroyed. */
+  QHash<QObject *, QPair<QString, Identifier> > _info;
+  /** Number of submitters per pending query. */
+  QHash<QObject *, size_t> _subscribers;
+  /** The set of running queries. */
+  QSet<QObject *> _running;
+  /** Number of running queries per station. */
+  QHash<Identifier, size_t> _runningPerPeer;
+  /** If @c true, a call to @c _schedule is already pending. */
+  bool _schedulePending;
+};
+
+#endif // QUERYSCHEDULER_HH
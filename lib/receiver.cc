@@ -6,19 +6,35 @@
 #include "datasetfile.hh"
 #include <netinet/in.h>
 #include "station.hh"
+#include "sidstore.hh"
+#include <QJsonArray>
+#include <cmath>
+#include <cstring>
+
+/** Scale of the baseband samples of narrowband recordings, the narrow band holds much less noise
+ * than the full input stream. */
+#define RECEIVER_BASEBAND_SCALE 16.f
+/** Block size and capacity of the queue of the receiver stage, about 20s at 48kHz. */
+#define RECEIVER_BLOCK_SIZE     4096
+#define RECEIVER_QUEUE_SIZE     (1<<20)
+/** Block size and capacity of the queue of the beacon receiver stage. */
+#define BEACON_BLOCK_SIZE       2048
+#define BEACON_QUEUE_SIZE       (1<<16)
 
 
 /* ********************************************************************************************* *
  * Implementation of ReceiverConfig
  * ********************************************************************************************* */
 ReceiverConfig::ReceiverConfig()
-  : _device()
+  : _device(), _beacons(), _narrowbandRate(200), _tracked(), _engine(FFT_ENGINE),
+    _resolution(10), _tau(1), _recordRate(10)
 {
   // pass...
 }
 
 ReceiverConfig::ReceiverConfig(const QString &filename)
-  : _device()
+  : _device(), _beacons(), _narrowbandRate(200), _tracked(), _engine(FFT_ENGINE),
+    _resolution(10), _tau(1), _recordRate(10)
 {
   QFile file(filename);
   if (! file.open(QIODevice::ReadOnly)) {
@@ -38,6 +54,8 @@ ReceiverConfig::ReceiverConfig(const QString &filename)
     return;
   }
   QJsonObject obj = doc.object();
+  _parseNarrowband(obj);
+  _parseTracker(obj);
   if (! obj.contains("device")) {
     logError() << "No input device specified in receiver config " << filename << ".";
     return;
@@ -55,8 +73,11 @@ ReceiverConfig::ReceiverConfig(const QString &filename)
 }
 
 ReceiverConfig::ReceiverConfig(const QJsonObject &obj)
-  : _device()
+  : _device(), _beacons(), _narrowbandRate(200), _tracked(), _engine(FFT_ENGINE),
+    _resolution(10), _tau(1), _recordRate(10)
 {
+  _parseNarrowband(obj);
+  _parseTracker(obj);
   if (! obj.contains("device")) {
     logError() << "No input device specified in receiver config.";
     return;
@@ -73,7 +94,9 @@ ReceiverConfig::ReceiverConfig(const QJsonObject &obj)
 }
 
 ReceiverConfig::ReceiverConfig(const ReceiverConfig &other)
-  : _device(other._device)
+  : _device(other._device), _beacons(other._beacons), _narrowbandRate(other._narrowbandRate),
+    _tracked(other._tracked), _engine(other._engine), _resolution(other._resolution),
+    _tau(other._tau), _recordRate(other._recordRate)
 {
   // pass...
 }
@@ -81,6 +104,13 @@ ReceiverConfig::ReceiverConfig(const ReceiverConfig &other)
 ReceiverConfig &
 ReceiverConfig::operator =(const ReceiverConfig &other) {
   _device = other._device;
+  _beacons = other._beacons;
+  _narrowbandRate = other._narrowbandRate;
+  _tracked = other._tracked;
+  _engine = other._engine;
+  _resolution = other._resolution;
+  _tau = other._tau;
+  _recordRate = other._recordRate;
   return *this;
 }
 
@@ -88,6 +118,30 @@ QJsonObject
 ReceiverConfig::toJson() const {
   QJsonObject res;
   res.insert("device", _device.deviceName());
+  if (! _beacons.isEmpty()) {
+    QJsonArray beacons;
+    foreach (Beacon beacon, _beacons) {
+      beacons.append(beacon.toJson());
+    }
+    QJsonObject narrowband;
+    narrowband.insert("rate", _narrowbandRate);
+    narrowband.insert("beacons", beacons);
+    res.insert("narrowband", narrowband);
+  }
+  QJsonObject tracker;
+  const char *engines[] = {"fft", "goertzel", "msk"};
+  tracker.insert("engine", engines[_engine]);
+  tracker.insert("resolution", _resolution);
+  tracker.insert("tau", _tau);
+  tracker.insert("recordRate", _recordRate);
+  if (! _tracked.isEmpty()) {
+    QJsonArray beacons;
+    foreach (Beacon beacon, _tracked) {
+      beacons.append(beacon.toJson());
+    }
+    tracker.insert("beacons", beacons);
+  }
+  res.insert("tracker", tracker);
   return res;
 }
 
@@ -116,19 +170,163 @@ ReceiverConfig::setDevice(const QAudioDeviceInfo &device) {
   _device = device;
 }
 
+bool
+ReceiverConfig::isNarrowband() const {
+  return ! _beacons.isEmpty();
+}
+
+const QVector<Beacon> &
+ReceiverConfig::beacons() const {
+  return _beacons;
+}
+
+void
+ReceiverConfig::setBeacons(const QVector<Beacon> &beacons) {
+  _beacons = beacons;
+}
+
+double
+ReceiverConfig::narrowbandRate() const {
+  return _narrowbandRate;
+}
+
+void
+ReceiverConfig::setNarrowbandRate(double rate) {
+  _narrowbandRate = rate;
+}
+
+bool
+ReceiverConfig::isTracking() const {
+  return ! trackedBeacons().isEmpty();
+}
+
+const QVector<Beacon> &
+ReceiverConfig::trackedBeacons() const {
+  return _tracked.isEmpty() ? _beacons : _tracked;
+}
+
+void
+ReceiverConfig::setTrackedBeacons(const QVector<Beacon> &beacons) {
+  _tracked = beacons;
+}
+
+ReceiverConfig::Engine
+ReceiverConfig::engine() const {
+  return _engine;
+}
+
+void
+ReceiverConfig::setEngine(Engine engine) {
+  _engine = engine;
+}
+
+double
+ReceiverConfig::resolution() const {
+  return _resolution;
+}
+
+void
+ReceiverConfig::setResolution(double resolution) {
+  _resolution = resolution;
+}
+
+double
+ReceiverConfig::tau() const {
+  return _tau;
+}
+
+void
+ReceiverConfig::setTau(double tau) {
+  _tau = tau;
+}
+
+double
+ReceiverConfig::recordRate() const {
+  return _recordRate;
+}
+
+void
+ReceiverConfig::setRecordRate(double rate) {
+  _recordRate = rate;
+}
+
+void
+ReceiverConfig::_parseNarrowband(const QJsonObject &obj) {
+  if (! obj.value("narrowband").isObject()) { return; }
+  QJsonObject narrowband = obj.value("narrowband").toObject();
+  _narrowbandRate = narrowband.value("rate").toDouble(200);
+  foreach (QJsonValue beacon, narrowband.value("beacons").toArray()) {
+    Beacon b(beacon.toObject());
+    if (b.name().isEmpty()) {
+      logWarning() << "Skip invalid beacon in receiver config.";
+      continue;
+    }
+    _beacons.append(b);
+  }
+}
+
+void
+ReceiverConfig::_parseTracker(const QJsonObject &obj) {
+  if (! obj.value("tracker").isObject()) { return; }
+  QJsonObject tracker = obj.value("tracker").toObject();
+  QString engine = tracker.value("engine").toString("fft");
+  if ("fft" == engine) {
+    _engine = FFT_ENGINE;
+  } else if ("goertzel" == engine) {
+    _engine = GOERTZEL_ENGINE;
+  } else if ("msk" == engine) {
+    _engine = MSK_ENGINE;
+  } else {
+    logWarning() << "Unknown tracker engine '" << engine << "' in receiver config, use FFT.";
+  }
+  _resolution = tracker.value("resolution").toDouble(10);
+  if (_resolution <= 0) {
+    logWarning() << "Invalid Goertzel resolution in receiver config, use 10Hz.";
+    _resolution = 10;
+  }
+  _tau = tracker.value("tau").toDouble(1);
+  if (_tau <= 0) {
+    logWarning() << "Invalid tracker time constant in receiver config, use 1s.";
+    _tau = 1;
+  }
+  _recordRate = tracker.value("recordRate").toDouble(10);
+  foreach (QJsonValue beacon, tracker.value("beacons").toArray()) {
+    Beacon b(beacon.toObject());
+    if (b.name().isEmpty()) {
+      logWarning() << "Skip invalid tracked beacon in receiver config.";
+      continue;
+    }
+    _tracked.append(b);
+  }
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of Receiver
  * ********************************************************************************************* */
 Receiver::Receiver(Station &station, const ReceiverConfig &config, QObject *parent)
-  : Audio(config.device(), parent), _station(station), _tmpFile(), _samples(0)
+  : Audio(config.device(), parent), _station(station), _stage(0), _tmpFile(), _samples(0),
+    _beacons(config.beacons()), _narrowbandRate(config.narrowbandRate()), _ddc(0)
 {
-  // pass...
+  _stage = new ReceiverStage(*this);
+  _station.pipeline().add(_stage);
 }
 
 Receiver::~Receiver()
 {
-  // pass...
+  // Stop the stage before the down-converters get destroyed
+  delete _stage;
+  delete _ddc;
+}
+
+double
+Receiver::dataRate() const {
+  // Devices are opened at 46kHz
+  double rate = ready() ? sampleRate() : 46e3;
+  if (_beacons.isEmpty()) {
+    return 2*rate;
+  }
+  return 4*_beacons.size()*DDCBank::integerRate(rate, _narrowbandRate);
 }
 
 bool
@@ -144,21 +342,57 @@ Receiver::start(double mSec) {
   }
 
   _startTime = QDateTime::currentDateTimeUtc();
-  return _tmpFile.open();
+  _samples = 0;
+  if (! _beacons.isEmpty()) {
+    delete _ddc;
+    _ddc = new DDCBank(_input->format().sampleRate(), _narrowbandRate);
+    // The datasets store the rate as an integer
+    if (_ddc->outputRate() != std::floor(_ddc->outputRate())) {
+      logWarning() << "Cannot start reception: No integer narrowband rate near "
+                   << _narrowbandRate << "Hz at an input rate of "
+                   << _input->format().sampleRate() << "Hz.";
+      Audio::stop();
+      delete _ddc; _ddc = 0;
+      return false;
+    }
+    foreach (Beacon beacon, _beacons) {
+      _ddc->add(beacon.frequency());
+    }
+    logDebug() << "Record " << _beacons.size() << " beacons at " << _ddc->outputRate() << "Hz.";
+  }
+  // The temporary file is reused, drop the previous recording
+  if (! (_tmpFile.open() && _tmpFile.resize(0))) {
+    logError() << "Cannot start reception: Cannot open temporary file.";
+    _tmpFile.close();
+    Audio::stop();
+    delete _ddc; _ddc = 0;
+    return false;
+  }
+  _stage->start();
+  return true;
 }
 
 void
 Receiver::stop() {
   logDebug() << "Stop reception. Store data.";
   Audio::stop();
-  if (_tmpFile.open()) {
+  // Wait for the stage to store the queued samples
+  _stage->flush();
+  _stage->stop();
+  _stage->wait();
+  if (_tmpFile.isOpen()) {
     save();
   }
   _tmpFile.close();
+  delete _ddc;
+  _ddc = 0;
 }
 
 bool
 Receiver::save() {
+  // Narrowband recordings hold the I and Q components of each beacon
+  size_t numTimeseries = _ddc ? 2*_beacons.size() : 1;
+  _samples = std::min(_samples, size_t(_tmpFile.size()/(2*numTimeseries)));
   DataSetFile::Header fileHeader;
   fileHeader.year = htons(_startTime.date().year());
   fileHeader.month = _startTime.date().month();
@@ -166,14 +400,15 @@ Receiver::save() {
   fileHeader.hour = _startTime.time().hour();
   fileHeader.minute = _startTime.time().minute();
   fileHeader.second = _startTime.time().second();
-  fileHeader.datasets = htons(1);
+  fileHeader.datasets = htons(numTimeseries);
   fileHeader.samples = htonl(_samples);
-  fileHeader.rate = htonl(_input->format().sampleRate());
+  fileHeader.rate = htonl(_ddc ? uint32_t(_ddc->outputRate()) : _input->format().sampleRate());
 
   Timeseries::Header header;
   header.longitude = _station.location().longitude();
   header.latitude = _station.location().latitude();
   header.height = _station.location().height();
+  memcpy(header.identifier, _station.id().constData(), OVL_HASH_SIZE);
 
   // Create a new temp file to assemble datafile in
   QTemporaryFile tmpFile;
@@ -183,17 +418,44 @@ Receiver::save() {
   // Write file header
   tmpFile.write((const char *) &fileHeader, sizeof(DataSetFile::Header));
   OVLHashUpdate((const unsigned char *) &fileHeader, sizeof(DataSetFile::Header), &mdctx);
-  // write dataset header
-  tmpFile.write((const char *) &header, sizeof(Timeseries::Header));
-  OVLHashUpdate((const unsigned char *) &header, sizeof(Timeseries::Header), &mdctx);
 
-  // copy data from _tmpFile
   _tmpFile.seek(0);
-  for (size_t i=0; i<_nSamples; i++) {
-    int16_t value;
-    _tmpFile.read((char *) &value, 2);
-    tmpFile.write((const char *) &value, 2);
-    OVLHashUpdate((const unsigned char *) &value, 2, &mdctx);
+  if (! _ddc) {
+    // write dataset header
+    tmpFile.write((const char *) &header, sizeof(Timeseries::Header));
+    OVLHashUpdate((const unsigned char *) &header, sizeof(Timeseries::Header), &mdctx);
+    // copy data from _tmpFile
+    for (size_t i=0; i<_samples; i++) {
+      int16_t value;
+      _tmpFile.read((char *) &value, 2);
+      tmpFile.write((const char *) &value, 2);
+      OVLHashUpdate((const unsigned char *) &value, 2, &mdctx);
+    }
+  } else {
+    // Samples are interleaved in _tmpFile, narrowband recordings are small enough to be
+    // de-interleaved in memory
+    QByteArray data = _tmpFile.readAll();
+    const int16_t *samples = (const int16_t *) data.constData();
+    QVector<int16_t> timeseries(_samples);
+    for (size_t j=0; j<numTimeseries; j++) {
+      tmpFile.write((const char *) &header, sizeof(Timeseries::Header));
+      OVLHashUpdate((const unsigned char *) &header, sizeof(Timeseries::Header), &mdctx);
+      for (size_t i=0; i<_samples; i++) {
+        timeseries[i] = samples[i*numTimeseries+j];
+      }
+      tmpFile.write((const char *) timeseries.constData(), 2*_samples);
+      OVLHashUpdate((const unsigned char *) timeseries.constData(), 2*_samples, &mdctx);
+    }
+    // Append the beacon table
+    QVector<DataSetFile::Baseband> beacons;
+    foreach (Beacon beacon, _beacons) {
+      DataSetFile::Baseband baseband = { beacon.name(), beacon.frequency(),
+                                         RECEIVER_BASEBAND_SCALE };
+      beacons.append(baseband);
+    }
+    QByteArray table = DataSetFile::basebandTable(beacons);
+    tmpFile.write(table);
+    OVLHashUpdate((const unsigned char *) table.constData(), table.size(), &mdctx);
   }
 
   // Get hash of file
@@ -201,7 +463,11 @@ Receiver::save() {
   OVLHashFinal(&mdctx, (uint8_t *)hash);
 
   // Move to destination
-  tmpFile.copy(_station.datasets().path()+Identifier(hash).toBase32());
+  if (! tmpFile.copy(_station.datasets().path()+"/"+Identifier(hash).toBase32())) {
+    logError() << "Cannot store dataset " << Identifier(hash).toBase32() << ".";
+    return false;
+  }
+  _station.datasets().addDataset(Identifier(hash));
   logDebug() << "Added dataset at " << _station.datasets().path()
              << "/" << Identifier(hash).toBase32();
   return true;
@@ -211,41 +477,94 @@ qint64
 Receiver::writeData(const char *data, qint64 len) {
   // Forward to default implementation Audio::writeData
   qint64 nbytes = Audio::writeData(data, len);
+  // Store samples on the pipeline stage
+  size_t n = nbytes/2, dropped = n - _stage->push((const int16_t *) data, n);
+  if (dropped) {
+    logWarning() << "Receiver falls behind: Dropped " << dropped << " samples of the recording.";
+  }
+  return nbytes;
+}
 
-  // Save data into temp file in network byte-order
-  size_t offset = 0;
-  while (nbytes>0) {
-    int16_t value = htons(*(int16_t *)(data+offset));
-    _tmpFile.write((const char *) &value, 2);
-    nbytes -= 2; _samples += 1;
+void
+Receiver::_store(const int16_t *samples, size_t nSamples) {
+  if (0 == _ddc) {
+    // Save data into temp file in network byte-order
+    for (size_t i=0; i<nSamples; i++) {
+      int16_t value = htons(samples[i]);
+      _tmpFile.write((const char *) &value, 2);
+    }
+    _samples += nSamples;
+    return;
   }
 
-  return nbytes;
+  // Save the scaled baseband samples of all beacons interleaved
+  QVector<int16_t> frame(2*_beacons.size());
+  for (size_t offset=0; offset<nSamples;) {
+    offset += _ddc->process(samples+offset, nSamples-offset);
+    if (! _ddc->completed()) { continue; }
+    for (int i=0; i<_beacons.size(); i++) {
+      float re = RECEIVER_BASEBAND_SCALE*_ddc->re(i), im = RECEIVER_BASEBAND_SCALE*_ddc->im(i);
+      frame[2*i]   = htons(int16_t(std::max(-32768.f, std::min(std::round(re), 32767.f))));
+      frame[2*i+1] = htons(int16_t(std::max(-32768.f, std::min(std::round(im), 32767.f))));
+    }
+    _tmpFile.write((const char *) frame.constData(), 2*frame.size());
+    _samples += 1;
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of ReceiverStage
+ * ********************************************************************************************* */
+ReceiverStage::ReceiverStage(Receiver &receiver)
+  : PipelineStage("receiver", RECEIVER_BLOCK_SIZE, RECEIVER_QUEUE_SIZE, BLOCK), _receiver(receiver)
+{
+  // pass...
 }
 
+void
+ReceiverStage::process(const int16_t *samples, size_t n) {
+  _receiver._store(samples, n);
+}
 
 
 /* ********************************************************************************************* *
  * Implementation of Beacon
  * ********************************************************************************************* */
 Beacon::Beacon()
-  : _name(), _fmin(0), _fmax(0)
+  : _name(), _fmin(0), _fmax(0), _baud(0)
 {
   // pass...
 }
 
-Beacon::Beacon(const QString &name, double fmin, double fmax)
-  : _name(name), _fmin(fmin), _fmax(fmax)
+Beacon::Beacon(const QString &name, double fmin, double fmax, double baud)
+  : _name(name), _fmin(fmin), _fmax(fmax), _baud(baud)
+{
+  // pass...
+}
+
+Beacon::Beacon(const QJsonObject &obj)
+  : _name(obj.value("name").toString()), _fmin(obj.value("fmin").toDouble()),
+    _fmax(obj.value("fmax").toDouble()), _baud(obj.value("baud").toDouble())
 {
   // pass...
 }
 
 Beacon::Beacon(const Beacon &other)
-  : _name(other._name), _fmin(other._fmin), _fmax(other._fmax)
+  : _name(other._name), _fmin(other._fmin), _fmax(other._fmax), _baud(other._baud)
 {
   // pass...
 }
 
+Beacon &
+Beacon::operator=(const Beacon &other) {
+  _name = other._name;
+  _fmin = other._fmin;
+  _fmax = other._fmax;
+  _baud = other._baud;
+  return *this;
+}
+
 const QString &
 Beacon::name() const {
   return _name;
@@ -261,27 +580,93 @@ Beacon::fmax() const {
   return _fmax;
 }
 
+double
+Beacon::frequency() const {
+  return (_fmin+_fmax)/2;
+}
+
+double
+Beacon::baud() const {
+  return (_baud > 0) ? _baud : std::abs(_fmax-_fmin);
+}
+
+QJsonObject
+Beacon::toJson() const {
+  QJsonObject obj;
+  obj.insert("name", _name);
+  obj.insert("fmin", _fmin);
+  obj.insert("fmax", _fmax);
+  if (_baud > 0) {
+    obj.insert("baud", _baud);
+  }
+  return obj;
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of BeaconReceiver
  * ********************************************************************************************* */
 BeaconReceiver::BeaconReceiver(const QVector<Beacon> &beacons, double tau,
                                const ReceiverConfig &config, Station &station)
-  : Audio(config.device(), &station), _station(station), _nFFTBuffer(4096), _beacons(beacons)
+  : Audio(config.device(), &station), _station(station), _engine(config.engine()), _psd(0),
+    _beacons(beacons), _bank(0), _msk(0), _stage(0), _recordInterval(100), _lastRecord(0)
 {
-  _fftInBuffer = new double[4096];
-  _fftOutBuffer = new double[4096];
-  _fft = fftw_plan_r2r_1d(4096, _fftInBuffer, _fftOutBuffer, FFTW_R2HC, FFTW_ESTIMATE);
   // resize and initialize signal averages
   _averages.fill(0, _beacons.size());
-  // damping factor for the averaging
-  _lambda = std::min(1., 4096./48e3/tau);
+  _phases.fill(NAN, _beacons.size());
+  _estimates.fill(0, _beacons.size());
+  _estimatedPhases.fill(NAN, _beacons.size());
+
+  // The engines run at the rate of the input device
+  double rate = ready() ? sampleRate() : 46e3;
+  double resolution = config.resolution();
+  if (ReceiverConfig::MSK_ENGINE == _engine) {
+    _msk = new MSKDemodulator(rate, tau);
+    for (int i=0; i<_beacons.size(); i++) {
+      _msk->add(_beacons[i].frequency(), _beacons[i].baud());
+    }
+    _lambda = 1;
+    logDebug() << "Demodulate " << _beacons.size() << " MSK beacons.";
+  } else if (ReceiverConfig::GOERTZEL_ENGINE == _engine) {
+    _bank = new GoertzelBank(rate, std::max(1., std::round(rate/resolution)));
+    // Bins spaced by the resolution over the band of each beacon
+    for (int i=0; i<_beacons.size(); i++) {
+      _firstFilter.append(_bank->numFilters());
+      double fmin = std::min(_beacons[i].fmin(), _beacons[i].fmax());
+      double fmax = std::max(_beacons[i].fmin(), _beacons[i].fmax());
+      size_t n = std::floor((fmax-fmin)/_bank->resolution());
+      double f0 = (fmin+fmax)/2 - n*_bank->resolution()/2;
+      for (size_t j=0; j<=n; j++) {
+        _bank->add(f0 + j*_bank->resolution());
+      }
+    }
+    _firstFilter.append(_bank->numFilters());
+    // damping factor for the averaging
+    _lambda = std::min(1., _bank->length()/rate/tau);
+    logDebug() << "Track " << _beacons.size() << " beacons with " << _bank->numFilters()
+               << " Goertzel filters at " << _bank->resolution() << "Hz resolution.";
+  } else {
+    // Exponential average of the power over Hann windowed frames with 50% overlap
+    _psd = new WelchPSD(_station.fftPlans(), rate, rate/4096, 0.5, WindowFunction::HANN,
+                        WelchPSD::EXPONENTIAL, tau*rate/2048);
+    _lambda = 1;
+  }
+
+  // Run the engine on a pipeline stage, estimates are passed back by queued signals
+  qRegisterMetaType< QVector<double> >("QVector<double>");
+  connect(this, SIGNAL(updated(QVector<double>,QVector<double>)),
+          this, SLOT(_onUpdated(QVector<double>,QVector<double>)));
+  _stage = new BeaconReceiverStage(*this);
+  _station.pipeline().add(_stage);
+  _stage->start();
 }
 
 BeaconReceiver::~BeaconReceiver() {
-  fftw_destroy_plan(_fft);
-  delete[] _fftInBuffer;
-  delete[] _fftOutBuffer;
+  // Stop the stage before the engines get destroyed
+  delete _stage;
+  delete _psd;
+  delete _bank;
+  delete _msk;
 }
 
 const QVector<Beacon> &
@@ -294,46 +679,126 @@ BeaconReceiver::averages() const {
   return _averages;
 }
 
+const QVector<double> &
+BeaconReceiver::phases() const {
+  return _phases;
+}
+
+BeaconReceiver::Engine
+BeaconReceiver::engine() const {
+  return _engine;
+}
+
+double
+BeaconReceiver::recordRate() const {
+  return _recordInterval ? 1e3/_recordInterval : 0;
+}
+
+void
+BeaconReceiver::setRecordRate(double rate) {
+  _recordInterval = (rate > 0) ? std::max(qint64(1), qint64(std::round(1e3/rate))) : 0;
+}
+
 qint64
 BeaconReceiver::writeData(const char *data, qint64 len) {
   if (len <= 0) { return 0; }
-  // Store samples in FFT input buffer
-  size_t nSamples = std::min(size_t(len/2), _nFFTBuffer);
-  for (size_t i=0; i<nSamples; i++) {
-    _fftInBuffer[4096-_nFFTBuffer] = ntohs(* (int16_t *)(data+i));
-  }
-  // update samples left
-  _nFFTBuffer -= nSamples;
-  // If inbuffer is full -> do FFT
-  if (0 == _nFFTBuffer) {
-    _doFFT();
-    _nFFTBuffer = 4096;
-  }
-
+  // Pass samples to the pipeline stage, samples are dropped if the engine falls behind
+  size_t nSamples = len/2;
+  _stage->push((const int16_t *) data, nSamples);
   // Return the number of bytes processed
   return nSamples*2;
 }
 
 void
-BeaconReceiver::_doFFT() {
-  // Perform FFT
-  fftw_execute(_fft);
-  // Update signal estimates
-  for (size_t i=0; i<_beacons.size(); i++) {
-    int a = 4096*_beacons[i].fmin()/48e3;
-    int b = 4096*_beacons[i].fmax()/48e3;
-    // limit a & b
-    a = std::max(1, std::min(a, 2048));
-    b = std::max(1, std::min(b, 2048));
+BeaconReceiver::_process(const int16_t *samples, size_t nSamples) {
+  // Feed all samples, pass estimates on each completed block
+  size_t offset = 0;
+  while (offset < nSamples) {
+    if (ReceiverConfig::GOERTZEL_ENGINE == _engine) {
+      offset += _bank->process(samples+offset, nSamples-offset);
+      if (! _bank->completed()) { continue; }
+      _doGoertzel();
+    } else if (ReceiverConfig::MSK_ENGINE == _engine) {
+      offset += _msk->process(samples+offset, nSamples-offset);
+      if (! _msk->completed()) { continue; }
+      _doMSK();
+    } else {
+      offset += _psd->process(samples+offset, nSamples-offset);
+      if (! _psd->completed()) { continue; }
+      _doFFT();
+    }
+    emit updated(_estimates, _estimatedPhases);
+  }
+}
+
+void
+BeaconReceiver::_onUpdated(const QVector<double> &averages, const QVector<double> &phases) {
+  _averages = averages;
+  _phases = phases;
+  _record();
+}
+
+void
+BeaconReceiver::_doGoertzel() {
+  for (int i=0; i<_beacons.size(); i++) {
     // get max signal
     double sig = 0;
-    for (int j=a; j<b; j++) {
-      double v = _fftOutBuffer[j]*_fftOutBuffer[j] +
-          _fftOutBuffer[4096-j]*_fftOutBuffer[4096-j];
-      v = std::sqrt(v/4096);
-      sig = std::max(sig, v);
+    for (size_t j=_firstFilter[i]; j<_firstFilter[i+1]; j++) {
+      sig = std::max(sig, _bank->magnitude(j));
     }
     // peform averaging
-    _averages[i] = (1-_lambda)*_averages[i] + _lambda*sig;
+    _estimates[i] = (1-_lambda)*_estimates[i] + _lambda*sig;
+  }
+}
+
+void
+BeaconReceiver::_doMSK() {
+  for (int i=0; i<_beacons.size(); i++) {
+    _estimates[i] = _msk->amplitude(i);
+    _estimatedPhases[i] = _msk->phase(i);
   }
 }
+
+void
+BeaconReceiver::_doFFT() {
+  const QVector<float> &psd = _psd->psd();
+  // Update signal estimates from the averaged power spectrum
+  for (int i=0; i<_beacons.size(); i++) {
+    size_t a = _psd->bin(std::min(_beacons[i].fmin(), _beacons[i].fmax()));
+    size_t b = _psd->bin(std::max(_beacons[i].fmin(), _beacons[i].fmax()));
+    // get max signal
+    float sig = 0;
+    for (size_t j=std::max(size_t(1), a); j<=b; j++) {
+      sig = std::max(sig, psd[j]);
+    }
+    _estimates[i] = std::sqrt(sig);
+  }
+}
+
+void
+BeaconReceiver::_record() {
+  if (0 == _recordInterval) { return; }
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  if ((now - _lastRecord) < _recordInterval) { return; }
+  _lastRecord = now;
+  // Wrap the phases, unwrapped phases grow without bound with the carrier offset
+  for (int i=0; i<_beacons.size(); i++) {
+    _station.sid().append(_beacons[i].name(), now, _averages[i],
+                          std::remainder(_phases[i], 2*M_PI));
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of BeaconReceiverStage
+ * ********************************************************************************************* */
+BeaconReceiverStage::BeaconReceiverStage(BeaconReceiver &receiver)
+  : PipelineStage("beacons", BEACON_BLOCK_SIZE, BEACON_QUEUE_SIZE, DROP), _receiver(receiver)
+{
+  // pass...
+}
+
+void
+BeaconReceiverStage::process(const int16_t *samples, size_t n) {
+  _receiver._process(samples, n);
+}
@@ -7,11 +7,58 @@
 #include "audio.hh"
 #include "location.hh"
 #include "datasetfile.hh"
-#include <fftw3.h>
+#include "pipeline.hh"
+#include "dsp/goertzelbank.hh"
+#include "dsp/welch.hh"
+#include "dsp/mskdemod.hh"
+#include "dsp/ddc.hh"
 
+class ReceiverStage;
+class BeaconReceiverStage;
 
+/** A beacon within the band [fmin, fmax]. MSK beacons transmit at the center of the band, their
+ * baud rate defaults to the width of the band. */
+class Beacon
+{
+public:
+  Beacon();
+  Beacon(const QString &name, double fmin, double fmax, double baud=0);
+  explicit Beacon(const QJsonObject &obj);
+  Beacon(const Beacon &other);
+
+  Beacon &operator=(const Beacon &other);
+
+  const QString &name() const;
+  double fmin() const;
+  double fmax() const;
+  /** Returns the center frequency of the band. */
+  double frequency() const;
+  /** Returns the baud rate of MSK beacons. */
+  double baud() const;
+
+  QJsonObject toJson() const;
+
+protected:
+  QString _name;
+  double _fmin;
+  double _fmax;
+  double _baud;
+};
+
+
+/** Configuration of the receiver. If beacons are configured, the receiver records the complex
+ * baseband of each beacon at the narrowband rate instead of the full input stream. If tracked
+ * beacons are configured, the station runs a @c BeaconReceiver with the configured engine. */
 class ReceiverConfig
 {
+public:
+  /** Possible tracking engines. */
+  typedef enum {
+    FFT_ENGINE,
+    GOERTZEL_ENGINE,
+    MSK_ENGINE
+  } Engine;
+
 public:
   ReceiverConfig();
   explicit ReceiverConfig(const QString &filename);
@@ -26,11 +73,58 @@ public:
   const QAudioDeviceInfo &device() const;
   void setDevice(const QAudioDeviceInfo &device);
 
+  /** Returns @c true if beacons are configured for narrowband recordings. */
+  bool isNarrowband() const;
+  /** Returns the beacons of narrowband recordings. */
+  const QVector<Beacon> &beacons() const;
+  void setBeacons(const QVector<Beacon> &beacons);
+  /** Returns the requested sample rate of narrowband recordings in Hz, the recordings use the
+   * closest integer rate the input rate is divisible by, see @c DDCBank. */
+  double narrowbandRate() const;
+  void setNarrowbandRate(double rate);
+
+  /** Returns @c true if beacons are configured for tracking. */
+  bool isTracking() const;
+  /** Returns the beacons to track, the beacons of narrowband recordings unless specified. */
+  const QVector<Beacon> &trackedBeacons() const;
+  void setTrackedBeacons(const QVector<Beacon> &beacons);
+  /** Returns the engine of the beacon tracker. */
+  Engine engine() const;
+  void setEngine(Engine engine);
+  /** Returns the frequency resolution of the Goertzel engine in Hz. */
+  double resolution() const;
+  void setResolution(double resolution);
+  /** Returns the time constant of the tracker in s. */
+  double tau() const;
+  void setTau(double tau);
+  /** Returns the rate in Hz at which the tracked amplitudes are recorded. */
+  double recordRate() const;
+  void setRecordRate(double rate);
+
+protected:
+  /** Reads the narrowband settings. */
+  void _parseNarrowband(const QJsonObject &obj);
+  /** Reads the tracker settings. */
+  void _parseTracker(const QJsonObject &obj);
+
 protected:
   QAudioDeviceInfo _device;
+  QVector<Beacon> _beacons;
+  double _narrowbandRate;
+  QVector<Beacon> _tracked;
+  Engine _engine;
+  double _resolution;
+  double _tau;
+  double _recordRate;
 };
 
 
+/** Records the input stream into datasets. In narrowband mode, a bank of digital down-converters
+ * shifts the band of each beacon to baseband. The in-phase and quadrature components are stored
+ * as two timeseries per beacon, followed by a table of the beacons (see @c DataSetFile). Hence a
+ * long-term recording of a few beacons takes less than 1% of the full bandwidth recording. The
+ * down-conversion and the writes to the disk happen on a pipeline stage, such that the capture
+ * never waits for the disk. */
 class Receiver: public Audio
 {
   Q_OBJECT
@@ -39,67 +133,153 @@ public:
   Receiver(Station &station, const ReceiverConfig &config, QObject *parent=0);
   virtual ~Receiver();
 
+  /** Returns the data rate of a recording in bytes per second, i.e. two bytes per sample of the
+   * input stream or of the I and Q components of each beacon in narrowband mode. */
+  double dataRate() const;
+
 public slots:
   bool start(double mSec=-1);
   void stop();
 
 protected:
   qint64 writeData(const char *data, qint64 len);
+  /** Stores the samples into the temporary file, called by the pipeline stage. */
+  void _store(const int16_t *samples, size_t n);
   bool save();
 
 protected:
   Station &_station;
+  /** Pipeline stage storing the samples. */
+  ReceiverStage *_stage;
   QTemporaryFile _tmpFile;
   size_t _samples;
   QDateTime _startTime;
+  /** Beacons and sample rate of narrowband recordings. */
+  QVector<Beacon> _beacons;
+  double _narrowbandRate;
+  /** Down-converters of a running narrowband recording. */
+  DDCBank *_ddc;
+
+  friend class ReceiverStage;
 };
 
 
-class Beacon
+/** Pipeline stage of a @c Receiver. If the disk falls behind for longer than the queue holds,
+ * the capture waits a bounded time for the stage before samples get dropped. */
+class ReceiverStage: public PipelineStage
 {
 public:
-  Beacon();
-  Beacon(const QString &name, double fmin, double fmax);
-  Beacon(const Beacon &other);
-
-  Beacon &operator=(const Beacon &other);
+  explicit ReceiverStage(Receiver &receiver);
 
-  const QString &name() const;
-  double fmin() const;
-  double fmax() const;
+protected:
+  void process(const int16_t *samples, size_t n);
 
 protected:
-  QString _name;
-  double _fmin;
-  double _fmax;
+  Receiver &_receiver;
 };
 
 
+/** Tracks the signal strength of a set of beacons.
+ * The FFT engine estimates the power spectrum from Hann windowed 4096 point frames with 50%
+ * overlap, averaged exponentially over the time constant, and takes the maximum over all bins
+ * within the band of each beacon. The Goertzel engine only evaluates the bins
+ * within the beacon bands, at the given frequency resolution. Its cost is proportional to the
+ * number of bins watched rather than the full spectrum, which makes it the choice for small
+ * stations. The MSK engine demodulates each beacon coherently and tracks the amplitude and phase
+ * of its carrier, see @c MSKDemodulator. The engines run on a pipeline stage, their estimates are
+ * passed back to the thread of the receiver with the @c updated signal. The averages are recorded
+ * into the SID store of the station at the record rate, one series per beacon. */
 class BeaconReceiver: public Audio
 {
   Q_OBJECT
 
 public:
-  BeaconReceiver(const QVector<Beacon> &beacons, double tau, const ReceiverConfig &config, Station &station);
+  typedef ReceiverConfig::Engine Engine;
+
+public:
+  /** Constructor.
+   * @param beacons Specifies the beacons to track.
+   * @param tau Specifies the time constant of the averaging in s, the update interval of the MSK
+   *        engine.
+   * @param config Specifies the receiver config, including the engine and the frequency
+   *        resolution of the Goertzel engine.
+   * @param station Specifies the station. */
+  BeaconReceiver(const QVector<Beacon> &beacons, double tau, const ReceiverConfig &config,
+                 Station &station);
   virtual ~BeaconReceiver();
 
   const QVector<Beacon> &beacons() const;
   const QVector<double> &averages() const;
+  /** Returns the carrier phases in rad, NaN unless the MSK engine is used. */
+  const QVector<double> &phases() const;
+  Engine engine() const;
+
+  /** Returns the rate in Hz at which the averages are recorded. */
+  double recordRate() const;
+  /** Sets the rate in Hz at which the averages are recorded, 0 disables the recording. */
+  void setRecordRate(double rate);
+
+signals:
+  /** Gets emitted by the pipeline stage on new estimates. */
+  void updated(const QVector<double> &averages, const QVector<double> &phases);
+
+protected slots:
+  /** Takes the estimates of the pipeline stage. */
+  void _onUpdated(const QVector<double> &averages, const QVector<double> &phases);
 
 protected:
   qint64 writeData(const char *data, qint64 len);
+  /** Feeds the samples to the engine, called by the pipeline stage. */
+  void _process(const int16_t *samples, size_t n);
   void _doFFT();
+  void _doGoertzel();
+  void _doMSK();
+  /** Records the averages into the SID store if the record interval passed. */
+  void _record();
 
 protected:
   Station &_station;
+  Engine _engine;
 
-  fftw_plan _fft;
-  size_t _nFFTBuffer;
-  double *_fftInBuffer;
-  double *_fftOutBuffer;
+  /** Averaged power spectrum of the FFT engine. */
+  WelchPSD *_psd;
+  /** Damping factor of the averaging of the Goertzel engine. */
   double _lambda;
   QVector<Beacon> _beacons;
+  /** Latest estimates, updated on the thread of the receiver. */
   QVector<double> _averages;
+  /** Filter bank of the Goertzel engine. */
+  GoertzelBank *_bank;
+  /** Index of the first filter of each beacon, followed by the total number of filters. */
+  QVector<size_t> _firstFilter;
+  /** Demodulator of the MSK engine. */
+  MSKDemodulator *_msk;
+  QVector<double> _phases;
+  /** Estimates of the engine, owned by the pipeline stage. */
+  QVector<double> _estimates;
+  QVector<double> _estimatedPhases;
+  /** Pipeline stage running the engine. */
+  BeaconReceiverStage *_stage;
+  /** Interval between recorded averages in ms, 0 if disabled. */
+  qint64 _recordInterval;
+  /** Time of the last recorded averages in ms since epoch. */
+  qint64 _lastRecord;
+
+  friend class BeaconReceiverStage;
+};
+
+
+/** Pipeline stage of a @c BeaconReceiver. Samples get dropped if the engine falls behind. */
+class BeaconReceiverStage: public PipelineStage
+{
+public:
+  explicit BeaconReceiverStage(BeaconReceiver &receiver);
+
+protected:
+  void process(const int16_t *samples, size_t n);
+
+protected:
+  BeaconReceiver &_receiver;
 };
 
 #endif // RECEIVER_HH
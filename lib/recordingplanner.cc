@@ -0,0 +1,127 @@
+#include "recordingplanner.hh"
+#include <ovlnet/logger.hh>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStorageInfo>
+#include <algorithm>
+
+
+/* ********************************************************************************************* *
+ * Implementation of RecordingPlanner
+ * ********************************************************************************************* */
+RecordingPlanner::RecordingPlanner(const QString &filename, const QString &dataDir, double rate)
+  : _dataDir(dataDir), _rate(rate), _reserve(1024LL*1024*1024), _upload(512.*1024*1024),
+    _horizon(7), _now(), _available(0), _diskPlanned(0), _uploadPlanned(0)
+{
+  QFile file(filename);
+  if (! file.open(QIODevice::ReadOnly)) {
+    logDebug() << "No recording planner config " << filename << ": Use defaults.";
+    return;
+  }
+  QJsonParseError err;
+  QJsonDocument doc = QJsonDocument::fromJson(file.readAll(), &err);
+  file.close();
+  if ((QJsonParseError::NoError != err.error) || (! doc.isObject())) {
+    logError() << "Cannot read recording planner config " << filename << ": Use defaults.";
+    return;
+  }
+  QJsonObject obj = doc.object();
+  if (obj.contains("reserve")) {
+    _reserve = qint64(obj.value("reserve").toDouble()*1024*1024);
+  }
+  if (obj.contains("upload")) {
+    _upload = obj.value("upload").toDouble()*1024*1024;
+  }
+  if (obj.value("horizon").toInt() > 0) {
+    _horizon = obj.value("horizon").toInt();
+  }
+  if (obj.value("rate").toDouble() > 0) {
+    _rate = obj.value("rate").toDouble();
+  }
+}
+
+double
+RecordingPlanner::rate() const {
+  return _rate;
+}
+
+qint64
+RecordingPlanner::available() const {
+  QStorageInfo storage(_dataDir);
+  if (! storage.isValid()) { return 0; }
+  return std::max(qint64(0), storage.bytesAvailable()-_reserve);
+}
+
+qint64
+RecordingPlanner::forecast(const ScheduledEvent &event, const QDateTime &now) const {
+  return qint64(_occurrences(event, now)*event.duration()*_rate);
+}
+
+void
+RecordingPlanner::begin(const QList<ScheduledEvent> &committed, const QDateTime &now,
+                        double background) {
+  _now = now;
+  _available = available();
+  _diskPlanned = qint64(background*_horizon*24*3600);
+  _uploadPlanned = 0;
+  foreach (ScheduledEvent event, committed) {
+    _diskPlanned += qint64(_occurrences(event, _now)*event.duration()*_rate);
+  }
+  if (_diskPlanned > _available) {
+    logWarning() << "Local schedule needs " << _diskPlanned/(1024*1024) << "MB within "
+                 << _horizon << " days, but only " << _available/(1024*1024) << "MB are available.";
+  }
+}
+
+bool
+RecordingPlanner::accept(ScheduledEvent &event, size_t peers) {
+  int occurrences = _occurrences(event, _now);
+  if (0 == occurrences) { return true; }
+
+  // Bytes per second of recording against disk and upload budget
+  double disk = occurrences*_rate;
+  double upload = disk*peers/_horizon;
+  double duration = event.duration();
+  duration = std::min(duration, (_available-_diskPlanned)/disk);
+  if ((_upload > 0) && (upload > 0)) {
+    duration = std::min(duration, (_upload-_uploadPlanned)/upload);
+  }
+
+  if (duration < 60) {
+    logDebug() << "Planner: Reject event at " << event.first().toString()
+               << ": Exceeds disk or upload budget.";
+    return false;
+  }
+  if (int(duration) < event.duration()) {
+    logDebug() << "Planner: Cap event at " << event.first().toString()
+               << " to " << int(duration) << "s.";
+    event.setDuration(int(duration));
+  }
+  _diskPlanned += qint64(disk*event.duration());
+  _uploadPlanned += upload*event.duration();
+  return true;
+}
+
+qint64
+RecordingPlanner::diskPlanned() const {
+  return _diskPlanned;
+}
+
+double
+RecordingPlanner::uploadPlanned() const {
+  return _uploadPlanned;
+}
+
+int
+RecordingPlanner::_occurrences(const ScheduledEvent &event, const QDateTime &now) const {
+  QDateTime end = now.addDays(_horizon);
+  int count = 0;
+  QDateTime next = event.nextEvent(now);
+  while (next.isValid() && (next < end)) {
+    count++;
+    if (ScheduledEvent::SINGLE == event.type()) { break; }
+    next = event.nextEvent(next.addMSecs(1));
+  }
+  return count;
+}
@@ -0,0 +1,77 @@
+#ifndef RECORDINGPLANNER_HH
+#define RECORDINGPLANNER_HH
+
+#include <QString>
+#include <QList>
+#include <QDateTime>
+#include "schedule.hh"
+
+
+/** Forecasts the disk usage and upload bandwidth of scheduled recordings and caps or rejects
+ * recordings exceeding the configured budgets.
+ * The disk budget is the free space of the data directory less a reserve. Each event consumes the
+ * bytes of all its recordings within the planning horizon. The upload budget limits the bytes per
+ * day served to the peers participating in joined events, assuming each peer downloads each
+ * recording once.
+ *
+ * The budgets are read from a JSON config file, e.g.
+ * @code
+ * { "reserve": 1024, "upload": 512, "horizon": 7, "rate": 92000 }
+ * @endcode
+ * specifying the reserve in MB, the upload budget in MB per day (0 for unlimited), the horizon in
+ * days and the data rate of a recording in bytes per second. The rate overrides the rate of the
+ * receiver passed to the constructor. */
+class RecordingPlanner
+{
+public:
+  /** Constructs a planner for the data directory @c dataDir using the config file @c filename.
+   * @c rate specifies the data rate of a recording in bytes per second, see
+   * @c Receiver::dataRate. */
+  RecordingPlanner(const QString &filename, const QString &dataDir, double rate);
+
+  /** Returns the data rate of a recording in bytes per second. */
+  double rate() const;
+  /** Returns the disk space in bytes available for recordings. */
+  qint64 available() const;
+
+  /** Returns the bytes recorded by the event within the horizon. */
+  qint64 forecast(const ScheduledEvent &event, const QDateTime &now) const;
+
+  /** Starts a new plan with the given events, which are always recorded. @c background specifies
+   * the bytes per second written besides the recordings (e.g., by the SID store), which are
+   * reserved for the whole horizon. */
+  void begin(const QList<ScheduledEvent> &committed, const QDateTime &now, double background=0);
+  /** Accepts the event with the given number of peers if it fits into the remaining budgets. If it
+   * does not fit, the duration of the event is capped to what fits. Returns @c false if less than
+   * a minute fits. */
+  bool accept(ScheduledEvent &event, size_t peers);
+
+  /** Returns the bytes planned to be recorded within the horizon. */
+  qint64 diskPlanned() const;
+  /** Returns the bytes per day planned to be served to peers. */
+  double uploadPlanned() const;
+
+protected:
+  /** Returns the number of occurrences of the event within the horizon starting at @c now. */
+  int _occurrences(const ScheduledEvent &event, const QDateTime &now) const;
+
+protected:
+  /** Data directory. */
+  QString _dataDir;
+  /** Data rate in bytes per second. */
+  double _rate;
+  /** Reserved disk space in bytes. */
+  qint64 _reserve;
+  /** Upload budget in bytes per day. */
+  double _upload;
+  /** Planning horizon in days. */
+  int _horizon;
+  /** Start of the current plan. */
+  QDateTime _now;
+  /** Disk space available for the current plan. */
+  qint64 _available;
+  qint64 _diskPlanned;
+  double _uploadPlanned;
+};
+
+#endif // RECORDINGPLANNER_HH
@@ -0,0 +1,114 @@
+#include "resolvecache.hh"
+#include "query.hh"
+#include <ovlnet/node.hh>
+
+
+/* ********************************************************************************************* *
+ * Implementation of ResolveCache
+ * ********************************************************************************************* */
+ResolveCache::ResolveCache(Node &node, size_t ttl, size_t negativeTTL, QObject *parent)
+  : QObject(parent), _node(node), _ttl(ttl), _negativeTTL(negativeTTL), _entries(), _pending(),
+    _purgeTimer()
+{
+  // Purge expired entries every 5min
+  _purgeTimer.setInterval(1000*300);
+  _purgeTimer.setSingleShot(false);
+  connect(&_purgeTimer, SIGNAL(timeout()), this, SLOT(_onPurge()));
+  _purgeTimer.start();
+}
+
+bool
+ResolveCache::lookup(const Identifier &id, NodeItem &node) const {
+  QHash<Identifier, Entry>::const_iterator entry = _entries.find(id);
+  if ((_entries.end() == entry) || (! entry->reachable)) { return false; }
+  if (entry->expires < QDateTime::currentDateTime()) { return false; }
+  node = entry->node;
+  return true;
+}
+
+bool
+ResolveCache::isUnreachable(const Identifier &id) const {
+  QHash<Identifier, Entry>::const_iterator entry = _entries.find(id);
+  if ((_entries.end() == entry) || entry->reachable) { return false; }
+  return entry->expires >= QDateTime::currentDateTime();
+}
+
+StationResolveQuery *
+ResolveCache::resolve(const Identifier &id) {
+  // Join pending search if there is one
+  if (_pending.contains(id)) {
+    return _pending[id];
+  }
+  StationResolveQuery *query = new StationResolveQuery(_node, id);
+  _pending.insert(id, query);
+  connect(query, SIGNAL(found(NodeItem)), this, SLOT(_onFound(NodeItem)));
+  connect(query, SIGNAL(notFound(Identifier)), this, SLOT(_onNotFound(Identifier)));
+  connect(query, SIGNAL(destroyed(QObject*)), this, SLOT(_onQueryDestroyed(QObject*)));
+  return query;
+}
+
+size_t
+ResolveCache::size() const {
+  return _entries.size();
+}
+
+void
+ResolveCache::insert(const NodeItem &node) {
+  if (node.id().isEmpty()) { return; }
+  Entry entry;
+  entry.node = node;
+  entry.reachable = true;
+  entry.expires = QDateTime::currentDateTime().addSecs(_ttl);
+  _entries.insert(node.id(), entry);
+}
+
+void
+ResolveCache::markUnreachable(const Identifier &id) {
+  Entry entry;
+  entry.node = NodeItem();
+  entry.reachable = false;
+  entry.expires = QDateTime::currentDateTime().addSecs(_negativeTTL);
+  _entries.insert(id, entry);
+}
+
+void
+ResolveCache::invalidate(const Identifier &id) {
+  _entries.remove(id);
+}
+
+void
+ResolveCache::_onFound(const NodeItem &node) {
+  _pending.remove(node.id());
+  insert(node);
+}
+
+void
+ResolveCache::_onNotFound(const Identifier &id) {
+  _pending.remove(id);
+  markUnreachable(id);
+}
+
+void
+ResolveCache::_onQueryDestroyed(QObject *query) {
+  QHash<Identifier, StationResolveQuery *>::iterator item = _pending.begin();
+  while (item != _pending.end()) {
+    if (query == item.value()) {
+      item = _pending.erase(item);
+    } else {
+      item++;
+    }
+  }
+}
+
+void
+ResolveCache::_onPurge() {
+  QDateTime now = QDateTime::currentDateTime();
+  QHash<Identifier, Entry>::iterator entry = _entries.begin();
+  while (entry != _entries.end()) {
+    if (entry->expires < now) {
+      entry = _entries.erase(entry);
+    } else {
+      entry++;
+    }
+  }
+}
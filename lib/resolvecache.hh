@@ -0,0 +1,82 @@
+#ifndef RESOLVECACHE_HH
+#define RESOLVECACHE_HH
+
+#include <QObject>
+#include <QHash>
+#include <QDateTime>
+#include <QTimer>
+#include <ovlnet/buckets.hh>
+
+class Node;
+class StationResolveQuery;
+
+
+/** Station-wide cache of resolved station identifiers.
+ * Maps station identifiers to the @c NodeItem (address & port) found by a DHT search. Entries
+ * expire after a TTL. Stations that could not be found or reached are kept as negative entries
+ * for a shorter TTL, such that queries to them fail fast instead of triggering a new search.
+ * Concurrent lookups for the same identifier share a single @c StationResolveQuery. */
+class ResolveCache: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructs an empty cache for the given node.
+   * @param ttl Specifies the time-to-live of positive entries in seconds.
+   * @param negativeTTL Specifies the time-to-live of negative entries in seconds. */
+  explicit ResolveCache(Node &node, size_t ttl=900, size_t negativeTTL=120, QObject *parent=0);
+
+  /** Returns @c true if there is a valid positive entry for the given station and stores the
+   * node item in @c node. */
+  bool lookup(const Identifier &id, NodeItem &node) const;
+  /** Returns @c true if the station is known to be unreachable. */
+  bool isUnreachable(const Identifier &id) const;
+  /** Returns the pending search query for the specified station. If there is none, a new search
+   * gets started. The returned query emits @c found or @c notFound exactly once. */
+  StationResolveQuery *resolve(const Identifier &id);
+
+  /** Returns the number of entries in the cache. */
+  size_t size() const;
+
+public slots:
+  /** Adds or updates a positive entry. */
+  void insert(const NodeItem &node);
+  /** Marks the given station as unreachable. */
+  void markUnreachable(const Identifier &id);
+  /** Removes any entry for the given station. */
+  void invalidate(const Identifier &id);
+
+protected slots:
+  void _onFound(const NodeItem &node);
+  void _onNotFound(const Identifier &id);
+  void _onQueryDestroyed(QObject *query);
+  /** Removes all expired entries. */
+  void _onPurge();
+
+protected:
+  /** A cache entry. */
+  typedef struct {
+    /** The resolved node, null for negative entries. */
+    NodeItem node;
+    /** If @c false, the entry is a negative one. */
+    bool reachable;
+    /** Time of expiry. */
+    QDateTime expires;
+  } Entry;
+
+protected:
+  /** The node used for the DHT searches. */
+  Node &_node;
+  /** TTL of positive entries in seconds. */
+  size_t _ttl;
+  /** TTL of negative entries in seconds. */
+  size_t _negativeTTL;
+  /** The cache table. */
+  QHash<Identifier, Entry> _entries;
+  /** Pending searches. */
+  QHash<Identifier, StationResolveQuery *> _pending;
+  /** Timer to purge expired entries. */
+  QTimer _purgeTimer;
+};
+
+#endif // RESOLVECACHE_HH
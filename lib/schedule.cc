@@ -2,11 +2,20 @@
 #include "station.hh"
 #include "stationlist.hh"
 #include "query.hh"
+#include "queryscheduler.hh"
+#include "binarycodec.hh"
+#include "scheduletrigger.hh"
+#include "scheduleselector.hh"
+#include "recordingplanner.hh"
+#include "receiver.hh"
+#include "sidstore.hh"
 #include <ovlnet/logger.hh>
 
 #include <QJsonObject>
 #include <QTimeZone>
 #include <QFile>
+#include <QFileInfo>
+#include <QDir>
 #include <QJsonDocument>
 #include <QJsonArray>
 #include <QFont>
@@ -32,20 +41,24 @@ dayOfWeekName(int dow) {
  * Implementation of ScheduledEvent interface
  * ********************************************************************************************* */
 ScheduledEvent::ScheduledEvent()
-  : _type(SINGLE), _first()
+  : _type(SINGLE), _first(), _duration(SCHEDULE_DEFAULT_DURATION)
 {
   // pass...
 }
 
-ScheduledEvent::ScheduledEvent(const QDateTime &first, Type type)
-  : _type(type), _first(first)
+ScheduledEvent::ScheduledEvent(const QDateTime &first, Type type, int duration)
+  : _type(type), _first(first), _duration(duration)
 {
   // pass...
 }
 
 ScheduledEvent::ScheduledEvent(const QJsonObject &obj)
-  : _type(SINGLE), _first()
+  : _type(SINGLE), _first(), _duration(SCHEDULE_DEFAULT_DURATION)
 {
+  // Duration is optional
+  if (obj.value("duration").toInt() > 0) {
+    _duration = obj.value("duration").toInt();
+  }
   // Check if first event date-time is present
   if (! obj.contains("first")) { return; }
   // Read date-time as UTC
@@ -70,8 +83,22 @@ ScheduledEvent::ScheduledEvent(const QJsonObject &obj)
   }
 }
 
+ScheduledEvent::ScheduledEvent(BinaryReader &record)
+  : _type(SINGLE), _first(), _duration(SCHEDULE_DEFAULT_DURATION)
+{
+  uint8_t type; QDateTime first; uint32_t duration;
+  if (! (record.readUInt8(type) && record.readDateTime(first))) { return; }
+  if (type > WEEKLY) { return; }
+  _type = Type(type);
+  _first = first.toLocalTime();
+  // Duration is optional
+  if (record.readUInt32(duration) && (duration > 0)) {
+    _duration = duration;
+  }
+}
+
 ScheduledEvent::ScheduledEvent(const ScheduledEvent &other)
-  : _type(other._type), _first(other._first)
+  : _type(other._type), _first(other._first), _duration(other._duration)
 {
   // pass...
 }
@@ -80,6 +107,7 @@ ScheduledEvent &
 ScheduledEvent::operator =(const ScheduledEvent &other) {
   _type = other._type;
   _first = other._first;
+  _duration = other._duration;
   return *this;
 }
 
@@ -123,12 +151,23 @@ ScheduledEvent::first() const {
   return _first;
 }
 
+int
+ScheduledEvent::duration() const {
+  return _duration;
+}
+
+void
+ScheduledEvent::setDuration(int duration) {
+  _duration = duration;
+}
+
 double
 ScheduledEvent::cost() const {
+  double scale = double(_duration)/SCHEDULE_DEFAULT_DURATION;
   switch (_type) {
-    case DAILY: return 28.;
-    case WEEKLY: return 4;
-    case SINGLE: return 1;
+    case DAILY: return 28.*scale;
+    case WEEKLY: return 4*scale;
+    case SINGLE: return 1*scale;
   }
   return 0.;
 }
@@ -142,9 +181,19 @@ ScheduledEvent::toJson() const {
     case DAILY: obj.insert("repeat", QString("daily")); break;
     case WEEKLY: obj.insert("repeat", QString("weekly")); break;
   }
+  obj.insert("duration", _duration);
   return obj;
 }
 
+void
+ScheduledEvent::toBinary(BinaryWriter &writer) const {
+  writer.beginRecord();
+  writer.writeUInt8(_type);
+  writer.writeDateTime(_first);
+  writer.writeUInt32(_duration);
+  writer.endRecord();
+}
+
 bool
 ScheduledEvent::passed(const QDateTime &timestamp) const {
   if (_type != SINGLE)
@@ -216,18 +265,21 @@ Schedule::data(const QModelIndex &index, int role) const {
 
   if (Qt::DisplayRole == role) {
     if (ScheduledEvent::SINGLE == evt.type()) {
-      return tr("Once on %1 at %2")
+      return tr("Once on %1 at %2 for %3 min")
           .arg(evt.first().date().toString())
-          .arg(evt.first().time().toString());
+          .arg(evt.first().time().toString())
+          .arg(evt.duration()/60.);
     } else if (ScheduledEvent::DAILY == evt.type()) {
-      return tr("Daily at %1 starting on %2")
+      return tr("Daily at %1 for %3 min starting on %2")
           .arg(evt.first().time().toString())
-          .arg(evt.first().date().toString());
+          .arg(evt.first().date().toString())
+          .arg(evt.duration()/60.);
     } else if (ScheduledEvent::WEEKLY == evt.type()) {
-      return tr("Every %1 at %2 starting on %3")
+      return tr("Every %1 at %2 for %4 min starting on %3")
           .arg(dayOfWeekName(evt.first().date().dayOfWeek()))
           .arg(evt.first().time().toString())
-          .arg(evt.first().date().toString());
+          .arg(evt.first().date().toString())
+          .arg(evt.duration()/60.);
     }
 
     return QVariant("Invalid.");
@@ -249,7 +301,7 @@ Schedule::headerData(int section, Qt::Orientation orientation, int role) const {
  * Implementation of LocalSchedule
  * ********************************************************************************************* */
 LocalSchedule::LocalSchedule(const QString &path, QObject *parent)
-  : Schedule(parent), _filename(path), _nextEvent(), _timer()
+  : Schedule(parent), _filename(path), _events()
 {
   logDebug() << "Load local schedule from file " << _filename << ".";
   QFile file(_filename);
@@ -289,14 +341,7 @@ LocalSchedule::LocalSchedule(const QString &path, QObject *parent)
     size_t idx = _events.size();
     beginInsertRows(QModelIndex(), idx, idx);
     _events.push_back(evt);
-    _updateSchedule();
     endInsertRows();
-
-    _timer.setInterval(750);
-    _timer.setSingleShot(false);
-
-    connect(&_timer, SIGNAL(timeout()), this, SLOT(checkSchedule()));
-    _timer.start();
   }
 }
 
@@ -332,13 +377,12 @@ LocalSchedule::numEvents() const {
 
 size_t
 LocalSchedule::add(const ScheduledEvent &event) {
-  for (int i=0; i<_events.size(); i++) {
-    if (_events[i] == event) { return i; }
+  if (contains(event)) {
+    return _events.indexOf(event);
   }
   size_t idx = _events.size();
   beginInsertRows(QModelIndex(), idx, idx);
   _events.push_back(event);
-  _updateSchedule();
   endInsertRows();
   emit updated();
   return idx;
@@ -369,26 +413,11 @@ LocalSchedule::removeScheduledEvent(size_t idx) {
   if (int(idx) < _events.size()) {
     beginRemoveRows(QModelIndex(), idx, idx);
     _events.remove(idx, 1);
-    _updateSchedule();
     endRemoveRows();
     emit updated();
   }
 }
 
-void
-LocalSchedule::_updateSchedule() {
-  _nextEvent = this->next(QDateTime::currentDateTime());
-}
-
-void
-LocalSchedule::checkSchedule() {
-  if (_nextEvent.isValid() && (_nextEvent == QDateTime::currentDateTime())) {
-    _updateSchedule();
-    // Start a recording of 10 min
-    emit startRecording(1000*60*10);
-  }
-}
-
 
 /* ********************************************************************************************* *
  * Implementation of RemoteScheduledEvent
@@ -399,8 +428,9 @@ RemoteScheduledEvent::RemoteScheduledEvent()
   // pass...
 }
 
-RemoteScheduledEvent::RemoteScheduledEvent(const Identifier &node, const QDateTime &first, ScheduledEvent::Type type)
-  : ScheduledEvent(first, type), _nodes()
+RemoteScheduledEvent::RemoteScheduledEvent(const Identifier &node, const QDateTime &first,
+                                           ScheduledEvent::Type type, int duration)
+  : ScheduledEvent(first, type, duration), _nodes()
 {
   _nodes.insert(node);
 }
@@ -439,15 +469,22 @@ RemoteScheduledEvent::addNode(const Identifier &id) {
   _nodes.insert(id);
 }
 
+void
+RemoteScheduledEvent::removeNode(const Identifier &id) {
+  _nodes.remove(id);
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of RemoteSchedule
  * ********************************************************************************************* */
 RemoteSchedule::RemoteSchedule(Station &station, QObject *parent)
-  : Schedule(parent), _station(station)
+  : Schedule(parent), _station(station), _events(), _index(), _nodeEvents()
 {
   connect(&_station.stations(), SIGNAL(stationUpdated(StationItem)),
           this, SLOT(_onUpdateStationSchedule(StationItem)));
+  connect(&_station.stations(), SIGNAL(stationRemoved(Identifier)),
+          this, SLOT(_onStationRemoved(Identifier)));
 }
 
 size_t
@@ -460,24 +497,84 @@ RemoteSchedule::scheduledEvent(size_t i) const {
   return _events[i];
 }
 
+bool
+RemoteSchedule::contains(const ScheduledEvent &event) const {
+  return _index.contains(event);
+}
+
+int
+RemoteSchedule::indexOf(const ScheduledEvent &event) const {
+  return _index.value(event, -1);
+}
+
 void
 RemoteSchedule::add(const Identifier &node, const ScheduledEvent &obj) {
-  RemoteScheduledEvent evt(node, obj);
-  if (! evt.isValid()) { return; }
+  if (_add(node, obj)) {
+    emit updated();
+  }
+}
 
-  for (int i=0; i<_events.size(); i++) {
-    if (_events[i] == evt) {
-      emit dataChanged(index(i,0), index(i,0));
-      _events[i].addNode(node);
-      emit updated();
-      return;
-    }
+void
+RemoteSchedule::remove(const Identifier &node, const ScheduledEvent &obj) {
+  if (_remove(node, obj)) {
+    emit updated();
+  }
+}
+
+bool
+RemoteSchedule::_add(const Identifier &node, const ScheduledEvent &obj) {
+  if (! obj.isValid()) { return false; }
+
+  QHash<ScheduledEvent, int>::const_iterator item = _index.find(obj);
+  if (_index.end() != item) {
+    int i = item.value();
+    if (_events[i].nodes().contains(node)) { return false; }
+    _events[i].addNode(node);
+    _nodeEvents[node].insert(obj);
+    emit dataChanged(index(i,0), index(i,0));
+    emit eventChanged(_events[i]);
+    return true;
   }
 
   beginInsertRows(QModelIndex(), _events.size(), _events.size());
-  _events.append(evt);
+  _index.insert(obj, _events.size());
+  _events.append(RemoteScheduledEvent(node, obj));
+  _nodeEvents[node].insert(obj);
   endInsertRows();
-  emit updated();
+  emit eventAdded(obj);
+  return true;
+}
+
+bool
+RemoteSchedule::_remove(const Identifier &node, const ScheduledEvent &obj) {
+  QHash<ScheduledEvent, int>::const_iterator item = _index.find(obj);
+  if (_index.end() == item) { return false; }
+  int i = item.value();
+  if (! _events[i].nodes().contains(node)) { return false; }
+
+  _events[i].removeNode(node);
+  _nodeEvents[node].remove(obj);
+  if (_nodeEvents[node].isEmpty()) {
+    _nodeEvents.remove(node);
+  }
+  if (_events[i].numNodes()) {
+    emit dataChanged(index(i,0), index(i,0));
+    emit eventChanged(_events[i]);
+    return true;
+  }
+
+  // No node left -> remove event
+  ScheduledEvent evt(_events[i]);
+  beginRemoveRows(QModelIndex(), i, i);
+  _events.remove(i);
+  _index.remove(evt);
+  // Update rows of all following events
+  for (int j=i; j<_events.size(); j++) {
+    _index[_events[j]] = j;
+  }
+  endRemoveRows();
+  emit eventRemoved(evt);
+  return true;
 }
 
 size_t
@@ -485,10 +582,16 @@ RemoteSchedule::numNodes(size_t i) const {
   return _events[i].numNodes();
 }
 
+const QSet<Identifier> &
+RemoteSchedule::nodes(size_t i) const {
+  return _events[i].nodes();
+}
+
 void
 RemoteSchedule::_onUpdateStationSchedule(const StationItem &station) {
   // logDebug() << "Station " << station.id() << " updated -> Update schedule.";
-  StationScheduleQuery *query = new StationScheduleQuery(_station, station.node());
+  StationScheduleQuery *query = _station.queries().submit(
+        new StationScheduleQuery(_station, station.node()), QueryScheduler::BACKGROUND);
   connect(query, SIGNAL(stationScheduleReceived(Identifier,QList<ScheduledEvent>)),
           this, SLOT(_onStationScheduleReceived(Identifier,QList<ScheduledEvent>)));
 }
@@ -496,36 +599,75 @@ RemoteSchedule::_onUpdateStationSchedule(const StationItem &station) {
 void
 RemoteSchedule::_onStationScheduleReceived(const Identifier &remote, const QList<ScheduledEvent> &events) {
   // logDebug() << "Station schedule received...";
+  // Only apply the difference to the last schedule received from the station
+  QSet<ScheduledEvent> received;
   QList<ScheduledEvent>::const_iterator evt = events.begin();
   for (; evt != events.end(); evt++) {
-    this->add(remote, *evt);
+    if (evt->isValid()) { received.insert(*evt); }
+  }
+  QSet<ScheduledEvent> known = _nodeEvents.value(remote);
+  bool changed = false;
+  foreach (ScheduledEvent event, known) {
+    if (! received.contains(event)) { changed |= _remove(remote, event); }
+  }
+  foreach (ScheduledEvent event, received) {
+    if (! known.contains(event)) { changed |= _add(remote, event); }
+  }
+  if (changed) {
+    emit updated();
   }
 }
 
+void
+RemoteSchedule::_onStationRemoved(const Identifier &remote) {
+  _onStationScheduleReceived(remote, QList<ScheduledEvent>());
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of MergedSchedule
  * ********************************************************************************************* */
-bool eventWeightLessThan(const QPair<ScheduledEvent, size_t> &a, const QPair<ScheduledEvent, size_t> &b) {
-  // Returns the weight for the events that is (cost / # nodes )
-  return (a.first.cost()/a.second) < (b.first.cost()/b.second);
-}
-
 MergedSchedule::MergedSchedule(const QString &path, Station &station, double maxCosts, QObject *parent)
-  : Schedule(parent), _maxCosts(maxCosts), _local(path), _remote(station)
+  : Schedule(parent), _station(station), _maxCosts(maxCosts), _local(path), _remote(station),
+    _selector(new ScheduleSelector()), _planner(0), _mergedRemoteEvents(), _trigger(0)
 {
-  // Connect to changes in the local and remote schedules
-  connect(&_local, SIGNAL(updated()), this, SLOT(_onScheduleUpdate()));
-  connect(&_remote, SIGNAL(updated()), this, SLOT(_onScheduleUpdate()));
-
-  // Configure check timer
-  _timer.setInterval(750);
-  _timer.setSingleShot(false);
-  // check for event regularily
-  connect(&_timer, SIGNAL(timeout()), this, SLOT(checkSchedule()));
-
-  _onScheduleUpdate();
-  _timer.start();
+  // Budgets are configured next to the schedule
+  _planner = new RecordingPlanner(QFileInfo(path).absoluteDir().filePath("planner.json"),
+                                  station.datasets().path(), station.receiver().dataRate());
+
+  // Start recordings at the precise start times of the merged events
+  _trigger = new ScheduleTrigger(*this, this);
+  connect(_trigger, SIGNAL(triggered(QDateTime,int)), this, SLOT(_onTriggered(QDateTime,int)));
+
+  // Forward row changes of the local schedule, these are the first rows of the merged schedule
+  connect(&_local, SIGNAL(rowsAboutToBeInserted(QModelIndex,int,int)),
+          this, SLOT(_onLocalRowsAboutToBeInserted(QModelIndex,int,int)));
+  connect(&_local, SIGNAL(rowsInserted(QModelIndex,int,int)),
+          this, SLOT(_onLocalRowsInserted(QModelIndex,int,int)));
+  connect(&_local, SIGNAL(rowsAboutToBeRemoved(QModelIndex,int,int)),
+          this, SLOT(_onLocalRowsAboutToBeRemoved(QModelIndex,int,int)));
+  connect(&_local, SIGNAL(rowsRemoved(QModelIndex,int,int)),
+          this, SLOT(_onLocalRowsRemoved(QModelIndex,int,int)));
+  // Track the participants of the remote events
+  connect(&_remote, SIGNAL(eventAdded(ScheduledEvent)), this, SLOT(_onRemoteEventAdded(ScheduledEvent)));
+  connect(&_remote, SIGNAL(eventChanged(ScheduledEvent)),
+          this, SLOT(_onRemoteEventChanged(ScheduledEvent)));
+  connect(&_remote, SIGNAL(eventRemoved(ScheduledEvent)),
+          this, SLOT(_onRemoteEventRemoved(ScheduledEvent)));
+  // Reselect remote events once the local or remote schedule changed
+  connect(&_local, SIGNAL(updated()), this, SLOT(_reselect()));
+  connect(&_remote, SIGNAL(updated()), this, SLOT(_reselect()));
+  // ... or the free disk space changed
+  connect(&station.datasets(), SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(_reselect()));
+  connect(&station.datasets(), SIGNAL(modelReset()), this, SLOT(_reselect()));
+
+  _trigger->rearm();
+  _reselect();
+}
+
+MergedSchedule::~MergedSchedule() {
+  delete _selector;
+  delete _planner;
 }
 
 size_t
@@ -541,6 +683,18 @@ MergedSchedule::scheduledEvent(size_t idx) const {
   return _mergedRemoteEvents[idx-_local.numEvents()];
 }
 
+bool
+MergedSchedule::contains(const ScheduledEvent &event) const {
+  return _trigger->contains(event);
+}
+
+QDateTime
+MergedSchedule::next(const QDateTime &now) const {
+  QDateTime next;
+  if (_trigger->next(now, next)) { return next; }
+  return Schedule::next(now);
+}
+
 LocalSchedule &
 MergedSchedule::local() {
   return _local;
@@ -551,51 +705,150 @@ MergedSchedule::remote() {
   return _remote;
 }
 
+const ScheduleTrigger &
+MergedSchedule::trigger() const {
+  return *_trigger;
+}
+
+const RecordingPlanner &
+MergedSchedule::planner() const {
+  return *_planner;
+}
+
+void
+MergedSchedule::_onTriggered(const QDateTime &when, int duration) {
+  emit startRecording(1000.*duration);
+}
+
+void
+MergedSchedule::_updateCandidate(const ScheduledEvent &event) {
+  int idx = _remote.indexOf(event);
+  if (idx < 0) {
+    _selector->remove(event);
+    return;
+  }
+  // This station participates in all joined events
+  QList<ScheduleSelector::Participant> participants;
+  participants.append(ScheduleSelector::Participant(_station.id(), _station.location()));
+  foreach (Identifier node, _remote.nodes(idx)) {
+    Location location;
+    if (_station.stations().hasStation(node)) {
+      location = _station.stations().station(node).location();
+    }
+    participants.append(ScheduleSelector::Participant(node, location));
+  }
+  _selector->update(event, participants);
+}
+
+void
+MergedSchedule::_onRemoteEventAdded(const ScheduledEvent &event) {
+  _updateCandidate(event);
+}
+
+void
+MergedSchedule::_onRemoteEventChanged(const ScheduledEvent &event) {
+  _updateCandidate(event);
+}
+
+void
+MergedSchedule::_onRemoteEventRemoved(const ScheduledEvent &event) {
+  _selector->remove(event);
+}
+
+void
+MergedSchedule::_onLocalRowsAboutToBeInserted(const QModelIndex &parent, int first, int last) {
+  beginInsertRows(QModelIndex(), first, last);
+}
+
+void
+MergedSchedule::_onLocalRowsInserted(const QModelIndex &parent, int first, int last) {
+  for (int i=first; i<=last; i++) {
+    _trigger->add(_local.scheduledEvent(i));
+  }
+  endInsertRows();
+}
+
 void
-MergedSchedule::checkSchedule() {
-  if (_nextEvent.isValid() && (_nextEvent == QDateTime::currentDateTime())) {
-    _updateSchedule();
-    // Start a recording of 10 min
-    emit startRecording(1000*60*10);
+MergedSchedule::_onLocalRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last) {
+  for (int i=first; i<=last; i++) {
+    _trigger->remove(_local.scheduledEvent(i));
   }
+  beginRemoveRows(QModelIndex(), first, last);
 }
 
 void
-MergedSchedule::_updateSchedule() {
-  _nextEvent = this->next(QDateTime::currentDateTime());
+MergedSchedule::_onLocalRowsRemoved(const QModelIndex &parent, int first, int last) {
+  endRemoveRows();
 }
 
 void
-MergedSchedule::_onScheduleUpdate() {
-  beginResetModel();
+MergedSchedule::_reselect() {
+  QDateTime now = QDateTime::currentDateTime();
   double cost = _maxCosts;
   // Add consts from local events
+  QList<ScheduledEvent> local;
   for (size_t i=0; i<_local.numEvents(); i++) {
     cost -= _local.scheduledEvent(i).cost();
+    local.append(_local.scheduledEvent(i));
   }
-  _mergedRemoteEvents.clear();
-  // If some cost margin left for remote events add some cheap enough but worth it
+  // If some cost margin left for remote events, join those adding most to the coverage of the
+  // network given the local events.
+  QList<ScheduledEvent> candidates;
   if (cost > 0) {
-    // Filter remote events by cost
-    QVector< QPair<ScheduledEvent, size_t> > remEvt; remEvt.reserve(_remote.numEvents());
-    for (size_t i=0; i<_remote.numEvents(); i++) {
-      // Ignore all events to expesive or already on local schedule or passed
-      if ( (_remote.scheduledEvent(i).cost() < cost)
-           && !_local.contains(_remote.scheduledEvent(i))
-           && !_remote.scheduledEvent(i).passed(QDateTime::currentDateTime()))
-        remEvt.append(QPair<ScheduledEvent, size_t>(_remote.scheduledEvent(i), _remote.numNodes(i)));
+    candidates = _selector->select(cost, local, now);
+  }
+  // Cap or reject events exceeding the disk or upload budgets, in order of their selection
+  _planner->begin(local, now, _station.sid().diskRate());
+  QList<ScheduledEvent> selection;
+  QHash<ScheduledEvent, ScheduledEvent> selected;
+  foreach (ScheduledEvent evt, candidates) {
+    int idx = _remote.indexOf(evt);
+    if (_planner->accept(evt, (idx < 0) ? 0 : _remote.numNodes(idx))) {
+      selection.append(evt);
+      selected.insert(evt, evt);
     }
-    // sort remote events by weight
-    qStableSort(remEvt.begin(), remEvt.end(), &eventWeightLessThan);
-    // Add as many events as allowed by the cost margin left
-    for (int i=0; i<remEvt.size(); i++) {
-      if (cost > remEvt[i].first.cost()) {
-        _mergedRemoteEvents.append(remEvt[i].first);
-        cost -= remEvt[i].first.cost();
+  }
+
+  // Remove rows of events not selected anymore
+  bool changed = false;
+  QSet<ScheduledEvent> merged;
+  for (int i=_mergedRemoteEvents.size()-1; i>=0; i--) {
+    if (selected.contains(_mergedRemoteEvents[i])) {
+      merged.insert(_mergedRemoteEvents[i]);
+      // Update duration if capped differently
+      const ScheduledEvent &evt = selected[_mergedRemoteEvents[i]];
+      if (evt.duration() != _mergedRemoteEvents[i].duration()) {
+        _mergedRemoteEvents[i] = evt;
+        _trigger->remove(evt);
+        _trigger->add(evt);
+        int row = _local.numEvents()+i;
+        emit dataChanged(index(row, 0), index(row, 0));
+        changed = true;
       }
+      continue;
     }
+    int row = _local.numEvents()+i;
+    beginRemoveRows(QModelIndex(), row, row);
+    ScheduledEvent evt(_mergedRemoteEvents[i]);
+    _mergedRemoteEvents.remove(i);
+    endRemoveRows();
+    if (! _local.contains(evt)) {
+      _trigger->remove(evt);
+    }
+    changed = true;
+  }
+  // Append rows of newly selected events
+  foreach (ScheduledEvent evt, selection) {
+    if (merged.contains(evt)) { continue; }
+    int row = numEvents();
+    beginInsertRows(QModelIndex(), row, row);
+    _mergedRemoteEvents.append(evt);
+    endInsertRows();
+    _trigger->add(evt);
+    changed = true;
+  }
+
+  if (changed) {
+    emit updated();
   }
-  endResetModel();
-  // Update next event
-  _updateSchedule();
 }
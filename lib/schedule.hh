@@ -4,13 +4,23 @@
 #include <QAbstractListModel>
 #include <QDateTime>
 #include <QVector>
-#include <QTimer>
+#include <QHash>
+#include <QSet>
 
 #include <ovlnet/buckets.hh>
 
 
+/** Default duration of a recording in seconds. */
+#define SCHEDULE_DEFAULT_DURATION 600
+
+
 class Station;
+class ScheduleTrigger;
+class ScheduleSelector;
+class RecordingPlanner;
 class StationItem;
+class BinaryReader;
+class BinaryWriter;
 
 
 /** Represents a single or repeating event. */
@@ -27,12 +37,14 @@ public:
 public:
   /** Empty constructor. */
   ScheduledEvent();
-  /** Constructor for an event at the specified date and time. */
-  ScheduledEvent(const QDateTime &first, Type=SINGLE);
+  /** Constructor for an event at the specified date and time, lasting @c duration seconds. */
+  ScheduledEvent(const QDateTime &first, Type=SINGLE, int duration=SCHEDULE_DEFAULT_DURATION);
   /** Copy constructor. */
   ScheduledEvent(const ScheduledEvent &other);
   /** Constructs an event from JSON. */
   ScheduledEvent(const QJsonObject &obj);
+  /** Constructs an event from a binary record. */
+  ScheduledEvent(BinaryReader &record);
   /** Assignment operator. */
   ScheduledEvent &operator=(const ScheduledEvent &other);
 
@@ -46,16 +58,23 @@ public:
   Type type() const;
   /** Returns the local date and time of the first occurence of the event. */
   const QDateTime &first() const;
+  /** Returns the duration of the recording in seconds. */
+  int duration() const;
+  /** Sets the duration of the recording in seconds. */
+  void setDuration(int duration);
   /** Returns the cost associated with the event.
    * Costs are used for the heuristic to determine which remote events are selected to be included
-   * in the schedule. The costs of an event is determined by its type.
-   * That is, a single event has a cost of 1, weekly events have a cost of 4 and daily event costs
-   * 28. */
+   * in the schedule. The costs of an event is determined by its type and duration.
+   * That is, a single event of the default duration has a cost of 1, weekly events have a cost of 4
+   * and daily event costs 28. */
   double cost() const;
 
   /** Serializes the event into a JSON object. */
   QJsonObject toJson() const;
+  /** Serializes the event into a binary record. */
+  void toBinary(BinaryWriter &writer) const;
 
+  /** Compares type and first occurrence, the duration is not part of the identity of an event. */
   bool operator==(const ScheduledEvent &other) const;
   bool operator!=(const ScheduledEvent &other) const;
 
@@ -67,8 +86,15 @@ protected:
   Type _type;
   /** Date and time of the first event. */
   QDateTime _first;
+  /** Duration in seconds. */
+  int _duration;
 };
 
+/** Hash of an event, consistent with @c ScheduledEvent::operator==. */
+inline uint qHash(const ScheduledEvent &event, uint seed=0) {
+  return qHash(event.first().toMSecsSinceEpoch(), seed) ^ uint(event.type());
+}
+
 
 class Schedule: public QAbstractListModel
 {
@@ -115,20 +141,9 @@ public:
 
   bool save();
 
-public slots:
-  void checkSchedule();
-
-signals:
-  void startRecording(double mSec);
-
-protected slots:
-  void _updateSchedule();
-
 protected:
   QString _filename;
-  QDateTime _nextEvent;
   QVector<ScheduledEvent> _events;
-  QTimer _timer;
 };
 
 
@@ -138,7 +153,8 @@ public:
   /** Empty constructor. */
   RemoteScheduledEvent();
   /** Constructor for an event at the specified date and time. */
-  RemoteScheduledEvent(const Identifier &node, const QDateTime &first, ScheduledEvent::Type=SINGLE);
+  RemoteScheduledEvent(const Identifier &node, const QDateTime &first, ScheduledEvent::Type=SINGLE,
+                       int duration=SCHEDULE_DEFAULT_DURATION);
   /** Copy constructor. */
   RemoteScheduledEvent(const RemoteScheduledEvent &other);
   RemoteScheduledEvent(const Identifier &node, const ScheduledEvent &obj);
@@ -148,6 +164,7 @@ public:
   size_t numNodes() const;
   const QSet<Identifier> &nodes() const;
   void addNode(const Identifier &id);
+  void removeNode(const Identifier &id);
 
 protected:
   QSet<Identifier> _nodes;
@@ -164,16 +181,43 @@ public:
   size_t numEvents() const;
   const ScheduledEvent &scheduledEvent(size_t i) const;
 
+  bool contains(const ScheduledEvent &event) const;
+  /** Returns the row of the event or -1 if the event is unknown. */
+  int indexOf(const ScheduledEvent &event) const;
+
   void add(const Identifier &node, const ScheduledEvent &obj);
+  /** Removes the node from the event, the event is removed once no node is left. */
+  void remove(const Identifier &node, const ScheduledEvent &obj);
   size_t numNodes(size_t i) const;
+  /** Returns the nodes participating in the specified event. */
+  const QSet<Identifier> &nodes(size_t i) const;
+
+signals:
+  /** Gets emitted if an event was added. */
+  void eventAdded(const ScheduledEvent &event);
+  /** Gets emitted if the number of nodes of an event changed. */
+  void eventChanged(const ScheduledEvent &event);
+  /** Gets emitted if an event was removed. */
+  void eventRemoved(const ScheduledEvent &event);
+
+protected:
+  /** Adds the node to the event, returns @c true if something changed. */
+  bool _add(const Identifier &node, const ScheduledEvent &obj);
+  /** Removes the node from the event, returns @c true if something changed. */
+  bool _remove(const Identifier &node, const ScheduledEvent &obj);
 
 protected slots:
   void _onUpdateStationSchedule(const StationItem &station);
   void _onStationScheduleReceived(const Identifier &remote, const QList<ScheduledEvent> &events);
+  void _onStationRemoved(const Identifier &remote);
 
 protected:
   Station &_station;
   QVector<RemoteScheduledEvent> _events;
+  /** Maps events to their row in @c _events. */
+  QHash<ScheduledEvent, int> _index;
+  /** The last schedule received from each node. */
+  QHash<Identifier, QSet<ScheduledEvent> > _nodeEvents;
 };
 
 
@@ -183,6 +227,7 @@ class MergedSchedule: public Schedule
 
 public:
   explicit MergedSchedule(const QString &path, Station &station, double maxCosts=28, QObject *parent=0);
+  virtual ~MergedSchedule();
 
   size_t numEvents() const;
   const ScheduledEvent &scheduledEvent(size_t idx) const;
@@ -190,23 +235,46 @@ public:
   LocalSchedule &local();
   RemoteSchedule &remote();
 
-public slots:
-  void checkSchedule();
+  bool contains(const ScheduledEvent &event) const;
+  QDateTime next(const QDateTime &now) const;
+
+  /** Returns the trigger of the scheduled events. */
+  const ScheduleTrigger &trigger() const;
+  /** Returns the planner of disk and bandwidth usage. */
+  const RecordingPlanner &planner() const;
 
 signals:
   void startRecording(double mSec);
 
+protected:
+  /** Updates the participants of a remote event in the selector. */
+  void _updateCandidate(const ScheduledEvent &event);
+
 protected slots:
-  void _updateSchedule();
-  void _onScheduleUpdate();
+  /** Selects the remote events to join and updates the rows that changed. */
+  void _reselect();
+  void _onRemoteEventAdded(const ScheduledEvent &event);
+  void _onRemoteEventChanged(const ScheduledEvent &event);
+  void _onRemoteEventRemoved(const ScheduledEvent &event);
+  void _onLocalRowsAboutToBeInserted(const QModelIndex &parent, int first, int last);
+  void _onLocalRowsInserted(const QModelIndex &parent, int first, int last);
+  void _onLocalRowsAboutToBeRemoved(const QModelIndex &parent, int first, int last);
+  void _onLocalRowsRemoved(const QModelIndex &parent, int first, int last);
+  /** Gets called at the start time of an event. */
+  void _onTriggered(const QDateTime &when, int duration);
 
 protected:
+  Station &_station;
   double _maxCosts;
   LocalSchedule _local;
   RemoteSchedule _remote;
+  /** Selects the remote events maximizing the network coverage. */
+  ScheduleSelector *_selector;
+  /** Caps or rejects remote events exceeding the disk or bandwidth budgets. */
+  RecordingPlanner *_planner;
   QVector<ScheduledEvent> _mergedRemoteEvents;
-  QDateTime _nextEvent;
-  QTimer _timer;
+  /** Triggers the events at their start times. */
+  ScheduleTrigger *_trigger;
 };
 
 #endif // SCHEDULE_HH
@@ -0,0 +1,253 @@
+#include "scheduleselector.hh"
+#include <queue>
+#include <algorithm>
+#include <cmath>
+
+/** Number of bits of the element index, the kind is stored above. */
+#define SELECTOR_KIND_SHIFT 24
+/** Number of baseline length classes, doubling from 200km. */
+#define SELECTOR_LENGTH_CLASSES 7
+/** Number of baseline orientation classes over 180 degrees. */
+#define SELECTOR_ORIENTATION_CLASSES 6
+
+
+/** Upper bound of the gain of a candidate, as used by the lazy greedy search. */
+typedef struct {
+  /** Gain or gain per cost, used for ranking. */
+  double key;
+  /** The gain. */
+  double gain;
+  /** Index of the candidate. */
+  int index;
+  /** Selection round in which the bound was computed. */
+  int round;
+} SelectorBound;
+
+inline bool
+operator<(const SelectorBound &a, const SelectorBound &b) {
+  // Prefer earlier candidates on ties to keep the selection stable
+  if (a.key == b.key) { return a.index > b.index; }
+  return a.key < b.key;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of ScheduleSelector
+ * ********************************************************************************************* */
+ScheduleSelector::ScheduleSelector(double stationWeight, double baselineWeight, double timeWeight)
+  : _stationWeight(stationWeight), _baselineWeight(baselineWeight), _timeWeight(timeWeight),
+    _events(), _eventElements(), _index(), _stations()
+{
+  // pass...
+}
+
+void
+ScheduleSelector::update(const ScheduledEvent &event, const QList<Participant> &participants) {
+  if (! event.isValid()) { return; }
+
+  QVector<int> elements;
+  // Participating stations
+  foreach (Participant participant, participants) {
+    if (! _stations.contains(participant.first)) {
+      _stations.insert(participant.first, _stations.size());
+    }
+    elements.append((STATION << SELECTOR_KIND_SHIFT) | _stations[participant.first]);
+  }
+  // Classes of the baselines between participating stations
+  for (int i=0; i<participants.size(); i++) {
+    const Location &a = participants[i].second;
+    if (a.isNull()) { continue; }
+    for (int j=i+1; j<participants.size(); j++) {
+      const Location &b = participants[j].second;
+      if (b.isNull()) { continue; }
+      double dist = a.arcDist(b);
+      int length = std::min(SELECTOR_LENGTH_CLASSES-1,
+                            int(std::log2(std::max(dist, 100.)/100.)));
+      int orientation = std::min(SELECTOR_ORIENTATION_CLASSES-1,
+                                 int(std::fmod(a.bearing(b), 180.)*SELECTOR_ORIENTATION_CLASSES/180));
+      elements.append((BASELINE << SELECTOR_KIND_SHIFT)
+                      | (length*SELECTOR_ORIENTATION_CLASSES + orientation));
+    }
+  }
+  // Hours of the week
+  _hours(event, elements);
+  // Remove duplicates
+  std::sort(elements.begin(), elements.end());
+  elements.erase(std::unique(elements.begin(), elements.end()), elements.end());
+
+  if (_index.contains(event)) {
+    int idx = _index[event];
+    _events[idx] = event;
+    _eventElements[idx] = elements;
+  } else {
+    _index.insert(event, _events.size());
+    _events.append(event);
+    _eventElements.append(elements);
+  }
+}
+
+void
+ScheduleSelector::remove(const ScheduledEvent &event) {
+  if (! _index.contains(event)) { return; }
+  // Move last candidate into the gap
+  int idx = _index.take(event), last = _events.size()-1;
+  if (idx != last) {
+    _events[idx] = _events[last];
+    _eventElements[idx] = _eventElements[last];
+    _index[_events[idx]] = idx;
+  }
+  _events.removeLast();
+  _eventElements.removeLast();
+}
+
+bool
+ScheduleSelector::contains(const ScheduledEvent &event) const {
+  return _index.contains(event);
+}
+
+size_t
+ScheduleSelector::numCandidates() const {
+  return _events.size();
+}
+
+QList<ScheduledEvent>
+ScheduleSelector::select(double budget, const QList<ScheduledEvent> &fixed,
+                         const QDateTime &now) const
+{
+  // Elements covered by the fixed events
+  QSet<int> covered;
+  QSet<ScheduledEvent> excluded;
+  foreach (ScheduledEvent event, fixed) {
+    foreach (int element, _elements(event)) {
+      covered.insert(element);
+    }
+    excluded.insert(event);
+  }
+
+  // Filter candidates
+  QVector<int> candidates;
+  for (int i=0; i<_events.size(); i++) {
+    if ((_events[i].cost() < budget) && (! excluded.contains(_events[i]))
+        && (! _events[i].passed(now))) {
+      candidates.append(i);
+    }
+  }
+
+  // Greedy by gain per cost is arbitrarily bad if a single expensive event covers most, hence
+  // also run greedy by gain alone and keep the better selection.
+  double perCostValue, totalValue;
+  QList<int> perCost = _greedy(candidates, budget, covered, true, perCostValue);
+  QList<int> total = _greedy(candidates, budget, covered, false, totalValue);
+
+  QList<ScheduledEvent> result;
+  foreach (int idx, ((totalValue > perCostValue) ? total : perCost)) {
+    result.append(_events[idx]);
+  }
+  return result;
+}
+
+double
+ScheduleSelector::coverage(const QList<ScheduledEvent> &events) const {
+  QSet<int> covered;
+  foreach (ScheduledEvent event, events) {
+    foreach (int element, _elements(event)) {
+      covered.insert(element);
+    }
+  }
+  double value = 0;
+  foreach (int element, covered) {
+    value += _weight(element);
+  }
+  return value;
+}
+
+void
+ScheduleSelector::_hours(const ScheduledEvent &event, QVector<int> &elements) const {
+  QDateTime first = event.first().toUTC();
+  int hour = (first.date().dayOfWeek()-1)*24 + first.time().hour();
+  if (ScheduledEvent::DAILY == event.type()) {
+    for (int day=0; day<7; day++) {
+      elements.append((HOUR << SELECTOR_KIND_SHIFT) | ((hour + day*24) % (7*24)));
+    }
+  } else {
+    elements.append((HOUR << SELECTOR_KIND_SHIFT) | hour);
+  }
+}
+
+QVector<int>
+ScheduleSelector::_elements(const ScheduledEvent &event) const {
+  if (_index.contains(event)) {
+    return _eventElements[_index[event]];
+  }
+  // Unknown events cover their time only
+  QVector<int> elements;
+  _hours(event, elements);
+  return elements;
+}
+
+double
+ScheduleSelector::_weight(int element) const {
+  switch (Kind(element >> SELECTOR_KIND_SHIFT)) {
+    case STATION: return _stationWeight;
+    case BASELINE: return _baselineWeight;
+    case HOUR: return _timeWeight;
+  }
+  return 0;
+}
+
+double
+ScheduleSelector::_gain(const QVector<int> &elements, const QSet<int> &covered) const {
+  double gain = 0;
+  foreach (int element, elements) {
+    if (! covered.contains(element)) {
+      gain += _weight(element);
+    }
+  }
+  return gain;
+}
+
+QList<int>
+ScheduleSelector::_greedy(const QVector<int> &candidates, double budget, const QSet<int> &covered,
+                          bool perCost, double &value) const
+{
+  QSet<int> current(covered);
+  QList<int> selected;
+  value = 0;
+
+  // Initial bounds are the exact gains
+  std::priority_queue<SelectorBound> queue;
+  foreach (int idx, candidates) {
+    double gain = _gain(_eventElements[idx], current);
+    if (gain <= 0) { continue; }
+    SelectorBound bound = { perCost ? gain/_events[idx].cost() : gain, gain, idx, 0 };
+    queue.push(bound);
+  }
+
+  int round = 0;
+  while (! queue.empty()) {
+    SelectorBound top = queue.top(); queue.pop();
+    double cost = _events[top.index].cost();
+    // The budget only shrinks, so this candidate will never fit again
+    if (cost >= budget) { continue; }
+    if (top.round != round) {
+      // Gains only shrink as more is covered (submodularity), hence re-evaluating the top bound
+      // is sufficient. Push it back with its current gain.
+      top.gain = _gain(_eventElements[top.index], current);
+      if (top.gain <= 0) { continue; }
+      top.key = perCost ? top.gain/cost : top.gain;
+      top.round = round;
+      queue.push(top);
+      continue;
+    }
+    // Up-to-date bound on top -> best candidate
+    selected.append(top.index);
+    foreach (int element, _eventElements[top.index]) {
+      current.insert(element);
+    }
+    value += top.gain;
+    budget -= cost;
+    round++;
+  }
+
+  return selected;
+}
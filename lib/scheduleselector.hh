@@ -0,0 +1,91 @@
+#ifndef SCHEDULESELECTOR_HH
+#define SCHEDULESELECTOR_HH
+
+#include <QHash>
+#include <QSet>
+#include <QList>
+#include <QVector>
+#include <QPair>
+#include "schedule.hh"
+#include "location.hh"
+
+
+/** Selects the remote events to join, such that the network coverage is maximized under a cost
+ * budget.
+ * The coverage of a set of events is the weighted number of distinct elements covered by them,
+ * where each event covers
+ * @li the participating stations,
+ * @li the classes (length and orientation) of the baselines between participating stations and
+ * @li the hours of the week it occurs in.
+ * Hence events adding new stations, new baselines and new recording times are preferred over
+ * events covering what is already covered. As this objective is monotone and submodular, it is
+ * maximized by a lazy greedy (CELF) search, once by coverage per cost and once by coverage alone,
+ * keeping the better result.
+ *
+ * The elements of each event are computed once the event is added or updated, such that
+ * a selection only re-runs the greedy search. The class does not access the network or any clock,
+ * hence it can be driven by a simulation. */
+class ScheduleSelector
+{
+public:
+  /** A participating station and its location (may be null if unknown). */
+  typedef QPair<Identifier, Location> Participant;
+
+public:
+  /** Constructor.
+   * @param stationWeight Specifies the weight of each covered station.
+   * @param baselineWeight Specifies the weight of each covered baseline class.
+   * @param timeWeight Specifies the weight of each covered hour of the week. */
+  ScheduleSelector(double stationWeight=1, double baselineWeight=1, double timeWeight=1);
+
+  /** Adds or updates a candidate event with its participants. */
+  void update(const ScheduledEvent &event, const QList<Participant> &participants);
+  /** Removes a candidate event. */
+  void remove(const ScheduledEvent &event);
+  /** Returns @c true if the event is a candidate. */
+  bool contains(const ScheduledEvent &event) const;
+  /** Returns the number of candidates. */
+  size_t numCandidates() const;
+
+  /** Selects candidates with a total cost less than @c budget maximizing the coverage. The events
+   * in @c fixed are always included and not selected again, passed events are ignored. The result
+   * is ordered by the time of selection. */
+  QList<ScheduledEvent> select(double budget, const QList<ScheduledEvent> &fixed,
+                               const QDateTime &now) const;
+  /** Returns the coverage of the given events. */
+  double coverage(const QList<ScheduledEvent> &events) const;
+
+protected:
+  /** Element kinds, stored in the upper bits of an element. */
+  typedef enum {
+    STATION = 0, BASELINE = 1, HOUR = 2
+  } Kind;
+
+  /** Returns the time elements of the event. */
+  void _hours(const ScheduledEvent &event, QVector<int> &elements) const;
+  /** Returns the elements covered by the event. */
+  QVector<int> _elements(const ScheduledEvent &event) const;
+  /** Returns the weight of an element. */
+  double _weight(int element) const;
+  /** Returns the weight of the elements not covered yet. */
+  double _gain(const QVector<int> &elements, const QSet<int> &covered) const;
+  /** Runs the lazy greedy search. If @c perCost is @c true, candidates are ranked by gain per
+   * cost. */
+  QList<int> _greedy(const QVector<int> &candidates, double budget, const QSet<int> &covered,
+                     bool perCost, double &value) const;
+
+protected:
+  double _stationWeight;
+  double _baselineWeight;
+  double _timeWeight;
+  /** Candidate events. */
+  QVector<ScheduledEvent> _events;
+  /** The elements covered by each candidate. */
+  QVector< QVector<int> > _eventElements;
+  /** Maps candidate events to their index. */
+  QHash<ScheduledEvent, int> _index;
+  /** Maps station identifiers to element numbers. */
+  QHash<Identifier, int> _stations;
+};
+
+#endif // SCHEDULESELECTOR_HH
@@ -0,0 +1,233 @@
+#include "scheduletrigger.hh"
+#include <ovlnet/logger.hh>
+#include <algorithm>
+#include <cstdlib>
+
+/** Max. interval of the trigger timer in ms. */
+#define SCHEDULE_TRIGGER_MAX_INTERVAL (3600*1000)
+/** Interval of the clock watchdog in ms. */
+#define SCHEDULE_TRIGGER_WATCHDOG_INTERVAL (10*1000)
+/** Deviation of the system clock in ms considered as a clock jump. */
+#define SCHEDULE_TRIGGER_CLOCK_TOLERANCE 1000
+
+
+/* ********************************************************************************************* *
+ * Implementation of ScheduleTrigger
+ * ********************************************************************************************* */
+ScheduleTrigger::ScheduleTrigger(const Schedule &schedule, QObject *parent)
+  : QObject(parent), _schedule(schedule), _heap(), _live(), _serial(0), _reference(0),
+    _timer(), _watchdog(), _clock(), _clockStart(0),
+    _maxLateness(60*1000), _triggered(0), _missed(0), _jitterSum(0), _jitterMax(0)
+{
+  _timer.setSingleShot(true);
+  _timer.setTimerType(Qt::PreciseTimer);
+  connect(&_timer, SIGNAL(timeout()), this, SLOT(_onTimeout()));
+
+  _watchdog.setInterval(SCHEDULE_TRIGGER_WATCHDOG_INTERVAL);
+  _watchdog.setSingleShot(false);
+  connect(&_watchdog, SIGNAL(timeout()), this, SLOT(_onWatchdog()));
+
+  _resetClock();
+  _watchdog.start();
+}
+
+void
+ScheduleTrigger::rearm() {
+  _live.clear();
+  for (size_t i=0; i<_schedule.numEvents(); i++) {
+    if (! _live.contains(_schedule.scheduledEvent(i))) {
+      _live.insert(_schedule.scheduledEvent(i), ++_serial);
+    }
+  }
+  _rebuild(QDateTime::currentMSecsSinceEpoch());
+}
+
+void
+ScheduleTrigger::add(const ScheduledEvent &event) {
+  if ((! event.isValid()) || _live.contains(event)) { return; }
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  _live.insert(event, ++_serial);
+  // Keep the reference time of the heap, an occurrence between reference and now is simply late
+  _push(event, _serial, std::min(_reference, now));
+  _arm(now);
+}
+
+void
+ScheduleTrigger::remove(const ScheduledEvent &event) {
+  if (! _live.remove(event)) { return; }
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  // Compact heap if it holds mostly removed events
+  if (_heap.size() > (2*_live.size()+16)) {
+    _rebuild(now);
+  } else {
+    _arm(now);
+  }
+}
+
+bool
+ScheduleTrigger::contains(const ScheduledEvent &event) const {
+  return _live.contains(event);
+}
+
+QDateTime
+ScheduleTrigger::next() const {
+  if (_heap.isEmpty()) { return QDateTime(); }
+  return QDateTime::fromMSecsSinceEpoch(_heap.first().due);
+}
+
+bool
+ScheduleTrigger::next(const QDateTime &now, QDateTime &next) const {
+  qint64 t = now.toMSecsSinceEpoch();
+  if (t < _reference) { return false; }
+  if (_heap.isEmpty()) {
+    next = QDateTime();
+    return true;
+  }
+  if (t > _heap.first().due) { return false; }
+  next = QDateTime::fromMSecsSinceEpoch(_heap.first().due);
+  return true;
+}
+
+size_t
+ScheduleTrigger::numPending() const {
+  return _live.size();
+}
+
+void
+ScheduleTrigger::setMaxLateness(qint64 ms) {
+  _maxLateness = ms;
+}
+
+size_t
+ScheduleTrigger::numTriggered() const {
+  return _triggered;
+}
+
+size_t
+ScheduleTrigger::numMissed() const {
+  return _missed;
+}
+
+double
+ScheduleTrigger::meanJitter() const {
+  if (0 == _triggered) { return 0; }
+  return double(_jitterSum)/_triggered;
+}
+
+qint64
+ScheduleTrigger::maxJitter() const {
+  return _jitterMax;
+}
+
+bool
+ScheduleTrigger::_later(const Occurrence &a, const Occurrence &b) {
+  // Turns std::push_heap & co. into a min-heap
+  return a.due > b.due;
+}
+
+void
+ScheduleTrigger::_push(const ScheduledEvent &event, quint64 serial, qint64 after) {
+  if (! event.isValid()) { return; }
+  QDateTime next = event.nextEvent(QDateTime::fromMSecsSinceEpoch(after));
+  if (! next.isValid()) { return; }
+  Occurrence occ = { next.toMSecsSinceEpoch(), serial, event };
+  _heap.append(occ);
+  std::push_heap(_heap.begin(), _heap.end(), _later);
+}
+
+bool
+ScheduleTrigger::_isLive(const Occurrence &occ) const {
+  return _live.value(occ.event, 0) == occ.serial;
+}
+
+void
+ScheduleTrigger::_rebuild(qint64 now) {
+  _heap.clear();
+  _reference = now;
+  QHash<ScheduledEvent, quint64>::const_iterator item = _live.begin();
+  for (; item != _live.end(); item++) {
+    _push(item.key(), item.value(), now);
+  }
+  _arm(now);
+}
+
+void
+ScheduleTrigger::_arm(qint64 now) {
+  // Drop removed events from the top of the heap
+  while (_heap.size() && (! _isLive(_heap.first()))) {
+    std::pop_heap(_heap.begin(), _heap.end(), _later);
+    _heap.removeLast();
+  }
+  if (_heap.isEmpty()) {
+    _timer.stop();
+    return;
+  }
+  qint64 interval = std::max(qint64(0), _heap.first().due - now);
+  // Wake up at least once per hour, the watchdog handles clock jumps in between
+  _timer.start(int(std::min(interval, qint64(SCHEDULE_TRIGGER_MAX_INTERVAL))));
+}
+
+void
+ScheduleTrigger::_resetClock() {
+  _clockStart = QDateTime::currentMSecsSinceEpoch();
+  _clock.start();
+}
+
+void
+ScheduleTrigger::_onTimeout() {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  // Take all occurrences due in order of their start time
+  QList<Occurrence> due;
+  while (_heap.size() && (_heap.first().due <= now)) {
+    std::pop_heap(_heap.begin(), _heap.end(), _later);
+    Occurrence occ = _heap.takeLast();
+    if (! _isLive(occ)) { continue; }
+    due.append(occ);
+    // Schedule next occurrence of repeating events, occurrences passed meanwhile are skipped
+    _push(occ.event, occ.serial, std::max(occ.due, now)+1);
+  }
+
+  // Coincident occurrences trigger once, lasting as long as the longest of them
+  for (int i=0; i<due.size(); ) {
+    qint64 start = due[i].due;
+    int duration = 0;
+    for (; (i<due.size()) && (due[i].due == start); i++) {
+      duration = std::max(duration, due[i].event.duration());
+    }
+
+    qint64 jitter = now - start;
+    if (jitter > _maxLateness) {
+      logWarning() << "Schedule: Skip event at "
+                   << QDateTime::fromMSecsSinceEpoch(start).toString()
+                   << ", detected " << jitter << "ms late.";
+      _missed++;
+      continue;
+    }
+    _triggered++;
+    _jitterSum += jitter;
+    _jitterMax = std::max(_jitterMax, jitter);
+    logDebug() << "Schedule: Trigger event at "
+               << QDateTime::fromMSecsSinceEpoch(start).toString()
+               << " with a jitter of " << jitter << "ms (mean " << meanJitter()
+               << "ms, max " << _jitterMax << "ms).";
+    emit triggered(QDateTime::fromMSecsSinceEpoch(start), duration);
+  }
+  _reference = std::max(_reference, now+1);
+  _arm(now);
+}
+
+void
+ScheduleTrigger::_onWatchdog() {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  qint64 drift = now - (_clockStart + _clock.elapsed());
+  if (std::abs(drift) <= SCHEDULE_TRIGGER_CLOCK_TOLERANCE) { return; }
+  logInfo() << "Schedule: System clock jumped by " << drift << "ms, re-arm schedule.";
+  _resetClock();
+  if (drift > 0) {
+    // Clock jumped forward: Process the occurrences jumped over (or skip them if too late)
+    _onTimeout();
+  } else {
+    // Clock jumped backward: Occurrences may be pending again
+    rearm();
+  }
+}
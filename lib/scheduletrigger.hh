@@ -0,0 +1,121 @@
+#ifndef SCHEDULETRIGGER_HH
+#define SCHEDULETRIGGER_HH
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QTimer>
+#include <QElapsedTimer>
+#include "schedule.hh"
+
+
+/** Triggers the events of a schedule at their precise start times.
+ * The upcoming occurrences of all events are kept in a min-heap and a single single-shot timer is
+ * armed for the earliest one. Once it fires, all occurrences due are popped, @c triggered gets
+ * emitted once per distinct start time with the longest duration of the coincident events, and
+ * the next occurrences of the repeating events are pushed back. Single events can be added and
+ * removed incrementally, removed events are dropped lazily once they reach the top of the heap.
+ * Alternatively, @c rearm rebuilds the heap from the complete schedule.
+ *
+ * As timers run on a monotonic clock, a watchdog compares the system clock against it and rebuilds
+ * the heap if the system clock jumped (e.g. NTP step or suspend). Occurrences detected later than
+ * the max. lateness are skipped and counted as missed. The deviation of the actual from the
+ * scheduled start time (jitter) is recorded for all triggered occurrences. */
+class ScheduleTrigger : public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Constructs a trigger for the events of the given schedule. */
+  explicit ScheduleTrigger(const Schedule &schedule, QObject *parent=0);
+
+  /** Rebuilds the heap of upcoming occurrences from the schedule and re-arms the timer. */
+  void rearm();
+  /** Adds an event, does nothing if the event is already known. */
+  void add(const ScheduledEvent &event);
+  /** Removes an event. */
+  void remove(const ScheduledEvent &event);
+  /** Returns @c true if the event is known. */
+  bool contains(const ScheduledEvent &event) const;
+
+  /** Returns the next start time or an invalid date-time if nothing is pending. */
+  QDateTime next() const;
+  /** Determines the next start time at or after @c now from the heap. Returns @c false if the heap
+   * cannot answer (i.e. @c now is before the last update or after the earliest occurrence). */
+  bool next(const QDateTime &now, QDateTime &next) const;
+  /** Returns the number of pending occurrences. */
+  size_t numPending() const;
+
+  /** Sets the max. lateness in ms, after which an occurrence is skipped. */
+  void setMaxLateness(qint64 ms);
+
+  /** Returns the number of triggered occurrences. */
+  size_t numTriggered() const;
+  /** Returns the number of skipped occurrences. */
+  size_t numMissed() const;
+  /** Returns the mean jitter of the triggered occurrences in ms. */
+  double meanJitter() const;
+  /** Returns the max. jitter of the triggered occurrences in ms. */
+  qint64 maxJitter() const;
+
+signals:
+  /** Gets emitted at the scheduled start time @c when with the duration of the recording in
+   * seconds. */
+  void triggered(const QDateTime &when, int duration);
+
+protected:
+  /** An upcoming occurrence of an event. */
+  typedef struct {
+    /** Start time in ms since epoch. */
+    qint64 due;
+    /** Serial of the event, outdated if the event was removed meanwhile. */
+    quint64 serial;
+    /** The event. */
+    ScheduledEvent event;
+  } Occurrence;
+
+  /** Heap order of the occurrences. */
+  static bool _later(const Occurrence &a, const Occurrence &b);
+  /** Arms the timer for the earliest occurrence. */
+  void _arm(qint64 now);
+  /** Pushes the next occurrence of the event after the specified time. */
+  void _push(const ScheduledEvent &event, quint64 serial, qint64 after);
+  /** Returns @c true if the event of the occurrence was not removed. */
+  bool _isLive(const Occurrence &occ) const;
+  /** Rebuilds the heap from all known events. */
+  void _rebuild(qint64 now);
+  /** Resets the reference of the system clock against the monotonic clock. */
+  void _resetClock();
+
+protected slots:
+  void _onTimeout();
+  void _onWatchdog();
+
+protected:
+  /** The schedule. */
+  const Schedule &_schedule;
+  /** Min-heap of upcoming occurrences. */
+  QVector<Occurrence> _heap;
+  /** Serials of all known events. */
+  QHash<ScheduledEvent, quint64> _live;
+  /** Last serial assigned. */
+  quint64 _serial;
+  /** Time in ms since epoch, the heap holds the next occurrence at or after of each event. */
+  qint64 _reference;
+  /** Fires at the earliest occurrence. */
+  QTimer _timer;
+  /** Checks the system clock periodically. */
+  QTimer _watchdog;
+  /** Monotonic clock. */
+  QElapsedTimer _clock;
+  /** System time in ms since epoch at the start of @c _clock. */
+  qint64 _clockStart;
+  qint64 _maxLateness;
+  size_t _triggered;
+  size_t _missed;
+  /** Sum of absolute jitter in ms. */
+  qint64 _jitterSum;
+  qint64 _jitterMax;
+};
+
+#endif // SCHEDULETRIGGER_HH
@@ -0,0 +1,633 @@
+#include "sidstore.hh"
+#include "binarycodec.hh"
+#include <ovlnet/logger.hh>
+#include <QFile>
+#include <QSaveFile>
+#include <QUrl>
+#include <QJsonArray>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+/** Default retention of raw rows in ms, rollups are kept forever. */
+#define SID_RAW_RETENTION (7LL*24*3600*1000)
+/** Raw rows are pruned once they exceed the retention by this many ms, such that a series file
+ * gets rewritten at most once a day. */
+#define SID_PRUNE_SLACK (24LL*3600*1000)
+/** Upper estimates of the compressed size of a raw and a rollup row in bytes, including the
+ * chunk header. */
+#define SID_RAW_ROW_BYTES    12
+#define SID_ROLLUP_ROW_BYTES 24
+
+
+/** Writes a bit stream, most significant bit first. */
+class SidBitWriter
+{
+public:
+  SidBitWriter(QByteArray &data)
+    : _data(data), _bits(0)
+  {
+    // pass...
+  }
+
+  /** Writes the lower @c n bits of the value. */
+  void write(uint64_t value, int n) {
+    while (n > 0) {
+      if (0 == _bits) { _data.push_back(char(0)); _bits = 8; }
+      int k = std::min(n, _bits);
+      uint8_t chunk = uint8_t((value >> (n-k)) & ((1u << k)-1));
+      _data[_data.size()-1] = char(uint8_t(_data[_data.size()-1]) | (chunk << (_bits-k)));
+      _bits -= k; n -= k;
+    }
+  }
+
+protected:
+  QByteArray &_data;
+  /** Free bits in the last byte. */
+  int _bits;
+};
+
+
+/** Reads a bit stream, most significant bit first. */
+class SidBitReader
+{
+public:
+  SidBitReader(const char *data, size_t len)
+    : _data((const uint8_t *) data), _len(len), _pos(0), _ok(true)
+  {
+    // pass...
+  }
+
+  /** Reads @c n bits. */
+  uint64_t read(int n) {
+    uint64_t value = 0;
+    while (n > 0) {
+      if ((_pos >> 3) >= _len) { _ok = false; return 0; }
+      int bits = 8 - (_pos & 7);
+      int k = std::min(n, bits);
+      uint8_t chunk = (_data[_pos >> 3] >> (bits-k)) & ((1u << k)-1);
+      value = (value << k) | chunk;
+      _pos += k; n -= k;
+    }
+    return value;
+  }
+
+  /** Returns @c false if the stream ended prematurely. */
+  bool ok() const { return _ok; }
+
+protected:
+  const uint8_t *_data;
+  size_t _len;
+  size_t _pos;
+  bool _ok;
+};
+
+
+static inline uint32_t
+float_bits(float value) {
+  uint32_t bits; std::memcpy(&bits, &value, 4);
+  return bits;
+}
+
+static inline float
+bits_float(uint32_t bits) {
+  float value; std::memcpy(&value, &bits, 4);
+  return value;
+}
+
+/** Encodes a column of time stamps as delta-of-delta. */
+static void
+encode_times(SidBitWriter &writer, const QVector<SidRow> &rows) {
+  writer.write(uint64_t(rows[0].time), 64);
+  int64_t prevDelta = 0;
+  for (int i=1; i<rows.size(); i++) {
+    int64_t delta = rows[i].time - rows[i-1].time;
+    int64_t dod = delta - prevDelta;
+    prevDelta = delta;
+    if (0 == dod) {
+      writer.write(0, 1);
+    } else if ((dod >= -63) && (dod <= 64)) {
+      writer.write(0x2, 2); writer.write(uint64_t(dod+63), 7);
+    } else if ((dod >= -255) && (dod <= 256)) {
+      writer.write(0x6, 3); writer.write(uint64_t(dod+255), 9);
+    } else if ((dod >= -2047) && (dod <= 2048)) {
+      writer.write(0xe, 4); writer.write(uint64_t(dod+2047), 12);
+    } else {
+      writer.write(0xf, 4); writer.write(uint64_t(dod), 64);
+    }
+  }
+}
+
+static bool
+decode_times(SidBitReader &reader, size_t count, QVector<qint64> &times) {
+  times.push_back(qint64(reader.read(64)));
+  int64_t prevDelta = 0;
+  for (size_t i=1; (i<count) && reader.ok(); i++) {
+    int64_t dod = 0;
+    if (0 == reader.read(1)) { dod = 0; }
+    else if (0 == reader.read(1)) { dod = int64_t(reader.read(7)) - 63; }
+    else if (0 == reader.read(1)) { dod = int64_t(reader.read(9)) - 255; }
+    else if (0 == reader.read(1)) { dod = int64_t(reader.read(12)) - 2047; }
+    else { dod = int64_t(reader.read(64)); }
+    prevDelta += dod;
+    times.push_back(times.back() + prevDelta);
+  }
+  return reader.ok();
+}
+
+/** Encodes a column of floats by XOR against the previous value. */
+static void
+encode_values(SidBitWriter &writer, const QVector<SidRow> &rows, float SidRow::*column) {
+  uint32_t prev = float_bits(rows[0].*column);
+  writer.write(prev, 32);
+  int prevLeading = -1, prevTrailing = 0;
+  for (int i=1; i<rows.size(); i++) {
+    uint32_t value = float_bits(rows[i].*column);
+    uint32_t x = value ^ prev;
+    prev = value;
+    if (0 == x) {
+      writer.write(0, 1);
+      continue;
+    }
+    writer.write(1, 1);
+    int leading = std::min(31, __builtin_clz(x)), trailing = __builtin_ctz(x);
+    if ((prevLeading >= 0) && (leading >= prevLeading) && (trailing >= prevTrailing)) {
+      // Meaningful bits fit into the previous window
+      writer.write(0, 1);
+      writer.write(x >> prevTrailing, 32-prevLeading-prevTrailing);
+    } else {
+      int length = 32-leading-trailing;
+      writer.write(1, 1);
+      writer.write(uint64_t(leading), 5);
+      writer.write(uint64_t(length-1), 5);
+      writer.write(x >> trailing, length);
+      prevLeading = leading; prevTrailing = trailing;
+    }
+  }
+}
+
+static bool
+decode_values(SidBitReader &reader, size_t count, QVector<float> &values) {
+  uint32_t prev = uint32_t(reader.read(32));
+  values.push_back(bits_float(prev));
+  int prevLeading = -1, prevTrailing = 0;
+  for (size_t i=1; (i<count) && reader.ok(); i++) {
+    if (1 == reader.read(1)) {
+      uint32_t x = 0;
+      if (0 == reader.read(1)) {
+        if (prevLeading < 0) { return false; }
+        x = uint32_t(reader.read(32-prevLeading-prevTrailing)) << prevTrailing;
+      } else {
+        int leading = int(reader.read(5));
+        int length = int(reader.read(5))+1;
+        int trailing = 32-leading-length;
+        if (trailing < 0) { return false; }
+        x = uint32_t(reader.read(length)) << trailing;
+        prevLeading = leading; prevTrailing = trailing;
+      }
+      prev ^= x;
+    }
+    values.push_back(bits_float(prev));
+  }
+  return reader.ok();
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of SidChunk
+ * ********************************************************************************************* */
+QByteArray
+SidChunk::encode(const QVector<SidRow> &rows, bool minMax) {
+  QByteArray data;
+  if (rows.isEmpty()) { return data; }
+  SidBitWriter writer(data);
+  encode_times(writer, rows);
+  encode_values(writer, rows, &SidRow::mean);
+  if (minMax) {
+    encode_values(writer, rows, &SidRow::min);
+    encode_values(writer, rows, &SidRow::max);
+  }
+  encode_values(writer, rows, &SidRow::phase);
+  return data;
+}
+
+bool
+SidChunk::decode(const char *data, size_t len, size_t count, bool minMax, QVector<SidRow> &rows) {
+  if (0 == count) { return true; }
+  SidBitReader reader(data, len);
+  QVector<qint64> times;
+  QVector<float> mean, min, max, phase;
+  if (! decode_times(reader, count, times)) { return false; }
+  if (! decode_values(reader, count, mean)) { return false; }
+  if (minMax) {
+    if (! decode_values(reader, count, min)) { return false; }
+    if (! decode_values(reader, count, max)) { return false; }
+  }
+  if (! decode_values(reader, count, phase)) { return false; }
+  for (size_t i=0; i<count; i++) {
+    SidRow row = { times[i], mean[i], minMax ? min[i] : mean[i], minMax ? max[i] : mean[i],
+                   phase[i] };
+    rows.push_back(row);
+  }
+  return true;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of SidSeriesFile
+ * ********************************************************************************************* */
+SidSeriesFile::SidSeriesFile(const QString &filename, bool minMax, size_t chunkSize,
+                             qint64 maxAge)
+  : _filename(filename), _minMax(minMax), _chunkSize(std::min(size_t(0xffff), chunkSize)),
+    _maxAge(maxAge), _chunks(), _pending()
+{
+  _readIndex();
+}
+
+SidSeriesFile::~SidSeriesFile() {
+  flush();
+}
+
+void
+SidSeriesFile::append(const SidRow &row) {
+  _pending.append(row);
+  if ((size_t(_pending.size()) >= _chunkSize) || ((row.time - _pending.first().time) >= _maxAge)) {
+    flush();
+  }
+}
+
+bool
+SidSeriesFile::flush() {
+  if (_pending.isEmpty()) { return true; }
+  QFile file(_filename);
+  if (! file.open(QIODevice::WriteOnly | QIODevice::Append)) {
+    logError() << "Cannot write SID series " << _filename << ".";
+    return false;
+  }
+  QByteArray payload = SidChunk::encode(_pending, _minMax);
+  ChunkHeader header;
+  header.magic[0] = 'S'; header.magic[1] = 'C';
+  header.flags = _minMax ? 1 : 0;
+  header.count = qToBigEndian(quint16(_pending.size()));
+  header.size = qToBigEndian(quint32(payload.size()));
+  header.first = qToBigEndian(qint64(_pending.first().time));
+  header.last = qToBigEndian(qint64(_pending.last().time));
+
+  ChunkInfo info = { file.size(), _pending.first().time, _pending.last().time,
+                     uint32_t(payload.size()), uint16_t(_pending.size()) };
+  if ((qint64(sizeof(ChunkHeader)) != file.write((const char *) &header, sizeof(ChunkHeader)))
+      || (payload.size() != file.write(payload))) {
+    logError() << "Cannot write SID series " << _filename << ".";
+    // Drop the partial chunk
+    file.resize(info.offset);
+    return false;
+  }
+  file.close();
+  _chunks.append(info);
+  _pending.clear();
+  return true;
+}
+
+void
+SidSeriesFile::query(qint64 from, qint64 to, QVector<SidRow> &rows, size_t maxRows) const {
+  // First chunk ending at or after from
+  int i = 0, j = _chunks.size();
+  while (i < j) {
+    int m = (i+j)/2;
+    if (_chunks[m].last < from) { i = m+1; } else { j = m; }
+  }
+  if ((i < _chunks.size()) && (_chunks[i].first < to)) {
+    QFile file(_filename);
+    if (! file.open(QIODevice::ReadOnly)) {
+      logError() << "Cannot read SID series " << _filename << ".";
+      return;
+    }
+    QVector<SidRow> chunk;
+    for (; (i < _chunks.size()) && (_chunks[i].first < to) && (size_t(rows.size()) < maxRows);
+         i++) {
+      file.seek(_chunks[i].offset + sizeof(ChunkHeader));
+      QByteArray payload = file.read(_chunks[i].size);
+      chunk.clear();
+      if (! SidChunk::decode(payload.constData(), payload.size(), _chunks[i].count, _minMax,
+                             chunk)) {
+        logWarning() << "Skip invalid chunk in SID series " << _filename << ".";
+        continue;
+      }
+      for (int j=0; (j < chunk.size()) && (size_t(rows.size()) < maxRows); j++) {
+        if ((chunk[j].time >= from) && (chunk[j].time < to)) { rows.append(chunk[j]); }
+      }
+    }
+  }
+  for (int j=0; (j < _pending.size()) && (size_t(rows.size()) < maxRows); j++) {
+    if ((_pending[j].time >= from) && (_pending[j].time < to)) { rows.append(_pending[j]); }
+  }
+}
+
+bool
+SidSeriesFile::prune(qint64 before) {
+  int n = 0;
+  while ((n < _chunks.size()) && (_chunks[n].last < before)) { n++; }
+  if (0 == n) { return true; }
+
+  // Copy the remaining chunks into a new file
+  QFile src(_filename);
+  QSaveFile dst(_filename);
+  if ((! src.open(QIODevice::ReadOnly)) || (! dst.open(QIODevice::WriteOnly))) {
+    logError() << "Cannot prune SID series " << _filename << ".";
+    return false;
+  }
+  qint64 offset = (n < _chunks.size()) ? _chunks[n].offset : src.size();
+  src.seek(offset);
+  while (! src.atEnd()) {
+    QByteArray block = src.read(65536);
+    if (block.isEmpty() || (block.size() != dst.write(block))) {
+      logError() << "Cannot prune SID series " << _filename << ".";
+      dst.cancelWriting();
+      return false;
+    }
+  }
+  src.close();
+  if (! dst.commit()) {
+    logError() << "Cannot prune SID series " << _filename << ".";
+    return false;
+  }
+
+  _chunks.remove(0, n);
+  for (int i=0; i<_chunks.size(); i++) {
+    _chunks[i].offset -= offset;
+  }
+  return true;
+}
+
+bool
+SidSeriesFile::isEmpty() const {
+  return _chunks.isEmpty() && _pending.isEmpty();
+}
+
+qint64
+SidSeriesFile::first() const {
+  if (! _chunks.isEmpty()) { return _chunks.first().first; }
+  return _pending.isEmpty() ? 0 : _pending.first().time;
+}
+
+qint64
+SidSeriesFile::last() const {
+  if (! _pending.isEmpty()) { return _pending.last().time; }
+  return _chunks.isEmpty() ? 0 : _chunks.last().last;
+}
+
+void
+SidSeriesFile::_readIndex() {
+  QFile file(_filename);
+  if (! file.exists()) { return; }
+  if (! file.open(QIODevice::ReadWrite)) {
+    logError() << "Cannot open SID series " << _filename << ".";
+    return;
+  }
+  qint64 offset = 0, size = file.size();
+  ChunkHeader header;
+  while ((offset + qint64(sizeof(ChunkHeader))) <= size) {
+    file.seek(offset);
+    if (qint64(sizeof(ChunkHeader)) != file.read((char *) &header, sizeof(ChunkHeader))) {
+      break;
+    }
+    if (('S' != header.magic[0]) || ('C' != header.magic[1])) { break; }
+    ChunkInfo info = { offset, qFromBigEndian(header.first), qFromBigEndian(header.last),
+                       qFromBigEndian(header.size), qFromBigEndian(header.count) };
+    if ((offset + qint64(sizeof(ChunkHeader)) + info.size) > size) { break; }
+    _chunks.append(info);
+    offset += sizeof(ChunkHeader) + info.size;
+  }
+  if (offset < size) {
+    logWarning() << "Drop " << (size-offset) << " invalid bytes at the end of SID series "
+                 << _filename << ".";
+    file.resize(offset);
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of SidStore
+ * ********************************************************************************************* */
+SidStore::SidStore(const QString &path, QObject *parent)
+  : QObject(parent), _dir(path), _rawRate(0), _numRecorded(0), _rawRetention(SID_RAW_RETENTION),
+    _series()
+{
+  if (! _dir.exists()) {
+    _dir.mkpath(_dir.absolutePath());
+  }
+  // Open all existing series
+  foreach (QString name, _dir.entryList(QStringList() << "*.raw.sid", QDir::Files)) {
+    name.chop(8);
+    _getSeries(QUrl::fromPercentEncoding(name.toLatin1()), true);
+  }
+  logDebug() << "Opened SID store at " << _dir.absolutePath() << " with " << _series.size()
+             << " series.";
+}
+
+SidStore::~SidStore() {
+  foreach (Series *series, _series) {
+    for (int i=0; i<NumLevels; i++) {
+      delete series->files[i];
+    }
+    delete series;
+  }
+}
+
+QStringList
+SidStore::series() const {
+  QStringList names = _series.keys();
+  names.sort();
+  return names;
+}
+
+bool
+SidStore::contains(const QString &series) const {
+  return _series.contains(series);
+}
+
+bool
+SidStore::range(const QString &series, qint64 &first, qint64 &last) const {
+  Series *s = _series.value(series, 0);
+  if ((0 == s) || s->files[RAW]->isEmpty()) { return false; }
+  // Rollups reach further back than the pruned raw rows
+  first = s->files[RAW]->first();
+  for (int i=SECOND; i<NumLevels; i++) {
+    if (! s->files[i]->isEmpty()) { first = std::min(first, s->files[i]->first()); }
+  }
+  last = s->files[RAW]->last();
+  return true;
+}
+
+bool
+SidStore::range(const QString &series, Level level, qint64 &first, qint64 &last) const {
+  Series *s = _series.value(series, 0);
+  if ((0 == s) || s->files[level]->isEmpty()) { return false; }
+  first = s->files[level]->first();
+  last = s->files[level]->last();
+  return true;
+}
+
+double
+SidStore::rawRate() const {
+  return _rawRate;
+}
+
+void
+SidStore::setRawRate(double rate, size_t series) {
+  _rawRate = std::max(0., rate);
+  _numRecorded = series;
+}
+
+qint64
+SidStore::rawRetention() const {
+  return _rawRetention;
+}
+
+void
+SidStore::setRawRetention(qint64 ms) {
+  _rawRetention = ms;
+}
+
+double
+SidStore::diskRate() const {
+  if (_rawRate <= 0) { return 0; }
+  double rate = _rawRate*SID_RAW_ROW_BYTES + SID_ROLLUP_ROW_BYTES*(1 + 1./60 + 1./3600);
+  return _numRecorded*rate;
+}
+
+void
+SidStore::append(const QString &series, qint64 time, float amplitude, float phase) {
+  Series *s = _getSeries(series, true);
+  // Keep the time order, e.g. if the clock was set back
+  if ((! s->files[RAW]->isEmpty()) && (time <= s->files[RAW]->last())) { return; }
+  SidRow row = { time, amplitude, amplitude, amplitude, phase };
+  s->files[RAW]->append(row);
+  // Drop raw rows beyond the retention, the rollups keep the history
+  if ((_rawRetention > 0) && (s->files[RAW]->first() < (time-_rawRetention-SID_PRUNE_SLACK))) {
+    s->files[RAW]->prune(time-_rawRetention);
+  }
+  for (int i=SECOND; i<NumLevels; i++) {
+    _rollup(s->files[i], s->rollups[i], interval(Level(i)), time, amplitude, phase);
+  }
+}
+
+void
+SidStore::flush() {
+  foreach (Series *series, _series) {
+    for (int i=0; i<NumLevels; i++) {
+      series->files[i]->flush();
+    }
+  }
+}
+
+QVector<SidRow>
+SidStore::query(const QString &series, qint64 from, qint64 to, Level level,
+                size_t maxRows) const {
+  QVector<SidRow> rows;
+  Series *s = _series.value(series, 0);
+  if (s) {
+    s->files[level]->query(from, to, rows, maxRows);
+  }
+  return rows;
+}
+
+SidStore::Level
+SidStore::level(qint64 from, qint64 to, size_t maxPoints, double rawRate) {
+  double range = std::max(qint64(0), to-from);
+  if ((rawRate > 0) && ((range*rawRate/1000) <= maxPoints)) { return RAW; }
+  for (int i=SECOND; i<NumLevels; i++) {
+    if ((range/interval(Level(i))) <= maxPoints) { return Level(i); }
+  }
+  return HOUR;
+}
+
+qint64
+SidStore::interval(Level level) {
+  switch (level) {
+    case RAW: return 0;
+    case SECOND: return 1000;
+    case MINUTE: return 60*1000;
+    case HOUR: return 3600*1000;
+  }
+  return 0;
+}
+
+void
+SidStore::seriesToBinary(BinaryWriter &writer) const {
+  foreach (QString name, series()) {
+    qint64 first = 0, last = 0;
+    range(name, first, last);
+    writer.beginRecord();
+    writer.writeString(name);
+    writer.writeInt64(first);
+    writer.writeInt64(last);
+    writer.endRecord();
+  }
+}
+
+QJsonObject
+SidStore::seriesToJson() const {
+  QJsonArray list;
+  foreach (QString name, series()) {
+    qint64 first = 0, last = 0;
+    range(name, first, last);
+    QJsonObject obj;
+    obj.insert("name", name);
+    obj.insert("first", double(first));
+    obj.insert("last", double(last));
+    list.append(obj);
+  }
+  QJsonObject result;
+  result.insert("series", list);
+  return result;
+}
+
+SidStore::Series *
+SidStore::_getSeries(const QString &name, bool create) {
+  if (_series.contains(name)) { return _series[name]; }
+  if (! create) { return 0; }
+  Series *series = new Series();
+  for (int i=0; i<NumLevels; i++) {
+    // Only rollups carry min and max
+    series->files[i] = new SidSeriesFile(_filename(name, Level(i)), RAW != i);
+    series->rollups[i].count = 0;
+  }
+  _series.insert(name, series);
+  return series;
+}
+
+QString
+SidStore::_filename(const QString &name, Level level) const {
+  const char *suffix[NumLevels] = { ".raw.sid", ".1s.sid", ".1m.sid", ".1h.sid" };
+  return _dir.absoluteFilePath(QString::fromLatin1(QUrl::toPercentEncoding(name)) + suffix[level]);
+}
+
+void
+SidStore::_rollup(SidSeriesFile *file, Accumulator &acc, qint64 interval, qint64 time,
+                  float amplitude, float phase)
+{
+  // Write completed interval
+  if (acc.count && (time >= (acc.start+interval))) {
+    SidRow row = { acc.start, float(acc.sum/acc.count), acc.min, acc.max,
+                   acc.phaseCount ? float(std::atan2(acc.sinSum, acc.cosSum)) : NAN };
+    // Skip intervals already written before a restart
+    if (file->isEmpty() || (row.time > file->last())) {
+      file->append(row);
+    }
+    acc.count = 0;
+  }
+  // Start new interval
+  if (0 == acc.count) {
+    acc.start = time - (time % interval);
+    acc.sum = 0; acc.min = acc.max = amplitude;
+    acc.sinSum = acc.cosSum = 0; acc.phaseCount = 0;
+  }
+  acc.sum += amplitude; acc.count++;
+  acc.min = std::min(acc.min, amplitude);
+  acc.max = std::max(acc.max, amplitude);
+  if (! std::isnan(phase)) {
+    acc.sinSum += std::sin(phase); acc.cosSum += std::cos(phase);
+    acc.phaseCount++;
+  }
+}
@@ -0,0 +1,219 @@
+#ifndef SIDSTORE_HH
+#define SIDSTORE_HH
+
+#include <QObject>
+#include <QDir>
+#include <QHash>
+#include <QVector>
+#include <QStringList>
+#include <QJsonObject>
+#include <cmath>
+
+class BinaryWriter;
+
+
+/** A row of a SID (sudden ionospheric disturbance) time series. Raw rows hold a single sample
+ * (min and max equal the mean), rollup rows aggregate all samples of their interval. */
+typedef struct {
+  /** Time in ms since epoch (UTC), the start of the interval for rollups. */
+  qint64 time;
+  /** Mean amplitude. */
+  float mean;
+  /** Min. amplitude. */
+  float min;
+  /** Max. amplitude. */
+  float max;
+  /** Mean phase in rad, NaN if unknown. */
+  float phase;
+} SidRow;
+
+
+/** Compression of a chunk of rows.
+ * The chunk is stored column by column in a bit stream. Time stamps are encoded as
+ * delta-of-delta, values by XOR against the previous value of the same column, storing only the
+ * meaningful bits (as in Facebook's Gorilla TSDB). Regularly sampled, slowly varying series
+ * compress to a few bits per row. */
+class SidChunk
+{
+public:
+  /** Encodes the rows. If @c minMax is @c false, the min and max columns are omitted. */
+  static QByteArray encode(const QVector<SidRow> &rows, bool minMax);
+  /** Decodes @c count rows and appends them to @c rows. Returns @c false on error. */
+  static bool decode(const char *data, size_t len, size_t count, bool minMax,
+                     QVector<SidRow> &rows);
+};
+
+
+/** An append-only file of compressed chunks holding one series at one level.
+ * Each chunk holds up to a fixed number of rows and is prefixed by a header with its time range,
+ * such that range queries only decode the chunks overlapping the range. Rows are collected in
+ * memory until a chunk is full or spans the max. age, which bounds the rows lost on a crash for
+ * slowly updated rollups. A truncated chunk at the end of the file (e.g., after a crash)
+ * gets dropped on open. */
+class SidSeriesFile
+{
+public:
+  /** Opens or creates the file. Pending rows are written once @c chunkSize rows are collected or
+   * the rows span @c maxAge ms. */
+  SidSeriesFile(const QString &filename, bool minMax, size_t chunkSize=1024,
+                qint64 maxAge=600000);
+  /** Destructor, writes pending rows. */
+  ~SidSeriesFile();
+
+  /** Appends a row, rows must be appended in time order. */
+  void append(const SidRow &row);
+  /** Writes all pending rows as a (possibly partial) chunk. */
+  bool flush();
+
+  /** Appends the rows with @c from <= time < @c to to @c rows, until @c rows holds
+   * @c maxRows rows. */
+  void query(qint64 from, qint64 to, QVector<SidRow> &rows, size_t maxRows) const;
+
+  /** Drops all chunks ending before @c before by rewriting the file. Pending rows are kept. */
+  bool prune(qint64 before);
+
+  /** Returns @c true if the file holds no rows. */
+  bool isEmpty() const;
+  /** Returns the time of the first row. */
+  qint64 first() const;
+  /** Returns the time of the last row. */
+  qint64 last() const;
+
+protected:
+  /** Header of a chunk as stored in the file. */
+  typedef struct __attribute__((packed)) {
+    char magic[2];
+    uint8_t flags;
+    uint16_t count;
+    uint32_t size;
+    int64_t first;
+    int64_t last;
+  } ChunkHeader;
+
+  /** Index entry of a chunk. */
+  typedef struct {
+    qint64 offset;
+    qint64 first;
+    qint64 last;
+    uint32_t size;
+    uint16_t count;
+  } ChunkInfo;
+
+  /** Reads the chunk headers. */
+  void _readIndex();
+
+protected:
+  QString _filename;
+  bool _minMax;
+  size_t _chunkSize;
+  qint64 _maxAge;
+  QVector<ChunkInfo> _chunks;
+  QVector<SidRow> _pending;
+};
+
+
+/** Embedded store of SID time series, e.g. the amplitude and phase of VLF beacons.
+ * Each series is stored at its raw sample rate and as rollups over 1 s, 1 min and 1 h intervals,
+ * which are updated automatically as samples are appended. Hence, queries over long ranges read
+ * only a few rows of a coarse level. Raw rows are kept for a limited time only (7 days by
+ * default), the rollups are kept forever. */
+class SidStore: public QObject
+{
+  Q_OBJECT
+
+public:
+  /** Levels of a series. */
+  typedef enum {
+    RAW = 0,
+    SECOND,
+    MINUTE,
+    HOUR
+  } Level;
+  /** Number of levels. */
+  static const int NumLevels = 4;
+
+public:
+  /** Opens or creates the store in the directory @c path. */
+  explicit SidStore(const QString &path, QObject *parent=0);
+  /** Destructor, writes all pending rows. */
+  virtual ~SidStore();
+
+  /** Returns the names of all series. */
+  QStringList series() const;
+  /** Returns @c true if the series exists. */
+  bool contains(const QString &series) const;
+  /** Returns the time range of the series over all levels. */
+  bool range(const QString &series, qint64 &first, qint64 &last) const;
+  /** Returns the time range of the series at the given level. */
+  bool range(const QString &series, Level level, qint64 &first, qint64 &last) const;
+
+  /** Returns the rate in Hz at which samples get appended, 0 if nothing is recorded. */
+  double rawRate() const;
+  /** Sets the rate in Hz at which samples get appended to the given number of series. */
+  void setRawRate(double rate, size_t series);
+  /** Returns the retention of raw rows in ms, 0 if kept forever. */
+  qint64 rawRetention() const;
+  /** Sets the retention of raw rows in ms, 0 keeps them forever. */
+  void setRawRetention(qint64 ms);
+  /** Returns an upper estimate of the bytes per second written to disk while recording at the
+   * raw rate. */
+  double diskRate() const;
+
+  /** Appends a sample to the series, creating it if needed. */
+  void append(const QString &series, qint64 time, float amplitude, float phase=NAN);
+  /** Writes all pending rows. */
+  void flush();
+
+  /** Returns the first @c maxRows rows of the series at the given level with
+   * @c from <= time < @c to. */
+  QVector<SidRow> query(const QString &series, qint64 from, qint64 to, Level level,
+                        size_t maxRows) const;
+  /** Returns the finest level with at most @c maxPoints rows within the range, assuming the raw
+   * level holds at most @c rawRate samples per second. The raw level is never selected if
+   * @c rawRate is 0. */
+  static Level level(qint64 from, qint64 to, size_t maxPoints, double rawRate);
+  /** Returns the interval of the level in ms, 0 for the raw level. */
+  static qint64 interval(Level level);
+
+  /** Serializes the list of series with their time ranges. */
+  void seriesToBinary(BinaryWriter &writer) const;
+  QJsonObject seriesToJson() const;
+
+protected:
+  /** Accumulator of a rollup. */
+  typedef struct {
+    qint64 start;
+    double sum;
+    float min;
+    float max;
+    size_t count;
+    double sinSum;
+    double cosSum;
+    size_t phaseCount;
+  } Accumulator;
+
+  /** A series with its files and rollup accumulators. */
+  typedef struct {
+    SidSeriesFile *files[NumLevels];
+    Accumulator rollups[NumLevels];
+  } Series;
+
+  /** Returns the series, creating it if @c create is @c true. */
+  Series *_getSeries(const QString &name, bool create);
+  /** Returns the file name of the series at the given level. */
+  QString _filename(const QString &name, Level level) const;
+  /** Adds a sample to a rollup, writing the completed interval if the sample is beyond. */
+  void _rollup(SidSeriesFile *file, Accumulator &acc, qint64 interval, qint64 time,
+               float amplitude, float phase);
+
+protected:
+  QDir _dir;
+  /** Rate in Hz and number of recorded series. */
+  double _rawRate;
+  size_t _numRecorded;
+  /** Retention of raw rows in ms. */
+  qint64 _rawRetention;
+  QHash<QString, Series *> _series;
+};
+
+#endif // SIDSTORE_HH
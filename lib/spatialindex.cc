@@ -0,0 +1,182 @@
+#include "spatialindex.hh"
+#include <algorithm>
+#include <cmath>
+
+/** Mean earth radius in km. */
+#define EARTH_RADIUS 6371.0088
+
+
+inline double
+dist2(const double *a, const double *b) {
+  double dx = a[0]-b[0], dy = a[1]-b[1], dz = a[2]-b[2];
+  return dx*dx + dy*dy + dz*dz;
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of SpatialIndex
+ * ********************************************************************************************* */
+SpatialIndex::SpatialIndex()
+  : _locations(), _points(), _axis(), _dirty(false)
+{
+  // pass...
+}
+
+void
+SpatialIndex::insert(const Identifier &id, const Location &loc) {
+  if (loc.isNull()) {
+    remove(id); return;
+  }
+  _locations.insert(id, loc);
+  _dirty = true;
+}
+
+void
+SpatialIndex::remove(const Identifier &id) {
+  if (_locations.remove(id)) {
+    _dirty = true;
+  }
+}
+
+void
+SpatialIndex::clear() {
+  _locations.clear();
+  _points.clear();
+  _axis.clear();
+  _dirty = false;
+}
+
+size_t
+SpatialIndex::size() const {
+  return _locations.size();
+}
+
+QList<Identifier>
+SpatialIndex::nearest(const Location &loc, size_t k) const {
+  QList<Identifier> res;
+  if ((0 == k) || loc.isNull()) { return res; }
+  _update();
+
+  double q[3]; loc.unitVector(q);
+  QVector< QPair<double, int> > heap;
+  heap.reserve(k+1);
+  _nearest(0, _points.size(), q, k, heap);
+
+  std::sort_heap(heap.begin(), heap.end());
+  for (int i=0; i<heap.size(); i++) {
+    res.append(_points[heap[i].second].id);
+  }
+  return res;
+}
+
+QList<Identifier>
+SpatialIndex::within(const Location &loc, double radius) const {
+  QList<Identifier> res;
+  if (loc.isNull()) { return res; }
+  _update();
+
+  // Convert great circle distance to chord length on the unit sphere
+  double chord = 2*std::sin(std::min(radius/EARTH_RADIUS, M_PI)/2);
+  double q[3]; loc.unitVector(q);
+  QVector< QPair<double, int> > found;
+  _within(0, _points.size(), q, chord*chord, found);
+
+  std::sort(found.begin(), found.end());
+  for (int i=0; i<found.size(); i++) {
+    res.append(_points[found[i].second].id);
+  }
+  return res;
+}
+
+void
+SpatialIndex::_update() const {
+  if (! _dirty) { return; }
+  _points.resize(_locations.size());
+  _axis.resize(_locations.size());
+  QHash<Identifier, Location>::const_iterator item = _locations.begin();
+  for (int i=0; item != _locations.end(); item++, i++) {
+    item.value().unitVector(_points[i].v);
+    _points[i].id = item.key();
+  }
+  _build(0, _points.size());
+  _dirty = false;
+}
+
+void
+SpatialIndex::_build(int lo, int hi) const {
+  if ((hi-lo) < 1) { return; }
+  // Split along the axis of the largest spread
+  double min[3] = { 2, 2, 2 }, max[3] = { -2, -2, -2 };
+  for (int i=lo; i<hi; i++) {
+    for (int j=0; j<3; j++) {
+      min[j] = std::min(min[j], _points[i].v[j]);
+      max[j] = std::max(max[j], _points[i].v[j]);
+    }
+  }
+  uint8_t axis = 0;
+  for (int j=1; j<3; j++) {
+    if ((max[j]-min[j]) > (max[axis]-min[axis])) { axis = j; }
+  }
+
+  int mid = (lo+hi)/2;
+  std::nth_element(_points.begin()+lo, _points.begin()+mid, _points.begin()+hi,
+                   [axis](const Point &a, const Point &b) { return a.v[axis] < b.v[axis]; });
+  _axis[mid] = axis;
+  _build(lo, mid);
+  _build(mid+1, hi);
+}
+
+void
+SpatialIndex::_nearest(int lo, int hi, const double *q, size_t k,
+                       QVector< QPair<double, int> > &heap) const
+{
+  if ((hi-lo) < 1) { return; }
+  int mid = (lo+hi)/2;
+  const Point &p = _points[mid];
+
+  // Keep the k nearest points in a max-heap
+  double d = dist2(q, p.v);
+  if (size_t(heap.size()) < k) {
+    heap.append(qMakePair(d, mid));
+    std::push_heap(heap.begin(), heap.end());
+  } else if (d < heap.first().first) {
+    std::pop_heap(heap.begin(), heap.end());
+    heap.last() = qMakePair(d, mid);
+    std::push_heap(heap.begin(), heap.end());
+  }
+
+  // Search the near side first, the far side only if it may contain closer points
+  double diff = q[_axis[mid]] - p.v[_axis[mid]];
+  if (diff < 0) {
+    _nearest(lo, mid, q, k, heap);
+    if ((size_t(heap.size()) < k) || ((diff*diff) < heap.first().first)) {
+      _nearest(mid+1, hi, q, k, heap);
+    }
+  } else {
+    _nearest(mid+1, hi, q, k, heap);
+    if ((size_t(heap.size()) < k) || ((diff*diff) < heap.first().first)) {
+      _nearest(lo, mid, q, k, heap);
+    }
+  }
+}
+
+void
+SpatialIndex::_within(int lo, int hi, const double *q, double r2,
+                      QVector< QPair<double, int> > &res) const
+{
+  if ((hi-lo) < 1) { return; }
+  int mid = (lo+hi)/2;
+  const Point &p = _points[mid];
+
+  double d = dist2(q, p.v);
+  if (d <= r2) {
+    res.append(qMakePair(d, mid));
+  }
+  double diff = q[_axis[mid]] - p.v[_axis[mid]];
+  if ((diff <= 0) || ((diff*diff) <= r2)) {
+    _within(lo, mid, q, r2, res);
+  }
+  if ((diff >= 0) || ((diff*diff) <= r2)) {
+    _within(mid+1, hi, q, r2, res);
+  }
+}
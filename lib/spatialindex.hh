@@ -0,0 +1,66 @@
+#ifndef SPATIALINDEX_HH
+#define SPATIALINDEX_HH
+
+#include <QVector>
+#include <QHash>
+#include <QList>
+#include <ovlnet/buckets.hh>
+#include "location.hh"
+
+
+/** Spatial index over the locations of stations.
+ * The locations are stored as unit vectors in a k-d tree. As the chord length between two points
+ * on the unit sphere is monotonic in their great circle distance, nearest-neighbour and radius
+ * queries reduce to euclidean queries on these vectors. Heights are ignored.
+ *
+ * The tree is rebuilt lazily with the first query after the index was modified. */
+class SpatialIndex
+{
+public:
+  /** Constructs an empty index. */
+  SpatialIndex();
+
+  /** Adds or moves the specified station. Null locations are ignored. */
+  void insert(const Identifier &id, const Location &loc);
+  /** Removes the specified station. */
+  void remove(const Identifier &id);
+  /** Removes all stations. */
+  void clear();
+  /** Returns the number of indexed stations. */
+  size_t size() const;
+
+  /** Returns up to @c k stations closest to the specified location, nearest first. */
+  QList<Identifier> nearest(const Location &loc, size_t k) const;
+  /** Returns all stations within the specified great circle distance in km, nearest first. */
+  QList<Identifier> within(const Location &loc, double radius) const;
+
+protected:
+  /** A point in the tree. */
+  typedef struct {
+    double v[3];
+    Identifier id;
+  } Point;
+
+  /** Rebuilds the tree if the index was modified. */
+  void _update() const;
+  /** Builds the subtree over the points in [lo, hi). */
+  void _build(int lo, int hi) const;
+  /** Collects the @c k nearest points of the subtree over [lo, hi). */
+  void _nearest(int lo, int hi, const double *q, size_t k,
+                QVector< QPair<double, int> > &heap) const;
+  /** Collects all points of the subtree over [lo, hi) within the squared chord length @c r2. */
+  void _within(int lo, int hi, const double *q, double r2,
+               QVector< QPair<double, int> > &res) const;
+
+protected:
+  /** The locations of all stations. */
+  QHash<Identifier, Location> _locations;
+  /** The points in tree order, the root of every subtree is its median element. */
+  mutable QVector<Point> _points;
+  /** The split axis of the subtree rooted at each element. */
+  mutable QVector<uint8_t> _axis;
+  /** If @c true, the tree needs to be rebuilt. */
+  mutable bool _dirty;
+};
+
+#endif // SPATIALINDEX_HH
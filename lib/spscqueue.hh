@@ -0,0 +1,86 @@
+#ifndef SPSCQUEUE_HH
+#define SPSCQUEUE_HH
+
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+
+
+/** A bounded lock-free queue of values for a single producer and a single consumer thread.
+ * The values are kept in a ring buffer whose capacity is a power of two. The producer only writes
+ * the head index and the consumer only the tail index, each on its own cache line, hence neither
+ * side ever waits for the other. */
+template <class T>
+class SPSCQueue
+{
+public:
+  /** Constructs an empty queue holding at least @c capacity values. */
+  explicit SPSCQueue(size_t capacity)
+    : _data(0), _mask(0), _head(0), _tail(0)
+  {
+    size_t size = 1;
+    while (size < capacity) { size <<= 1; }
+    _data = new T[size];
+    _mask = size-1;
+  }
+
+  /** Destructor. */
+  ~SPSCQueue() {
+    delete[] _data;
+  }
+
+  /** Returns the capacity of the queue. */
+  size_t capacity() const {
+    return _mask+1;
+  }
+
+  /** Returns the number of values in the queue. Exact for the consumer, a lower bound of the
+   * free space for the producer. */
+  size_t size() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+  }
+
+  /** Appends at most @c n values, limited by the free space. Returns the number of values
+   * appended. Must only be called by the producer. */
+  size_t push(const T *data, size_t n) {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t tail = _tail.load(std::memory_order_acquire);
+    n = std::min(n, capacity()-(head-tail));
+    // Copy in up to two parts, wrapping around the end of the buffer
+    size_t first = std::min(n, capacity()-(head & _mask));
+    std::copy(data, data+first, _data+(head & _mask));
+    std::copy(data+first, data+n, _data);
+    _head.store(head+n, std::memory_order_release);
+    return n;
+  }
+
+  /** Removes at most @c n values and stores them in @c data. Returns the number of values
+   * removed. Must only be called by the consumer. */
+  size_t pop(T *data, size_t n) {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t head = _head.load(std::memory_order_acquire);
+    n = std::min(n, head-tail);
+    size_t first = std::min(n, capacity()-(tail & _mask));
+    std::copy(_data+(tail & _mask), _data+(tail & _mask)+first, data);
+    std::copy(_data, _data+(n-first), data+first);
+    _tail.store(tail+n, std::memory_order_release);
+    return n;
+  }
+
+protected:
+  /** Ring buffer. */
+  T *_data;
+  /** Capacity - 1. */
+  size_t _mask;
+  /** Total number of values pushed, written by the producer only. */
+  alignas(64) std::atomic<size_t> _head;
+  /** Total number of values popped, written by the consumer only. */
+  alignas(64) std::atomic<size_t> _tail;
+
+private:
+  // Not copyable
+  SPSCQueue(const SPSCQueue &other);
+  SPSCQueue &operator=(const SPSCQueue &other);
+};
+
+#endif // SPSCQUEUE_HH
@@ -3,16 +3,32 @@
 #include <QJsonObject>
 #include <QJsonArray>
 #include <QAudioDeviceInfo>
+#include <QUrlQuery>
+#include <algorithm>
 
 #include <ovlnet/node.hh>
 #include <ovlnet/socks.hh>
 
 #include "location.hh"
 #include "stationlist.hh"
+#include "resolvecache.hh"
+#include "queryscheduler.hh"
 #include "schedule.hh"
 #include "receiver.hh"
 #include "bootstraplist.hh"
 #include "socksservice.hh"
+#include "binarycodec.hh"
+#include "blobresponse.hh"
+#include "compression.hh"
+#include "stationdigest.hh"
+#include "sidstore.hh"
+#include "pipeline.hh"
+#include "dsp/fftplan.hh"
+
+/** Max. number of rows of a SID response, longer ranges are served in pages. */
+#define STATION_SID_MAX_ROWS 10000
+/** Number of stations listed by a /list?near=... request without k. */
+#define STATION_NEAR_DEFAULT 16
 
 
 /* ********************************************************************************************* *
@@ -20,15 +36,26 @@
  * ********************************************************************************************* */
 Station::Station(const QString &path, const QHostAddress &addr, uint16_t port, QObject *parent)
   : Node(path+"/identity.pem", addr, port, parent), HttpRequestHandler(), _path(path),
-    _location(Location::fromFile(_path+"/location.json")), _stations(0),
-    _schedule(0), _datasets(0), _receiver(0), _bootstrapTimer(), _ctrlWhitelist()
+    _location(Location::fromFile(_path+"/location.json")), _resolver(0), _queries(0),
+    _stations(0),
+    _schedule(0), _datasets(0), _receiver(0), _tracker(0), _fftPlans(0), _sid(0), _pipeline(0),
+    _bootstrapTimer(), _ctrlWhitelist(),
+    _responseCache()
 {
-  _stations = new StationList(*this);
-  _schedule = new MergedSchedule(_path+"/schedule.json", *this, 28, this);
+  _resolver = new ResolveCache(*this, 900, 120, this);
+  _queries = new QueryScheduler(16, 2, this);
+  _stations = new StationList(*this, _path+"/stations.json");
   _datasets = new DataSetDir(_path+"/data");
+  _fftPlans = new FFTPlanCache(_path+"/fftwf.wisdom", this);
+  _sid = new SidStore(_path+"/sid", this);
+  _pipeline = new Pipeline(10*60*1000, this);
+
+  // Create receiver and beacon tracker, the schedule plans with the data rate of the receiver
+  ReceiverConfig receiverConfig(_path+"/receiver.json");
+  _receiver = new Receiver(*this, receiverConfig, this);
+  _createTracker(receiverConfig);
 
-  // Create receiver...
-  _receiver = new Receiver(*this, ReceiverConfig(_path+"/receiver.json"), this);
+  _schedule = new MergedSchedule(_path+"/schedule.json", *this, 28, this);
 
   // Register service
   registerService("vlf::station", new HttpService(*this, this));
@@ -50,6 +77,24 @@ Station::Station(const QString &path, const QHostAddress &addr, uint16_t port, Q
   connect(this, SIGNAL(nodeAppeard(NodeItem)), _stations, SLOT(contactStation(NodeItem)));
   // Start scheduled recording
   connect(_schedule, SIGNAL(startRecording(double)), _receiver, SLOT(start(double)));
+
+  // Drop cached responses whenever the served data changes
+  connect(_stations, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(_onStationsChanged()));
+  connect(_stations, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(_onStationsChanged()));
+  connect(_stations, SIGNAL(modelReset()), this, SLOT(_onStationsChanged()));
+  connect(_schedule, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(_onScheduleChanged()));
+  connect(_schedule, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(_onScheduleChanged()));
+  connect(_schedule, SIGNAL(dataChanged(QModelIndex,QModelIndex)),
+          this, SLOT(_onScheduleChanged()));
+  connect(_schedule, SIGNAL(modelReset()), this, SLOT(_onScheduleChanged()));
+  connect(_datasets, SIGNAL(rowsInserted(QModelIndex,int,int)), this, SLOT(_onDataSetsChanged()));
+  connect(_datasets, SIGNAL(rowsRemoved(QModelIndex,int,int)), this, SLOT(_onDataSetsChanged()));
+  connect(_datasets, SIGNAL(modelReset()), this, SLOT(_onDataSetsChanged()));
+}
+
+Station::~Station() {
+  // Stop the tracker before the FFT plans and the SID store get destroyed
+  delete _tracker;
 }
 
 const Location &
@@ -60,6 +105,8 @@ Station::location() const {
 void
 Station::setLocation(const Location &loc) {
   _location = loc;
+  _dropCachedResponses("/status");
+  _stations->updateDistances();
   // Save location into file.
   QFile file(_path+"/location.json");
   if (! file.open(QIODevice::WriteOnly)) {
@@ -75,6 +122,16 @@ Station::stations() {
   return *_stations;
 }
 
+ResolveCache &
+Station::resolver() {
+  return *_resolver;
+}
+
+QueryScheduler &
+Station::queries() {
+  return *_queries;
+}
+
 MergedSchedule &
 Station::schedule() {
   return *_schedule;
@@ -85,6 +142,26 @@ Station::datasets() {
   return *_datasets;
 }
 
+FFTPlanCache &
+Station::fftPlans() {
+  return *_fftPlans;
+}
+
+SidStore &
+Station::sid() {
+  return *_sid;
+}
+
+Pipeline &
+Station::pipeline() {
+  return *_pipeline;
+}
+
+Receiver &
+Station::receiver() {
+  return *_receiver;
+}
+
 QAudioDeviceInfo
 Station::inputDevice() const {
   return _receiver->device();
@@ -93,9 +170,12 @@ Station::inputDevice() const {
 bool
 Station::setInputDevice(const QAudioDeviceInfo &device) {
   _receiver->setDevice(device);
-  ReceiverConfig cfg;
+  // Keep the remaining settings
+  ReceiverConfig cfg(_path+"/receiver.json");
   cfg.setDevice(device);
   cfg.save(_path+"/receiver.json");
+  // The tracker engines depend on the sample rate of the device
+  _createTracker(cfg);
   return true;
 }
 
@@ -107,12 +187,18 @@ Station::acceptReqest(HttpRequest *request) {
   if ((HTTP_GET == request->method()) && ("/list" == request->uri().path())) {
     return true;
   }
+  if ((HTTP_GET == request->method()) && ("/list/digest" == request->uri().path())) {
+    return true;
+  }
   if ((HTTP_GET == request->method()) && ("/schedule" == request->uri().path())) {
     return true;
   }
   if ((HTTP_GET == request->method()) && request->uri().path().startsWith("/data")) {
     return true;
   }
+  if ((HTTP_GET == request->method()) && ("/sid" == request->uri().path())) {
+    return true;
+  }
   if (request->uri().path().startsWith("/ctrl/") && _ctrlWhitelist.contains(request->remote().id())) {
     return true;
   }
@@ -121,8 +207,92 @@ Station::acceptReqest(HttpRequest *request) {
 
 HttpResponse *
 Station::processRequest(HttpRequest *request) {
-  if ((HTTP_GET == request->method()) && ("/status" == request->uri().path())) {
+  QString path = request->uri().path();
+  // Check if the binary encoding and/or compression is requested
+  QUrlQuery query(request->uri());
+  // The digest is always binary encoded
+  bool binary = ("binary" == query.queryItemValue("format")) || ("/list/digest" == path);
+  bool deflate = ("deflate" == query.queryItemValue("encoding"));
+
+  if ((HTTP_GET == request->method()) && _isMetadata(path)) {
+    // Handle status, stations list, schedule and dataset list requests
+    QString contentType = binary ? "application/octet-stream" : "application/json";
+    if (! deflate) {
+      return new HttpBlobResponse(_metadata(path, query, binary), contentType, request);
+    }
+    // Filtered lists are rare and differ per request, do not cache them
+    if (query.hasQueryItem("buckets") || query.hasQueryItem("near")) {
+      HttpBlobResponse *response = new HttpBlobResponse(
+            deflateData(_metadata(path, query, binary)), contentType, request);
+      response->setHeader("Content-Encoding", "deflate");
+      return response;
+    }
+    // Compress response once and serve it from the cache until the data changes
+    QString key = path + "?" + (binary ? "binary" : "json");
+    if (! _responseCache.contains(key)) {
+      _responseCache.insert(key, deflateData(_metadata(path, query, binary)));
+    }
+    HttpBlobResponse *response = new HttpBlobResponse(_responseCache[key], contentType, request);
+    response->setHeader("Content-Encoding", "deflate");
+    return response;
+  } else if ((HTTP_GET == request->method()) && ("/sid" == path)) {
+    // Handle SID series requests, not cached as the series grow continuously
+    QByteArray data = _sidData(query, binary);
+    if (data.isEmpty()) {
+      return new HttpStringResponse(request->version(), HTTP_NOT_FOUND, "Not found.",
+                                    request->socket());
+    }
+    QString contentType = binary ? "application/octet-stream" : "application/json";
+    if (! deflate) {
+      return new HttpBlobResponse(data, contentType, request);
+    }
+    HttpBlobResponse *response = new HttpBlobResponse(deflateData(data), contentType, request);
+    response->setHeader("Content-Encoding", "deflate");
+    return response;
+  } else if ((HTTP_GET == request->method()) && path.startsWith("/data")) {
+    // Handle data download queries
+    Identifier id = Identifier::fromBase32(path.mid(6));
+    if (! _datasets->contains(id)) {
+      return new HttpStringResponse(request->version(), HTTP_NOT_FOUND, "Not found.",
+                                    request->socket());
+    }
+    // serve compressed file if requested and ready, it gets created in the background otherwise
+    QString filename;
+    if (deflate && (! (filename = _datasets->compressedFilename(id)).isEmpty())) {
+      HttpFileResponse *response = new HttpFileResponse(filename, request);
+      response->setHeader("Content-Encoding", "deflate");
+      return response;
+    }
+    // serve file
+    return new HttpFileResponse(_datasets->dataset(id).filename(), request);
+  }
+
+  // Unknown request -> send a 404
+  return new HttpStringResponse(
+        request->version(), HTTP_NOT_FOUND, "Not found", request->socket());
+}
+
+bool
+Station::_isMetadata(const QString &path) const {
+  return ("/status" == path) || ("/list" == path) || ("/list/digest" == path) ||
+      ("/schedule" == path) || ("/data" == path);
+}
+
+QByteArray
+Station::_metadata(const QString &path, const QUrlQuery &query, bool binary) {
+  if ("/status" == path) {
     // Handle station info request
+    if (binary) {
+      BinaryWriter writer(BinaryCodec::STATUS);
+      writer.beginRecord();
+      writer.writeIdentifier(id());
+      writer.writeDouble(_location.longitude());
+      writer.writeDouble(_location.latitude());
+      writer.writeDouble(_location.height());
+      writer.writeString("");
+      writer.endRecord();
+      return writer.data();
+    }
     // Assemble location
     QJsonObject location;
     location.insert("longitude", _location.longitude());
@@ -132,40 +302,190 @@ Station::processRequest(HttpRequest *request) {
     QJsonObject result;
     result.insert("id", id().toBase32());
     result.insert("location", location);
-    // Send response as JSON
-    return new HttpJsonResponse(QJsonDocument(result), request);
-  } else if ((HTTP_GET == request->method()) && ("/list" == request->uri().path())) {
-    // Handle stations list request
+    return QJsonDocument(result).toJson(QJsonDocument::Compact);
+  } else if ("/list" == path) {
+    // Handle stations list request, optionally restricted to some digest buckets
+    QVector<bool> selected(StationDigest::NumBuckets, ! query.hasQueryItem("buckets"));
+    foreach (QString item, query.queryItemValue("buckets").split(",", QString::SkipEmptyParts)) {
+      bool ok; int bucket = item.toInt(&ok);
+      if (ok && (bucket >= 0) && (bucket < StationDigest::NumBuckets)) {
+        selected[bucket] = true;
+      }
+    }
+    QList<Identifier> ids;
+    if (query.hasQueryItem("near")) {
+      // ... and/or to the k stations nearest to near=lon,lat or those within radius km of it,
+      // nearest first
+      QStringList coords = query.queryItemValue("near").split(",");
+      if (2 != coords.size()) { return QByteArray(); }
+      Location loc(coords[0].toDouble(), coords[1].toDouble(), 0);
+      bool ok; double radius = query.queryItemValue("radius").toDouble(&ok);
+      if (ok && (radius > 0)) {
+        ids = _stations->spatialIndex().within(loc, radius);
+      } else {
+        int k = query.queryItemValue("k").toInt(&ok);
+        ids = _stations->spatialIndex().nearest(loc, (ok && (k > 0)) ? k : STATION_NEAR_DEFAULT);
+      }
+    } else {
+      for (size_t i=0; i<_stations->numStations(); i++) {
+        ids.append(_stations->station(i).id());
+      }
+    }
+    if (binary) {
+      BinaryWriter writer(BinaryCodec::LIST);
+      foreach (Identifier station, ids) {
+        if (! selected[StationDigest::bucket(station)]) { continue; }
+        writer.beginRecord();
+        writer.writeIdentifier(station);
+        writer.endRecord();
+      }
+      return writer.data();
+    }
     QJsonArray stations;
-    for (size_t i=0; i<_stations->numStations(); i++) {
-      stations.append(_stations->station(i).id().toBase32());
+    foreach (Identifier station, ids) {
+      if (! selected[StationDigest::bucket(station)]) { continue; }
+      stations.append(station.toBase32());
     }
-    return new HttpJsonResponse(QJsonDocument(stations), request);
-  } else if ((HTTP_GET == request->method()) && ("/schedule" == request->uri().path())) {
+    return QJsonDocument(stations).toJson(QJsonDocument::Compact);
+  } else if ("/list/digest" == path) {
+    // Handle station list digest request
+    BinaryWriter writer(BinaryCodec::DIGEST);
+    _stations->digest().toBinary(writer);
+    return writer.data();
+  } else if ("/schedule" == path) {
     // Handle schedule request
+    if (binary) {
+      BinaryWriter writer(BinaryCodec::SCHEDULE);
+      for (size_t i=0; i<_schedule->numEvents(); i++) {
+        _schedule->scheduledEvent(i).toBinary(writer);
+      }
+      return writer.data();
+    }
     QJsonArray schedule;
     for (size_t i=0; i<_schedule->numEvents(); i++) {
       schedule.append(_schedule->scheduledEvent(i).toJson());
     }
-    return new HttpJsonResponse(QJsonDocument(schedule), request);
-  } else if ((HTTP_GET == request->method()) && ("/data" == request->uri().path())) {
+    return QJsonDocument(schedule).toJson(QJsonDocument::Compact);
+  } else if ("/data" == path) {
     // Handle dataset list queries
-    return new HttpJsonResponse(QJsonDocument(_datasets->toJson()), request);
-  } else if ((HTTP_GET == request->method()) && request->uri().path().startsWith("/data")) {
-    // Handle data download queries
-    QString id = request->uri().path().mid(6);
-    if (! _datasets->contains(Identifier::fromBase32(id))) {
-      return new HttpStringResponse(request->version(), HTTP_NOT_FOUND, "Not found.",
-                                    request->socket());
+    if (binary) {
+      return _datasets->toBinary();
     }
-    // serve file
-    return new HttpFileResponse(
-          _datasets->dataset(Identifier::fromBase32(id)).filename(), request);
+    return QJsonDocument(_datasets->toJson()).toJson(QJsonDocument::Compact);
   }
+  return QByteArray();
+}
 
-  // Unknown request -> send a 404
-  return new HttpStringResponse(
-        request->version(), HTTP_NOT_FOUND, "Not found", request->socket());
+QByteArray
+Station::_sidData(const QUrlQuery &query, bool binary) {
+  if (! query.hasQueryItem("series")) {
+    // List all series
+    if (binary) {
+      BinaryWriter writer(BinaryCodec::SID_SERIES);
+      _sid->seriesToBinary(writer);
+      return writer.data();
+    }
+    return QJsonDocument(_sid->seriesToJson()).toJson(QJsonDocument::Compact);
+  }
+
+  QString series = query.queryItemValue("series");
+  qint64 first = 0, last = 0;
+  if (! _sid->range(series, first, last)) { return QByteArray(); }
+  // Range defaults to the complete series, [from, to) in ms since epoch
+  bool ok;
+  qint64 from = query.queryItemValue("from").toLongLong(&ok);
+  if (! ok) { from = first; }
+  qint64 to = query.queryItemValue("to").toLongLong(&ok);
+  if (! ok) { to = last+1; }
+  // Use the requested level or the finest one with at most the requested number of points
+  SidStore::Level level = SidStore::RAW;
+  int value = query.queryItemValue("level").toInt(&ok);
+  if (ok && (value >= 0) && (value < SidStore::NumLevels)) {
+    level = SidStore::Level(value);
+  } else {
+    value = query.queryItemValue("points").toInt(&ok);
+    value = (ok && (value > 0)) ? std::min(value, STATION_SID_MAX_ROWS) : 2000;
+    level = SidStore::level(from, to, value, _sid->rawRate());
+    // Raw rows before the retention are gone, fall back to the rollups
+    qint64 rawFirst = 0, rawLast = 0;
+    if ((SidStore::RAW == level) && _sid->range(series, SidStore::RAW, rawFirst, rawLast)
+        && (from < (rawFirst - SidStore::interval(SidStore::HOUR)))) {
+      level = SidStore::level(from, to, value, 0);
+    }
+  }
+
+  // Serve at most one page, the client continues at the time of the next row (-1 if none)
+  QVector<SidRow> rows = _sid->query(series, from, to, level, STATION_SID_MAX_ROWS+1);
+  qint64 next = -1;
+  if (rows.size() > STATION_SID_MAX_ROWS) {
+    next = rows.last().time;
+    rows.removeLast();
+  }
+  if (binary) {
+    BinaryWriter writer(BinaryCodec::SID);
+    writer.beginRecord();
+    writer.writeString(series);
+    writer.writeInt64(SidStore::interval(level));
+    writer.writeInt64(next);
+    writer.endRecord();
+    foreach (SidRow row, rows) {
+      writer.beginRecord();
+      writer.writeInt64(row.time);
+      writer.writeFloat(row.mean);
+      writer.writeFloat(row.min);
+      writer.writeFloat(row.max);
+      writer.writeFloat(row.phase);
+      writer.endRecord();
+    }
+    return writer.data();
+  }
+  QJsonArray time, mean, min, max, phase;
+  foreach (SidRow row, rows) {
+    time.append(double(row.time));
+    mean.append(row.mean);
+    min.append(row.min);
+    max.append(row.max);
+    // NaN is not valid JSON
+    phase.append(std::isnan(row.phase) ? QJsonValue() : QJsonValue(row.phase));
+  }
+  QJsonObject result;
+  result.insert("series", series);
+  result.insert("interval", double(SidStore::interval(level)));
+  result.insert("next", double(next));
+  result.insert("time", time);
+  result.insert("mean", mean);
+  result.insert("min", min);
+  result.insert("max", max);
+  result.insert("phase", phase);
+  return QJsonDocument(result).toJson(QJsonDocument::Compact);
+}
+
+void
+Station::_dropCachedResponses(const QString &path) {
+  QHash<QString, QByteArray>::iterator item = _responseCache.begin();
+  while (item != _responseCache.end()) {
+    if (item.key().startsWith(path+"?")) {
+      item = _responseCache.erase(item);
+    } else {
+      item++;
+    }
+  }
+}
+
+void
+Station::_createTracker(const ReceiverConfig &config) {
+  delete _tracker;
+  _tracker = 0;
+  _sid->setRawRate(0, 0);
+  if (! config.isTracking()) { return; }
+  _tracker = new BeaconReceiver(config.trackedBeacons(), config.tau(), config, *this);
+  _tracker->setRecordRate(config.recordRate());
+  _sid->setRawRate(_tracker->recordRate(), config.trackedBeacons().size());
+  if (! _tracker->start()) {
+    logError() << "Cannot start beacon tracker.";
+    return;
+  }
+  logInfo() << "Track " << config.trackedBeacons().size() << " beacons.";
 }
 
 void
@@ -189,3 +509,19 @@ void
 Station::_onDisconnected() {
   _bootstrapTimer.start();
 }
+
+void
+Station::_onStationsChanged() {
+  _dropCachedResponses("/list");
+  _dropCachedResponses("/list/digest");
+}
+
+void
+Station::_onScheduleChanged() {
+  _dropCachedResponses("/schedule");
+}
+
+void
+Station::_onDataSetsChanged() {
+  _dropCachedResponses("/data");
+}
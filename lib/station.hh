@@ -6,10 +6,18 @@
 #include <ovlnet/httpservice.hh>
 #include "datasetfile.hh"
 #include <QAudioDeviceInfo>
+#include <QUrlQuery>
 
 class StationList;
+class ResolveCache;
+class QueryScheduler;
 class MergedSchedule;
 class Receiver;
+class ReceiverConfig;
+class BeaconReceiver;
+class FFTPlanCache;
+class SidStore;
+class Pipeline;
 
 
 /** Central class of all vlfnet stations. It keeps track of all known stations in the network and
@@ -23,6 +31,8 @@ public:
    * @c path. The underlying ovlnet node gets bound to the specified @c addr and @c port. */
   explicit Station(const QString &path, const QHostAddress &addr=QHostAddress::Any,
                    uint16_t port=7741, QObject *parent=0);
+  /** Destructor, stops the beacon tracker. */
+  virtual ~Station();
 
   /** Returns the location of the station. */
   const Location &location() const;
@@ -32,12 +42,26 @@ public:
   /** Returns a list of known stations. */
   StationList &stations();
 
+  /** Returns the cache of resolved station identifiers. */
+  ResolveCache &resolver();
+  /** Returns the scheduler of all outbound queries. */
+  QueryScheduler &queries();
+
   /** Returns the schedule of the station. */
   MergedSchedule &schedule();
 
   /** Returns the datasets held by this station. */
   DataSetDir &datasets();
 
+  /** Returns the station-wide cache of FFT plans. */
+  FFTPlanCache &fftPlans();
+  /** Returns the store of SID time series. */
+  SidStore &sid();
+  /** Returns the registry of the processing stages of the sample streams. */
+  Pipeline &pipeline();
+  /** Returns the receiver of scheduled recordings. */
+  Receiver &receiver();
+
   /** Returns the configured default reception device. */
   QAudioDeviceInfo inputDevice() const;
   /** Sets the default reception device. */
@@ -48,6 +72,20 @@ public:
   /** Processes accepted HTTP requests. */
   HttpResponse *processRequest(HttpRequest *request);
 
+protected:
+  /** Returns @c true if the specified path is a metadata endpoint. */
+  bool _isMetadata(const QString &path) const;
+  /** Assembles the response body of the specified metadata endpoint. */
+  QByteArray _metadata(const QString &path, const QUrlQuery &query, bool binary);
+  /** Assembles the response body of the SID endpoint. Returns an empty array if the requested
+   * series is unknown. Long ranges are served in pages, the response holds the time to request
+   * the next page from. */
+  QByteArray _sidData(const QUrlQuery &query, bool binary);
+  /** Drops all cached responses for the specified path. */
+  void _dropCachedResponses(const QString &path);
+  /** (Re-)Creates and starts the beacon tracker if beacons are configured for tracking. */
+  void _createTracker(const ReceiverConfig &config);
+
 protected slots:
   /** Gets called periodically until the node is connected to the network. */
   void _onBootstrap();
@@ -55,12 +93,22 @@ protected slots:
   void _onDisconnected();
   /** Gets called once the connection to the network is established. */
   void _onConnected();
+  /** Gets called if the station list changed. */
+  void _onStationsChanged();
+  /** Gets called if the schedule changed. */
+  void _onScheduleChanged();
+  /** Gets called if the dataset list changed. */
+  void _onDataSetsChanged();
 
 protected:
   /** Path to the configuration directory. */
   QString _path;
   /** My location. */
   Location _location;
+  /** Cache of resolved station identifiers. */
+  ResolveCache *_resolver;
+  /** Scheduler for outbound queries. */
+  QueryScheduler *_queries;
   /** A list of known stations. */
   StationList *_stations;
   /** The reception schedule of the station. */
@@ -69,10 +117,20 @@ protected:
   DataSetDir *_datasets;
   /** The receiver. */
   Receiver *_receiver;
+  /** Tracks the configured beacons and records their amplitudes into the SID store. */
+  BeaconReceiver *_tracker;
+  /** FFT plans and wisdom. */
+  FFTPlanCache *_fftPlans;
+  /** Beacon amplitude time series. */
+  SidStore *_sid;
+  /** Processing stages of the sample streams. */
+  Pipeline *_pipeline;
   /** Timer to bootstrap the net on connection loss. */
   QTimer _bootstrapTimer;
   /** Whitelist for the remote ctrl. */
   QSet<Identifier> _ctrlWhitelist;
+  /** Compressed metadata responses, keyed by path and format. */
+  QHash<QString, QByteArray> _responseCache;
 };
 
 #endif // STATION_HH
@@ -0,0 +1,97 @@
+#include "stationdigest.hh"
+#include "binarycodec.hh"
+
+
+/* ********************************************************************************************* *
+ * Implementation of StationDigest
+ * ********************************************************************************************* */
+StationDigest::StationDigest()
+  : _counts(NumBuckets, 0), _digests(NumBuckets, QByteArray(OVL_HASH_SIZE, 0)), _numRead(0)
+{
+  // pass...
+}
+
+StationDigest::StationDigest(const StationDigest &other)
+  : _counts(other._counts), _digests(other._digests), _numRead(other._numRead)
+{
+  // pass...
+}
+
+StationDigest &
+StationDigest::operator =(const StationDigest &other) {
+  _counts = other._counts;
+  _digests = other._digests;
+  _numRead = other._numRead;
+  return *this;
+}
+
+void
+StationDigest::add(const Identifier &id) {
+  if (OVL_HASH_SIZE != id.size()) { return; }
+  _counts[bucket(id)]++;
+  _toggle(id);
+}
+
+void
+StationDigest::remove(const Identifier &id) {
+  if (OVL_HASH_SIZE != id.size()) { return; }
+  _counts[bucket(id)]--;
+  _toggle(id);
+}
+
+uint32_t
+StationDigest::count(int bucket) const {
+  return _counts[bucket];
+}
+
+const QByteArray &
+StationDigest::digest(int bucket) const {
+  return _digests[bucket];
+}
+
+QList<int>
+StationDigest::differing(const StationDigest &other) const {
+  QList<int> buckets;
+  for (int i=0; i<NumBuckets; i++) {
+    if ((_counts[i] != other._counts[i]) || (_digests[i] != other._digests[i])) {
+      buckets.append(i);
+    }
+  }
+  return buckets;
+}
+
+void
+StationDigest::toBinary(BinaryWriter &writer) const {
+  for (int i=0; i<NumBuckets; i++) {
+    writer.beginRecord();
+    writer.writeUInt32(_counts[i]);
+    writer.writeIdentifier(Identifier(_digests[i].constData()));
+    writer.endRecord();
+  }
+}
+
+bool
+StationDigest::readBucket(BinaryReader &record) {
+  if (_numRead >= NumBuckets) { return false; }
+  uint32_t count; Identifier digest;
+  if (! (record.readUInt32(count) && record.readIdentifier(digest))) {
+    return false;
+  }
+  _counts[_numRead] = count;
+  _digests[_numRead] = QByteArray(digest.constData(), OVL_HASH_SIZE);
+  _numRead++;
+  return true;
+}
+
+int
+StationDigest::bucket(const Identifier &id) {
+  return uint8_t(id.at(0));
+}
+
+void
+StationDigest::_toggle(const Identifier &id) {
+  QByteArray &digest = _digests[bucket(id)];
+  for (int i=0; i<OVL_HASH_SIZE; i++) {
+    digest[i] = digest.at(i) ^ id.at(i);
+  }
+}
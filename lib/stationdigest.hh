@@ -0,0 +1,73 @@
+#ifndef STATIONDIGEST_HH
+#define STATIONDIGEST_HH
+
+#include <QVector>
+#include <QList>
+#include <QByteArray>
+#include <ovlnet/buckets.hh>
+
+class BinaryReader;
+class BinaryWriter;
+
+
+/** Compact summary of a set of station identifiers used to reconcile station lists.
+ * The identifiers are split into 256 buckets by their first byte. Each bucket holds the number
+ * of identifiers and the XOR of all identifiers in it. Two stations compare their digests and
+ * only exchange the identifiers of buckets that differ. The digest of a station includes its own
+ * identifier, such that two stations knowing the same network have equal digests.
+ *
+ * The number of buckets is fixed, hence the cost of a reconciliation grows with the network: each
+ * bucket holds about N/256 of N stations and a single differing station costs the transfer of its
+ * whole bucket (about 8kB at 100000 stations). Once about 256 stations differ, almost all buckets
+ * do and the exchange degrades to the complete list. This is fine for networks of some thousand
+ * stations reconciling every few minutes. Larger networks need to split differing buckets
+ * recursively or an invertible bloom lookup table, both changing the digest endpoint. */
+class StationDigest
+{
+public:
+  /** Number of buckets. */
+  static const int NumBuckets = 256;
+
+public:
+  /** Constructs an empty digest. */
+  StationDigest();
+  /** Copy constructor. */
+  StationDigest(const StationDigest &other);
+  /** Assignment operator. */
+  StationDigest &operator=(const StationDigest &other);
+
+  /** Adds an identifier. */
+  void add(const Identifier &id);
+  /** Removes an identifier. */
+  void remove(const Identifier &id);
+
+  /** Returns the number of identifiers in the specified bucket. */
+  uint32_t count(int bucket) const;
+  /** Returns the XOR of all identifiers in the specified bucket. */
+  const QByteArray &digest(int bucket) const;
+  /** Returns the buckets that differ between this and the other digest. */
+  QList<int> differing(const StationDigest &other) const;
+
+  /** Serializes the digest into one binary record per bucket. */
+  void toBinary(BinaryWriter &writer) const;
+  /** Reads the next bucket from a binary record. Returns @c false on error or if all buckets
+   * were read. */
+  bool readBucket(BinaryReader &record);
+
+  /** Returns the bucket of an identifier. */
+  static int bucket(const Identifier &id);
+
+protected:
+  /** Toggles the identifier in the XOR of its bucket. */
+  void _toggle(const Identifier &id);
+
+protected:
+  /** Number of identifiers per bucket. */
+  QVector<uint32_t> _counts;
+  /** XOR of the identifiers per bucket. */
+  QVector<QByteArray> _digests;
+  /** Number of buckets read by @c readBucket. */
+  int _numRead;
+};
+
+#endif // STATIONDIGEST_HH
@@ -1,34 +1,49 @@
 #include "stationlist.hh"
 #include "station.hh"
 #include "query.hh"
+#include "resolvecache.hh"
+#include "queryscheduler.hh"
+#include "binarycodec.hh"
 #include <ovlnet/utils.hh>
 #include <QJsonObject>
+#include <QJsonArray>
+#include <QSaveFile>
+#include <QFile>
+#include <algorithm>
 
 
 /* ********************************************************************************************* *
  * Implementation of StationItem
  * ********************************************************************************************* */
 StationItem::StationItem()
-  : _lastSeen(), _node(), _location(), _description()
+  : _lastSeen(), _node(), _location(), _description(),
+    _failures(0), _successes(0), _rtt(0), _refreshInterval(NetworkPolicy::MinRefresh),
+    _nextRefresh(0)
 {
   // pass...
 }
 
 StationItem::StationItem(const Identifier &id, const Location &location, const QString &descr)
   : _lastSeen(QDateTime::currentDateTime()), _node(id, QHostAddress(), 0), _location(location),
-    _description(descr)
+    _description(descr),
+    _failures(0), _successes(0), _rtt(0), _refreshInterval(NetworkPolicy::MinRefresh),
+    _nextRefresh(0)
 {
   // pass...
 }
 
 StationItem::StationItem(const NodeItem &node, const Location &location, const QString &descr)
-  : _lastSeen(QDateTime::currentDateTime()), _node(node), _location(location), _description(descr)
+  : _lastSeen(QDateTime::currentDateTime()), _node(node), _location(location), _description(descr),
+    _failures(0), _successes(0), _rtt(0), _refreshInterval(NetworkPolicy::MinRefresh),
+    _nextRefresh(0)
 {
   // pass...
 }
 
 StationItem::StationItem(const NodeItem &node, const QJsonObject &obj)
-  : _lastSeen(QDateTime::currentDateTime()), _node(node), _location(), _description()
+  : _lastSeen(QDateTime::currentDateTime()), _node(node), _location(), _description(),
+    _failures(0), _successes(0), _rtt(0), _refreshInterval(NetworkPolicy::MinRefresh),
+    _nextRefresh(0)
 {
   if (! obj.contains("id")) {
     logDebug() << "Cannot construct StationItem from JSON document: Does not specify a station ID.";
@@ -53,9 +68,30 @@ StationItem::StationItem(const NodeItem &node, const QJsonObject &obj)
              << ") @" << _location.longitude() << ", " << _location.latitude(); */
 }
 
+StationItem::StationItem(const NodeItem &node, BinaryReader &record)
+  : _lastSeen(QDateTime::currentDateTime()), _node(node), _location(), _description(),
+    _failures(0), _successes(0), _rtt(0), _refreshInterval(NetworkPolicy::MinRefresh),
+    _nextRefresh(0)
+{
+  Identifier id; double lon, lat, height;
+  if (! (record.readIdentifier(id) && record.readDouble(lon) && record.readDouble(lat)
+         && record.readDouble(height) && record.readString(_description))) {
+    logDebug() << "Cannot construct StationItem from binary record: Record too short.";
+    _node = NodeItem(); return;
+  }
+  // Verify node info with ID
+  if (_node.id() != id) {
+    logDebug() << "Cannot construct StationItem from binary record: Node ID missmatch!";
+    _node = NodeItem(); return;
+  }
+  _location = Location(lon, lat, height);
+}
+
 StationItem::StationItem(const StationItem &other)
   : _lastSeen(other._lastSeen), _node(other._node), _location(other._location),
-    _description(other._description)
+    _description(other._description), _failures(other._failures),
+    _successes(other._successes), _rtt(other._rtt), _refreshInterval(other._refreshInterval),
+    _nextRefresh(other._nextRefresh)
 {
   // pass...
 }
@@ -66,6 +102,11 @@ StationItem::operator =(const StationItem &other) {
   _node = other._node;
   _location = other._location;
   _description = other._description;
+  _failures = other._failures;
+  _successes = other._successes;
+  _rtt = other._rtt;
+  _refreshInterval = other._refreshInterval;
+  _nextRefresh = other._nextRefresh;
   return *this;
 }
 
@@ -110,24 +151,141 @@ StationItem::update(const PeerItem &peer) {
   _lastSeen = QDateTime::currentDateTime();
 }
 
+size_t
+StationItem::failures() const {
+  return _failures;
+}
+
+size_t
+StationItem::successes() const {
+  return _successes;
+}
+
+double
+StationItem::rtt() const {
+  return _rtt;
+}
+
+qint64
+StationItem::refreshInterval() const {
+  return _refreshInterval;
+}
+
+qint64
+StationItem::nextRefresh() const {
+  return _nextRefresh;
+}
+
+void
+StationItem::takeStats(const StationItem &other) {
+  _failures = other._failures;
+  _successes = other._successes;
+  _rtt = other._rtt;
+  _refreshInterval = other._refreshInterval;
+  _nextRefresh = other._nextRefresh;
+}
+
+void
+StationItem::succeeded(double rtt) {
+  _lastSeen = QDateTime::currentDateTime();
+  if (rtt >= 0) {
+    // Smooth RTT like TCP does
+    _rtt = (0 == _rtt) ? rtt : (7*_rtt + rtt)/8;
+  }
+  // Refresh stable stations less often
+  _refreshInterval = NetworkPolicy::refreshAfterSuccess(_refreshInterval, _successes, _failures);
+  _successes++;
+  _failures = 0;
+  _nextRefresh = QDateTime::currentMSecsSinceEpoch() + _refreshInterval;
+}
+
+void
+StationItem::failed() {
+  _failures++;
+  _refreshInterval = NetworkPolicy::refreshAfterFailure(_failures);
+  _nextRefresh = QDateTime::currentMSecsSinceEpoch() + _refreshInterval;
+}
+
+QJsonObject
+StationItem::toJson() const {
+  QJsonObject obj;
+  obj.insert("id", id().toBase32());
+  obj.insert("address", _node.addr().toString());
+  obj.insert("port", int(_node.port()));
+  obj.insert("location", _location.toJson());
+  obj.insert("description", _description);
+  obj.insert("lastSeen", _lastSeen.toUTC().toString("yyyy-MM-dd hh:mm:ss"));
+  obj.insert("failures", int(_failures));
+  obj.insert("successes", int(_successes));
+  obj.insert("rtt", _rtt);
+  return obj;
+}
+
+StationItem
+StationItem::fromJson(const QJsonObject &obj) {
+  Identifier id = Identifier::fromBase32(obj.value("id").toString());
+  QHostAddress addr(obj.value("address").toString());
+  if ((! id.isValid()) || addr.isNull() || (! obj.value("location").isObject())) {
+    return StationItem();
+  }
+  StationItem item(NodeItem(id, addr, obj.value("port").toInt()),
+                   Location(obj.value("location").toObject()),
+                   obj.value("description").toString());
+  QDateTime lastSeen = QDateTime::fromString(obj.value("lastSeen").toString(),
+                                             "yyyy-MM-dd hh:mm:ss");
+  if (lastSeen.isValid()) {
+    lastSeen.setTimeSpec(Qt::UTC);
+    item._lastSeen = lastSeen.toLocalTime();
+  }
+  item._failures = obj.value("failures").toInt();
+  item._successes = obj.value("successes").toInt();
+  item._rtt = obj.value("rtt").toDouble();
+  return item;
+}
+
 
 /* ********************************************************************************************* *
  * Implementation of StationList
  * ********************************************************************************************* */
-StationList::StationList(Station &station)
-  : QAbstractTableModel(&station), _station(station)
+StationList::StationList(Station &station, const QString &cacheFile)
+  : QAbstractTableModel(&station), _station(station), _stations(), _index(), _distances(),
+    _spatial(), _digest(), _policy(8),
+    _probeStart(), _probeQueries(), _deadTime(7*24*3600*1000LL),
+    _networkUpdateTimer(), _reconcileTimer(), _cacheFile(cacheFile), _unverified(), _saveTimer()
 {
-  // every 10min update the network of known stations
-  _networkUpdateTimer.setInterval(1000*600);
-  _networkUpdateTimer.setSingleShot(false);
+  // The digest includes this station, such that stations knowing the same network agree
+  _digest.add(_station.id());
+
+  // Contacts candidates and refreshes known stations once they are due
+  _networkUpdateTimer.setInterval(1000);
+  _networkUpdateTimer.setSingleShot(true);
+  // The interval of the reconciliation adapts to the number of pending candidates
+  _reconcileTimer.setInterval(1000);
+  _reconcileTimer.setSingleShot(true);
 
   connect(&_networkUpdateTimer, SIGNAL(timeout()), this, SLOT(_onUpdateNetwork()));
+  connect(&_reconcileTimer, SIGNAL(timeout()), this, SLOT(_onReconcile()));
 
   _networkUpdateTimer.start();
+  _reconcileTimer.start();
+
+  if (! _cacheFile.isEmpty()) {
+    // Warm start from the station cache
+    load();
+    // save cache every 10min
+    _saveTimer.setInterval(1000*600);
+    _saveTimer.setSingleShot(false);
+    connect(&_saveTimer, SIGNAL(timeout()), this, SLOT(_onSave()));
+    _saveTimer.start();
+  }
 
   // done...
 }
 
+StationList::~StationList() {
+  save();
+}
+
 size_t
 StationList::numStations() const {
   return _stations.size();
@@ -135,12 +293,7 @@ StationList::numStations() const {
 
 bool
 StationList::hasStation(const Identifier &id) const {
-  for (int i=0; i<_stations.size(); i++) {
-    if (_stations[i].id() == id) {
-      return true;
-    }
-  }
-  return false;
+  return _index.contains(id);
 }
 
 const StationItem &
@@ -163,32 +316,138 @@ StationList::station(const Identifier &id) {
   return _stations[indexOf(id)];
 }
 
-size_t
-StationList::indexOf(const Identifier &id) const {
+double
+StationList::distance(size_t i) const {
+  return _distances[i].first;
+}
+
+const SpatialIndex &
+StationList::spatialIndex() const {
+  return _spatial;
+}
+
+void
+StationList::updateDistances() {
   for (int i=0; i<_stations.size(); i++) {
-    if (_stations[i].id() == id) { return i; }
+    _distances[i] = qMakePair(_stations[i].location().arcDist(_station.location()),
+                              _stations[i].location().lineDist(_station.location()));
   }
-  return _stations.size();
+  if (_stations.size()) {
+    emit dataChanged(index(0, 5), index(_stations.size()-1, 5));
+  }
+}
 
+void
+StationList::_updateLocation(int idx) {
+  const Location &loc = _stations[idx].location();
+  if (_distances.size() <= idx) {
+    _distances.resize(idx+1);
+  }
+  _distances[idx] = qMakePair(loc.arcDist(_station.location()), loc.lineDist(_station.location()));
+  _spatial.insert(_stations[idx].id(), loc);
+}
+
+const StationDigest &
+StationList::digest() const {
+  return _digest;
+}
+
+const CrawlQueue &
+StationList::crawler() const {
+  return _policy.crawler();
+}
+
+void
+StationList::setMaxProbes(size_t n) {
+  _policy.setMaxProbes(n);
+}
+
+void
+StationList::setDeadTime(size_t sec) {
+  _deadTime = qint64(sec)*1000;
+}
+
+bool
+StationList::load() {
+  QFile file(_cacheFile);
+  if (! file.exists()) { return true; }
+  if (! file.open(QIODevice::ReadOnly)) {
+    logError() << "Cannot read station cache " << _cacheFile << ".";
+    return false;
+  }
+  QJsonDocument doc = QJsonDocument::fromJson(file.readAll());
+  file.close();
+  if (! doc.isArray()) {
+    logError() << "Invalid station cache " << _cacheFile << ": Not an array.";
+    return false;
+  }
+
+  QJsonArray stations = doc.array();
+  beginResetModel();
+  for (int i=0; i<stations.size(); i++) {
+    StationItem item = StationItem::fromJson(stations.at(i).toObject());
+    if (item.isNull() || _index.contains(item.id()) || (_station.id() == item.id())) {
+      continue;
+    }
+    _index.insert(item.id(), _stations.size());
+    _digest.add(item.id());
+    _stations.append(item);
+    _updateLocation(_stations.size()-1);
+    // Seed resolver and revalidate later
+    _station.resolver().insert(item.node());
+    _unverified.append(item.node());
+  }
+  endResetModel();
+  logInfo() << "Loaded " << _stations.size() << " stations from " << _cacheFile << ".";
+
+  // Revalidate stations once the event loop is running
+  if (_unverified.size()) {
+    QTimer::singleShot(0, this, SLOT(_onRevalidate()));
+  }
+  return true;
+}
+
+bool
+StationList::save() const {
+  if (_cacheFile.isEmpty()) { return false; }
+  QJsonArray stations;
+  for (int i=0; i<_stations.size(); i++) {
+    stations.append(_stations[i].toJson());
+  }
+  QSaveFile file(_cacheFile);
+  if (! file.open(QIODevice::WriteOnly)) {
+    logError() << "Cannot write station cache " << _cacheFile << ".";
+    return false;
+  }
+  file.write(QJsonDocument(stations).toJson());
+  return file.commit();
+}
+
+size_t
+StationList::indexOf(const Identifier &id) const {
+  return _index.value(id, _stations.size());
 }
 
 void
 StationList::addCandidate(const Identifier &id) {
-  if (! hasStation(id)) {
-    _candidates.insert(id);
+  if ((! hasStation(id)) && (_station.id() != id)
+      && _policy.crawler().add(id, QDateTime::currentMSecsSinceEpoch())) {
+    _wakeUp(1000);
   }
 }
 
 void
 StationList::contactStation(const NodeItem &node) {
-  StationInfoQuery *query = new StationInfoQuery(_station, node);
+  StationInfoQuery *query = _station.queries().submit(
+        new StationInfoQuery(_station, node), QueryScheduler::BACKGROUND);
   connect(query, SIGNAL(stationInfoReceived(StationItem)),
           this, SLOT(updateStation(StationItem)));
 }
 
 void
 StationList::contactStation(const Identifier &node) {
-  StationInfoQuery *query = new StationInfoQuery(_station, node);
+  StationInfoQuery *query = _station.queries().submit(
+        new StationInfoQuery(_station, node), QueryScheduler::BACKGROUND);
   connect(query, SIGNAL(stationInfoReceived(StationItem)),
           this, SLOT(updateStation(StationItem)));
 }
@@ -196,52 +455,239 @@ StationList::contactStation(const Identifier &node) {
 void
 StationList::updateStation(const StationItem &station) {
   if (station.isNull()) { return; }
-  if (hasStation(station.id())) {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  // Remember address of station
+  _station.resolver().insert(station.node());
+  // Remove from candidates
+  _policy.crawler().succeeded(station.id(), now);
+  // Measure RTT if the station was probed
+  double rtt = -1;
+  if (_probeStart.contains(station.id())) {
+    rtt = now - _probeStart.take(station.id());
+  }
+  QHash<Identifier, int>::const_iterator item = _index.find(station.id());
+  if (_index.end() != item) {
     // If station extists: update station
-    size_t idx = indexOf(station.id());
-    _stations[idx] = station;
-    emit dataChanged(index(idx, 0), index(idx, 4));
+    int idx = item.value();
+    StationItem updated(station);
+    updated.takeStats(_stations[idx]);
+    updated.succeeded(rtt);
+    _stations[idx] = updated;
+    _updateLocation(idx);
+    _scheduleRefresh(idx);
+    emit dataChanged(index(idx, 0), index(idx, 8));
   } else {
-    // Remove from candidates
-    _candidates.remove(station.id());
     // & add to station list
     beginInsertRows(QModelIndex(), _stations.size(), _stations.size());
+    _index.insert(station.id(), _stations.size());
+    _digest.add(station.id());
     _stations.append(station);
+    _stations.last().succeeded(rtt);
+    _updateLocation(_stations.size()-1);
+    _scheduleRefresh(_stations.size()-1);
     endInsertRows();
   }
   // logDebug() << "Station " << station.id() << ": Status updated.";
   emit stationUpdated(station);
 }
 
+void
+StationList::_scheduleRefresh(int idx) {
+  _policy.scheduleRefresh(_stations[idx].id(), _stations[idx].nextRefresh());
+  _wakeUp(_stations[idx].nextRefresh() - QDateTime::currentMSecsSinceEpoch());
+}
+
+void
+StationList::_wakeUp(qint64 delay) {
+  delay = std::max(qint64(0), delay);
+  if ((! _networkUpdateTimer.isActive()) || (_networkUpdateTimer.remainingTime() > delay)) {
+    _networkUpdateTimer.start(delay);
+  }
+}
+
+void
+StationList::_removeStation(int idx) {
+  Identifier id = _stations[idx].id();
+  logInfo() << "Remove station " << id << ": Not seen since "
+            << _stations[idx].lastSeen().toString() << ".";
+  beginRemoveRows(QModelIndex(), idx, idx);
+  _stations.remove(idx);
+  _distances.remove(idx);
+  _index.remove(id);
+  _digest.remove(id);
+  _spatial.remove(id);
+  _policy.removeRefresh(id);
+  // Update rows of all following stations
+  for (int i=idx; i<_stations.size(); i++) {
+    _index[_stations[i].id()] = i;
+  }
+  endRemoveRows();
+  emit stationRemoved(id);
+}
+
 void
 StationList::addToCandidates(const QList<Identifier> &nodes) {
   // logDebug() << "Received list of " << nodes.size() << " station identifiers.";
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  size_t added = 0;
   QList<Identifier>::const_iterator node = nodes.begin();
   for (; node != nodes.end(); node++) {
     // only add new stations
-    if ((! hasStation(*node)) && (_station.id() != *node)) {
-      _candidates.insert(*node);
+    if ((! hasStation(*node)) && (_station.id() != *node) && _policy.crawler().add(*node, now)) {
+      added++;
     }
   }
+  // Speed up crawler if new candidates arrived
+  if (added) {
+    _wakeUp(0);
+  }
+}
+
+void
+StationList::_probe(const Identifier &id) {
+  _connectProbe(_station.queries().submit(
+                  new StationInfoQuery(_station, id), QueryScheduler::BACKGROUND));
+}
+
+void
+StationList::_probe(const NodeItem &node) {
+  _connectProbe(_station.queries().submit(
+                  new StationInfoQuery(_station, node), QueryScheduler::BACKGROUND));
+}
+
+void
+StationList::_connectProbe(StationInfoQuery *query) {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  if (_probeQueries.contains(query)) {
+    // The scheduler returned a running probe of the same station, which is connected already.
+    // Release the probe counted for this one.
+    _policy.probeDone(now);
+    return;
+  }
+  _probeQueries.insert(query);
+  _probeStart.insert(query->remote(), now);
+  connect(query, SIGNAL(stationInfoReceived(StationItem)),
+          this, SLOT(updateStation(StationItem)));
+  connect(query, SIGNAL(failed()), this, SLOT(_onProbeFailed()));
+  connect(query, SIGNAL(destroyed()), this, SLOT(_onProbeDone()));
 }
 
 void
 StationList::_onUpdateNetwork() {
-  // As long as there are items in the candidate queue -> contact them
-  if (_candidates.size()) {
-    // Take some element
-    Identifier id = *_candidates.begin(); _candidates.remove(id);
-    contactStation(id);
-  } else if (_stations.size()) {
-    // If all candidates has been contacted search for new candidates
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  // Contact pending candidates and refresh known stations in parallel
+  Identifier id; bool refresh;
+  while (_policy.nextProbe(id, refresh, now)) {
+    if (! refresh) {
+      _probe(id);
+    } else if (_index.contains(id) && (station(id).failures() < 2)) {
+      _probe(station(id).node());
+    } else {
+      // Station may have moved, resolve it again
+      _probe(id);
+    }
+  }
+
+  const CrawlQueue &crawl = _policy.crawler();
+  double rate = crawl.discoveryRate(now);
+  if (crawl.numPending()) {
+    logDebug() << "Crawler: " << _stations.size() << " stations known, "
+               << crawl.numPending() << " candidates pending, " << rate << " stations/min.";
+  }
+  emit crawlProgress(_stations.size(), crawl.numPending(), rate);
+
+  // Without candidates or refreshes waiting, new ones restart the timer
+  qint64 interval = _policy.nextRound(now);
+  if (interval >= 0) {
+    _networkUpdateTimer.start(interval);
+  }
+}
+
+void
+StationList::_onReconcile() {
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  if (_policy.reconcile() && _stations.size()) {
+    // If all candidates has been contacted search for new candidates. Compare digests first
+    // and only fetch the stations of differing buckets.
     size_t idx = dht_rand32() % _stations.size();
-    // Update station itself
-    contactStation(_stations[idx].id());
-    // and get station list
-    // logDebug() << "Update network: Query start list from " << _stations[idx].id();
-    StationListQuery *query = new StationListQuery(_station, _stations[idx].id());
-    connect(query, SIGNAL(stationListReceived(QList<Identifier>)),
-            this, SLOT(addToCandidates(QList<Identifier>)));
+    StationDigestQuery *query = _station.queries().submit(
+          new StationDigestQuery(_station, _stations[idx].node()), QueryScheduler::BACKGROUND);
+    connect(query, SIGNAL(digestReceived(Identifier,StationDigest)),
+            this, SLOT(_onDigestReceived(Identifier,StationDigest)));
+    connect(query, SIGNAL(failed()), this, SLOT(_onDigestFailed()));
+  }
+  // Once per crawl round, the interval grows while the crawler converged
+  _reconcileTimer.start(_policy.reconcileInterval(now));
+}
+
+void
+StationList::_onSave() {
+  save();
+}
+
+void
+StationList::_onRevalidate() {
+  // Refresh all cached stations now, limited by the max. number of parallel probes
+  qint64 now = QDateTime::currentMSecsSinceEpoch();
+  foreach (NodeItem node, _unverified) {
+    _policy.scheduleRefresh(node.id(), now);
+  }
+  _unverified.clear();
+  _wakeUp(0);
+}
+
+void
+StationList::_onProbeFailed() {
+  JsonQuery *query = qobject_cast<JsonQuery *>(sender());
+  if (! query) { return; }
+  Identifier id = query->remote();
+  _probeStart.remove(id);
+  if (! _index.contains(id)) {
+    // Candidate not reachable
+    _policy.crawler().failed(id, QDateTime::currentMSecsSinceEpoch());
+    return;
+  }
+  // Known station not reachable -> back off or remove it
+  int idx = _index[id];
+  if (_stations[idx].lastSeen().msecsTo(QDateTime::currentDateTime()) > _deadTime) {
+    _removeStation(idx);
+    return;
+  }
+  _stations[idx].failed();
+  _scheduleRefresh(idx);
+  emit dataChanged(index(idx, 0), index(idx, 8));
+}
+
+void
+StationList::_onDigestReceived(const Identifier &remote, const StationDigest &digest) {
+  QList<int> buckets = _digest.differing(digest);
+  if (buckets.isEmpty()) {
+    // Both stations know the same network
+    return;
+  }
+  StationListQuery *query = _station.queries().submit(
+        new StationListQuery(_station, remote, buckets), QueryScheduler::BACKGROUND);
+  connect(query, SIGNAL(stationListReceived(QList<Identifier>)),
+          this, SLOT(addToCandidates(QList<Identifier>)));
+}
+
+void
+StationList::_onDigestFailed() {
+  JsonQuery *digestQuery = qobject_cast<JsonQuery *>(sender());
+  if (! digestQuery) { return; }
+  // Station may not serve digests yet -> fall back to the complete station list
+  StationListQuery *query = _station.queries().submit(
+        new StationListQuery(_station, digestQuery->remote()), QueryScheduler::BACKGROUND);
+  connect(query, SIGNAL(stationListReceived(QList<Identifier>)),
+          this, SLOT(addToCandidates(QList<Identifier>)));
+}
+
+void
+StationList::_onProbeDone() {
+  _probeQueries.remove(sender());
+  // Continue crawling immediately if candidates or refreshes are due
+  if (_policy.probeDone(QDateTime::currentMSecsSinceEpoch())) {
+    _wakeUp(0);
   }
 }
 
@@ -253,7 +699,7 @@ StationList::rowCount(const QModelIndex &parent) const {
 
 int
 StationList::columnCount(const QModelIndex &parent) const {
-  return 7;
+  return 9;
 }
 
 QVariant
@@ -275,10 +721,18 @@ StationList::data(const QModelIndex &index, int role) const {
       return _stations[index.row()].location().height();
     case 5:
       return tr("%1 (%2) km")
-          .arg(QString::number(_stations[index.row()].location().arcDist(_station.location()), 'f', 1))
-          .arg(QString::number(_stations[index.row()].location().lineDist(_station.location()), 'f', 1));
+          .arg(QString::number(_distances[index.row()].first, 'f', 1))
+          .arg(QString::number(_distances[index.row()].second, 'f', 1));
     case 6:
       return _stations[index.row()].description();
+    case 7:
+      return _stations[index.row()].lastSeen().toString();
+    case 8:
+      if (0 == _stations[index.row()].successes()) { return QVariant(); }
+      return tr("%1 ms (%2 ok, %3 failed)")
+          .arg(QString::number(_stations[index.row()].rtt(), 'f', 0))
+          .arg(_stations[index.row()].successes())
+          .arg(_stations[index.row()].failures());
   }
 
   return QVariant();
@@ -296,6 +750,8 @@ StationList::headerData(int section, Qt::Orientation orientation, int role) cons
     case 4: return tr("Height");
     case 5: return tr("Distance");
     case 6: return tr("Destription");
+    case 7: return tr("Last seen");
+    case 8: return tr("RTT");
   }
   return QVariant();
 }
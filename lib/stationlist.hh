@@ -5,13 +5,19 @@
 #include <QJsonDocument>
 #include <QAbstractTableModel>
 #include <QTimer>
+#include <QSet>
 #include "location.hh"
+#include "networkpolicy.hh"
+#include "spatialindex.hh"
+#include "stationdigest.hh"
 
 
 class Node;
 class Station;
 class HttpClientConnection;
 class HttpClientResponse;
+class BinaryReader;
+class StationInfoQuery;
 
 
 class StationItem
@@ -21,6 +27,7 @@ public:
   StationItem(const Identifier &id, const Location &location, const QString &descr="");
   StationItem(const NodeItem &node, const Location &location, const QString &descr="");
   StationItem(const NodeItem &node, const QJsonObject &obj);
+  StationItem(const NodeItem &node, BinaryReader &record);
   StationItem(const StationItem &other);
 
   StationItem &operator=(const StationItem &other);
@@ -36,11 +43,44 @@ public:
 
   void update(const PeerItem &peer);
 
+  /** Returns the number of consecutive failed contacts. */
+  size_t failures() const;
+  /** Returns the total number of successful contacts. */
+  size_t successes() const;
+  /** Returns the smoothed round-trip time of status queries in ms, 0 if unknown. */
+  double rtt() const;
+  /** Returns the current refresh interval in ms. */
+  qint64 refreshInterval() const;
+  /** Returns the time of the next refresh in ms since epoch. */
+  qint64 nextRefresh() const;
+  /** Takes the liveness statistics from a previous record of the same station. */
+  void takeStats(const StationItem &other);
+  /** Records a successful contact with the given round-trip time in ms (negative if unknown).
+   * The refresh interval grows while the station is stable. */
+  void succeeded(double rtt);
+  /** Records a failed contact. The next refresh is delayed with an exponential backoff. */
+  void failed();
+
+  /** Serializes the station including its address for the station cache. */
+  QJsonObject toJson() const;
+  /** Constructs a station from an entry of the station cache. */
+  static StationItem fromJson(const QJsonObject &obj);
+
 protected:
   QDateTime _lastSeen;
   NodeItem _node;
   Location _location;
   QString _description;
+  /** Number of consecutive failed contacts. */
+  size_t _failures;
+  /** Total number of successful contacts. */
+  size_t _successes;
+  /** Smoothed round-trip time in ms. */
+  double _rtt;
+  /** Refresh interval in ms. */
+  qint64 _refreshInterval;
+  /** Time of the next refresh in ms since epoch. */
+  qint64 _nextRefresh;
 };
 
 
@@ -49,7 +89,11 @@ class StationList : public QAbstractTableModel
   Q_OBJECT
 
 public:
-  StationList(Station &station);
+  /** Constructs the list of known stations. If a @c cacheFile is given, the stations are loaded
+   * from that file, revalidated in the background and saved periodically. */
+  StationList(Station &station, const QString &cacheFile=QString());
+  /** Destructor, saves the station cache. */
+  virtual ~StationList();
 
   size_t numStations() const;
   bool hasStation(const Identifier &id) const;
@@ -58,6 +102,29 @@ public:
   const StationItem &station(const Identifier &id) const;
   StationItem &station(const Identifier &id);
 
+  /** Returns the great circle distance of the specified station from this station in km. */
+  double distance(size_t i) const;
+  /** Returns the spatial index over the locations of all known stations. */
+  const SpatialIndex &spatialIndex() const;
+  /** Recomputes the distances of all stations, e.g. once the location of this station changed. */
+  void updateDistances();
+
+  /** Returns the digest of all known stations including this one. */
+  const StationDigest &digest() const;
+
+  /** Returns the crawler state. */
+  const CrawlQueue &crawler() const;
+  /** Sets the max. number of parallel probes of the crawler. */
+  void setMaxProbes(size_t n);
+
+  /** Sets the time in seconds after which stations not seen are removed. */
+  void setDeadTime(size_t sec);
+
+  /** Loads the stations from the cache file. */
+  bool load();
+  /** Saves the stations into the cache file. */
+  bool save() const;
+
   /* *** Implementation of QAbstractTableModel interface. *** */
   int rowCount(const QModelIndex &parent) const;
   int columnCount(const QModelIndex &parent) const;
@@ -66,6 +133,11 @@ public:
 
 signals:
   void stationUpdated(const StationItem &item);
+  /** Gets emitted once a station was removed as it was not seen within the dead time. */
+  void stationRemoved(const Identifier &id);
+  /** Gets emitted after every crawl round with the number of known stations, pending candidates
+   * and the discovery rate in stations per minute. */
+  void crawlProgress(size_t known, size_t pending, double rate);
 
 protected slots:
   void updateStation(const StationItem &station);
@@ -76,15 +148,59 @@ protected slots:
 
 protected:
   size_t indexOf(const Identifier &id) const;
+  /** Contacts the specified candidate as a probe of the crawler. */
+  void _probe(const Identifier &id);
+  /** Contacts the specified known station to refresh it. */
+  void _probe(const NodeItem &node);
+  /** Connects to the signals of a probe. */
+  void _connectProbe(StationInfoQuery *query);
+  /** Schedules the next refresh of the station at the specified row. */
+  void _scheduleRefresh(int idx);
+  /** Runs the next network update within @c delay ms, unless it is due earlier anyway. */
+  void _wakeUp(qint64 delay);
+  /** Removes the station at the specified row. */
+  void _removeStation(int idx);
+  /** Updates the cached distance and the spatial index for the station at the specified row. */
+  void _updateLocation(int idx);
 
 private slots:
   void _onUpdateNetwork();
+  void _onReconcile();
+  void _onSave();
+  void _onRevalidate();
+  void _onProbeFailed();
+  void _onProbeDone();
+  void _onDigestReceived(const Identifier &remote, const StationDigest &digest);
+  void _onDigestFailed();
 
 protected:
   Station &_station;
   QVector<StationItem> _stations;
-  QSet<Identifier> _candidates;
+  /** Maps station identifiers to their row in @c _stations. */
+  QHash<Identifier, int> _index;
+  /** Great circle and direct distances from this station in km, one per row. */
+  QVector< QPair<double, double> > _distances;
+  /** Spatial index over the station locations. */
+  SpatialIndex _spatial;
+  /** Digest of the known stations, used to reconcile station lists with other stations. */
+  StationDigest _digest;
+  /** Candidates not contacted yet, scheduled refreshes and running probes. */
+  NetworkPolicy _policy;
+  /** Start times of running probes in ms since epoch. */
+  QHash<Identifier, qint64> _probeStart;
+  /** Queries of the running probes. */
+  QSet<QObject *> _probeQueries;
+  /** Time in ms after which stations not seen are removed. */
+  qint64 _deadTime;
   QTimer _networkUpdateTimer;
+  /** Timer to reconcile the station list with a random station, paced by the crawler. */
+  QTimer _reconcileTimer;
+  /** The station cache file. */
+  QString _cacheFile;
+  /** Stations loaded from the cache, not revalidated yet. */
+  QList<NodeItem> _unverified;
+  /** Timer to save the station cache periodically. */
+  QTimer _saveTimer;
 };
 
 
@@ -0,0 +1,56 @@
+#include "simulation.hh"
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  app.setApplicationName("vlfsim");
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription(
+        "Simulates station discovery and schedule selection of a VLF network in virtual time.");
+  parser.addHelpOption();
+  parser.addOptions({
+                      {{"n", "stations"}, "Number of stations.", "N", "1000"},
+                      {{"d", "days"}, "Simulated days.", "DAYS", "7"},
+                      {{"s", "seed"}, "Random seed.", "SEED", "1"},
+                      {"offline", "Fraction of unreachable stations.", "FRACTION", "0.05"},
+                      {"bootstrap", "Stations known initially by each station.", "N", "3"},
+                      {"probes", "Max. parallel probes per station.", "N", "8"},
+                      {{"e", "events"}, "Distinct events in the network.", "N", "200"},
+                      {"local-events", "Max. local events per station.", "N", "3"},
+                      {"budget", "Cost budget per station.", "COST", "28"},
+                      {"legacy", "Select remote events by cost per node."}
+                    });
+  parser.process(app);
+
+  SimConfig config;
+  config.stations = parser.value("stations").toUInt();
+  config.days = parser.value("days").toInt();
+  config.seed = parser.value("seed").toUInt();
+  config.offline = parser.value("offline").toDouble();
+  config.bootstrap = parser.value("bootstrap").toUInt();
+  config.maxProbes = parser.value("probes").toUInt();
+  config.events = parser.value("events").toUInt();
+  config.localEvents = parser.value("local-events").toUInt();
+  config.maxCosts = parser.value("budget").toDouble();
+  config.legacy = parser.isSet("legacy");
+  if ((config.stations < 2) || (config.days < 1)) {
+    QTextStream(stderr) << "At least 2 stations and 1 day are needed.\n";
+    return 1;
+  }
+
+  SimPopulation population(config);
+
+  CrawlSimulation crawl(population, config);
+  crawl.run();
+  crawl.report();
+
+  ScheduleSimulation schedule(population, config);
+  schedule.run();
+  schedule.report();
+
+  return 0;
+}
@@ -0,0 +1,458 @@
+#include "simulation.hh"
+#include <QTextStream>
+#include <algorithm>
+#include <ctime>
+#include <cmath>
+
+/** Timeout of a failed probe in ms. */
+#define SIM_PROBE_TIMEOUT 5000
+
+
+/* ********************************************************************************************* *
+ * Implementation of SimPopulation
+ * ********************************************************************************************* */
+SimPopulation::SimPopulation(const SimConfig &config)
+  : _rng(config.seed), _epoch(QDate(2024, 1, 1), QTime(0, 0)), _ids(), _locations(), _online(),
+    _index(), _localEvents()
+{
+  // Stations uniformly distributed over the globe
+  for (size_t i=0; i<config.stations; i++) {
+    char id[OVL_HASH_SIZE];
+    for (int j=0; j<OVL_HASH_SIZE; j++) {
+      id[j] = char(index(256));
+    }
+    _ids.append(Identifier(id));
+    _index.insert(_ids.last(), i);
+    double lat = std::asin(2*uniform()-1)*180/M_PI;
+    double lon = 360*uniform()-180;
+    _locations.append(Location(lon, lat, 0));
+    _online.append(uniform() >= config.offline);
+  }
+
+  // Pool of events within the first week, some of them are popular
+  QVector<ScheduledEvent> pool;
+  for (size_t i=0; i<config.events; i++) {
+    double u = uniform();
+    ScheduledEvent::Type type = ScheduledEvent::SINGLE;
+    if (u > 0.85) { type = ScheduledEvent::DAILY; }
+    else if (u > 0.5) { type = ScheduledEvent::WEEKLY; }
+    pool.append(ScheduledEvent(_epoch.addSecs(600*index(7*24*6)), type));
+  }
+  for (size_t i=0; i<config.stations; i++) {
+    QList<ScheduledEvent> events;
+    size_t n = pool.size() ? index(config.localEvents+1) : 0;
+    for (size_t j=0; j<n; j++) {
+      // Prefer events at the front of the pool
+      double u = uniform();
+      const ScheduledEvent &evt = pool[size_t(u*u*pool.size())];
+      if (! events.contains(evt)) { events.append(evt); }
+    }
+    _localEvents.append(events);
+  }
+}
+
+size_t
+SimPopulation::size() const {
+  return _ids.size();
+}
+
+const Identifier &
+SimPopulation::id(size_t i) const {
+  return _ids[i];
+}
+
+const Location &
+SimPopulation::location(size_t i) const {
+  return _locations[i];
+}
+
+bool
+SimPopulation::online(size_t i) const {
+  return _online[i];
+}
+
+int
+SimPopulation::indexOf(const Identifier &id) const {
+  return _index.value(id, -1);
+}
+
+const QList<ScheduledEvent> &
+SimPopulation::localEvents(size_t i) const {
+  return _localEvents[i];
+}
+
+const QDateTime &
+SimPopulation::epoch() const {
+  return _epoch;
+}
+
+double
+SimPopulation::uniform() {
+  return std::uniform_real_distribution<double>(0, 1)(_rng);
+}
+
+size_t
+SimPopulation::index(size_t n) {
+  return std::uniform_int_distribution<size_t>(0, n-1)(_rng);
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of CrawlSimulation
+ * ********************************************************************************************* */
+CrawlSimulation::CrawlSimulation(SimPopulation &population, const SimConfig &config)
+  : _population(population), _config(config), _now(0), _queue(), _states(population.size()),
+    _knownPairs(0), _totalPairs(0), _numProbes(0), _numRefreshes(0), _numFailedProbes(0),
+    _numDigests(0), _numLists(0), _numListEntries(0), _cpu(0)
+{
+  size_t online = 0;
+  for (size_t i=0; i<_population.size(); i++) {
+    if (_population.online(i)) { online++; }
+  }
+  _totalPairs = online*(online-1);
+  for (int i=0; i<4; i++) { _converged[i] = -1; }
+
+  for (size_t i=0; i<_population.size(); i++) {
+    State &state = _states[i];
+    state.policy.setMaxProbes(_config.maxProbes);
+    state.nextRound = -1;
+    state.nextReconcile = -1;
+    state.digest.add(_population.id(i));
+    if (! _population.online(i)) { continue; }
+    // Each station knows some bootstrap stations
+    for (size_t j=0; j<_config.bootstrap; j++) {
+      size_t peer = _population.index(_population.size());
+      if (peer != i) {
+        state.policy.crawler().add(_population.id(peer), 0);
+      }
+    }
+    qint64 start = _population.index(1000);
+    _scheduleRound(i, start);
+    _scheduleReconcile(i, start);
+  }
+}
+
+void
+CrawlSimulation::run() {
+  qint64 end = qint64(_config.days)*24*3600*1000;
+  std::clock_t start = std::clock();
+  while ((! _queue.empty()) && (_queue.top().time <= end)) {
+    Event event = _queue.top(); _queue.pop();
+    _now = event.time;
+    switch (event.type) {
+      case ROUND: _onRound(event); break;
+      case RECONCILE: _onReconcile(event); break;
+      case PROBE_DONE: _onProbeDone(event); break;
+      case DIGEST_DONE: _onDigestDone(event); break;
+      case LIST_DONE: _onListDone(event); break;
+    }
+  }
+  _cpu = double(std::clock()-start)/CLOCKS_PER_SEC;
+}
+
+void
+CrawlSimulation::report() const {
+  QTextStream out(stdout);
+  size_t online = 0;
+  for (size_t i=0; i<_population.size(); i++) {
+    if (_population.online(i)) { online++; }
+  }
+  out << "Crawl simulation: " << _population.size() << " stations (" << online << " online), "
+      << _config.days << " days\n";
+  const char *names[4] = {"50%", "90%", "99%", "100%"};
+  for (int i=0; i<4; i++) {
+    out << "  " << names[i] << " of station pairs known after: ";
+    if (_converged[i] < 0) { out << "never\n"; }
+    else { out << double(_converged[i])/60000 << " min\n"; }
+  }
+  out << "  Station pairs known: " << 100.*_knownPairs/std::max(size_t(1), _totalPairs) << "%\n";
+  double stationDays = double(_population.size())*_config.days;
+  out << "  Status probes: " << _numProbes << " (" << _numRefreshes << " refreshes, "
+      << _numFailedProbes << " failed), " << _numProbes/stationDays << " per station and day\n";
+  out << "  Digest queries: " << _numDigests << ", " << _numDigests/stationDays
+      << " per station and day\n";
+  out << "  List queries: " << _numLists << " returning " << _numListEntries << " identifiers\n";
+  out << "  CPU: " << _cpu << "s, " << _cpu/_config.days << "s per simulated day\n";
+}
+
+void
+CrawlSimulation::_schedule(const Event &event) {
+  _queue.push(event);
+}
+
+void
+CrawlSimulation::_scheduleRound(int station, qint64 time) {
+  _states[station].nextRound = time;
+  Event event = { time, ROUND, station, -1, true, false, QList<int>() };
+  _schedule(event);
+}
+
+void
+CrawlSimulation::_wakeUp(int station, qint64 delay) {
+  qint64 next = _states[station].nextRound;
+  delay = std::max(qint64(0), delay);
+  if ((next < 0) || ((next - _now) > delay)) {
+    _scheduleRound(station, _now + delay);
+  }
+}
+
+void
+CrawlSimulation::_scheduleReconcile(int station, qint64 time) {
+  _states[station].nextReconcile = time;
+  Event event = { time, RECONCILE, station, -1, true, false, QList<int>() };
+  _schedule(event);
+}
+
+qint64
+CrawlSimulation::_rtt() {
+  return 50 + _population.index(450);
+}
+
+void
+CrawlSimulation::_onRound(const Event &event) {
+  State &state = _states[event.station];
+  // Skip rounds rescheduled meanwhile
+  if (event.time != state.nextRound) { return; }
+  state.nextRound = -1;
+
+  // Contact pending candidates and refresh known stations in parallel
+  Identifier id; bool refresh;
+  while (state.policy.nextProbe(id, refresh, _now)) {
+    int peer = _population.indexOf(id);
+    bool success = (peer >= 0) && _population.online(peer);
+    _numProbes++;
+    if (refresh) { _numRefreshes++; }
+    Event probe = { _now + (success ? _rtt() : SIM_PROBE_TIMEOUT), PROBE_DONE, event.station, peer,
+                    success, refresh, QList<int>() };
+    _schedule(probe);
+  }
+
+  qint64 delay = state.policy.nextRound(_now);
+  if (delay >= 0) {
+    _scheduleRound(event.station, _now + delay);
+  }
+}
+
+void
+CrawlSimulation::_onReconcile(const Event &event) {
+  State &state = _states[event.station];
+  if (event.time != state.nextReconcile) { return; }
+  // If all candidates have been contacted, compare digests with a random known station
+  if (state.policy.reconcile() && state.known.size()) {
+    QList<int> known = state.known.keys();
+    int peer = known[_population.index(known.size())];
+    _numDigests++;
+    Event digest = { _now + _rtt(), DIGEST_DONE, event.station, peer, true, false, QList<int>() };
+    _schedule(digest);
+  }
+  _scheduleReconcile(event.station, _now + state.policy.reconcileInterval(_now));
+}
+
+void
+CrawlSimulation::_onProbeDone(const Event &event) {
+  State &state = _states[event.station];
+  if (event.success) {
+    const Identifier &id = _population.id(event.peer);
+    state.policy.crawler().succeeded(id, _now);
+    if (! state.known.contains(event.peer)) {
+      Peer peer = { NetworkPolicy::MinRefresh, 0, 0 };
+      state.known.insert(event.peer, peer);
+      state.digest.add(id);
+      _knownPairs++;
+      const double thresholds[4] = {0.5, 0.9, 0.99, 1.0};
+      for (int i=0; i<4; i++) {
+        if ((_converged[i] < 0) && (_knownPairs >= thresholds[i]*_totalPairs)) {
+          _converged[i] = _now;
+        }
+      }
+    }
+    // Refresh stable stations less often
+    Peer &peer = state.known[event.peer];
+    peer.interval = NetworkPolicy::refreshAfterSuccess(peer.interval, peer.successes,
+                                                       peer.failures);
+    peer.successes++;
+    peer.failures = 0;
+    state.policy.scheduleRefresh(id, _now + peer.interval);
+    _wakeUp(event.station, peer.interval);
+    // The probed station learns about the prober through the overlay network
+    if ((! _states[event.peer].known.contains(event.station))
+        && _states[event.peer].policy.crawler().add(_population.id(event.station), _now)) {
+      _wakeUp(event.peer, 0);
+    }
+  } else {
+    _numFailedProbes++;
+    if ((event.peer >= 0) && state.known.contains(event.peer)) {
+      // Known station not reachable -> back off
+      Peer &peer = state.known[event.peer];
+      peer.failures++;
+      peer.interval = NetworkPolicy::refreshAfterFailure(peer.failures);
+      state.policy.scheduleRefresh(_population.id(event.peer), _now + peer.interval);
+      _wakeUp(event.station, peer.interval);
+    } else if (event.peer >= 0) {
+      state.policy.crawler().failed(_population.id(event.peer), _now);
+    }
+  }
+  // Continue crawling immediately if candidates or refreshes are due
+  if (state.policy.probeDone(_now)) {
+    _wakeUp(event.station, 0);
+  }
+}
+
+void
+CrawlSimulation::_onDigestDone(const Event &event) {
+  QList<int> buckets = _states[event.station].digest.differing(_states[event.peer].digest);
+  if (buckets.isEmpty()) { return; }
+  _numLists++;
+  Event list = { _now + _rtt(), LIST_DONE, event.station, event.peer, true, false, buckets };
+  _schedule(list);
+}
+
+void
+CrawlSimulation::_onListDone(const Event &event) {
+  State &state = _states[event.station];
+  QSet<int> buckets = event.buckets.toSet();
+  QList<int> stations = _states[event.peer].known.keys();
+  stations.append(event.peer);
+  size_t added = 0;
+  foreach (int station, stations) {
+    const Identifier &id = _population.id(station);
+    if (! buckets.contains(StationDigest::bucket(id))) { continue; }
+    _numListEntries++;
+    if ((station != event.station) && (! state.known.contains(station))
+        && state.policy.crawler().add(id, _now)) {
+      added++;
+    }
+  }
+  if (added) {
+    _wakeUp(event.station, 0);
+  }
+}
+
+
+/* ********************************************************************************************* *
+ * Implementation of ScheduleSimulation
+ * ********************************************************************************************* */
+ScheduleSimulation::ScheduleSimulation(SimPopulation &population, const SimConfig &config)
+  : _population(population), _config(config), _served(population.size()), _participantsOf(),
+    _cpu(0), _numSelections(0)
+{
+  for (size_t i=0; i<_population.size(); i++) {
+    if (_population.online(i)) {
+      _served[i] = _population.localEvents(i);
+    }
+  }
+}
+
+void
+ScheduleSimulation::run() {
+  QTextStream out(stdout);
+  out << "Schedule simulation: " << (_config.legacy ? "cost per node" : "coverage")
+      << " selection, budget " << _config.maxCosts << "\n";
+
+  for (int day=0; day<_config.days; day++) {
+    // Collect participants of the schedules served in the previous round
+    _participantsOf.clear();
+    for (size_t i=0; i<_population.size(); i++) {
+      foreach (ScheduledEvent evt, _served[i]) {
+        _participantsOf[evt].append(i);
+      }
+    }
+
+    std::clock_t start = std::clock();
+    ScheduleSelector selector;
+    if (! _config.legacy) {
+      QHash<ScheduledEvent, QList<int> >::const_iterator item = _participantsOf.begin();
+      for (; item != _participantsOf.end(); item++) {
+        selector.update(item.key(), _participants(item.value()));
+      }
+    }
+    QVector< QList<ScheduledEvent> > served(_population.size());
+    for (size_t i=0; i<_population.size(); i++) {
+      if (! _population.online(i)) { continue; }
+      const QList<ScheduledEvent> &local = _population.localEvents(i);
+      double budget = _config.maxCosts;
+      foreach (ScheduledEvent evt, local) {
+        budget -= evt.cost();
+      }
+      served[i] = local;
+      if (budget > 0) {
+        served[i].append(_config.legacy ? _legacySelect(budget, local, _participantsOf)
+                                        : selector.select(budget, local, _population.epoch()));
+        _numSelections++;
+      }
+    }
+    _served = served;
+    _cpu += double(std::clock()-start)/CLOCKS_PER_SEC;
+
+    // Summary of the round
+    QHash<ScheduledEvent, QList<int> > recorded;
+    for (size_t i=0; i<_population.size(); i++) {
+      foreach (ScheduledEvent evt, _served[i]) {
+        recorded[evt].append(i);
+      }
+    }
+    size_t participants = 0, coincident = 0;
+    QHash<ScheduledEvent, QList<int> >::const_iterator item = recorded.begin();
+    for (; item != recorded.end(); item++) {
+      participants += item.value().size();
+      if (item.value().size() > 1) { coincident++; }
+    }
+    out << "  Day " << (day+1) << ": " << recorded.size() << " events recorded, "
+        << double(participants)/std::max(1, recorded.size()) << " stations per event, "
+        << coincident << " coincident\n";
+    _participantsOf = recorded;
+  }
+}
+
+void
+ScheduleSimulation::report() const {
+  QTextStream out(stdout);
+  // Evaluate the final schedules by the coverage objective
+  ScheduleSelector selector;
+  QList<ScheduledEvent> events;
+  QHash<ScheduledEvent, QList<int> >::const_iterator item = _participantsOf.begin();
+  for (; item != _participantsOf.end(); item++) {
+    selector.update(item.key(), _participants(item.value()));
+    events.append(item.key());
+  }
+  out << "  Network coverage: " << selector.coverage(events) << "\n";
+  out << "  CPU: " << _cpu << "s, " << _cpu/std::max(1, _config.days) << "s per simulated day, "
+      << 1e3*_cpu/std::max(size_t(1), _numSelections) << "ms per selection\n";
+}
+
+QList<ScheduledEvent>
+ScheduleSimulation::_legacySelect(double budget, const QList<ScheduledEvent> &local,
+                                  const QHash<ScheduledEvent, QList<int> > &participants) const
+{
+  // Candidates ordered by cost per node, then by time
+  QList< QPair<QPair<double, qint64>, ScheduledEvent> > candidates;
+  QHash<ScheduledEvent, QList<int> >::const_iterator item = participants.begin();
+  for (; item != participants.end(); item++) {
+    const ScheduledEvent &evt = item.key();
+    if ((evt.cost() < budget) && (! local.contains(evt)) && (! evt.passed(_population.epoch()))) {
+      QPair<double, qint64> key(evt.cost()/item.value().size(), evt.first().toMSecsSinceEpoch());
+      candidates.append(qMakePair(key, evt));
+    }
+  }
+  std::sort(candidates.begin(), candidates.end(),
+            [](const QPair<QPair<double, qint64>, ScheduledEvent> &a,
+               const QPair<QPair<double, qint64>, ScheduledEvent> &b) { return a.first < b.first; });
+  QList<ScheduledEvent> selected;
+  for (int i=0; i<candidates.size(); i++) {
+    if (budget > candidates[i].second.cost()) {
+      selected.append(candidates[i].second);
+      budget -= candidates[i].second.cost();
+    }
+  }
+  return selected;
+}
+
+QList<ScheduleSelector::Participant>
+ScheduleSimulation::_participants(const QList<int> &stations) const {
+  QList<ScheduleSelector::Participant> participants;
+  foreach (int station, stations) {
+    participants.append(ScheduleSelector::Participant(_population.id(station),
+                                                      _population.location(station)));
+  }
+  return participants;
+}
@@ -0,0 +1,198 @@
+#ifndef SIMULATION_HH
+#define SIMULATION_HH
+
+#include <QVector>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+#include <queue>
+#include <random>
+
+#include "lib/location.hh"
+#include "lib/networkpolicy.hh"
+#include "lib/stationdigest.hh"
+#include "lib/schedule.hh"
+#include "lib/scheduleselector.hh"
+
+
+/** Parameters of a simulation run. */
+typedef struct {
+  /** Number of stations. */
+  size_t stations;
+  /** Simulated days. */
+  int days;
+  /** Seed of the random number generator. */
+  unsigned int seed;
+  /** Fraction of stations not reachable. */
+  double offline;
+  /** Number of stations known initially by each station. */
+  size_t bootstrap;
+  /** Max. number of parallel probes per station. */
+  size_t maxProbes;
+  /** Number of distinct events in the network. */
+  size_t events;
+  /** Max. number of local events per station. */
+  size_t localEvents;
+  /** Cost budget of each station. */
+  double maxCosts;
+  /** If @c true, remote events are selected by the former cost per node heuristic. */
+  bool legacy;
+} SimConfig;
+
+
+/** A synthetic population of stations and their local schedules. */
+class SimPopulation
+{
+public:
+  /** Generates a population as specified by the config. */
+  explicit SimPopulation(const SimConfig &config);
+
+  size_t size() const;
+  const Identifier &id(size_t i) const;
+  const Location &location(size_t i) const;
+  bool online(size_t i) const;
+  /** Returns the index of the station with the given identifier or -1. */
+  int indexOf(const Identifier &id) const;
+  /** Returns the local events of the station. */
+  const QList<ScheduledEvent> &localEvents(size_t i) const;
+  /** Returns the start of the simulation. */
+  const QDateTime &epoch() const;
+
+  /** Returns a random number in [0,1). */
+  double uniform();
+  /** Returns a random index in [0,n). */
+  size_t index(size_t n);
+
+protected:
+  std::mt19937 _rng;
+  QDateTime _epoch;
+  QVector<Identifier> _ids;
+  QVector<Location> _locations;
+  QVector<bool> _online;
+  QHash<Identifier, int> _index;
+  QVector< QList<ScheduledEvent> > _localEvents;
+};
+
+
+/** Simulates the discovery of stations by the crawler, the refreshes of known stations and the
+ * reconciliation of station lists (@c StationDigest) in virtual time. Each simulated station runs
+ * the @c NetworkPolicy of @c StationList. */
+class CrawlSimulation
+{
+public:
+  CrawlSimulation(SimPopulation &population, const SimConfig &config);
+
+  /** Runs the simulation for the configured number of days. */
+  void run();
+  /** Prints the results. */
+  void report() const;
+
+protected:
+  /** Simulation event types. */
+  typedef enum {
+    ROUND, RECONCILE, PROBE_DONE, DIGEST_DONE, LIST_DONE
+  } EventType;
+
+  /** A simulation event. */
+  typedef struct {
+    qint64 time;
+    EventType type;
+    int station;
+    int peer;
+    bool success;
+    /** If @c true, the probe refreshed a known station. */
+    bool refresh;
+    QList<int> buckets;
+  } Event;
+
+  /** Liveness of a known station, see @c StationItem. */
+  typedef struct {
+    qint64 interval;
+    size_t successes;
+    size_t failures;
+  } Peer;
+
+  /** State of a simulated station. */
+  typedef struct {
+    NetworkPolicy policy;
+    QHash<int, Peer> known;
+    StationDigest digest;
+    /** Times of the next round and reconciliation, -1 if none is scheduled. */
+    qint64 nextRound;
+    qint64 nextReconcile;
+  } State;
+
+  /** Orders events by time. */
+  typedef struct {
+    bool operator()(const Event &a, const Event &b) const { return a.time > b.time; }
+  } EventLater;
+
+  void _schedule(const Event &event);
+  void _scheduleRound(int station, qint64 time);
+  /** Runs the next round of the station within @c delay ms, unless it is due earlier anyway. */
+  void _wakeUp(int station, qint64 delay);
+  void _scheduleReconcile(int station, qint64 time);
+  void _onRound(const Event &event);
+  void _onReconcile(const Event &event);
+  void _onProbeDone(const Event &event);
+  void _onDigestDone(const Event &event);
+  void _onListDone(const Event &event);
+  /** Random round-trip time in ms. */
+  qint64 _rtt();
+
+protected:
+  SimPopulation &_population;
+  SimConfig _config;
+  qint64 _now;
+  std::priority_queue<Event, std::vector<Event>, EventLater> _queue;
+  QVector<State> _states;
+  /** Number of known (online) station pairs. */
+  size_t _knownPairs;
+  size_t _totalPairs;
+  /** Time in ms at which 50%, 90%, 99% and 100% of all pairs were known, -1 if never. */
+  qint64 _converged[4];
+  size_t _numProbes;
+  size_t _numRefreshes;
+  size_t _numFailedProbes;
+  size_t _numDigests;
+  size_t _numLists;
+  size_t _numListEntries;
+  /** CPU time in s. */
+  double _cpu;
+};
+
+
+/** Simulates the selection of remote events by all stations in rounds of one day. In each round,
+ * each station selects from the schedules served by all other stations in the previous round. */
+class ScheduleSimulation
+{
+public:
+  ScheduleSimulation(SimPopulation &population, const SimConfig &config);
+
+  /** Runs the simulation for the configured number of days. */
+  void run();
+  /** Prints the results. */
+  void report() const;
+
+protected:
+  /** Selects remote events by the former cost per node heuristic. */
+  QList<ScheduledEvent> _legacySelect(double budget, const QList<ScheduledEvent> &local,
+                                      const QHash<ScheduledEvent, QList<int> > &participants) const;
+  /** Returns the participants of all served events with their locations. */
+  QList<ScheduleSelector::Participant> _participants(const QList<int> &stations) const;
+
+protected:
+  SimPopulation &_population;
+  SimConfig _config;
+  /** Events served by each station. */
+  QVector< QList<ScheduledEvent> > _served;
+  /** Participants of all served events after the last round. */
+  QHash<ScheduledEvent, QList<int> > _participantsOf;
+  /** CPU time in s. */
+  double _cpu;
+  /** Number of selections. */
+  size_t _numSelections;
+};
+
+#endif // SIMULATION_HH
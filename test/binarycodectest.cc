@@ -0,0 +1,135 @@
+#include "lib/binarycodec.hh"
+#include "lib/schedule.hh"
+#include <QTextStream>
+#include <cmath>
+#include <cstring>
+
+
+/** Returns the identifier with all bytes set to @c i. */
+static Identifier
+testId(int i) {
+  char id[OVL_HASH_SIZE];
+  for (int j=0; j<OVL_HASH_SIZE; j++) { id[j] = char(i); }
+  return Identifier(id);
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Splits the records of a response, returns @c false if the response is malformed. */
+static bool
+records(const QByteArray &data, BinaryCodec::Type &type, QList<QByteArray> &result) {
+  uint32_t count;
+  if (! BinaryCodec::parseHeader(data.constData(), data.size(), type, count)) { return false; }
+  int pos = VLF_BINARY_HEADER_SIZE;
+  for (uint32_t i=0; i<count; i++) {
+    BinaryReader prefix(data.constData()+pos, data.size()-pos);
+    uint16_t len;
+    if ((! prefix.readUInt16(len)) || (prefix.bytesLeft() < len)) { return false; }
+    result.append(data.mid(pos+2, len));
+    pos += 2+len;
+  }
+  return pos == data.size();
+}
+
+/** Checks that all field types decode to the written values. */
+static bool
+testFields(QTextStream &out) {
+  QDateTime when = QDateTime::fromMSecsSinceEpoch(1700000000123LL);
+  BinaryWriter writer(BinaryCodec::STATUS);
+  writer.beginRecord();
+  writer.writeUInt8(0xab); writer.writeUInt16(0xbeef); writer.writeUInt32(0xdeadbeef);
+  writer.writeInt64(-1234567890123LL); writer.writeFloat(-1.5f); writer.writeDouble(M_PI);
+  writer.writeIdentifier(testId(7)); writer.writeDateTime(when);
+  writer.writeString(QString::fromUtf8("Zürich"));
+  writer.endRecord();
+  writer.beginRecord();
+  writer.writeString("");
+  writer.endRecord();
+
+  BinaryCodec::Type type;
+  QList<QByteArray> recs;
+  bool ok = BinaryCodec::isBinary(writer.data()) && records(writer.data(), type, recs)
+      && (BinaryCodec::STATUS == type) && (2 == recs.size());
+  if (! ok) { return report(ok, "fields", out); }
+  BinaryReader reader(recs[0].constData(), recs[0].size());
+  uint8_t u8; uint16_t u16; uint32_t u32; int64_t i64; float f; double d;
+  Identifier id; QDateTime dt; QString str;
+  ok &= reader.readUInt8(u8) && (0xab == u8) && reader.readUInt16(u16) && (0xbeef == u16);
+  ok &= reader.readUInt32(u32) && (0xdeadbeef == u32);
+  ok &= reader.readInt64(i64) && (-1234567890123LL == i64);
+  ok &= reader.readFloat(f) && (-1.5f == f) && reader.readDouble(d) && (M_PI == d);
+  ok &= reader.readIdentifier(id) && (testId(7) == id) && reader.readDateTime(dt) && (when == dt);
+  ok &= reader.readString(str) && (QString::fromUtf8("Zürich") == str);
+  ok &= (0 == reader.bytesLeft()) && (! reader.readUInt8(u8));
+  BinaryReader empty(recs[1].constData(), recs[1].size());
+  ok &= empty.readString(str) && str.isEmpty() && (0 == empty.bytesLeft());
+  return report(ok, "fields", out);
+}
+
+/** Checks that short records, oversized records and invalid headers are rejected. */
+static bool
+testMalformed(QTextStream &out) {
+  // Reads past the end of a record fail
+  const char data[] = { 0, 5, 'a', 'b' };
+  BinaryReader reader(data, sizeof(data));
+  QString str; uint32_t u32; Identifier id;
+  bool ok = (! reader.readString(str)) && (! BinaryReader(data, 3).readUInt32(u32))
+      && (! BinaryReader(data, 4).readIdentifier(id));
+
+  // Records exceeding 64kB are dropped, the remaining ones stay intact
+  BinaryWriter writer(BinaryCodec::LIST);
+  writer.beginRecord(); writer.writeIdentifier(testId(1)); writer.endRecord();
+  writer.beginRecord();
+  for (int i=0; i<0x10000/OVL_HASH_SIZE+1; i++) { writer.writeIdentifier(testId(2)); }
+  ok &= (! writer.endRecord());
+  writer.beginRecord(); writer.writeIdentifier(testId(3)); writer.endRecord();
+  BinaryCodec::Type type;
+  QList<QByteArray> recs;
+  ok &= records(writer.data(), type, recs) && (BinaryCodec::LIST == type) && (2 == recs.size());
+  ok &= (QByteArray(testId(3).constData(), OVL_HASH_SIZE) == recs[1]);
+
+  // Invalid magic, version and truncated header
+  uint32_t count;
+  QByteArray header = writer.data().left(VLF_BINARY_HEADER_SIZE);
+  ok &= BinaryCodec::parseHeader(header.constData(), header.size(), type, count) && (2 == count);
+  ok &= (! BinaryCodec::parseHeader(header.constData(), header.size()-1, type, count));
+  QByteArray version = header; version[4] = char(BinaryCodec::Version+1);
+  ok &= (! BinaryCodec::parseHeader(version.constData(), version.size(), type, count));
+  QByteArray magic = header; magic[0] = 'X';
+  ok &= (! BinaryCodec::parseHeader(magic.constData(), magic.size(), type, count));
+  ok &= (! BinaryCodec::isBinary("[]"));
+  return report(ok, "malformed", out);
+}
+
+/** Checks the binary encoding of scheduled events. */
+static bool
+testSchedule(QTextStream &out) {
+  ScheduledEvent event(QDateTime::fromMSecsSinceEpoch(1700000000000LL), ScheduledEvent::WEEKLY,
+                       900);
+  BinaryWriter writer(BinaryCodec::SCHEDULE);
+  event.toBinary(writer);
+  BinaryCodec::Type type;
+  QList<QByteArray> recs;
+  bool ok = records(writer.data(), type, recs) && (1 == recs.size());
+  if (ok) {
+    BinaryReader reader(recs[0].constData(), recs[0].size());
+    ScheduledEvent res(reader);
+    ok &= res.isValid() && (event == res) && (900 == res.duration());
+  }
+  return report(ok, "schedule", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testFields(out);
+  ok &= testMalformed(out);
+  ok &= testSchedule(out);
+  return ok ? 0 : 1;
+}
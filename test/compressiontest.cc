@@ -0,0 +1,116 @@
+#include "lib/compression.hh"
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QFile>
+#include <random>
+#include <cmath>
+#include <algorithm>
+
+
+/** Returns @c n bytes of a compressible test signal. */
+static QByteArray
+testData(size_t n) {
+  std::mt19937 rng(1);
+  QByteArray data(n, 0);
+  for (size_t i=0; i<n; i++) {
+    data[int(i)] = char(int(100*std::sin(0.01*i)) + int(rng() % 8));
+  }
+  return data;
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks that a stream inflates to the original data, whatever the size of the chunks. */
+static bool
+testChunks(QTextStream &out) {
+  QByteArray data = testData(300000), compressed = deflateData(data);
+  bool ok = (! compressed.isEmpty()) && (compressed.size() < data.size());
+  const int chunks[] = { 1, 7, 4096, compressed.size() };
+  for (int c=0; c<4; c++) {
+    Inflater inflater;
+    QByteArray res;
+    for (int i=0; ok && (i<compressed.size()); i+=chunks[c]) {
+      ok &= (! inflater.isComplete());
+      ok &= inflater.inflate(compressed.constData()+i, std::min(chunks[c], compressed.size()-i),
+                             res);
+    }
+    ok &= inflater.isComplete() && (res == data) && (size_t(data.size()) == inflater.totalOut());
+  }
+  return report(ok, "chunks", out);
+}
+
+/** Checks that corrupt streams and trailing data are rejected. */
+static bool
+testCorrupt(QTextStream &out) {
+  QByteArray data = testData(10000), compressed = deflateData(data), res;
+  QByteArray corrupt = compressed;
+  corrupt[compressed.size()/2] = char(corrupt[compressed.size()/2] ^ 0x55);
+  Inflater broken;
+  bool ok = (! broken.inflate(corrupt, res));
+  // Trailing bytes within the last chunk and in a later chunk
+  Inflater trailing;
+  ok &= (! trailing.inflate(compressed + "x", res));
+  Inflater later;
+  res.clear();
+  ok &= later.inflate(compressed, res) && later.isComplete() && (! later.inflate("x", 1, res));
+  // Once failed, the inflater stays failed
+  ok &= (! later.inflate(QByteArray(), res));
+  return report(ok, "corrupt", out);
+}
+
+/** Checks that decompression stops once the limit is exceeded, even within a single chunk. */
+static bool
+testLimit(QTextStream &out) {
+  // 16MB of zeros compress to about 16kB at the best level
+  QByteArray data(1<<24, 0), compressed = deflateData(data, 9), res;
+  Inflater exact(data.size());
+  bool ok = (compressed.size() < (1<<16)) && exact.inflate(compressed, res) && exact.isComplete()
+      && (res == data);
+  Inflater limited(1<<20);
+  res.clear();
+  ok &= (! limited.inflate(compressed, res)) && (! limited.isComplete());
+  // Stops within one buffer beyond the limit
+  ok &= (res.size() <= ((1<<20) + (1<<16))) && (limited.totalOut() > (1<<20));
+  ok &= (! limited.inflate(QByteArray(), res));
+  return report(ok, "limit", out);
+}
+
+/** Checks the compressed copy of a file, including an empty one. */
+static bool
+testFile(QTextStream &out) {
+  QTemporaryDir dir;
+  bool ok = true;
+  const int sizes[] = { 0, 100, 1000000 };
+  for (int s=0; s<3; s++) {
+    QByteArray data = testData(sizes[s]);
+    QFile source(dir.filePath("source"));
+    ok &= source.open(QIODevice::WriteOnly) && (data.size() == source.write(data));
+    source.close();
+    ok &= deflateFile(dir.filePath("source"), dir.filePath("dest"));
+    QFile dest(dir.filePath("dest"));
+    ok &= dest.open(QIODevice::ReadOnly);
+    Inflater inflater;
+    QByteArray res;
+    ok &= inflater.inflate(dest.readAll(), res) && inflater.isComplete() && (res == data);
+  }
+  // Missing source
+  ok &= (! deflateFile(dir.filePath("missing"), dir.filePath("dest2")));
+  ok &= (! QFile::exists(dir.filePath("dest2")));
+  return report(ok, "file", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testChunks(out);
+  ok &= testCorrupt(out);
+  ok &= testLimit(out);
+  ok &= testFile(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,105 @@
+#include "lib/dsp/ddc.hh"
+#include <QTextStream>
+#include <vector>
+#include <cmath>
+#include <complex>
+
+/** Sample rate of the input device. */
+#define TEST_RATE      46000.
+/** Output rate of the down-converters. */
+#define TEST_OUTPUT    200.
+/** Duration of the signal in s. */
+#define TEST_DURATION  4
+/** Time in s until the filters settled. */
+#define TEST_SETTLE    0.5
+
+
+/** Returns the sum of the tones at the given frequencies with the given amplitudes. */
+static std::vector<int16_t>
+tones(const QVector<double> &frequencies, const QVector<double> &amplitudes) {
+  std::vector<int16_t> signal(size_t(TEST_DURATION*TEST_RATE));
+  for (size_t i=0; i<signal.size(); i++) {
+    double x = 0;
+    for (int j=0; j<frequencies.size(); j++) {
+      x += amplitudes[j]*std::cos(2*M_PI*frequencies[j]*i/TEST_RATE + 0.7*j);
+    }
+    signal[i] = int16_t(std::round(x));
+  }
+  return signal;
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks the selection of integer output rates. */
+static bool
+testRates(QTextStream &out) {
+  bool ok = (230 == DDCBank::integerRate(46000, 200)) && (200 == DDCBank::integerRate(48000, 200))
+      && (225 == DDCBank::integerRate(44100, 200));
+  // 22050 Hz is not divisible by 4, the bank falls back to the closest rate
+  ok &= (0 == DDCBank::integerRate(22050, 200));
+  DDCBank bank(22050, 200), integer(TEST_RATE, TEST_OUTPUT);
+  ok &= (std::abs(bank.outputRate()-200) < 10) && (230 == integer.outputRate())
+      && (200 == integer.decimation());
+  return report(ok, "rates", out);
+}
+
+/** Checks that each channel passes its tone at the input amplitude, shifted by the center
+ * frequency, and suppresses the tones of the other channels. */
+static bool
+testChannels(QTextStream &out) {
+  QVector<double> frequencies, amplitudes;
+  // Tones off the center frequencies, within the passband
+  frequencies.append(19830); amplitudes.append(2000);
+  frequencies.append(23420); amplitudes.append(200);
+  std::vector<int16_t> signal = tones(frequencies, amplitudes);
+  DDCBank bank(TEST_RATE, TEST_OUTPUT);
+  bank.add(19800); bank.add(23400);
+  // An empty channel 1kHz away from the strong tone
+  bank.add(20800);
+
+  bool ok = (3 == bank.numChannels());
+  double maxError[2] = {0, 0}, maxLeak = 0, rotation[2] = {0, 0};
+  std::complex<double> last[2];
+  size_t offset = 0, n = 0;
+  while (offset < signal.size()) {
+    offset += bank.process(signal.data()+offset, signal.size()-offset);
+    if (! bank.completed()) { continue; }
+    if (offset/TEST_RATE < TEST_SETTLE) { continue; }
+    for (int j=0; j<2; j++) {
+      std::complex<double> z(bank.re(j), bank.im(j));
+      maxError[j] = std::max(maxError[j], std::abs(std::abs(z)/amplitudes[j]-1));
+      // The phase rotates by the offset from the center frequency
+      if (n) { rotation[j] += std::arg(z*std::conj(last[j])); }
+      last[j] = z;
+    }
+    maxLeak = std::max(maxLeak, double(std::abs(std::complex<float>(bank.re(2), bank.im(2)))));
+    n++;
+  }
+  // 3.5s at 230Hz
+  ok &= (std::abs(double(n) - (TEST_DURATION-TEST_SETTLE)*230) < 2);
+  // The passband droop stays below 0.5dB, the tone 20dB weaker is not disturbed by the strong one
+  ok &= (maxError[0] < 0.06) && (maxError[1] < 0.06);
+  for (int j=0; j<2; j++) {
+    double frequency = rotation[j]/(n-1)*bank.outputRate()/(2*M_PI);
+    ok &= (std::abs(frequency - (frequencies[j]-(j ? 23400 : 19800))) < 0.01);
+  }
+  // At least 60dB below the strong tone
+  ok &= (maxLeak < 2000e-3);
+  out << "channels: amplitude error " << 100*maxError[0] << "%, " << 100*maxError[1]
+      << "%, leakage " << 20*std::log10(maxLeak/2000) << "dB\n";
+  return report(ok, "channels", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testRates(out);
+  ok &= testChannels(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#include "lib/dsp/goertzelbank.hh"
+#include <QTextStream>
+#include <vector>
+#include <cmath>
+
+/** Sample rate of the input device. */
+#define TEST_RATE      46000.
+/** Block length, not a power of two. */
+#define TEST_LENGTH    4600
+/** Frequency and amplitude of the tone. */
+#define TEST_FREQUENCY 19800.
+#define TEST_AMPLITUDE 1000.
+
+
+/** Returns a tone at the given frequency and amplitude. */
+static std::vector<int16_t>
+tone(double frequency, double amplitude, size_t n) {
+  std::vector<int16_t> signal(n);
+  for (size_t i=0; i<n; i++) {
+    signal[i] = int16_t(std::round(amplitude*std::cos(2*M_PI*frequency*i/TEST_RATE + 0.3)));
+  }
+  return signal;
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks the magnitudes of filters on and off the tone, processing the blocks in pieces. */
+static bool
+testMagnitude(QTextStream &out) {
+  GoertzelBank bank(TEST_RATE, TEST_LENGTH);
+  // On the tone, in the next bin, far off and between bins
+  bank.add(TEST_FREQUENCY); bank.add(TEST_FREQUENCY+10); bank.add(TEST_FREQUENCY+2000);
+  bank.add(TEST_FREQUENCY+5);
+  std::vector<int16_t> signal = tone(TEST_FREQUENCY, TEST_AMPLITUDE, 3*TEST_LENGTH);
+
+  bool ok = (4 == bank.numFilters()) && (10 == bank.resolution());
+  size_t offset = 0, blocks = 0;
+  while (offset < signal.size()) {
+    // Pieces not aligned to the blocks
+    size_t n = std::min(signal.size()-offset, size_t(1000));
+    size_t m = bank.process(signal.data()+offset, n);
+    ok &= (m > 0) && (m <= n);
+    offset += m;
+    if (! bank.completed()) { continue; }
+    blocks++;
+    // A DFT bin of a tone at amplitude A has magnitude A*N/2
+    double expected = TEST_AMPLITUDE*std::sqrt(double(TEST_LENGTH))/2;
+    ok &= (std::abs(bank.magnitude(0)/expected-1) < 1e-3);
+    ok &= (bank.magnitude(1) < 1e-3*expected) && (bank.magnitude(2) < 1e-3*expected);
+    // Half a bin off, the magnitude drops to 2/pi
+    ok &= (std::abs(bank.magnitude(3)/expected - 2/M_PI) < 1e-2);
+  }
+  // Each block starts from a reset state
+  ok &= (3 == blocks) && (offset == signal.size());
+  return report(ok, "magnitude", out);
+}
+
+/** Checks that of a comb of filters spaced by the resolution only the one on the tone responds. */
+static bool
+testComb(QTextStream &out) {
+  GoertzelBank bank(TEST_RATE, TEST_LENGTH);
+  std::vector<int16_t> signal = tone(TEST_FREQUENCY, TEST_AMPLITUDE, TEST_LENGTH);
+  for (int i=0; i<9; i++) {
+    bank.add(TEST_FREQUENCY - 40 + 10*i);
+  }
+  bool ok = (TEST_LENGTH == bank.process(signal.data(), signal.size())) && bank.completed();
+  for (int i=0; i<9; i++) {
+    ok &= ((4 == i) == (bank.magnitude(i) > 1));
+  }
+  ok &= (0 == bank.process(signal.data(), 0)) && (! bank.completed());
+  return report(ok, "comb", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testMagnitude(out);
+  ok &= testComb(out);
+  return ok ? 0 : 1;
+}
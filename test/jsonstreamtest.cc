@@ -0,0 +1,121 @@
+#include "lib/jsonstream.hh"
+#include <QTextStream>
+#include <QStringList>
+#include <QJsonObject>
+#include <cstring>
+#include <algorithm>
+
+
+/** Collects the elements, aborts after @c abortAfter elements if not 0. */
+class Collector: public JsonStreamHandler
+{
+public:
+  Collector(size_t limit=0)
+    : JsonStreamHandler(), abortAfter(limit), items(), keys()
+  {
+    // pass...
+  }
+
+  bool arrayItem(const QJsonValue &value) {
+    items.append(value);
+    return (0 == abortAfter) || (size_t(items.size()) < abortAfter);
+  }
+
+  bool objectMember(const QString &key, const QJsonValue &value) {
+    keys.append(key);
+    return arrayItem(value);
+  }
+
+public:
+  size_t abortAfter;
+  QList<QJsonValue> items;
+  QStringList keys;
+};
+
+/** Parses the document in chunks of @c chunk bytes, returns @c true if it is complete and
+ * valid. */
+static bool
+parse(const char *doc, Collector &handler, size_t chunk=(1<<16), size_t maxElementSize=(1<<20)) {
+  JsonStreamParser parser(handler, maxElementSize);
+  size_t len = std::strlen(doc);
+  for (size_t i=0; i<len; i+=chunk) {
+    if (! parser.feed(doc+i, std::min(chunk, len-i))) { return false; }
+  }
+  return parser.isComplete() && (! parser.hasError());
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks that arrays and objects yield their elements, whatever the size of the chunks. */
+static bool
+testElements(QTextStream &out) {
+  const char *array = " [\"a,]\\\"\", 12 ,-1.5e3,true,null,[1,[2]],{\"x\":\"}\"}] ";
+  const char *object = "{\"a\" : 1, \"b\\\"\":[\"]\"], \"c\":{}}";
+  bool ok = true;
+  const size_t chunks[] = { 1, 3, 1<<16 };
+  for (int c=0; c<3; c++) {
+    Collector items, members;
+    ok &= parse(array, items, chunks[c]) && (7 == items.items.size());
+    ok = ok && (QString("a,]\"") == items.items[0].toString()) && (12 == items.items[1].toInt())
+        && (-1500 == items.items[2].toDouble()) && items.items[3].toBool()
+        && items.items[4].isNull() && items.items[5].isArray()
+        && (QString("}") == items.items[6].toObject().value("x").toString());
+    ok &= parse(object, members, chunks[c]) && (3 == members.items.size());
+    ok = ok && ((QStringList() << "a" << "b\"" << "c") == members.keys);
+  }
+  Collector empty;
+  ok &= parse("[]", empty) && parse("{ }", empty) && empty.items.isEmpty();
+  return report(ok, "elements", out);
+}
+
+/** Checks that malformed documents are rejected, in particular missing or repeated separators. */
+static bool
+testMalformed(QTextStream &out) {
+  const char *docs[] = { "[1 2]", "[,1]", "[1,]", "[1,,2]", "[[1] [2]]", "{\"a\":1 \"b\":2}",
+                         "{\"a\":1,}", "{,\"a\":1}", "{\"a\" 1}", "{1:2}", "\"a\"", "[1]]",
+                         "[1}", "[tru]", "[1", 0 };
+  bool ok = true;
+  for (int i=0; docs[i]; i++) {
+    Collector handler;
+    ok &= (! parse(docs[i], handler));
+  }
+  return report(ok, "malformed", out);
+}
+
+/** Checks the limit of the element size and the abort by the handler. */
+static bool
+testLimits(QTextStream &out) {
+  // Many small elements are fine, a single large one is not
+  QByteArray many = "[";
+  for (int i=0; i<1000; i++) { many.append(i ? ",\"0123456789\"" : "\"0123456789\""); }
+  many.append("]");
+  Collector small, large;
+  bool ok = parse(many.constData(), small, 100, 64) && (1000 == small.items.size());
+  QByteArray big = "[\"" + QByteArray(100, 'x') + "\"]";
+  ok &= (! parse(big.constData(), large, 7, 64)) && large.items.isEmpty();
+
+  Collector abort(2);
+  JsonStreamParser parser(abort);
+  ok &= (! parser.feed("[1,2,3]")) && parser.hasError() && (2 == abort.items.size());
+  // The parser stays failed until reset
+  ok &= (! parser.feed(" "));
+  parser.reset();
+  abort.abortAfter = 0;
+  ok &= parser.feed("[4]") && parser.isComplete() && (3 == abort.items.size());
+  return report(ok, "limits", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testElements(out);
+  ok &= testMalformed(out);
+  ok &= testLimits(out);
+  return ok ? 0 : 1;
+}
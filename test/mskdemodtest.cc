@@ -0,0 +1,93 @@
+#include "lib/dsp/mskdemod.hh"
+#include <QTextStream>
+#include <vector>
+#include <random>
+#include <cmath>
+
+/** Sample rate of the input device. */
+#define TEST_RATE      46000.
+/** Carrier, baud rate and amplitude of the synthetic beacon. */
+#define TEST_CARRIER   23400.
+#define TEST_BAUD      200.
+#define TEST_AMPLITUDE 3000.
+/** Standard deviation of the white noise added. */
+#define TEST_NOISE     300.
+/** Duration of the signal in s, the carrier phase jumps by TEST_JUMP rad halfway. The squared
+ * signal jumps by four times that, which must stay well below pi to be unwrapped. */
+#define TEST_DURATION  20
+#define TEST_JUMP      0.5
+/** Time in s to acquire the carrier. */
+#define TEST_SETTLE    2.
+
+
+/** Generates a random MSK signal with the given carrier offset in Hz. */
+static std::vector<int16_t>
+mskSignal(double offset, unsigned seed) {
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> noise(0, TEST_NOISE);
+  size_t n = TEST_DURATION*TEST_RATE;
+  double samplesPerSymbol = TEST_RATE/TEST_BAUD, modulation = 0;
+  int bit = 1;
+  std::vector<int16_t> signal(n);
+  for (size_t i=0; i<n; i++) {
+    if (std::fmod(i, samplesPerSymbol) < 1) { bit = (rng() & 1) ? 1 : -1; }
+    // The phase changes by +/- pi/2 per symbol
+    modulation += bit*M_PI/2/samplesPerSymbol;
+    double phase = 2*M_PI*(TEST_CARRIER+offset)*i/TEST_RATE + modulation + 0.3
+        + ((i > n/2) ? TEST_JUMP : 0);
+    signal[i] = int16_t(std::round(TEST_AMPLITUDE*std::cos(phase) + noise(rng)));
+  }
+  return signal;
+}
+
+/** Demodulates the signal and checks the estimates. Returns @c false on failure. */
+static bool
+check(double offset, unsigned seed, QTextStream &out) {
+  std::vector<int16_t> signal = mskSignal(offset, seed);
+  MSKDemodulator demod(TEST_RATE, 0.1);
+  demod.add(TEST_CARRIER, TEST_BAUD);
+
+  // Phase relative to the carrier of the signal, averaged before and after the jump
+  double sumAmpl = 0, maxAmplError = 0, maxOffsetError = 0;
+  double before[2] = {0, 0}, after[2] = {0, 0};
+  size_t n = 0, offset0 = 0;
+  while (offset0 < signal.size()) {
+    offset0 += demod.process(signal.data()+offset0, signal.size()-offset0);
+    if (! demod.completed()) { continue; }
+    double t = offset0/TEST_RATE;
+    if (t < TEST_SETTLE) { continue; }
+    sumAmpl += demod.amplitude(0); n++;
+    maxAmplError = std::max(maxAmplError, std::abs(demod.amplitude(0)/TEST_AMPLITUDE-1));
+    // Skip the jump, the frequency tracking takes a while to settle again
+    if (std::abs(t-TEST_DURATION/2.) < 1) { continue; }
+    maxOffsetError = std::max(maxOffsetError, std::abs(demod.frequencyOffset(0)-offset));
+    double phase = demod.phase(0) - 2*M_PI*offset*t;
+    double *sum = (t < TEST_DURATION/2.) ? before : after;
+    sum[0] += std::cos(phase); sum[1] += std::sin(phase);
+  }
+  double meanAmplError = std::abs(sumAmpl/n/TEST_AMPLITUDE-1);
+  double jump = std::remainder(std::atan2(after[1], after[0])-std::atan2(before[1], before[0]),
+                               2*M_PI);
+
+  bool ok = (meanAmplError < 0.01) && (maxAmplError < 0.05) && (maxOffsetError < 0.1)
+      && (std::abs(jump-TEST_JUMP) < 0.1);
+  out << (ok ? "ok  " : "FAIL") << " offset " << offset << "Hz, seed " << seed
+      << ": amplitude error " << 100*meanAmplError << "% mean, " << 100*maxAmplError
+      << "% max, offset error " << maxOffsetError << "Hz max, phase jump " << jump << "rad\n";
+  return ok;
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  // Offsets up to 2.5Hz (baud/80) must be acquired, baud/64 is the theoretical limit
+  const double offsets[] = {-2.5, -1, 0, 1, 2.5};
+  bool ok = true;
+  for (unsigned seed=1; seed<=3; seed++) {
+    for (int i=0; i<5; i++) {
+      ok &= check(offsets[i], seed, out);
+    }
+  }
+  return ok ? 0 : 1;
+}
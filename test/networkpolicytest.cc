@@ -0,0 +1,110 @@
+#include "lib/networkpolicy.hh"
+#include <QTextStream>
+
+
+/** Returns the identifier with all bytes set to @c i. */
+static Identifier
+testId(int i) {
+  char id[OVL_HASH_SIZE];
+  for (int j=0; j<OVL_HASH_SIZE; j++) { id[j] = char(i); }
+  return Identifier(id);
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks that fresh candidates are preferred and failed ones retried with a backoff until they
+ * get dropped. */
+static bool
+testCrawlQueue(QTextStream &out) {
+  CrawlQueue queue(1000, 600000, 60000, 3);
+  Identifier id;
+  bool ok = (-1 == queue.nextDue(0));
+  ok &= queue.add(testId(1), 0) && queue.add(testId(2), 0) && (! queue.add(testId(1), 0));
+  ok &= (2 == queue.numPending()) && (0 == queue.nextDue(0));
+  ok &= queue.next(id, 0) && (testId(1) == id);
+  queue.failed(id, 0);
+  // The fresh candidate comes first, the failed one is due after the backoff
+  ok &= queue.next(id, 0) && (testId(2) == id) && (! queue.next(id, 0));
+  ok &= (60000 == queue.nextDue(0)) && (! queue.next(id, 59999));
+  ok &= queue.succeeded(testId(2), 100) && (1 == queue.numDiscovered());
+  // Backoff doubles, dropped after the third attempt
+  ok &= queue.next(id, 60000) && (testId(1) == id);
+  queue.failed(id, 60000);
+  ok &= (120000 == queue.nextDue(60000));
+  ok &= queue.next(id, 180000);
+  queue.failed(id, 180000);
+  ok &= (0 == queue.numPending()) && (1 == queue.numDropped()) && (-1 == queue.nextDue(180000));
+  return report(ok, "crawl queue", out);
+}
+
+/** Checks the probe limit and the order of candidates and refreshes. */
+static bool
+testProbes(QTextStream &out) {
+  NetworkPolicy policy(2);
+  Identifier id; bool refresh;
+  bool ok = (-1 == policy.nextRound(0));
+  policy.crawler().add(testId(1), 0); policy.crawler().add(testId(2), 0);
+  policy.crawler().add(testId(3), 0);
+  ok &= (NetworkPolicy::MinRound == policy.nextRound(0));
+  ok &= policy.nextProbe(id, refresh, 0) && (testId(1) == id) && (! refresh);
+  ok &= policy.nextProbe(id, refresh, 0) && (testId(2) == id);
+  // All probes running
+  ok &= (! policy.nextProbe(id, refresh, 0)) && (2 == policy.numProbes());
+  ok &= policy.probeDone(10) && policy.nextProbe(id, refresh, 10) && (testId(3) == id);
+  return report(ok, "probes", out);
+}
+
+/** Checks that rescheduled refreshes replace the previous ones. */
+static bool
+testRefreshes(QTextStream &out) {
+  NetworkPolicy policy(2);
+  Identifier id; bool refresh;
+  policy.scheduleRefresh(testId(1), 5000); policy.scheduleRefresh(testId(2), 3000);
+  policy.scheduleRefresh(testId(1), 7000);
+  bool ok = (2 == policy.numRefreshes()) && (3000 == policy.nextRound(0));
+  ok &= (! policy.nextProbe(id, refresh, 2999));
+  ok &= policy.nextProbe(id, refresh, 5000) && (testId(2) == id) && refresh;
+  // The outdated refresh of the first station is skipped
+  ok &= (! policy.nextProbe(id, refresh, 5000)) && (2000 == policy.nextRound(5000));
+  policy.removeRefresh(testId(1));
+  ok &= (-1 == policy.nextRound(5000));
+  ok &= (2*NetworkPolicy::MinRefresh
+         == NetworkPolicy::refreshAfterSuccess(NetworkPolicy::MinRefresh, 1, 0));
+  ok &= (NetworkPolicy::MinRefresh
+         == NetworkPolicy::refreshAfterSuccess(NetworkPolicy::MaxRefresh, 3, 1));
+  ok &= (NetworkPolicy::MaxRefresh == NetworkPolicy::refreshAfterFailure(20));
+  return report(ok, "refreshes", out);
+}
+
+/** Checks that an overdue refresh does not stop the rounds while candidates are waiting. */
+static bool
+testOverdue(QTextStream &out) {
+  NetworkPolicy policy(1);
+  Identifier id; bool refresh;
+  policy.scheduleRefresh(testId(1), 1000);
+  policy.crawler().add(testId(2), 0); policy.crawler().add(testId(3), 0);
+  bool ok = policy.nextProbe(id, refresh, 0) && (testId(2) == id);
+  // The probe runs past the refresh
+  ok &= (NetworkPolicy::MinRound == policy.nextRound(5000));
+  policy.probeDone(5000);
+  ok &= policy.nextProbe(id, refresh, 5000) && (testId(3) == id);
+  policy.probeDone(5100);
+  ok &= policy.nextProbe(id, refresh, 5100) && (testId(1) == id) && refresh;
+  return report(ok, "overdue refresh", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testCrawlQueue(out);
+  ok &= testProbes(out);
+  ok &= testRefreshes(out);
+  ok &= testOverdue(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+#include "lib/pipeline.hh"
+#include <QTextStream>
+#include <QElapsedTimer>
+#include <atomic>
+#include <vector>
+
+/** Block size and queue capacity of the test stages. */
+#define TEST_BLOCK_SIZE 64
+#define TEST_CAPACITY   256
+
+
+/** Sums the samples passed to the stage, sleeps @c delay ms per block to simulate a slow
+ * stage. */
+class SumStage: public PipelineStage
+{
+public:
+  SumStage(Overflow overflow, unsigned long delay=0)
+    : PipelineStage("test", TEST_BLOCK_SIZE, TEST_CAPACITY, overflow), _delay(delay), _sum(0),
+      _count(0)
+  {
+    // pass...
+  }
+
+  qint64 sum() const { return _sum; }
+  size_t count() const { return _count; }
+
+protected:
+  void process(const int16_t *samples, size_t n) {
+    for (size_t i=0; i<n; i++) {
+      _sum += samples[i];
+    }
+    _count += n;
+    if (_delay) { QThread::msleep(_delay); }
+  }
+
+protected:
+  unsigned long _delay;
+  std::atomic<qint64> _sum;
+  std::atomic<size_t> _count;
+};
+
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks the ring buffer of the queue, including the wrap-around. */
+static bool
+testQueue(QTextStream &out) {
+  SPSCQueue<int16_t> queue(100);
+  std::vector<int16_t> in(256), res(256);
+  for (size_t i=0; i<in.size(); i++) { in[i] = i; }
+  bool ok = (128 == queue.capacity());
+  ok &= (100 == queue.push(in.data(), 100)) && (28 == queue.push(in.data()+100, 100));
+  ok &= (50 == queue.pop(res.data(), 50)) && (78 == queue.size());
+  // Wraps around the end of the buffer
+  ok &= (50 == queue.push(in.data()+128, 100));
+  ok &= (128 == queue.pop(res.data()+50, 200)) && (0 == queue.size());
+  for (size_t i=0; i<178; i++) {
+    ok &= (res[i] == in[i]);
+  }
+  return report(ok, "queue", out);
+}
+
+/** Checks that a flush processes all samples, including the final partial block. */
+static bool
+testFlush(QTextStream &out) {
+  SumStage stage(PipelineStage::BLOCK);
+  stage.start();
+  std::vector<int16_t> samples(1000);
+  for (size_t i=0; i<samples.size(); i++) { samples[i] = i+1; }
+  for (size_t i=0; i<samples.size(); i+=10) {
+    stage.push(samples.data()+i, 10);
+  }
+  stage.flush();
+  PipelineStage::Statistics stats = stage.statistics();
+  bool ok = (1000 == stage.count()) && (500500 == stage.sum()) && (16 == stats.blocks)
+      && (0 == stats.dropped);
+  stage.stop();
+  stage.wait();
+  return report(ok, "flush", out);
+}
+
+/** Checks that a stage can be restarted, even if stopped while not running. */
+static bool
+testRestart(QTextStream &out) {
+  SumStage stage(PipelineStage::BLOCK);
+  std::vector<int16_t> samples(100, 1);
+  stage.stop();
+  stage.start();
+  stage.push(samples.data(), samples.size());
+  stage.flush();
+  bool ok = (100 == stage.count());
+  stage.stop();
+  stage.wait();
+  ok &= (! stage.isRunning());
+  stage.start();
+  stage.push(samples.data(), samples.size());
+  stage.flush();
+  ok &= (200 == stage.count());
+  stage.stop();
+  stage.wait();
+  return report(ok, "restart", out);
+}
+
+/** Checks that the producer waits a bounded time for a stuck stage and counts the stall and the
+ * dropped samples. */
+static bool
+testStall(QTextStream &out) {
+  SumStage stage(PipelineStage::BLOCK, 500);
+  stage.start();
+  std::vector<int16_t> samples(2*TEST_CAPACITY, 1);
+  QElapsedTimer timer; timer.start();
+  size_t pushed = stage.push(samples.data(), samples.size());
+  qint64 elapsed = timer.elapsed();
+  PipelineStage::Statistics stats = stage.statistics();
+  bool ok = (pushed >= TEST_CAPACITY) && (pushed < samples.size()) && (elapsed < 400)
+      && (1 == stats.stalls) && ((samples.size()-pushed) == stats.dropped);
+  stage.stop();
+  stage.wait();
+  return report(ok, "stall", out);
+}
+
+/** Checks that a stage with the DROP policy never waits. */
+static bool
+testDrop(QTextStream &out) {
+  SumStage stage(PipelineStage::DROP, 500);
+  stage.start();
+  std::vector<int16_t> samples(2*TEST_CAPACITY, 1);
+  QElapsedTimer timer; timer.start();
+  size_t pushed = stage.push(samples.data(), samples.size());
+  PipelineStage::Statistics stats = stage.statistics();
+  bool ok = (TEST_CAPACITY == pushed) && (timer.elapsed() < 50) && (0 == stats.stalls)
+      && (TEST_CAPACITY == stats.dropped);
+  stage.stop();
+  stage.wait();
+  return report(ok, "drop", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testQueue(out);
+  ok &= testFlush(out);
+  ok &= testRestart(out);
+  ok &= testStall(out);
+  ok &= testDrop(out);
+  return ok ? 0 : 1;
+}
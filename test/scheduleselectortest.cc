@@ -0,0 +1,117 @@
+#include "lib/scheduleselector.hh"
+#include <QTextStream>
+
+
+/** Returns the identifier with all bytes set to @c i. */
+static Identifier
+testId(int i) {
+  char id[OVL_HASH_SIZE];
+  for (int j=0; j<OVL_HASH_SIZE; j++) { id[j] = char(i); }
+  return Identifier(id);
+}
+
+/** Returns the participants with the given numbers, located along the equator. */
+static QList<ScheduleSelector::Participant>
+participants(const QList<int> &stations) {
+  QList<ScheduleSelector::Participant> result;
+  foreach (int i, stations) {
+    result.append(ScheduleSelector::Participant(testId(i), Location(10*i, 0, 0)));
+  }
+  return result;
+}
+
+/** Returns the event at the given hour after the start of the test week. */
+static ScheduledEvent
+event(int hour, ScheduledEvent::Type type=ScheduledEvent::SINGLE) {
+  // A Monday
+  QDateTime start(QDate(2030, 1, 7), QTime(0, 0), Qt::UTC);
+  return ScheduledEvent(start.addSecs(3600*hour), type);
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks that events adding new stations, baselines and times are preferred and events covering
+ * only what is covered already are never selected. */
+static bool
+testCoverage(QTextStream &out) {
+  QDateTime now(QDate(2030, 1, 1), QTime(0, 0), Qt::UTC);
+  ScheduleSelector selector;
+  ScheduledEvent local = event(10), same = event(10+7*24), small = event(12), large = event(11);
+  selector.update(local, participants(QList<int>() << 1));
+  // Same station and hour of the week as the local event
+  selector.update(same, participants(QList<int>() << 1));
+  selector.update(small, participants(QList<int>() << 1 << 2));
+  selector.update(large, participants(QList<int>() << 1 << 3 << 4));
+  QList<ScheduledEvent> fixed; fixed << local;
+
+  // The baseline of the small event has the same class as one of the large event
+  bool ok = (2 == selector.coverage(fixed))
+      && (2+1+1 == selector.coverage(QList<ScheduledEvent>() << small))
+      && (3+3+1 == selector.coverage(QList<ScheduledEvent>() << large));
+  // Only one fits into the budget, the cost must be less than the budget
+  QList<ScheduledEvent> selection = selector.select(1.5, fixed, now);
+  ok &= (1 == selection.size()) && (large == selection.first());
+  ok &= selector.select(1, fixed, now).isEmpty();
+  // Both fit, the small event still adds a station and an hour, the event without gain is not
+  // selected
+  selection = selector.select(10, fixed, now);
+  ok &= (2 == selection.size()) && (large == selection[0]) && (small == selection[1]);
+  // Passed events are ignored
+  selection = selector.select(10, fixed, large.first().addSecs(60));
+  ok &= (1 == selection.size()) && (small == selection.first());
+  return report(ok, "coverage", out);
+}
+
+/** Checks that an expensive event covering most wins over cheap events covering little. */
+static bool
+testCost(QTextStream &out) {
+  QDateTime now(QDate(2030, 1, 1), QTime(0, 0), Qt::UTC);
+  ScheduleSelector selector;
+  ScheduledEvent cheap = event(5), daily = event(6, ScheduledEvent::DAILY);
+  selector.update(cheap, participants(QList<int>() << 1));
+  QList<int> many;
+  for (int i=2; i<12; i++) { many << i; }
+  selector.update(daily, participants(many));
+  // Gain per cost prefers the cheap event, after which the daily one does not fit anymore
+  QList<ScheduledEvent> selection = selector.select(28.5, QList<ScheduledEvent>(), now);
+  bool ok = (1 == selection.size()) && (daily == selection.first());
+  selection = selector.select(29.5, QList<ScheduledEvent>(), now);
+  ok &= (2 == selection.size());
+  return report(ok, "cost", out);
+}
+
+/** Checks updating and removing candidates. */
+static bool
+testUpdate(QTextStream &out) {
+  QDateTime now(QDate(2030, 1, 1), QTime(0, 0), Qt::UTC);
+  ScheduleSelector selector;
+  ScheduledEvent a = event(1), b = event(2), c = event(3);
+  selector.update(a, participants(QList<int>() << 1));
+  selector.update(b, participants(QList<int>() << 2));
+  selector.update(c, participants(QList<int>() << 3));
+  selector.update(b, participants(QList<int>() << 2 << 4 << 5));
+  bool ok = (3 == selector.numCandidates())
+      && (3+3+1 == selector.coverage(QList<ScheduledEvent>() << b));
+  selector.remove(a);
+  ok &= (2 == selector.numCandidates()) && (! selector.contains(a)) && selector.contains(c);
+  QList<ScheduledEvent> selection = selector.select(1.5, QList<ScheduledEvent>(), now);
+  ok &= (1 == selection.size()) && (b == selection.first());
+  // Unknown events cover their time only
+  ok &= (1 == selector.coverage(QList<ScheduledEvent>() << a));
+  return report(ok, "update", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testCoverage(out);
+  ok &= testCost(out);
+  ok &= testUpdate(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,86 @@
+#include "lib/scheduletrigger.hh"
+#include <QCoreApplication>
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks the order of the upcoming occurrences and the removal of events. */
+static bool
+testHeap(QTextStream &out) {
+  QTemporaryDir dir;
+  LocalSchedule schedule(dir.filePath("schedule.json"));
+  QDateTime now = QDateTime::currentDateTime();
+  ScheduledEvent single(now.addSecs(3600)), daily(now.addSecs(7200), ScheduledEvent::DAILY);
+  ScheduledEvent weekly(now.addDays(-1), ScheduledEvent::WEEKLY);
+  schedule.add(single); schedule.add(daily); schedule.add(weekly);
+  ScheduleTrigger trigger(schedule);
+  trigger.rearm();
+  QDateTime next;
+  bool ok = (3 == trigger.numPending()) && (single.first() == trigger.next());
+  ok &= trigger.next(now.addSecs(1), next) && (single.first() == next);
+  // Past the earliest occurrence, the heap cannot answer
+  ok &= (! trigger.next(now.addSecs(3601), next));
+  trigger.remove(single);
+  ok &= (! trigger.contains(single)) && trigger.contains(daily) && (2 == trigger.numPending());
+  ok &= (daily.first() == trigger.next());
+  trigger.remove(daily);
+  ok &= (now.addDays(6).date() == trigger.next().date());
+  trigger.remove(weekly);
+  ok &= (! trigger.next().isValid()) && trigger.next(now.addSecs(1), next) && (! next.isValid());
+  return report(ok, "heap", out);
+}
+
+/** Checks that coincident occurrences trigger once with the longest duration, removed events do
+ * not trigger and late occurrences are skipped. */
+static bool
+testTrigger(QTextStream &out) {
+  QTemporaryDir dir;
+  LocalSchedule schedule(dir.filePath("schedule.json"));
+  ScheduleTrigger trigger(schedule);
+  trigger.setMaxLateness(50);
+  trigger.rearm();
+  QDateTime start = QDateTime::currentDateTime();
+  QThread::msleep(100);
+  // Between the last rearm and now, hence late
+  trigger.add(ScheduledEvent(start.addMSecs(10)));
+
+  QDateTime now = QDateTime::currentDateTime();
+  trigger.add(ScheduledEvent(now.addMSecs(200), ScheduledEvent::SINGLE, 10));
+  trigger.add(ScheduledEvent(now.addMSecs(200), ScheduledEvent::DAILY, 30));
+  ScheduledEvent removed(now.addMSecs(300));
+  trigger.add(removed);
+  trigger.remove(removed);
+
+  QList< QPair<QDateTime, int> > triggered;
+  QObject::connect(&trigger, &ScheduleTrigger::triggered, [&triggered](const QDateTime &when,
+                   int duration) { triggered.append(qMakePair(when, duration)); });
+  QTimer::singleShot(600, QCoreApplication::instance(), SLOT(quit()));
+  QCoreApplication::exec();
+
+  bool ok = (1 == triggered.size()) && (1 == trigger.numTriggered())
+      && (1 == trigger.numMissed());
+  ok = ok && (now.addMSecs(200) == triggered.first().first) && (30 == triggered.first().second);
+  ok &= (trigger.maxJitter() >= 0) && (trigger.maxJitter() < 100);
+  // The daily event is due again tomorrow
+  ok &= (3 == trigger.numPending()) && (now.addMSecs(200).addDays(1) == trigger.next());
+  return report(ok, "trigger", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QCoreApplication app(argc, argv);
+  QTextStream out(stdout);
+  bool ok = testHeap(out);
+  ok &= testTrigger(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,150 @@
+#include "lib/sidstore.hh"
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <QFile>
+#include <cstring>
+#include <random>
+
+
+/** Returns @c true if both rows are bitwise equal, NaN phases included. */
+static bool
+equal(const SidRow &a, const SidRow &b) {
+  return (a.time == b.time) && (0 == std::memcmp(&a.mean, &b.mean, 4*sizeof(float)));
+}
+
+/** Returns @c n rows sampled at about 10 Hz with some jitter, starting at @c time. */
+static QVector<SidRow>
+testRows(size_t n, qint64 time, std::mt19937 &rng) {
+  std::normal_distribution<float> noise(0, 1);
+  QVector<SidRow> rows;
+  float value = 1;
+  for (size_t i=0; i<n; i++) {
+    time += 100 + int(noise(rng)*20);
+    // A gap now and then
+    if (0 == (i % 97)) { time += 60000; }
+    value += 0.01*noise(rng);
+    SidRow row = { qint64(time), value, value-0.1f, value+0.1f, (i % 5) ? noise(rng) : NAN };
+    rows.append(row);
+  }
+  return rows;
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks that chunks decode to the encoded rows, with and without min and max. */
+static bool
+testChunk(QTextStream &out) {
+  std::mt19937 rng(1);
+  bool ok = true;
+  for (int minMax=0; minMax<2; minMax++) {
+    QVector<SidRow> rows = testRows(1000, 1700000000000LL, rng);
+    if (! minMax) {
+      for (int i=0; i<rows.size(); i++) { rows[i].min = rows[i].max = rows[i].mean; }
+    }
+    QByteArray data = SidChunk::encode(rows, minMax);
+    QVector<SidRow> res;
+    ok &= SidChunk::decode(data.constData(), data.size(), rows.size(), minMax, res);
+    ok &= (res.size() == rows.size());
+    for (int i=0; ok && (i<rows.size()); i++) {
+      ok &= equal(rows[i], res[i]);
+    }
+    // A truncated chunk fails
+    res.clear();
+    ok &= (! SidChunk::decode(data.constData(), data.size()/2, rows.size(), minMax, res));
+  }
+  return report(ok, "chunk", out);
+}
+
+/** Checks that a truncated chunk at the end of a file gets dropped on open. */
+static bool
+testTruncation(QTextStream &out) {
+  QTemporaryDir dir;
+  QString filename = dir.filePath("test.sid");
+  std::mt19937 rng(2);
+  QVector<SidRow> rows = testRows(250, 1700000000000LL, rng);
+  {
+    SidSeriesFile file(filename, false, 100, 3600000);
+    foreach (SidRow row, rows) { file.append(row); }
+  }
+  QFile file(filename);
+  qint64 size = file.size();
+  // Cut the last chunk of 50 rows
+  file.resize(size-5);
+  QVector<SidRow> res;
+  SidSeriesFile series(filename, false, 100, 3600000);
+  series.query(rows.first().time, rows.last().time+1, res, 1000);
+  bool ok = (200 == res.size()) && (file.size() < (size-5));
+  for (int i=0; ok && (i<res.size()); i++) {
+    ok &= (res[i].time == rows[i].time) && (res[i].mean == rows[i].mean);
+  }
+  // Appends continue after the last complete chunk
+  series.append(rows[200]);
+  series.flush();
+  res.clear();
+  series.query(rows.first().time, rows.last().time+1, res, 1000);
+  ok &= (201 == res.size()) && (rows[200].time == series.last());
+  return report(ok, "truncation", out);
+}
+
+/** Checks that raw rows beyond the retention get pruned while the rollups are kept. */
+static bool
+testPrune(QTextStream &out) {
+  QTemporaryDir dir;
+  // Start at midnight, such that the first rollup starts with the first row
+  qint64 day = 24*3600*1000LL, start = 19675*day, end = start + 4*day;
+  qint64 first = 0, last = 0;
+  bool ok = true;
+  {
+    SidStore store(dir.path());
+    store.setRawRetention(day);
+    for (qint64 t=start; t<end; t+=60000) {
+      store.append("test", t, 1);
+    }
+    ok &= store.range("test", SidStore::RAW, first, last) && (first >= (end-3*day))
+        && (first < (end-day));
+    ok &= store.range("test", SidStore::HOUR, first, last) && (start == first);
+    ok &= store.range("test", first, last) && (start == first) && ((end-60000) == last);
+  }
+  // Reopen the pruned files
+  SidStore store(dir.path());
+  QVector<SidRow> rows = store.query("test", start, end, SidStore::RAW, 10000);
+  ok &= (! rows.isEmpty()) && (rows.first().time >= (end-3*day))
+      && ((end-60000) == rows.last().time);
+  for (int i=1; ok && (i<rows.size()); i++) {
+    ok &= ((rows[i].time - rows[i-1].time) == 60000);
+  }
+  // The last hour is still accumulated
+  ok &= ((4*24-1) == store.query("test", start, end, SidStore::HOUR, 10000).size());
+  return report(ok, "prune", out);
+}
+
+/** Checks the level selection for the raw rate. */
+static bool
+testLevel(QTextStream &out) {
+  bool ok = (SidStore::RAW == SidStore::level(0, 100000, 2000, 10));
+  ok &= (SidStore::SECOND == SidStore::level(0, 100000, 2000, 50));
+  ok &= (SidStore::SECOND == SidStore::level(0, 100000, 2000, 0));
+  ok &= (SidStore::MINUTE == SidStore::level(0, 24*3600*1000LL, 2000, 10));
+  QTemporaryDir dir;
+  SidStore store(dir.path());
+  ok &= (0 == store.diskRate());
+  store.setRawRate(10, 2);
+  ok &= (store.diskRate() > 0);
+  return report(ok, "level", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  bool ok = testChunk(out);
+  ok &= testTruncation(out);
+  ok &= testPrune(out);
+  ok &= testLevel(out);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,120 @@
+#include "lib/dsp/welch.hh"
+#include <QTextStream>
+#include <QTemporaryDir>
+#include <vector>
+#include <random>
+#include <cmath>
+
+/** Sample rate of the input device. */
+#define TEST_RATE      46000.
+/** Resolution of the estimate, 920 samples per frame. */
+#define TEST_RESOLUTION 50.
+/** Frequency and amplitude of the tone. */
+#define TEST_FREQUENCY 19800.
+#define TEST_AMPLITUDE 1000.
+/** Standard deviation of the white noise. */
+#define TEST_NOISE     100.
+
+
+/** Returns a tone in white noise. */
+static std::vector<int16_t>
+signal(double amplitude, size_t n) {
+  std::mt19937 rng(1);
+  std::normal_distribution<double> noise(0, TEST_NOISE);
+  std::vector<int16_t> samples(n);
+  for (size_t i=0; i<n; i++) {
+    samples[i] = int16_t(std::round(amplitude*std::cos(2*M_PI*TEST_FREQUENCY*i/TEST_RATE)
+                                    + noise(rng)));
+  }
+  return samples;
+}
+
+/** Returns the mean of the estimate over all bins but DC, Nyquist and those around the tone. */
+static double
+noiseLevel(const WelchPSD &psd) {
+  double sum = 0; size_t n = 0, tone = psd.bin(TEST_FREQUENCY);
+  for (size_t i=1; i<psd.numBins()-1; i++) {
+    if ((i+2 >= tone) && (i <= tone+2)) { continue; }
+    sum += psd.psd()[i]; n++;
+  }
+  return sum/n;
+}
+
+/** Feeds the samples in pieces and returns the number of completed estimates. */
+static size_t
+feed(WelchPSD &psd, const std::vector<int16_t> &samples) {
+  size_t offset = 0, completed = 0;
+  while (offset < samples.size()) {
+    offset += psd.process(samples.data()+offset, std::min(samples.size()-offset, size_t(1000)));
+    if (psd.completed()) { completed++; }
+  }
+  return completed;
+}
+
+/** Reports the result of a check. */
+static bool
+report(bool ok, const char *name, QTextStream &out) {
+  out << (ok ? "ok   " : "FAIL ") << name << "\n";
+  return ok;
+}
+
+/** Checks frame size, hop and bin mapping. */
+static bool
+testFrames(QTextStream &out, FFTPlanCache &plans) {
+  WelchPSD psd(plans, TEST_RATE, TEST_RESOLUTION, 0.75);
+  bool ok = (920 == psd.size()) && (230 == psd.hop()) && (461 == psd.numBins());
+  ok &= (TEST_RESOLUTION == psd.resolution()) && (396 == psd.bin(TEST_FREQUENCY))
+      && (TEST_FREQUENCY == psd.frequency(396)) && (460 == psd.bin(1e6)) && (0 == psd.bin(-10));
+  // The first frame after 920 samples, then one per hop, an estimate per 8 frames
+  ok &= (2 == feed(psd, signal(TEST_AMPLITUDE, 920+15*230)));
+  return report(ok, "frames", out);
+}
+
+/** Checks the normalization of the linear average for noise and a tone. */
+static bool
+testLinear(QTextStream &out, FFTPlanCache &plans) {
+  WelchPSD psd(plans, TEST_RATE, TEST_RESOLUTION, 0.5, WindowFunction::HANN, WelchPSD::LINEAR,
+               64);
+  bool ok = (1 == feed(psd, signal(TEST_AMPLITUDE, 920+63*460)));
+  // White noise yields its variance in each bin
+  double level = noiseLevel(psd);
+  ok &= (std::abs(level/(TEST_NOISE*TEST_NOISE)-1) < 0.05);
+  // A tone in the center of a bin yields (A/2)^2*sum(w)^2/sum(w^2), that is A^2*N/6 for Hann
+  double tone = psd.psd()[psd.bin(TEST_FREQUENCY)];
+  ok &= (std::abs(tone/(TEST_AMPLITUDE*TEST_AMPLITUDE*psd.size()/6)-1) < 0.01);
+  out << "linear: noise " << 10*std::log10(level/(TEST_NOISE*TEST_NOISE)) << "dB, tone "
+      << 10*std::log10(tone/(TEST_AMPLITUDE*TEST_AMPLITUDE*psd.size()/6)) << "dB\n";
+  return report(ok, "linear", out);
+}
+
+/** Checks that the exponential average converges to the linear one, the maximum hold stays above
+ * it and reset clears the estimate. */
+static bool
+testAveraging(QTextStream &out, FFTPlanCache &plans) {
+  std::vector<int16_t> samples = signal(0, 920+199*460);
+  WelchPSD exponential(plans, TEST_RATE, TEST_RESOLUTION, 0.5, WindowFunction::HANN,
+                       WelchPSD::EXPONENTIAL, 16);
+  WelchPSD maxHold(plans, TEST_RATE, TEST_RESOLUTION, 0.5, WindowFunction::HANN,
+                   WelchPSD::MAX_HOLD);
+  // Both update per frame
+  bool ok = (200 == feed(exponential, samples)) && (200 == feed(maxHold, samples));
+  double variance = TEST_NOISE*TEST_NOISE;
+  ok &= (std::abs(noiseLevel(exponential)/variance-1) < 0.1);
+  // The maximum of 200 exponentially distributed values is about ln(200) = 5.3 times their mean
+  ok &= (noiseLevel(maxHold) > 4*variance) && (noiseLevel(maxHold) < 7*variance);
+  maxHold.reset();
+  ok &= (0 == noiseLevel(maxHold)) && (! maxHold.completed());
+  return report(ok, "averaging", out);
+}
+
+
+int main(int argc, char *argv[])
+{
+  QTextStream out(stdout);
+  QTemporaryDir dir;
+  FFTPlanCache plans(dir.filePath("fftwf.wisdom"));
+  bool ok = testFrames(out, plans);
+  ok &= testLinear(out, plans);
+  ok &= testAveraging(out, plans);
+  return ok ? 0 : 1;
+}